@@ -0,0 +1,551 @@
+/************************************************************************************//**
+* \file         busload.c
+* \brief        Bus load monitor source file.
+* \details      Calculates the bus load from the received and transmitted CAN messages.
+*               Each CAN message counts with its exact length on the CAN bus, from the
+*               start of frame bit up to and including the intermission. The number of
+*               stuff bits is either the worst case for its data length, or the exact
+*               number for its identifier, data and CRC.
+*
+*               For the exact number, the frame is assembled as bytes, padded at the
+*               front to a byte boundary with zero bits. These do not change the CRC,
+*               because it starts at zero, so a table calculates it a byte at a time.
+*               The stuffing itself is a small state machine: the value of the last bit
+*               and the number of equal bits in a row. A table holds the number of stuff
+*               bits and the next state for each state and byte, so that counting them
+*               also takes one table access per byte.
+*
+*               The bits are added to the bucket of the current time. The sliding window
+*               holds the latest BUSLOAD_BUCKETS completed buckets and its bus load is
+*               the sum of their bits, relative to what the bitrate allows in a window.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "busload.h"                        /* Bus load monitor                        */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Generator polynomial of the CRC of a CAN frame, without the x^15 term. */
+#define BUSLOAD_CRC_POLYNOMIAL         (0x4599U)
+
+/** \brief Number of stuffed bits of a frame with an 11-bit identifier, without the data
+ *  bytes: start of frame, identifier, RTR, IDE, r0, DLC and CRC.
+ */
+#define BUSLOAD_STD_STUFFED_BITS       (34U)
+
+/** \brief Number of stuffed bits of a frame with a 29-bit identifier, without the data
+ *  bytes: start of frame, identifier, SRR, IDE, RTR, r1, r0, DLC and CRC.
+ */
+#define BUSLOAD_EXT_STUFFED_BITS       (54U)
+
+/** \brief Number of bits at the end of a frame that are not stuffed: CRC delimiter, ACK
+ *  slot, ACK delimiter, end of frame and intermission.
+ */
+#define BUSLOAD_TRAILER_BITS           (13U)
+
+/** \brief Number of states of the stuffing state machine. The state is the value of the
+ *  last bit times four, plus the number of equal bits in a row minus one.
+ */
+#define BUSLOAD_STUFF_STATES           (8U)
+
+/** \brief Initial state of the stuffing state machine: one zero bit. */
+#define BUSLOAD_STUFF_START            (0U)
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Table with the CRC of each byte value. */
+static uint16_t busloadCrcTable[256];
+
+/** \brief Table with the number of stuff bits of a byte times eight, plus the next
+ *  state, for each state and byte value.
+ */
+static uint8_t busloadStuffTable[BUSLOAD_STUFF_STATES][256];
+
+/** \brief Configuration of the bus load monitor. Protected by the mutex. */
+static tBusloadConfig busloadConfig;
+
+/** \brief Time of one bucket in microseconds. */
+static uint64_t busloadBucketTime;
+
+/** \brief Number of the bucket that collects the bits of the current time. */
+static uint64_t busloadBucket;
+
+/** \brief True once the bucket number follows the time of the CAN messages. */
+static bool     busloadSynced;
+
+/** \brief Bits of the received and transmitted CAN messages in the current bucket. */
+static uint64_t busloadRxCurrent;
+static uint64_t busloadTxCurrent;
+
+/** \brief Bits of the received and transmitted CAN messages in each bucket of the
+ *  window. Bucket n is at index n modulo BUSLOAD_BUCKETS.
+ */
+static uint64_t busloadRxBuckets[BUSLOAD_BUCKETS];
+static uint64_t busloadTxBuckets[BUSLOAD_BUCKETS];
+
+/** \brief Bits of the received and transmitted CAN messages in the window. */
+static uint64_t busloadRxWindow;
+static uint64_t busloadTxWindow;
+
+/** \brief Highest number of bits in the window. */
+static uint64_t busloadPeak;
+
+/** \brief Totals since the start. */
+static uint64_t busloadRxFrames;
+static uint64_t busloadTxFrames;
+static uint64_t busloadRxBits;
+static uint64_t busloadTxBits;
+
+/** \brief Mutex that protects the buckets and the totals. CAN messages are transmitted
+ *  from any thread.
+ */
+static mtx_t busloadMutex;
+
+/** \brief Atomic boolean that is set while the bus load monitor runs. */
+static atomic_bool busloadRunning;
+
+/** \brief Copy of the stuff bit setting of the configuration, for determining the
+ *  length of a frame without the mutex.
+ */
+static atomic_bool busloadExactStuffing;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void     BusloadAdvance(uint64_t timestamp);
+static uint32_t BusloadStuffBits(uint32_t * state, uint32_t value, uint32_t count);
+
+
+/************************************************************************************//**
+** \brief     Initializes the bus load monitor. Builds the tables for the CRC and the
+**            stuff bits. The bus load monitor itself is only started with
+**            BusloadStart().
+**
+****************************************************************************************/
+void BusloadInit(void)
+{
+  uint32_t crc;
+  uint32_t state;
+  uint32_t count;
+
+  /* Initialize locals. */
+  atomic_init(&busloadRunning, false);
+  atomic_init(&busloadExactStuffing, false);
+  if (mtx_init(&busloadMutex, mtx_plain) != thrd_success)
+  {
+    assert(false);
+  }
+
+  /* Build the CRC table, by shifting each byte value through the CRC register. */
+  for (uint32_t value = 0; value < 256U; value++)
+  {
+    crc = value << 7;
+    for (uint32_t bit = 0; bit < 8U; bit++)
+    {
+      crc = ((crc & 0x4000U) != 0) ? ((crc << 1) ^ BUSLOAD_CRC_POLYNOMIAL) : (crc << 1);
+    }
+    busloadCrcTable[value] = (uint16_t)(crc & 0x7FFFU);
+  }
+
+  /* Build the stuffing table, by running each byte value through the state machine
+   * from each state, one bit at a time.
+   */
+  for (uint32_t start = 0; start < BUSLOAD_STUFF_STATES; start++)
+  {
+    for (uint32_t value = 0; value < 256U; value++)
+    {
+      state = start;
+      count = BusloadStuffBits(&state, value, 8U);
+      busloadStuffTable[start][value] = (uint8_t)((count << 3) | state);
+    }
+  }
+} /*** end of BusloadInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the bus load monitor. Stops it, in case it still runs.
+**
+****************************************************************************************/
+void BusloadTerminate(void)
+{
+  /* Stop the bus load monitor and release the mutex. */
+  BusloadStop();
+  mtx_destroy(&busloadMutex);
+} /*** end of BusloadTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts monitoring the bus load. Call it from OnPreStart to include all CAN
+**            messages from the start.
+** \param     config Pointer to the bus load monitor configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool BusloadStart(tBusloadConfig const * config)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter and when not yet running. */
+  if ( (config != NULL) && (config->bitrate > 0) && (config->window > 0) &&
+       (!atomic_load(&busloadRunning)) )
+  {
+    mtx_lock(&busloadMutex);
+    /* Store the configuration and empty the window. */
+    busloadConfig = *config;
+    atomic_store_explicit(&busloadExactStuffing, config->exactStuffing,
+                          memory_order_relaxed);
+    busloadBucketTime = ((uint64_t)config->window * 1000U) / BUSLOAD_BUCKETS;
+    if (busloadBucketTime == 0)
+    {
+      busloadBucketTime = 1U;
+    }
+    busloadBucket = 0;
+    busloadSynced = false;
+    busloadRxCurrent = 0;
+    busloadTxCurrent = 0;
+    memset(busloadRxBuckets, 0, sizeof(busloadRxBuckets));
+    memset(busloadTxBuckets, 0, sizeof(busloadTxBuckets));
+    busloadRxWindow = 0;
+    busloadTxWindow = 0;
+    busloadPeak = 0;
+    busloadRxFrames = 0;
+    busloadTxFrames = 0;
+    busloadRxBits = 0;
+    busloadTxBits = 0;
+    mtx_unlock(&busloadMutex);
+    atomic_store_explicit(&busloadRunning, true, memory_order_release);
+    result = true;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of BusloadStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops monitoring the bus load. The statistics keep their last values.
+**
+****************************************************************************************/
+void BusloadStop(void)
+{
+  /* No longer accept CAN messages. */
+  atomic_store_explicit(&busloadRunning, false, memory_order_release);
+} /*** end of BusloadStop ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a received or transmitted CAN message to the bus load, if the monitor
+**            runs. Can be called from any thread.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+**
+****************************************************************************************/
+void BusloadMessage(tCanMsg const * msg, bool transmitted)
+{
+  uint32_t bits;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when running. */
+  if ( (msg != NULL) && (atomic_load_explicit(&busloadRunning, memory_order_acquire)) )
+  {
+    /* The length of the frame does not depend on the window, so determine it before
+     * taking the mutex. The configuration can change during a restart, so use the
+     * atomic copy of the stuff bit setting.
+     */
+    bits = BusloadFrameBits(msg, atomic_load_explicit(&busloadExactStuffing,
+                                                      memory_order_relaxed));
+    mtx_lock(&busloadMutex);
+    /* Move the window up to the time of the CAN message and add its bits. */
+    BusloadAdvance(msg->timestamp);
+    if (transmitted)
+    {
+      busloadTxCurrent += bits;
+      busloadTxFrames++;
+      busloadTxBits += bits;
+    }
+    else
+    {
+      busloadRxCurrent += bits;
+      busloadRxFrames++;
+      busloadRxBits += bits;
+    }
+    mtx_unlock(&busloadMutex);
+  }
+} /*** end of BusloadMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the bus load statistics. Can be called from any thread. The window
+**            is moved up to the current time first, so it also covers the time since
+**            the latest CAN message.
+** \param     stats Pointer to where the statistics are stored.
+** \return    True if successful, false if the bus load monitor was never started.
+**
+****************************************************************************************/
+bool BusloadGetStats(tBusloadStats * stats)
+{
+  bool result = false;
+  double capacity;
+
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    mtx_lock(&busloadMutex);
+    /* Only continue when started at least once. */
+    if (busloadConfig.bitrate > 0)
+    {
+      if ( (atomic_load(&busloadRunning)) && (busloadSynced) )
+      {
+        BusloadAdvance(UtilSystemTime() - CanStartTime());
+      }
+      /* Relate the bits to the number of bits that fit in a window. */
+      capacity = (double)busloadConfig.bitrate * (double)busloadBucketTime *
+                 (double)BUSLOAD_BUCKETS / 1e6;
+      stats->rxLoad = (double)busloadRxWindow * 100.0 / capacity;
+      stats->txLoad = (double)busloadTxWindow * 100.0 / capacity;
+      stats->load = stats->rxLoad + stats->txLoad;
+      stats->peak = (double)busloadPeak * 100.0 / capacity;
+      stats->rxFrames = busloadRxFrames;
+      stats->txFrames = busloadTxFrames;
+      stats->rxBits = busloadRxBits;
+      stats->txBits = busloadTxBits;
+      result = true;
+    }
+    mtx_unlock(&busloadMutex);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of BusloadGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Calculates the number of bits that a CAN message takes up on the CAN bus,
+**            from the start of frame bit up to and including the intermission.
+** \param     msg Pointer to the CAN message.
+** \param     exactStuffing True to count the stuff bits that the frame actually needs,
+**            false to assume the worst case.
+** \return    Number of bits.
+**
+****************************************************************************************/
+uint32_t BusloadFrameBits(tCanMsg const * msg, bool exactStuffing)
+{
+  uint32_t result = 0;
+  uint8_t frame[5U + CAN_DATA_LEN_MAX];
+  uint32_t len;
+  uint32_t headerLen;
+  uint32_t padding;
+  uint64_t header;
+  uint8_t entry;
+  uint32_t crc = 0;
+  uint32_t state = BUSLOAD_STUFF_START;
+  uint32_t stuffed;
+  uint32_t stuffBits = 0;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter. */
+  if (msg != NULL)
+  {
+    len = (msg->len < CAN_DATA_LEN_MAX) ? msg->len : CAN_DATA_LEN_MAX;
+    /* Assemble the bits from the start of frame up to the data length code. The start
+     * of frame is a zero bit. Frames with an 11-bit identifier have 19 of them, padded
+     * to 3 bytes. Frames with a 29-bit identifier have 39, with recessive SRR and IDE
+     * bits, padded to 5 bytes. The RTR and reserved bits are zero.
+     */
+    if (!msg->ext)
+    {
+      stuffed = BUSLOAD_STD_STUFFED_BITS + (len * 8U);
+      header = ((uint64_t)(msg->id & 0x7FFU) << 7) | len;
+      headerLen = 3U;
+      padding = 0xA8U;
+    }
+    else
+    {
+      stuffed = BUSLOAD_EXT_STUFFED_BITS + (len * 8U);
+      header = ((uint64_t)((msg->id >> 18) & 0x7FFU) << 27) | (3ULL << 25) |
+               ((uint64_t)(msg->id & 0x3FFFFU) << 7) | len;
+      headerLen = 5U;
+      padding = 0x80U;
+    }
+    for (uint32_t idx = 0; idx < headerLen; idx++)
+    {
+      frame[idx] = (uint8_t)(header >> ((headerLen - 1U - idx) * 8U));
+    }
+    memcpy(&frame[headerLen], msg->data, len);
+
+    /* Count the stuff bits that the frame actually needs. */
+    if (exactStuffing)
+    {
+      /* Calculate the CRC and run the bits through the stuffing state machine, from the
+       * start of frame up to the data, a byte at a time. Both are independent, so the
+       * CPU works on them in parallel. For the stuffing, the padding alternates,
+       * starting with a one, so that it cannot cause a stuff bit and the start of frame
+       * bit starts a new row.
+       */
+      entry = busloadStuffTable[state][frame[0] | padding];
+      stuffBits = entry >> 3;
+      state = entry & 0x07U;
+      crc = busloadCrcTable[frame[0]];
+      for (uint32_t idx = 1; idx < (headerLen + len); idx++)
+      {
+        entry = busloadStuffTable[state][frame[idx]];
+        stuffBits += entry >> 3;
+        state = entry & 0x07U;
+        crc = ((crc << 8) ^ busloadCrcTable[(crc >> 7) ^ frame[idx]]) & 0x7FFFU;
+      }
+      /* Followed by the CRC. Its last seven bits are completed to a byte with the
+       * opposite of the last bit, which cannot cause a stuff bit.
+       */
+      entry = busloadStuffTable[state][crc >> 7];
+      stuffBits += entry >> 3;
+      state = entry & 0x07U;
+      entry = busloadStuffTable[state][((crc << 1) & 0xFEU) | ((crc & 1U) ^ 1U)];
+      stuffBits += entry >> 3;
+    }
+    /* Otherwise assume the worst case: after the first stuff bit, which needs five
+     * bits, every four bits need one.
+     */
+    else
+    {
+      stuffBits = (stuffed - 1U) / 4U;
+    }
+    result = stuffed + stuffBits + BUSLOAD_TRAILER_BITS;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of BusloadFrameBits ***/
+
+
+/************************************************************************************//**
+** \brief     Moves the window up to the bucket of the specified time. Each bucket that
+**            completes enters the window and pushes the oldest one out. Must be called
+**            with the mutex locked.
+** \param     timestamp Time in microseconds, relative to the start of the CAN driver.
+**
+****************************************************************************************/
+static void BusloadAdvance(uint64_t timestamp)
+{
+  uint64_t bucket = timestamp / busloadBucketTime;
+  size_t idx;
+
+  /* The first CAN message determines where the window starts. The CAN driver might not
+   * have been connected yet when the bus load monitor started.
+   */
+  if (!busloadSynced)
+  {
+    busloadBucket = bucket;
+    busloadSynced = true;
+  }
+  /* Only continue if the current bucket completed. */
+  if (bucket > busloadBucket)
+  {
+    /* Move the current bucket into the window. */
+    idx = (size_t)(busloadBucket % BUSLOAD_BUCKETS);
+    busloadRxWindow += busloadRxCurrent - busloadRxBuckets[idx];
+    busloadTxWindow += busloadTxCurrent - busloadTxBuckets[idx];
+    busloadRxBuckets[idx] = busloadRxCurrent;
+    busloadTxBuckets[idx] = busloadTxCurrent;
+    busloadRxCurrent = 0;
+    busloadTxCurrent = 0;
+    busloadBucket++;
+    if ((busloadRxWindow + busloadTxWindow) > busloadPeak)
+    {
+      busloadPeak = busloadRxWindow + busloadTxWindow;
+    }
+    /* Empty buckets follow until the specified time. After a whole window of them, the
+     * window is empty.
+     */
+    if ((bucket - busloadBucket) >= BUSLOAD_BUCKETS)
+    {
+      memset(busloadRxBuckets, 0, sizeof(busloadRxBuckets));
+      memset(busloadTxBuckets, 0, sizeof(busloadTxBuckets));
+      busloadRxWindow = 0;
+      busloadTxWindow = 0;
+      busloadBucket = bucket;
+    }
+    while (busloadBucket < bucket)
+    {
+      idx = (size_t)(busloadBucket % BUSLOAD_BUCKETS);
+      busloadRxWindow -= busloadRxBuckets[idx];
+      busloadTxWindow -= busloadTxBuckets[idx];
+      busloadRxBuckets[idx] = 0;
+      busloadTxBuckets[idx] = 0;
+      busloadBucket++;
+    }
+  }
+} /*** end of BusloadAdvance ***/
+
+
+/************************************************************************************//**
+** \brief     Runs bits through the stuffing state machine, one at a time. After five
+**            equal bits in a row, a stuff bit with the opposite value follows. It counts
+**            as the first bit of the next row.
+** \param     state Pointer to the state, which is updated.
+** \param     value The bits, with the last one in the least significant bit.
+** \param     count Number of bits.
+** \return    Number of stuff bits.
+**
+****************************************************************************************/
+static uint32_t BusloadStuffBits(uint32_t * state, uint32_t value, uint32_t count)
+{
+  uint32_t result = 0;
+  uint32_t last = *state >> 2;
+  uint32_t run = (*state & 0x03U) + 1U;
+  uint32_t bit;
+
+  for (uint32_t idx = count; idx > 0; idx--)
+  {
+    bit = (value >> (idx - 1U)) & 1U;
+    if (bit == last)
+    {
+      run++;
+      /* Insert a stuff bit after five equal bits. */
+      if (run == 5U)
+      {
+        result++;
+        last = bit ^ 1U;
+        run = 1U;
+      }
+    }
+    else
+    {
+      last = bit;
+      run = 1U;
+    }
+  }
+
+  /* Store the new state and give the result back to the caller. */
+  *state = (last << 2) | (run - 1U);
+  return result;
+} /*** end of BusloadStuffBits ***/
+
+
+/*********************************** end of busload.c **********************************/
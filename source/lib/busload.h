@@ -0,0 +1,81 @@
+/************************************************************************************//**
+* \file         busload.h
+* \brief        Bus load monitor header file.
+*
+****************************************************************************************/
+#ifndef BUSLOAD_H
+#define BUSLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of buckets that the sliding window is divided into. The window slides
+ *  ahead one bucket at a time.
+ */
+#ifndef BUSLOAD_BUCKETS
+#define BUSLOAD_BUCKETS                (100U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Configuration of the bus load monitor. */
+typedef struct
+{
+  /** \brief Bitrate of the CAN bus in bits per second. */
+  uint32_t bitrate;
+  /** \brief Length of the sliding window in milliseconds. At least one. */
+  uint32_t window;
+  /** \brief True to count the stuff bits that the identifier and data of each CAN
+   *  message actually need, false to assume the worst case.
+   */
+  bool     exactStuffing;
+} tBusloadConfig;
+
+/** \brief Bus load monitor statistics. The loads are in percent of the bitrate. */
+typedef struct
+{
+  /** \brief Bus load of the received and transmitted CAN messages over the latest
+   *  window.
+   */
+  double   load;
+  /** \brief Bus load of the received CAN messages over the latest window. */
+  double   rxLoad;
+  /** \brief Bus load of the transmitted CAN messages over the latest window. */
+  double   txLoad;
+  /** \brief Highest bus load over a window since the start. */
+  double   peak;
+  /** \brief Number of received CAN messages since the start. */
+  uint64_t rxFrames;
+  /** \brief Number of transmitted CAN messages since the start. */
+  uint64_t txFrames;
+  /** \brief Number of bits on the CAN bus of the received CAN messages. */
+  uint64_t rxBits;
+  /** \brief Number of bits on the CAN bus of the transmitted CAN messages. */
+  uint64_t txBits;
+} tBusloadStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void     BusloadInit(void);
+void     BusloadTerminate(void);
+bool     BusloadStart(tBusloadConfig const * config);
+void     BusloadStop(void);
+void     BusloadMessage(tCanMsg const * msg, bool transmitted);
+bool     BusloadGetStats(tBusloadStats * stats);
+uint32_t BusloadFrameBits(tCanMsg const * msg, bool exactStuffing);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUSLOAD_H */
+/*********************************** end of busload.h **********************************/
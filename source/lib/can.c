@@ -22,8 +22,18 @@
 #include <sys/ioctl.h>                      /* I/O control operations                  */
 #include <threads.h>                        /* Multithreading                          */
 #include <stdatomic.h>                      /* Atomic operations                       */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/eventfd.h>                    /* Event notification file descriptor      */
 #include "util.h"                           /* Utility functions                       */
+#include "loop.h"                           /* Event loop driver                       */
 #include "can.h"                            /* CAN driver                              */
+#include "format.h"                         /* CAN message text formatter              */
+#include "timer.h"                          /* Timer driver                            */
+#include "seq.h"                            /* Coroutine based test sequences          */
+#include "replay.h"                         /* Log file replay                         */
+#if (CAN_IO_URING > 0)
+#include "canuring.h"                       /* CAN io_uring backend                    */
+#endif
 
 
 /****************************************************************************************
@@ -32,6 +42,19 @@
 /** \brief Value of an invalid socket. */
 #define CAN_INVALID_SOCKET             (-1)
 
+/** \brief Number of CAN messages that are delivered per event loop iteration in offline
+ *  mode. Keeps the event loop responsive to other events, such as a key press.
+ */
+#define CAN_OFFLINE_BATCH              (1024U)
+
+/** \brief Configuration macro to select the io_uring backend for the CAN socket I/O.
+ *  Set by the CAPLIN_IO_URING build option. The plain read/write backend is the
+ *  default.
+ */
+#ifndef CAN_IO_URING
+#define CAN_IO_URING                   (0)
+#endif
+
 
 /****************************************************************************************
 * Local data declarations
@@ -73,11 +96,54 @@ static volatile uint64_t canStartTime;
  */
 static volatile bool canConnected;
 
+/** \brief Acceptance filters that are configured on the socket. The socket receives all
+ *  CAN messages when there are none.
+ */
+static tCanFilter canFilters[CAN_FILTERS_MAX];
+
+/** \brief Number of configured acceptance filters. */
+static size_t canFilterCount;
+
+/** \brief Traffic counters. Atomic because they are updated from the event thread and
+ *  from the threads that transmit.
+ */
+static atomic_uint_fast64_t canRxCount;
+static atomic_uint_fast64_t canTxCount;
+static atomic_uint_fast64_t canTxErrors;
+
+/** \brief Log file that supplies the CAN messages in offline mode. Its file pointer is
+ *  NULL when not in offline mode.
+ */
+static tReplayFile canOfflineFile;
+
+/** \brief Next CAN message from the log file in offline mode. */
+static tCanMsg canOfflineMsg;
+
+/** \brief Boolean flag that is set while canOfflineMsg holds a CAN message that was not
+ *  yet delivered.
+ */
+static bool canOfflineMsgValid;
+
+/** \brief Event file descriptor that stays signalled while connected in offline mode,
+ *  such that the event loop keeps delivering the CAN messages.
+ */
+static int canOfflineFd;
+
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
 static int CanEventThread(void * param);
+static void CanLoopEvent(int fd, uint32_t events, void * context);
+static void CanOfflineLoopEvent(int fd, uint32_t events, void * context);
+static void CanFrameReceived(struct can_frame const * frame);
+static bool CanApplyFilters(void);
+static bool CanOfflineAccept(tCanMsg const * msg);
+#if (CAN_IO_URING > 0)
+static void CanFrameTransmitted(tCanMsg const * msg);
+#else
+static void CanProcessReceived(void);
+#endif
 
 
 /************************************************************************************//**
@@ -99,6 +165,13 @@ void CanInit(tCanReceivedCallback rxCallbackFcn, tCanTransmittedCallback txCallb
   atomic_init(&canStopEventThread, false);
   canStartTime = 0;
   canConnected = false;
+  canFilterCount = 0;
+  atomic_init(&canRxCount, 0);
+  atomic_init(&canTxCount, 0);
+  atomic_init(&canTxErrors, 0);
+  canOfflineFile.file = NULL;
+  canOfflineMsgValid = false;
+  canOfflineFd = CAN_INVALID_SOCKET;
 
   /* Initialize the mutex. */
   if (mtx_init(&canSocketMutex, mtx_plain) != thrd_success)
@@ -124,6 +197,10 @@ void CanTerminate(void)
   /* Disconnect from the CAN bus. */
   CanDisconnect();
 
+  /* Close the log file of the offline mode. */
+  ReplayFileClose(&canOfflineFile);
+  canOfflineMsgValid = false;
+
   /* Destroy the mutex. */
   mtx_destroy(&canSocketMutex);
 
@@ -151,8 +228,29 @@ bool CanConnect(char const * device)
   /* Verify parameter. */
   assert(device != NULL);
 
+  /* In offline mode, the CAN messages come from the log file instead of a socket. */
+  if ( (device != NULL) && (canOfflineFile.file != NULL) )
+  {
+    /* Make sure we are in the disconnected state. */
+    CanDisconnect();
+    canStartTime = UtilSystemTime();
+
+    /* The event loop delivers the CAN messages, once it runs. An event file descriptor
+     * that stays signalled keeps it going.
+     */
+    canOfflineFd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (canOfflineFd != CAN_INVALID_SOCKET)
+    {
+      result = LoopAdd(canOfflineFd, EPOLLIN, CanOfflineLoopEvent, NULL);
+      if (!result)
+      {
+        close(canOfflineFd);
+        canOfflineFd = CAN_INVALID_SOCKET;
+      }
+    }
+  }
   /* Only continue with valid parameter. */
-  if (device != NULL)
+  else if (device != NULL)
   {
     /* Set positive result at this point and negate upon error detected. */
     result = true;
@@ -216,10 +314,53 @@ bool CanConnect(char const * device)
 
     if (result)
     {
+      /* Configure the acceptance filters, if any were set. */
+      if ( (canFilterCount > 0) && (!CanApplyFilters()) )
+      {
+        close(canSocket);
+        result = false;
+      }
+    }
+
+#if (CAN_IO_URING > 0)
+    if (result)
+    {
+      /* Hand the socket I/O over to the io_uring backend. */
+      if (!CanUringInit(canSocket, CanFrameReceived, CanFrameTransmitted))
+      {
+        close(canSocket);
+        result = false;
+      }
+    }
+#endif
+
+    if (result)
+    {
+      /* Is the socket serviced by the event loop? */
+      if (LoopSingleThreaded())
+      {
+        /* Register the socket with the event loop. With the io_uring backend, it is the
+         * ring that reports the completions.
+         */
+#if (CAN_IO_URING > 0)
+        if (!LoopAdd(CanUringGetFd(), EPOLLIN, CanLoopEvent, NULL))
+        {
+          CanUringTerminate();
+#else
+        if (!LoopAdd(canSocket, EPOLLIN, CanLoopEvent, NULL))
+        {
+#endif
+          close(canSocket);
+          result = false;
+        }
+      }
       /* Start the event thread. */
-      if (thrd_create(&canEventThreadId, (thrd_start_t)CanEventThread, NULL) 
-          != thrd_success)
+      else if (thrd_create(&canEventThreadId, (thrd_start_t)CanEventThread, NULL) 
+               != thrd_success)
       {
+#if (CAN_IO_URING > 0)
+        CanUringTerminate();
+#endif
         close(canSocket);
         result = false;
       }
@@ -253,6 +394,10 @@ void CanDisconnect(void)
   {
     /* Set atomic boolean flag to request the thread to stop. */
     atomic_store(&canStopEventThread, true);
+#if (CAN_IO_URING > 0)
+    /* The thread blocks on the ring, so make it return. */
+    CanUringWakeup();
+#endif
     /* Wait until the thread terminated. */
     thrd_join(canEventThreadId, NULL);
   }
@@ -260,9 +405,24 @@ void CanDisconnect(void)
   /* Close the socket. */
   if (canSocket != CAN_INVALID_SOCKET)
   {
+    /* Unregister it from the event loop, in case it was registered. */
+#if (CAN_IO_URING > 0)
+    LoopRemove(CanUringGetFd());
+    CanUringTerminate();
+#else
+    LoopRemove(canSocket);
+#endif
     close(canSocket);
   }
 
+  /* Stop delivering the CAN messages of the offline mode. */
+  if (canOfflineFd != CAN_INVALID_SOCKET)
+  {
+    LoopRemove(canOfflineFd);
+    close(canOfflineFd);
+    canOfflineFd = CAN_INVALID_SOCKET;
+  }
+
   /* Reset locals. */
   canStartTime = 0;
   atomic_init(&canStopEventThread, false);
@@ -287,8 +447,19 @@ bool CanTransmit(tCanMsg const * msg)
   /* Verify parameter. */
   assert(msg != NULL);
 
+  /* In offline mode, there is no CAN bus. The message is only reported as transmitted. */
+  if ( (msg != NULL) && (canConnected) && (canOfflineFile.file != NULL) )
+  {
+    txMsg = *msg;
+    txMsg.timestamp = UtilSystemTime() - canStartTime;
+    result = true;
+    if (canTransmittedCallback != NULL)
+    {
+      canTransmittedCallback(&txMsg);
+    }
+  }
   /* Only continue with valid parameter and when connected. */
-  if ( (msg != NULL) && (canConnected) )
+  else if ( (msg != NULL) && (canConnected) )
   {
     /* Copy the message so we can set the timestamp later on. */
     txMsg = *msg;
@@ -305,6 +476,15 @@ bool CanTransmit(tCanMsg const * msg)
       canTxFrame.data[idx] = msg->data[idx];
     }
 
+#if (CAN_IO_URING > 0)
+    /* Set the timestamp. */
+    txMsg.timestamp = UtilSystemTime() - canStartTime;
+    /* Submit the message for transmission. The backend calls the message transmitted
+     * callback, once the kernel completed the request.
+     */
+    result = CanUringTransmit(&canTxFrame, &txMsg);
+  }
+#else
     /* Submit the message for transmission. */
     mtx_lock(&canSocketMutex);   
     /* Set the timestamp. */
@@ -326,6 +506,17 @@ bool CanTransmit(tCanMsg const * msg)
       canTransmittedCallback(&txMsg);
     }
   }
+#endif
+
+  /* Update the traffic counters. */
+  if (result)
+  {
+    atomic_fetch_add_explicit(&canTxCount, 1, memory_order_relaxed);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(&canTxErrors, 1, memory_order_relaxed);
+  }
   
   /* Give the result back to the caller. */
   return result;
@@ -339,21 +530,167 @@ bool CanTransmit(tCanMsg const * msg)
 ****************************************************************************************/
 void CanPrintMessage(tCanMsg const * msg)
 {
-  /* Print timestamp. */
-  printf("(%.6f)", (float)msg->timestamp/(1000 * 1000));
-  /* Print identifier. */
-  printf(" %x", msg->id);
-  msg->ext ? printf("x") : printf(" ");
-  /* Print payload length. */
-  printf(" [%d]", msg->len);
-  /* Print data bytes. */
-  for (uint8_t idx = 0; idx < msg->len; idx++)
+  static const tFormatConfig config = { .style = FORMAT_CAPLIN };
+  char line[FORMAT_LINE_MAX];
+  size_t len;
+
+  /* Render the message and print it with one call. Going through stdio keeps it in
+   * order with the application's own output.
+   */
+  len = FormatMessage(&config, msg, line, sizeof(line));
+  (void)fwrite(line, 1, len, stdout);
+} /*** end of CanPrintMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if the CAN message passes the acceptance filter.
+** \param     filter Pointer to the acceptance filter.
+** \param     msg Pointer to the CAN message.
+** \return    True if the CAN message matches the filter, false otherwise.
+**
+****************************************************************************************/
+bool CanFilterMatch(tCanFilter const * filter, tCanMsg const * msg)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert(filter != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (filter != NULL) && (msg != NULL) )
   {
-    printf(" %02x", msg->data[idx]);
+    /* Compare the identifier type and the masked identifier bits. */
+    if ( (msg->ext == filter->ext) && 
+         (((msg->id ^ filter->id) & filter->mask) == 0) )
+    {
+      result = true;
+    }
   }
-  /* Add line ending. */
-  printf("\n");
-} /*** end of CanPrintMessage ***/
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanFilterMatch ***/
+
+
+/************************************************************************************//**
+** \brief     Configures the acceptance filters of the socket, such that the kernel
+**            already drops the CAN messages that the application is not interested in.
+**            Takes effect right away when connected and is kept for later connections.
+** \param     filters Array with the acceptance filters. A CAN message is received when
+**            it matches at least one of them.
+** \param     count Number of acceptance filters. Zero to receive all CAN messages.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool CanSetFilters(tCanFilter const * filters, size_t count)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert( (filters != NULL) || (count == 0) );
+  assert(count <= CAN_FILTERS_MAX);
+
+  /* Only continue with valid parameters. */
+  if ( ((filters != NULL) || (count == 0)) && (count <= CAN_FILTERS_MAX) )
+  {
+    /* Store the filters. */
+    for (size_t idx = 0; idx < count; idx++)
+    {
+      canFilters[idx] = filters[idx];
+    }
+    canFilterCount = count;
+    /* Configure them on the socket, if connected. */
+    result = true;
+    if (canSocket != CAN_INVALID_SOCKET)
+    {
+      result = CanApplyFilters();
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanSetFilters ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the traffic counters of the CAN driver.
+** \param     stats Pointer to where the counters are stored.
+**
+****************************************************************************************/
+void CanGetStats(tCanStats * stats)
+{
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    stats->rxCount = atomic_load_explicit(&canRxCount, memory_order_relaxed);
+    stats->txCount = atomic_load_explicit(&canTxCount, memory_order_relaxed);
+    stats->txErrors = atomic_load_explicit(&canTxErrors, memory_order_relaxed);
+  }
+} /*** end of CanGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the system time at which the CAN device was connected. The CAN
+**            message timestamps are relative to it.
+** \return    System time in microseconds.
+**
+****************************************************************************************/
+uint64_t CanStartTime(void)
+{
+  /* Give the result back to the caller. */
+  return canStartTime;
+} /*** end of CanStartTime ***/
+
+
+/************************************************************************************//**
+** \brief     Switches the CAN driver to offline mode. CanConnect() then reads the CAN
+**            messages from a log file, instead of connecting to a SocketCAN device. The
+**            event loop calls the message reception callback for each of them, as fast
+**            as possible. Timestamps, timers and the waits of sequences run on the
+**            virtual clock, which follows the timestamps of the log file. The acceptance
+**            filters apply, just like on a socket. Transmitted CAN messages go nowhere.
+**            Once all CAN messages were delivered, the event loop is stopped. Must be
+**            called before connecting.
+** \param     path Path of the log file, in any format that the replay module reads.
+** \return    True if successful, false if the log file could not be opened or holds no
+**            CAN messages.
+**
+****************************************************************************************/
+bool CanOpenOffline(char const * path)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(path != NULL);
+
+  /* Only continue with valid parameter and when not connected. */
+  if ( (path != NULL) && (!canConnected) )
+  {
+    /* Open the log file and read ahead its first CAN message. */
+    ReplayFileClose(&canOfflineFile);
+    if (ReplayFileOpen(&canOfflineFile, path))
+    {
+      canOfflineMsgValid = ReplayFileRead(&canOfflineFile, &canOfflineMsg);
+      if (canOfflineMsgValid)
+      {
+        /* Start the virtual clock at the first CAN message. */
+        UtilSetVirtualTime(canOfflineMsg.timestamp);
+        result = true;
+      }
+      else
+      {
+        ReplayFileClose(&canOfflineFile);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanOpenOffline ***/
 
 
 /************************************************************************************//**
@@ -365,68 +702,268 @@ void CanPrintMessage(tCanMsg const * msg)
 ****************************************************************************************/
 static int CanEventThread(void * param)
 {
-  struct can_frame canRxFrame;
-  tCanMsg rxMsg;
-  bool msgReceived;
-
   /* Enter the thread's loop and run it, until a stop is requested. */
   while (!atomic_load(&canStopEventThread))
   {
+#if (CAN_IO_URING > 0)
+    /* Wait for and process the completions. */
+    CanUringProcess(true);
+#else
     /* Empty out the CAN event queue. */
-    do
+    CanProcessReceived();
+
+    /* Sleep for 500us to not starve the CPU. */
+    UtilSleep(500);
+#endif
+  }
+
+  /* Shut down the thread. */
+  thrd_exit(EXIT_SUCCESS);
+} /*** end of CanEventThread ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when the CAN socket has data.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void CanLoopEvent(int fd, uint32_t events, void * context)
+{
+#if (CAN_IO_URING > 0)
+  /* Process the available completions. */
+  CanUringProcess(false);
+#else
+  /* Empty out the CAN event queue. */
+  CanProcessReceived();
+#endif
+} /*** end of CanLoopEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that delivers the CAN messages from the log file in
+**            offline mode.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void CanOfflineLoopEvent(int fd, uint32_t events, void * context)
+{
+  tCanMsg rxMsg;
+  uint64_t counter;
+  uint64_t deadline;
+  uint64_t next;
+
+  /* Deliver a batch of CAN messages. */
+  for (size_t count = 0; (count < CAN_OFFLINE_BATCH) && (canOfflineMsgValid); count++)
+  {
+    /* First run the timers and the sequence timeouts that expire before this CAN
+     * message, each at its own instant of the virtual clock. This also advances the
+     * virtual clock to the CAN message.
+     */
+    while (true)
     {
-      /* Attempt to get the next CAN event from the queue. */
-      msgReceived = false;
-      mtx_lock(&canSocketMutex);   
-      if (read(canSocket, &canRxFrame, sizeof(struct can_frame)) == 
-           (ssize_t)sizeof(struct can_frame))
+      SeqAdvance(UtilSystemTime());
+      if (UtilSystemTime() >= canOfflineMsg.timestamp)
       {
-        msgReceived = true;        
+        break;
       }
-      mtx_unlock(&canSocketMutex);
-
-      /* Only process the message, if one was actually received. */
-      if (msgReceived)
+      next = canOfflineMsg.timestamp;
+      if ( (SeqNextTimeout(&deadline)) && (deadline < next) )
       {
-        /* Set the message's timestamp. */
-        rxMsg.timestamp = UtilSystemTime() - canStartTime;
-
-        /* Ignore remote frames and error information. */
-        if (!(canRxFrame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)))
-        {
-          /* Copy the CAN message. */
-          if (canRxFrame.can_id & CAN_EFF_FLAG)
-          {
-            rxMsg.ext = true;
-          }
-          else
-          {
-            rxMsg.ext = false;
-          }
-          rxMsg.id = canRxFrame.can_id & ~CAN_EFF_FLAG;
-          rxMsg.len = canRxFrame.can_dlc;
-          for (uint8_t idx = 0; idx < canRxFrame.can_dlc; idx++)
-          {
-            rxMsg.data[idx] = canRxFrame.data[idx];
-          }
-
-          /* Call message reception callback. */
-          if (canReceivedCallback != NULL)
-          {
-            canReceivedCallback(&rxMsg);
-          }
-        }
+        next = deadline;
       }
+      TimerAdvance(next);
     }
-    while (msgReceived);
+    rxMsg = canOfflineMsg;
+    rxMsg.timestamp = UtilSystemTime() - canStartTime;
+    /* Read ahead the next CAN message. */
+    canOfflineMsgValid = ReplayFileRead(&canOfflineFile, &canOfflineMsg);
 
-    /* Sleep for 500us to not starve the CPU. */
-    UtilSleep(500);
+    /* Drop it, unless it passes the acceptance filters. */
+    if (!CanOfflineAccept(&rxMsg))
+    {
+      continue;
+    }
+
+    /* Update the traffic counter. */
+    atomic_fetch_add_explicit(&canRxCount, 1, memory_order_relaxed);
+
+    /* Call message reception callback. */
+    if (canReceivedCallback != NULL)
+    {
+      canReceivedCallback(&rxMsg);
+    }
   }
 
-  /* Shut down the thread. */
-  thrd_exit(EXIT_SUCCESS);
-} /*** end of CanEventThread ***/
+  /* All CAN messages delivered? Then stop the event loop, just like a key press of ESC
+   * would. Reset the event file descriptor, so it stops reporting events.
+   */
+  if (!canOfflineMsgValid)
+  {
+    (void)read(fd, &counter, sizeof(counter));
+    LoopStop();
+  }
+} /*** end of CanOfflineLoopEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if a CAN message from the log file passes the acceptance
+**            filters in offline mode, where the socket does not filter them.
+** \param     msg Pointer to the CAN message.
+** \return    True if it matches at least one acceptance filter or if there are none,
+**            false otherwise.
+**
+****************************************************************************************/
+static bool CanOfflineAccept(tCanMsg const * msg)
+{
+  bool result = (canFilterCount == 0);
+
+  /* Check the acceptance filters, until one matches. */
+  for (size_t idx = 0; (idx < canFilterCount) && (!result); idx++)
+  {
+    result = CanFilterMatch(&canFilters[idx], msg);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanOfflineAccept ***/
+
+
+#if (CAN_IO_URING == 0)
+/************************************************************************************//**
+** \brief     Reads all CAN frames that are currently queued on the socket and invokes
+**            the message reception callback for each received CAN message.
+**
+****************************************************************************************/
+static void CanProcessReceived(void)
+{
+  struct can_frame canRxFrame;
+  bool msgReceived;
+
+  /* Empty out the CAN event queue. */
+  do
+  {
+    /* Attempt to get the next CAN event from the queue. */
+    msgReceived = false;
+    mtx_lock(&canSocketMutex);   
+    if (read(canSocket, &canRxFrame, sizeof(struct can_frame)) == 
+         (ssize_t)sizeof(struct can_frame))
+    {
+      msgReceived = true;        
+    }
+    mtx_unlock(&canSocketMutex);
+
+    /* Only process the message, if one was actually received. */
+    if (msgReceived)
+    {
+      CanFrameReceived(&canRxFrame);
+    }
+  }
+  while (msgReceived);
+} /*** end of CanProcessReceived ***/
+#endif
+
+
+/************************************************************************************//**
+** \brief     Converts a received CAN frame to a CAN message and invokes the message
+**            reception callback.
+** \param     frame Pointer to the received CAN frame.
+**
+****************************************************************************************/
+static void CanFrameReceived(struct can_frame const * frame)
+{
+  tCanMsg rxMsg;
+
+  /* Set the message's timestamp. */
+  rxMsg.timestamp = UtilSystemTime() - canStartTime;
+
+  /* Ignore remote frames and error information. */
+  if (!(frame->can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)))
+  {
+    /* Copy the CAN message. */
+    if (frame->can_id & CAN_EFF_FLAG)
+    {
+      rxMsg.ext = true;
+    }
+    else
+    {
+      rxMsg.ext = false;
+    }
+    rxMsg.id = frame->can_id & ~CAN_EFF_FLAG;
+    rxMsg.len = frame->can_dlc;
+    for (uint8_t idx = 0; idx < frame->can_dlc; idx++)
+    {
+      rxMsg.data[idx] = frame->data[idx];
+    }
+
+    /* Update the traffic counter. */
+    atomic_fetch_add_explicit(&canRxCount, 1, memory_order_relaxed);
+
+    /* Call message reception callback. */
+    if (canReceivedCallback != NULL)
+    {
+      canReceivedCallback(&rxMsg);
+    }
+  }
+} /*** end of CanFrameReceived ***/
+
+
+/************************************************************************************//**
+** \brief     Configures the stored acceptance filters on the socket.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool CanApplyFilters(void)
+{
+  bool result = false;
+  struct can_filter rawFilters[CAN_FILTERS_MAX];
+  struct can_filter acceptAll = { .can_id = 0, .can_mask = 0 };
+
+  /* Convert the filters. Include the extended frame flag in the mask, such that 11-bit
+   * and 29-bit CAN identifiers with the same value are told apart.
+   */
+  for (size_t idx = 0; idx < canFilterCount; idx++)
+  {
+    rawFilters[idx].can_id = canFilters[idx].id | 
+                             (canFilters[idx].ext ? CAN_EFF_FLAG : 0U);
+    rawFilters[idx].can_mask = canFilters[idx].mask | CAN_EFF_FLAG;
+  }
+  /* Configure them on the socket. Without filters, all CAN messages are received. */
+  if (canFilterCount > 0)
+  {
+    result = (setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_FILTER, rawFilters,
+                         (socklen_t)(canFilterCount * sizeof(struct can_filter))) == 0);
+  }
+  else
+  {
+    result = (setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_FILTER, &acceptAll,
+                         sizeof(acceptAll)) == 0);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanApplyFilters ***/
+
+
+#if (CAN_IO_URING > 0)
+/************************************************************************************//**
+** \brief     Invokes the message transmitted callback, once the io_uring backend
+**            completed the transmission of a CAN message.
+** \param     msg Pointer to the transmitted CAN message.
+**
+****************************************************************************************/
+static void CanFrameTransmitted(tCanMsg const * msg)
+{
+  /* Call message transmitted callback. */
+  if (canTransmittedCallback != NULL)
+  {
+    canTransmittedCallback(msg);
+  }
+} /*** end of CanFrameTransmitted ***/
+#endif
 
 
 /*********************************** end of can.c **************************************/
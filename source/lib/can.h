@@ -16,6 +16,9 @@ extern "C" {
 /** \brief Maximum number of bytes in a CAN message. */
 #define CAN_DATA_LEN_MAX     (8U)
 
+/** \brief Maximum number of acceptance filters that can be configured on the socket. */
+#define CAN_FILTERS_MAX      (32U)
+
 
 /****************************************************************************************
 * Type definitions
@@ -34,6 +37,30 @@ typedef struct
   uint64_t timestamp;
 } tCanMsg;
 
+/** \brief Acceptance filter for CAN messages. A CAN message matches if it has the same
+ *  identifier type and if the identifier bits selected by the mask are equal.
+ */
+typedef struct
+{
+  /** \brief CAN message identifier to match. */
+  uint32_t id;
+  /** \brief Mask with the identifier bits that must match. */
+  uint32_t mask;
+  /** \brief True to match 29-bit CAN identifiers, false for 11-bit. */
+  bool     ext;
+} tCanFilter;
+
+/** \brief Traffic counters of the CAN driver. */
+typedef struct
+{
+  /** \brief Number of received CAN messages. */
+  uint64_t rxCount;
+  /** \brief Number of CAN messages that were submitted for transmission. */
+  uint64_t txCount;
+  /** \brief Number of CAN messages that could not be submitted for transmission. */
+  uint64_t txErrors;
+} tCanStats;
+
 /** \brief Function type for the message received callback handler. */
 typedef void (* tCanReceivedCallback)(tCanMsg const * msg);
 
@@ -50,6 +77,11 @@ bool CanConnect(char const * device);
 void CanDisconnect(void);
 bool CanTransmit(tCanMsg const * msg);
 void CanPrintMessage(tCanMsg const * msg);
+bool CanFilterMatch(tCanFilter const * filter, tCanMsg const * msg);
+bool CanSetFilters(tCanFilter const * filters, size_t count);
+void CanGetStats(tCanStats * stats);
+uint64_t CanStartTime(void);
+bool CanOpenOffline(char const * path);
 
 
 #ifdef __cplusplus
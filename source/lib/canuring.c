@@ -0,0 +1,717 @@
+/************************************************************************************//**
+* \file         canuring.c
+* \brief        SocketCAN io_uring backend source file.
+* \details      Optional I/O backend for the CAN driver, enabled with the CAPLIN_IO_URING
+*               build option. A multishot receive request with kernel provided buffers
+*               stays posted on the CAN socket, so received frames arrive as completions
+*               without a system call per frame. Transmit requests are submitted as
+*               submission queue entries. When the kernel allows a submission queue
+*               polling thread, submitting them does not need a system call either.
+*               The backend talks to the kernel directly and does not depend on liburing.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <sys/mman.h>                       /* Memory management                       */
+#include <sys/syscall.h>                    /* System call numbers                     */
+#include <linux/io_uring.h>                 /* io_uring kernel definitions             */
+#include "can.h"                            /* CAN driver                              */
+#include "canuring.h"                       /* CAN io_uring backend                    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define CAN_URING_INVALID_FD           (-1)
+
+/** \brief Buffer group identifier of the receive buffers. */
+#define CAN_URING_RX_BGID              (0U)
+
+/** \brief User data of the multishot receive request. Transmit requests use their slot
+ *  index plus one.
+ */
+#define CAN_URING_RX_TAG               (0U)
+
+/** \brief User data of the no-operation request that wakes up a waiting thread. */
+#define CAN_URING_WAKEUP_TAG           (UINT64_MAX)
+
+/** \brief Idle time in milliseconds after which the submission queue polling thread
+ *  goes to sleep.
+ */
+#define CAN_URING_SQ_THREAD_IDLE       (100U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Transmit request that is in flight. The frame must stay valid until the
+ *  kernel reports the completion.
+ */
+typedef struct
+{
+  /** \brief CAN frame that is being transmitted. */
+  struct can_frame frame;
+  /** \brief The CAN message, as reported to the transmitted callback. */
+  tCanMsg msg;
+} tCanUringTxSlot;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief The io_uring file descriptor. */
+static int canUringFd = CAN_URING_INVALID_FD;
+
+/** \brief The CAN socket. */
+static int canUringSocket;
+
+/** \brief Boolean flag that indicates if the kernel runs a submission queue polling
+ *  thread for the ring.
+ */
+static bool canUringSqPoll;
+
+/** \brief Mapped submission queue and completion queue ring memory. */
+static void * canUringSqRing;
+static size_t canUringSqRingSize;
+static void * canUringCqRing;
+static size_t canUringCqRingSize;
+
+/** \brief Mapped submission queue entries. */
+static struct io_uring_sqe * canUringSqes;
+static size_t canUringSqesSize;
+
+/** \brief Pointers into the submission queue ring. */
+static _Atomic uint32_t * canUringSqHead;
+static _Atomic uint32_t * canUringSqTail;
+static _Atomic uint32_t * canUringSqFlags;
+static uint32_t * canUringSqArray;
+static uint32_t canUringSqMask;
+static uint32_t canUringSqEntries;
+
+/** \brief Pointers into the completion queue ring. */
+static _Atomic uint32_t * canUringCqHead;
+static _Atomic uint32_t * canUringCqTail;
+static struct io_uring_cqe * canUringCqes;
+static uint32_t canUringCqMask;
+
+/** \brief Ring with the provided receive buffers and the buffers themselves. */
+static struct io_uring_buf_ring * canUringBufRing;
+static size_t canUringBufRingSize;
+static struct can_frame * canUringRxBuffers;
+
+/** \brief Tail of the provided buffer ring. Only accessed by the thread that processes
+ *  the completions.
+ */
+static uint16_t canUringBufTail;
+
+/** \brief Transmit slots and the stack with the indices of the free ones. */
+static tCanUringTxSlot canUringTxSlots[CAN_URING_SQ_ENTRIES];
+static uint16_t canUringTxFree[CAN_URING_SQ_ENTRIES];
+static uint16_t canUringTxFreeCount;
+
+/** \brief Mutex for mutual exclusive access to the submission queue and the transmit
+ *  slots. Transmit requests can be submitted from any thread.
+ */
+static mtx_t canUringSqMutex;
+
+/** \brief Thread local boolean flag that is set while processing completions. Transmit
+ *  requests from inside the callbacks are then submitted in one go, after all
+ *  completions were processed.
+ */
+static thread_local bool canUringProcessing;
+
+/** \brief Boolean flag that is set when the multishot receive request could not be
+ *  queued, because the submission queue was full. Protected by the submission queue
+ *  mutex.
+ */
+static bool canUringReceivePending;
+
+/** \brief Callback function pointers. */
+static tCanUringReceivedCallback canUringReceivedCallback;
+static tCanUringTransmittedCallback canUringTransmittedCallback;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static struct io_uring_sqe * CanUringGetSqe(void);
+static void CanUringPostReceive(void);
+static void CanUringRetryReceive(void);
+static void CanUringSubmit(uint32_t minComplete);
+static void CanUringRecycleBuffer(uint16_t bufferId);
+
+
+/************************************************************************************//**
+** \brief     Initializes the io_uring backend for the specified CAN socket and posts the
+**            multishot receive request.
+** \param     socket The bound CAN socket.
+** \param     rxCallbackFcn Frame received callback function pointer.
+** \param     txCallbackFcn Message transmitted callback function pointer.
+** \return    True if successful, false if io_uring is not available.
+**
+****************************************************************************************/
+bool CanUringInit(int socket, tCanUringReceivedCallback rxCallbackFcn,
+                  tCanUringTransmittedCallback txCallbackFcn)
+{
+  bool result = false;
+  struct io_uring_params params;
+  struct io_uring_buf_reg bufReg = { 0 };
+
+  /* Verify parameters. */
+  assert(rxCallbackFcn != NULL);
+  assert(txCallbackFcn != NULL);
+
+  /* Initialize locals. */
+  canUringSocket = socket;
+  canUringReceivedCallback = rxCallbackFcn;
+  canUringTransmittedCallback = txCallbackFcn;
+  canUringSqRing = MAP_FAILED;
+  canUringCqRing = MAP_FAILED;
+  canUringSqes = MAP_FAILED;
+  canUringBufRing = MAP_FAILED;
+  canUringRxBuffers = NULL;
+  canUringBufTail = 0;
+  canUringReceivePending = false;
+  canUringTxFreeCount = 0;
+  for (uint16_t idx = 0; idx < CAN_URING_SQ_ENTRIES; idx++)
+  {
+    canUringTxFree[canUringTxFreeCount++] = idx;
+  }
+  if (mtx_init(&canUringSqMutex, mtx_plain) != thrd_success)
+  {
+    assert(false);
+  }
+
+  /* Attempt to create the ring with a submission queue polling thread first. The
+   * completion queue is sized for a full set of receive buffers plus the transmit
+   * requests.
+   */
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_SQPOLL | IORING_SETUP_CQSIZE;
+  params.sq_thread_idle = CAN_URING_SQ_THREAD_IDLE;
+  params.cq_entries = CAN_URING_RX_BUFFERS + CAN_URING_SQ_ENTRIES;
+  canUringFd = (int)syscall(__NR_io_uring_setup, CAN_URING_SQ_ENTRIES, &params);
+  canUringSqPoll = (canUringFd >= 0);
+  /* Not allowed to use a polling thread? Fall back to a regular ring. */
+  if (canUringFd < 0)
+  {
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = CAN_URING_RX_BUFFERS + CAN_URING_SQ_ENTRIES;
+    canUringFd = (int)syscall(__NR_io_uring_setup, CAN_URING_SQ_ENTRIES, &params);
+  }
+
+  /* Map the rings into user space. */
+  if (canUringFd >= 0)
+  {
+    canUringSqRingSize = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+    canUringCqRingSize = params.cq_off.cqes + 
+                         (params.cq_entries * sizeof(struct io_uring_cqe));
+    /* Can both rings be mapped with a single mapping? */
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if (canUringCqRingSize > canUringSqRingSize)
+      {
+        canUringSqRingSize = canUringCqRingSize;
+      }
+    }
+    canUringSqRing = mmap(NULL, canUringSqRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, canUringFd, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      canUringCqRing = canUringSqRing;
+    }
+    else
+    {
+      canUringCqRing = mmap(NULL, canUringCqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, canUringFd, IORING_OFF_CQ_RING);
+    }
+    canUringSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    canUringSqes = mmap(NULL, canUringSqesSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, canUringFd, IORING_OFF_SQES);
+    /* Check for mapping errors. */
+    if ( (canUringSqRing != MAP_FAILED) && (canUringCqRing != MAP_FAILED) &&
+         (canUringSqes != MAP_FAILED) )
+    {
+      /* Set the pointers into the rings. */
+      canUringSqHead = (_Atomic uint32_t *)((uint8_t *)canUringSqRing + params.sq_off.head);
+      canUringSqTail = (_Atomic uint32_t *)((uint8_t *)canUringSqRing + params.sq_off.tail);
+      canUringSqFlags = (_Atomic uint32_t *)((uint8_t *)canUringSqRing + 
+                                             params.sq_off.flags);
+      canUringSqArray = (uint32_t *)((uint8_t *)canUringSqRing + params.sq_off.array);
+      canUringSqMask = *(uint32_t *)((uint8_t *)canUringSqRing + params.sq_off.ring_mask);
+      canUringSqEntries = params.sq_entries;
+      canUringCqHead = (_Atomic uint32_t *)((uint8_t *)canUringCqRing + params.cq_off.head);
+      canUringCqTail = (_Atomic uint32_t *)((uint8_t *)canUringCqRing + params.cq_off.tail);
+      canUringCqes = (struct io_uring_cqe *)((uint8_t *)canUringCqRing + 
+                                             params.cq_off.cqes);
+      canUringCqMask = *(uint32_t *)((uint8_t *)canUringCqRing + params.cq_off.ring_mask);
+      result = true;
+    }
+  }
+
+  /* Allocate the receive buffers and register them as provided buffer ring. */
+  if (result)
+  {
+    result = false;
+    canUringBufRingSize = CAN_URING_RX_BUFFERS * sizeof(struct io_uring_buf);
+    canUringBufRing = mmap(NULL, canUringBufRingSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    canUringRxBuffers = aligned_alloc(sizeof(struct can_frame),
+                                      CAN_URING_RX_BUFFERS * sizeof(struct can_frame));
+    if ( (canUringBufRing != MAP_FAILED) && (canUringRxBuffers != NULL) )
+    {
+      bufReg.ring_addr = (uint64_t)(uintptr_t)canUringBufRing;
+      bufReg.ring_entries = CAN_URING_RX_BUFFERS;
+      bufReg.bgid = CAN_URING_RX_BGID;
+      if (syscall(__NR_io_uring_register, canUringFd, IORING_REGISTER_PBUF_RING,
+                  &bufReg, 1) == 0)
+      {
+        /* Hand all receive buffers to the kernel. */
+        for (uint16_t idx = 0; idx < CAN_URING_RX_BUFFERS; idx++)
+        {
+          CanUringRecycleBuffer(idx);
+        }
+        result = true;
+      }
+    }
+  }
+
+  /* Post the multishot receive request. */
+  if (result)
+  {
+    mtx_lock(&canUringSqMutex);
+    CanUringPostReceive();
+    mtx_unlock(&canUringSqMutex);
+    CanUringSubmit(0);
+  }
+  /* Clean up in case of an error. */
+  else
+  {
+    CanUringTerminate();
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanUringInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the io_uring backend. Closing the ring cancels all requests that
+**            are still posted. Should only be called when no other thread processes
+**            completions anymore.
+**
+****************************************************************************************/
+void CanUringTerminate(void)
+{
+  /* Close the ring. */
+  if (canUringFd >= 0)
+  {
+    close(canUringFd);
+    canUringFd = CAN_URING_INVALID_FD;
+  }
+  /* Unmap the ring memory. */
+  if ( (canUringCqRing != MAP_FAILED) && (canUringCqRing != canUringSqRing) )
+  {
+    munmap(canUringCqRing, canUringCqRingSize);
+  }
+  if (canUringSqRing != MAP_FAILED)
+  {
+    munmap(canUringSqRing, canUringSqRingSize);
+  }
+  if (canUringSqes != MAP_FAILED)
+  {
+    munmap(canUringSqes, canUringSqesSize);
+  }
+  /* Release the receive buffers. */
+  if (canUringBufRing != MAP_FAILED)
+  {
+    munmap(canUringBufRing, canUringBufRingSize);
+  }
+  free(canUringRxBuffers);
+
+  /* Destroy the mutex. */
+  mtx_destroy(&canUringSqMutex);
+
+  /* Reset locals. */
+  canUringSqRing = MAP_FAILED;
+  canUringCqRing = MAP_FAILED;
+  canUringSqes = MAP_FAILED;
+  canUringBufRing = MAP_FAILED;
+  canUringRxBuffers = NULL;
+  canUringReceivedCallback = NULL;
+  canUringTransmittedCallback = NULL;
+} /*** end of CanUringTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the io_uring file descriptor. It reports readability when
+**            completions are available, so it can be monitored by the event loop.
+** \return    The io_uring file descriptor.
+**
+****************************************************************************************/
+int CanUringGetFd(void)
+{
+  /* Give the result back to the caller. */
+  return canUringFd;
+} /*** end of CanUringGetFd ***/
+
+
+/************************************************************************************//**
+** \brief     Submits a CAN frame for transmission. The transmitted callback is invoked
+**            once the kernel reports the completion. Can be called from any thread.
+** \param     frame Pointer to the CAN frame to transmit.
+** \param     msg Pointer to the CAN message, as reported to the transmitted callback.
+** \return    True if the frame could be submitted for transmission, false otherwise.
+**
+****************************************************************************************/
+bool CanUringTransmit(struct can_frame const * frame, tCanMsg const * msg)
+{
+  bool result = false;
+  struct io_uring_sqe * sqe;
+  uint16_t slot;
+
+  /* Obtain mutual exclusion to the submission queue. */
+  mtx_lock(&canUringSqMutex);
+  /* Only continue if a transmit slot is available. */
+  if (canUringTxFreeCount > 0)
+  {
+    /* Obtain a submission queue entry. */
+    sqe = CanUringGetSqe();
+    if (sqe != NULL)
+    {
+      /* Take a transmit slot and store the frame in it. */
+      slot = canUringTxFree[--canUringTxFreeCount];
+      canUringTxSlots[slot].frame = *frame;
+      canUringTxSlots[slot].msg = *msg;
+      /* Prepare the send request. */
+      sqe->opcode = IORING_OP_SEND;
+      sqe->fd = canUringSocket;
+      sqe->addr = (uint64_t)(uintptr_t)&canUringTxSlots[slot].frame;
+      sqe->len = sizeof(struct can_frame);
+      sqe->user_data = (uint64_t)slot + 1U;
+      /* Publish the entry to the kernel. */
+      atomic_store_explicit(canUringSqTail, 
+                            atomic_load_explicit(canUringSqTail, memory_order_relaxed) + 1,
+                            memory_order_release);
+      result = true;
+    }
+  }
+  /* Release mutual exclusion to the submission queue. */
+  mtx_unlock(&canUringSqMutex);
+
+  /* Submit right away, unless this runs inside a callback while processing 
+   * completions. In that case, all requests are submitted in one go afterwards.
+   */
+  if ( (result) && (!canUringProcessing) )
+  {
+    CanUringSubmit(0);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanUringTransmit ***/
+
+
+/************************************************************************************//**
+** \brief     Processes all available completions. Received frames are reported through
+**            the frame received callback and transmit completions through the message
+**            transmitted callback.
+** \param     wait True to block until at least one completion is available. Used by the
+**            event thread. False to only process what is available, which is what the
+**            event loop needs.
+**
+****************************************************************************************/
+void CanUringProcess(bool wait)
+{
+  struct io_uring_cqe * cqe;
+  uint32_t head;
+  uint32_t tail;
+  uint16_t slot;
+  bool repostReceive = false;
+  bool bufferRecycled = false;
+  tCanMsg txMsg;
+
+  /* Queue the multishot receive request, if this did not work out before. */
+  CanUringRetryReceive();
+  /* Submit pending requests and block until a completion is available, if requested. */
+  if (wait)
+  {
+    CanUringSubmit(1);
+  }
+
+  /* Process all available completions. */
+  canUringProcessing = true;
+  head = atomic_load_explicit(canUringCqHead, memory_order_relaxed);
+  tail = atomic_load_explicit(canUringCqTail, memory_order_acquire);
+  while (head != tail)
+  {
+    cqe = &canUringCqes[head & canUringCqMask];
+    /* Completion of the multishot receive request? */
+    if (cqe->user_data == CAN_URING_RX_TAG)
+    {
+      /* Was a frame received into a provided buffer? */
+      if (cqe->flags & IORING_CQE_F_BUFFER)
+      {
+        uint16_t bufferId = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        /* Report the frame if it is complete. */
+        if ( (cqe->res == (int32_t)sizeof(struct can_frame)) && 
+             (canUringReceivedCallback != NULL) )
+        {
+          canUringReceivedCallback(&canUringRxBuffers[bufferId]);
+        }
+        /* Hand the buffer back to the kernel. */
+        CanUringRecycleBuffer(bufferId);
+        bufferRecycled = true;
+      }
+      /* Did the kernel terminate the multishot request? For example because it ran out
+       * of receive buffers.
+       */
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+      {
+        repostReceive = true;
+      }
+    }
+    /* Completion of a transmit request? */
+    else if (cqe->user_data != CAN_URING_WAKEUP_TAG)
+    {
+      /* Release the transmit slot, after copying the message. */
+      slot = (uint16_t)(cqe->user_data - 1U);
+      txMsg = canUringTxSlots[slot].msg;
+      mtx_lock(&canUringSqMutex);
+      canUringTxFree[canUringTxFreeCount++] = slot;
+      mtx_unlock(&canUringSqMutex);
+      /* Report the message if it was successfully transmitted. */
+      if ( (cqe->res == (int32_t)sizeof(struct can_frame)) && 
+           (canUringTransmittedCallback != NULL) )
+      {
+        canUringTransmittedCallback(&txMsg);
+      }
+    }
+    head++;
+    /* Continue with completions that arrived in the meantime. */
+    if (head == tail)
+    {
+      atomic_store_explicit(canUringCqHead, head, memory_order_release);
+      tail = atomic_load_explicit(canUringCqTail, memory_order_acquire);
+    }
+  }
+  atomic_store_explicit(canUringCqHead, head, memory_order_release);
+  canUringProcessing = false;
+
+  /* Publish the recycled receive buffers to the kernel. */
+  if (bufferRecycled)
+  {
+    atomic_store_explicit((_Atomic uint16_t *)&canUringBufRing->tail, canUringBufTail,
+                          memory_order_release);
+  }
+  /* Repost the multishot receive request, if needed. */
+  if (repostReceive)
+  {
+    mtx_lock(&canUringSqMutex);
+    CanUringPostReceive();
+    mtx_unlock(&canUringSqMutex);
+  }
+  /* Submit the requests that were queued while processing the completions. */
+  CanUringSubmit(0);
+  /* The kernel consumed the submitted requests, so there is room again in case the
+   * multishot receive request did not fit.
+   */
+  CanUringRetryReceive();
+} /*** end of CanUringProcess ***/
+
+
+/************************************************************************************//**
+** \brief     Wakes up the thread that is blocked in CanUringProcess(), by submitting a
+**            request that completes right away. Can be called from any thread.
+**
+****************************************************************************************/
+void CanUringWakeup(void)
+{
+  struct io_uring_sqe * sqe;
+
+  /* Obtain mutual exclusion to the submission queue. */
+  mtx_lock(&canUringSqMutex);
+  /* Prepare the no-operation request. */
+  sqe = CanUringGetSqe();
+  if (sqe != NULL)
+  {
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = CAN_URING_WAKEUP_TAG;
+    atomic_store_explicit(canUringSqTail, 
+                          atomic_load_explicit(canUringSqTail, memory_order_relaxed) + 1,
+                          memory_order_release);
+  }
+  /* Release mutual exclusion to the submission queue. */
+  mtx_unlock(&canUringSqMutex);
+  /* Submit the request. */
+  CanUringSubmit(0);
+} /*** end of CanUringWakeup ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the next free submission queue entry. Should be called with mutual
+**            exclusion to the submission queue. The caller publishes the entry by
+**            incrementing the tail.
+** \return    Pointer to the cleared submission queue entry or NULL if the queue is full.
+**
+****************************************************************************************/
+static struct io_uring_sqe * CanUringGetSqe(void)
+{
+  struct io_uring_sqe * result = NULL;
+  uint32_t tail;
+  uint32_t head;
+
+  /* Only continue if the submission queue is not full. */
+  tail = atomic_load_explicit(canUringSqTail, memory_order_relaxed);
+  head = atomic_load_explicit(canUringSqHead, memory_order_acquire);
+  if ((tail - head) < canUringSqEntries)
+  {
+    /* Use the entry with the same index as its slot in the ring. */
+    result = &canUringSqes[tail & canUringSqMask];
+    memset(result, 0, sizeof(struct io_uring_sqe));
+    canUringSqArray[tail & canUringSqMask] = tail & canUringSqMask;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanUringGetSqe ***/
+
+
+/************************************************************************************//**
+** \brief     Queues the multishot receive request that selects its buffers from the
+**            provided buffer ring. Should be called with mutual exclusion to the
+**            submission queue. If the submission queue is full, the request is marked
+**            as pending, so that CanUringRetryReceive() queues it later on.
+**
+****************************************************************************************/
+static void CanUringPostReceive(void)
+{
+  struct io_uring_sqe * sqe;
+
+  /* Prepare the multishot receive request. */
+  sqe = CanUringGetSqe();
+  if (sqe != NULL)
+  {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = canUringSocket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = CAN_URING_RX_BGID;
+    sqe->user_data = CAN_URING_RX_TAG;
+    atomic_store_explicit(canUringSqTail, 
+                          atomic_load_explicit(canUringSqTail, memory_order_relaxed) + 1,
+                          memory_order_release);
+  }
+  /* Remember to try again, otherwise no more frames are received. */
+  canUringReceivePending = (sqe == NULL);
+} /*** end of CanUringPostReceive ***/
+
+
+/************************************************************************************//**
+** \brief     Queues the multishot receive request and submits it, if it is still
+**            pending because the submission queue was full.
+**
+****************************************************************************************/
+static void CanUringRetryReceive(void)
+{
+  bool posted = false;
+
+  /* Obtain mutual exclusion to the submission queue. */
+  mtx_lock(&canUringSqMutex);
+  /* Queue the request if it is still pending. */
+  if (canUringReceivePending)
+  {
+    CanUringPostReceive();
+    posted = !canUringReceivePending;
+  }
+  /* Release mutual exclusion to the submission queue. */
+  mtx_unlock(&canUringSqMutex);
+  /* Submit the request. */
+  if (posted)
+  {
+    CanUringSubmit(0);
+  }
+} /*** end of CanUringRetryReceive ***/
+
+
+/************************************************************************************//**
+** \brief     Enters the kernel if needed, to submit the queued requests and optionally
+**            wait for completions. With a submission queue polling thread, the kernel is
+**            only entered to wake up the polling thread or to wait.
+** \param     minComplete Number of completions to wait for.
+**
+****************************************************************************************/
+static void CanUringSubmit(uint32_t minComplete)
+{
+  uint32_t flags = 0;
+  uint32_t toSubmit = 0;
+
+  /* Polling thread picks up the requests by itself? */
+  if (canUringSqPoll)
+  {
+    /* Make sure the tail update is visible before checking if the thread sleeps. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(canUringSqFlags, memory_order_relaxed) & 
+        IORING_SQ_NEED_WAKEUP)
+    {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+  }
+  else
+  {
+    /* Determine the number of requests that the kernel did not consume yet. */
+    toSubmit = atomic_load_explicit(canUringSqTail, memory_order_acquire) -
+               atomic_load_explicit(canUringSqHead, memory_order_acquire);
+  }
+  if (minComplete > 0)
+  {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+
+  /* Only enter the kernel if there is something to do. */
+  if ( (toSubmit > 0) || (flags != 0) )
+  {
+    (void)syscall(__NR_io_uring_enter, canUringFd, toSubmit, minComplete, flags, NULL, 0);
+  }
+} /*** end of CanUringSubmit ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a receive buffer to the provided buffer ring. The kernel sees it once
+**            the tail of the buffer ring is published.
+** \param     bufferId Index of the receive buffer.
+**
+****************************************************************************************/
+static void CanUringRecycleBuffer(uint16_t bufferId)
+{
+  struct io_uring_buf * buf;
+
+  /* Fill the next entry of the buffer ring. */
+  buf = &canUringBufRing->bufs[canUringBufTail & (CAN_URING_RX_BUFFERS - 1U)];
+  buf->addr = (uint64_t)(uintptr_t)&canUringRxBuffers[bufferId];
+  buf->len = sizeof(struct can_frame);
+  buf->bid = bufferId;
+  canUringBufTail++;
+  /* During initialization, publish each buffer right away. */
+  if (!canUringProcessing)
+  {
+    atomic_store_explicit((_Atomic uint16_t *)&canUringBufRing->tail, canUringBufTail,
+                          memory_order_release);
+  }
+} /*** end of CanUringRecycleBuffer ***/
+
+
+/*********************************** end of canuring.c *********************************/
@@ -0,0 +1,60 @@
+/************************************************************************************//**
+* \file         canuring.h
+* \brief        SocketCAN io_uring backend header file.
+*
+****************************************************************************************/
+#ifndef CANURING_H
+#define CANURING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of submission queue entries. Also the maximum number of transmit
+ *  requests that can be in flight at the same time.
+ */
+#define CAN_URING_SQ_ENTRIES      (256U)
+
+/** \brief Number of receive buffers that are provided to the kernel for the multishot
+ *  receive request. Must be a power of two.
+ */
+#define CAN_URING_RX_BUFFERS      (1024U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type for the frame received callback handler. */
+typedef void (* tCanUringReceivedCallback)(struct can_frame const * frame);
+
+/** \brief Function type for the message transmitted callback handler. */
+typedef void (* tCanUringTransmittedCallback)(tCanMsg const * msg);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+bool CanUringInit(int socket, tCanUringReceivedCallback rxCallbackFcn,
+                  tCanUringTransmittedCallback txCallbackFcn);
+void CanUringTerminate(void);
+int  CanUringGetFd(void);
+bool CanUringTransmit(struct can_frame const * frame, tCanMsg const * msg);
+void CanUringProcess(bool wait);
+void CanUringWakeup(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CANURING_H */
+/*********************************** end of canuring.h *********************************/
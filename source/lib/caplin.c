@@ -12,9 +12,9 @@
 #include <stdbool.h>                        /* for boolean type                        */
 #include <stdio.h>                          /* for standard input/output functions     */
 #include <stdlib.h>                         /* for standard library                    */
-#include <stdatomic.h>                      /* Atomic operations                       */
 #include <signal.h>                         /* Signal handling                         */
 #include <string.h>                         /* for string library                      */
+#include <time.h>                           /* for time functions                      */
 #include <getopt.h>                         /* Command line parsing                    */
 #include <unistd.h>                         /* UNIX standard functions                 */
 #include <net/if.h>                         /* Network interfaces                      */
@@ -23,10 +23,43 @@
 #include <linux/can/raw.h>                  /* CAN raw sockets                         */
 #include <sys/ioctl.h>                      /* I/O control operations                  */
 #include <ifaddrs.h>                        /* Listing network interfaces.             */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/signalfd.h>                   /* Signal file descriptor                  */
+#include <sys/un.h>                         /* Unix domain sockets                     */
 #include "util.h"                           /* Utility functions                       */
+#include "loop.h"                           /* Event loop driver                       */
 #include "timer.h"                          /* Timer driver                            */
 #include "keys.h"                           /* Input key detection driver              */
 #include "can.h"                            /* CAN driver                              */
+#include "dispatch.h"                       /* Sharded message dispatcher              */
+#include "seq.h"                            /* Coroutine based test sequences          */
+#include "corr.h"                           /* Request/response correlation            */
+#include "ctrl.h"                           /* Control channel                         */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "replay.h"                         /* Log file replay                         */
+#include "pcapng.h"                         /* Asynchronous pcapng capture writer      */
+#include "pack.h"                           /* Compressed capture file                 */
+#include "trigger.h"                        /* Pre/post-trigger capture                */
+#include "latest.h"                         /* Latest value table                      */
+#include "stats.h"                          /* Per-identifier statistics               */
+#include "busload.h"                        /* Bus load monitor                        */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Set to 1 to run the application in single-threaded mode. One event loop then
+ *  services the CAN socket, the timers, the keyboard and the signals. All callbacks,
+ *  such as OnMessage, the timer callbacks and OnKey, are invoked one after the other
+ *  from the main thread, so the application does not need locks. Typically set through
+ *  the CAPLIN_SINGLE_THREADED option of the CMake build.
+ */
+#ifndef CAPLIN_SINGLE_THREADED
+#define CAPLIN_SINGLE_THREADED         (0)
+#endif
+
+/** \brief Value of an invalid file descriptor. */
+#define APP_INVALID_FD                 (-1)
 
 
 /****************************************************************************************
@@ -42,12 +75,20 @@ char canDevice[IFNAMSIZ] = "vcan0";
 /****************************************************************************************
 * Local data declarations
 ****************************************************************************************/
-/** \brief Atomic boolean that is used to request a program exit. */
-static atomic_bool appExitProgram;
-
 /** \brief Boolean flag to determine if the help info should be displayed. */
 static bool appArgHelp;
 
+/** \brief Path of the control channel socket, or an empty string for none. */
+static char appArgControl[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/** \brief Path of the log file to run offline on, or NULL to connect to the CAN bus. */
+static char const * appArgOffline;
+
+/** \brief Signal file descriptor through which the main thread receives the signals
+ *  that request a program exit.
+ */
+static int appSignalFd;
+
 
 /****************************************************************************************
 * External function prototypes
@@ -74,7 +115,9 @@ static void AppDisplayHelp(char const * appName);
 static void AppFindFirstCanInterface(void);
 static bool AppIsCanInterface(char const * name);
 static void AppKeyPressedCallback(char key);
-static void AppInterruptSignalHandler(int signum);
+static void AppMessageReceivedCallback(tCanMsg const * msg);
+static void AppMessageTransmittedCallback(tCanMsg const * msg);
+static void AppSignalLoopEvent(int fd, uint32_t events, void * context);
 
 
 /************************************************************************************//**
@@ -88,10 +131,18 @@ int main(int argc, char *argv[])
 {
   int result = EXIT_SUCCESS;
   bool canConnected = false;
+  bool offlineOpened = true;
+  sigset_t sigMask;
+  struct timespec runStart;
+  struct timespec runEnd;
+  tCanStats canStats;
+  double runTime;
 
   /* Initialize locals. */
-  atomic_init(&appExitProgram, false);
   appArgHelp = false;
+  appArgControl[0] = '\0';
+  appArgOffline = NULL;
+  appSignalFd = APP_INVALID_FD;
 
   /* Attempt to locate and use the first SocketCAN interface known on the system. */
   AppFindFirstCanInterface();
@@ -107,22 +158,92 @@ int main(int argc, char *argv[])
     return result;
   }
 
+  /* Block the delivery of the signals that request a program exit. This must be done
+   * before any thread is started, because threads inherit the signal mask. The main
+   * thread obtains these signals from a signal file descriptor instead.
+   */
+  sigemptyset(&sigMask);
+  sigaddset(&sigMask, SIGINT);
+  sigaddset(&sigMask, SIGTERM);
+  sigaddset(&sigMask, SIGHUP);
+  sigprocmask(SIG_BLOCK, &sigMask, NULL);
+
+  /* Initialize the event loop. The main thread blocks in it until an exit is requested.
+   * In single-threaded mode, it also services all other events. This must be done 
+   * before initializing the other drivers, because they register with the event loop.
+   */
+  if (!LoopInit(CAPLIN_SINGLE_THREADED > 0))
+  {
+    printf("ERROR: Could not initialize the event loop.\n");
+    return EXIT_FAILURE;
+  }
+  /* Register the signal file descriptor with the event loop. */
+  appSignalFd = signalfd(APP_INVALID_FD, &sigMask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (appSignalFd != APP_INVALID_FD)
+  {
+    (void)LoopAdd(appSignalFd, EPOLLIN, AppSignalLoopEvent, NULL);
+  }
+
+  /* When running offline, switch to the virtual clock. The timer driver then no longer
+   * needs a thread or timer file descriptor, because the CAN driver advances it.
+   */
+  if (appArgOffline != NULL)
+  {
+    UtilSetVirtualTime(0);
+  }
   /* Initialize the timer driver. */
   TimerInit();
+  /* Initialize the sequence module. */
+  SeqInit();
+  /* Initialize the request/response correlation module. */
+  CorrInit();
+  /* Initialize the control channel module. */
+  CtrlInit();
   /* Initialize the input key detection driver. */
   KeysInit(AppKeyPressedCallback);
+  /* Initialize the message dispatcher. */
+  DispatchInit(OnMessage);
+  /* Initialize the latest value table. */
+  LatestInit();
+  /* Initialize the per-identifier statistics. */
+  StatsInit();
+  /* Initialize the logger. */
+  LoggerInit();
+  /* Initialize the pcapng capture writer. */
+  PcapngInit();
+  /* Initialize the compressed capture writer. */
+  PackInit();
+  /* Initialize the pre/post-trigger capture. */
+  TriggerInit();
+  /* Initialize the bus load monitor. */
+  BusloadInit();
+  /* Initialize the replay module. */
+  ReplayInit();
   /* Initialization the CAN driver. */
-  CanInit(OnMessage, NULL);
+  CanInit(AppMessageReceivedCallback, AppMessageTransmittedCallback);
+
+  /* When running offline, open the log file. This already sets the virtual clock to its
+   * first CAN message, such that timers started in OnPreStart begin at that time.
+   */
+  if (appArgOffline != NULL)
+  {
+    offlineOpened = CanOpenOffline(appArgOffline);
+  }
 
-  /* Register interrupt signal handler for when CTRL+C was pressed. */
-  signal(SIGINT,AppInterruptSignalHandler);
   /* Call the OnPreStart callback. */
   OnPreStart();
-  /* Connect to the CAN bus. */
-  canConnected = CanConnect(canDevice);
+  /* Connect to the CAN bus, or to the log file when running offline. */
+  canConnected = offlineOpened && CanConnect(canDevice);
 
   /* Only run the actual CAN application if connected. */
-  if (!canConnected)
+  if (!offlineOpened)
+  {
+    /* Display error message. */
+    printf("ERROR: Could not read CAN messages from log file \"%s\".\n", appArgOffline);
+    /* Update the result. */
+    result = EXIT_FAILURE;
+  }
+  else if (!canConnected)
   {
     /* Display usage information. */
     AppDisplayHelp(argv[0]);
@@ -133,34 +254,100 @@ int main(int argc, char *argv[])
   }
   else
   {
+    /* Open the control channel, if requested on the command line. */
+    if ( (appArgControl[0] != '\0') && (!CtrlOpen(appArgControl)) )
+    {
+      printf("WARNING: Could not open control channel \"%s\".\n", appArgControl);
+    }
     /* Call the OnStart callback. */
     OnStart();
 
-    /* Enter the program loop until an exit is requested. */
-    while (!atomic_load(&appExitProgram))
+    /* Block in the event loop until an exit is requested, either by a signal or by the
+     * ESC key. The main thread does not wake up otherwise, unless the event loop also
+     * services all other events in single-threaded mode. When running offline, the
+     * event loop also delivers the CAN messages and stops after the last one.
+     */
+    (void)clock_gettime(CLOCK_MONOTONIC, &runStart);
+    LoopRun();
+    (void)clock_gettime(CLOCK_MONOTONIC, &runEnd);
+
+    /* Report the throughput of the offline run. */
+    if (appArgOffline != NULL)
     {
-      /* Nothing to do here, because the user's CAN application is event driven. Just
-       * delay a little to not starve the CPU. 
-       */
-      UtilSleep(50 * 1000);
+      CanGetStats(&canStats);
+      runTime = (double)(runEnd.tv_sec - runStart.tv_sec) +
+                ((double)(runEnd.tv_nsec - runStart.tv_nsec) / 1e9);
+      printf("Offline: %llu messages in %.3f s", (unsigned long long)canStats.rxCount,
+             runTime);
+      if (runTime > 0.0)
+      {
+        printf(", %.0f messages/s", (double)canStats.rxCount / runTime);
+      }
+      printf("\n");
     }
 
     /* Call the OnStop callback. */
     OnStop();
 
+    /* Stop the replay, in case it still runs. */
+    ReplayStop();
+
     /* Disconnect from the CAN bus. */
     CanDisconnect();
   }
 
+  /* Stop the dispatcher's worker threads, after they handled the queued messages. */
+  DispatchStop();
+  /* Stop the logger, after it wrote the queued messages. */
+  LoggerStop();
+  /* Stop the pcapng capture writer, after it wrote the queued messages. */
+  PcapngStop();
+  /* Stop the compressed capture writer, after it wrote the queued messages. */
+  PackStop();
+  /* Stop the pre/post-trigger capture, after it wrote a pending trigger. */
+  TriggerStop();
+  /* Stop the bus load monitor. Its statistics keep their last values. */
+  BusloadStop();
+
   /* Call the OnPostStop callback. */
   OnPostStop();
 
+  /* Terminate the control channel module. This also stops its cyclic messages. */
+  CtrlTerminate();
+  /* Terminate the request/response correlation module. */
+  CorrTerminate();
   /* Terminate the timer driver. */
   TimerTerminate();
   /* Terminate the CAN driver. */
   CanTerminate();
+  /* Terminate the message dispatcher. */
+  DispatchTerminate();
+  /* Terminate the logger. */
+  LoggerTerminate();
+  /* Terminate the pcapng capture writer. */
+  PcapngTerminate();
+  /* Terminate the compressed capture writer. */
+  PackTerminate();
+  /* Terminate the pre/post-trigger capture. */
+  TriggerTerminate();
+  /* Terminate the bus load monitor. */
+  BusloadTerminate();
+  /* Terminate the replay module. */
+  ReplayTerminate();
   /* Terminate the input key detection driver. */
   KeysTerminate();
+  /* Terminate the sequence module. */
+  SeqTerminate();
+
+  /* Release the signal file descriptor. */
+  if (appSignalFd != APP_INVALID_FD)
+  {
+    LoopRemove(appSignalFd);
+    close(appSignalFd);
+    appSignalFd = APP_INVALID_FD;
+  }
+  /* Terminate the event loop. */
+  LoopTerminate();
 
   /* Give the result back to the caller. */
   return result;
@@ -183,12 +370,14 @@ static void AppParseArguments(int argc, char *argv[])
     int option_index = 0;
     static struct option long_options[] = 
     {
-      { "help", no_argument, NULL, 'h' },
-      { NULL,   0,           NULL,  0  }
+      { "help",    no_argument,       NULL, 'h' },
+      { "control", required_argument, NULL, 'c' },
+      { "offline", required_argument, NULL, 'o' },
+      { NULL,      0,                 NULL,  0  }
     };
 
     /* Get the next argument, */
-    c = getopt_long(argc, argv, "-:h", long_options, &option_index);
+    c = getopt_long(argc, argv, "-:hc:o:", long_options, &option_index);
     /* All done? */
     if (c == -1)
     {
@@ -210,6 +399,19 @@ static void AppParseArguments(int argc, char *argv[])
         appArgHelp = true;
         break;
 
+      /* Control channel requested. */
+      case 'c':
+        /* Store the socket path. */
+        strncpy(appArgControl, optarg, sizeof(appArgControl) - 1U);
+        appArgControl[sizeof(appArgControl) - 1U] = '\0';
+        break;
+
+      /* Offline run on a log file requested. */
+      case 'o':
+        /* Store the log file path. */
+        appArgOffline = optarg;
+        break;
+
       default:
         break;
     }
@@ -224,7 +426,7 @@ static void AppParseArguments(int argc, char *argv[])
 ****************************************************************************************/
 static void AppDisplayHelp(char const * appName)
 {
-  printf("Usage: %s [-h] [interface]\n", appName);
+  printf("Usage: %s [-h] [-c PATH] [-o FILE] [interface]\n", appName);
   printf("\n");
   printf("  Run the SocketCAN node application, using the INTERFACE SocketCAN\n");
   printf("  network interface.\n");
@@ -235,10 +437,14 @@ static void AppDisplayHelp(char const * appName)
   printf("  Command 'ip addr | grep \"can\"' lists all available SocketCAN\n");
   printf("  network interfaces.\n");
   printf("\n");
-  printf("  Press ESC or CTRL+C to exit.\n");
+  printf("  Press ESC or CTRL+C, or send SIGTERM to exit.\n");
   printf("\n");
   printf("  Options:\n");
   printf("    -h, --help      Display this help information.\n");
+  printf("    -c, --control   Open a control channel on the Unix domain socket\n");
+  printf("                    at PATH. Send \"help\" to it for the commands.\n");
+  printf("    -o, --offline   Run offline on the CAN messages of log FILE, instead\n");
+  printf("                    of the CAN bus. Timers follow the logged timestamps.\n");
   printf("\n");
 } /*** end of AppDisplayHelp ***/
 
@@ -337,8 +543,11 @@ static void AppKeyPressedCallback(char key)
   /* -------------------------- ESC key pressed? --------------------------------------*/
   if (key == 27)
   {
-    /* Set request flag to exit the program when the ESC key was pressed. */
-    atomic_store(&appExitProgram, true);
+    /* Request the program exit when the ESC key was pressed, by stopping the event 
+     * loop. This signals the event loop's event file descriptor, so it is safe to do 
+     * from any thread.
+     */
+    LoopStop();
   }
   /* All other keys can be processed by the user's CAN application. */
   else
@@ -350,16 +559,86 @@ static void AppKeyPressedCallback(char key)
 
 
 /************************************************************************************//**
-** \brief     Application callback that gets called when CTRL+C was pressed to quit the
-**            program.
-** \param     signum Signal number (not used)
+** \brief     Application callback that gets called upon reception of a CAN message.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+static void AppMessageReceivedCallback(tCanMsg const * msg)
+{
+  /* Store the message as the latest value of its identifier. */
+  LatestMessage(msg);
+  /* Update the statistics of its identifier. */
+  StatsMessage(msg);
+  /* Log the message, if the logger runs. */
+  (void)LoggerMessage(msg, false);
+  /* Capture the message, if the pcapng capture writer runs. */
+  (void)PcapngMessage(msg, false);
+  /* Capture the message, if the compressed capture writer runs. */
+  (void)PackMessage(msg, false);
+  /* Keep the message in memory, if the pre/post-trigger capture runs. */
+  (void)TriggerMessage(msg, false);
+  /* Add the message to the bus load, if the bus load monitor runs. */
+  BusloadMessage(msg, false);
+  /* Complete the expected response that matches the message, if any. */
+  CorrMessageReceived(msg);
+  /* Pass the message on to the sequences that wait for it. */
+  SeqMessageReceived(msg);
+  /* Hand the message to the dispatcher's worker threads, if enabled. Otherwise call the
+   * handler registered for its identifier and the OnMessage callback directly.
+   */
+  if (!DispatchMessage(msg))
+  {
+    DispatchHandle(msg);
+  }
+} /*** end of AppMessageReceivedCallback ***/
+
+
+/************************************************************************************//**
+** \brief     Application callback that gets called upon transmission of a CAN message.
+** \param     msg Pointer to the transmitted CAN message.
 **
 ****************************************************************************************/
-static void AppInterruptSignalHandler(int signum)
+static void AppMessageTransmittedCallback(tCanMsg const * msg)
 {
-  /* Set request flag to exit the program when the CTRL+C key combo was pressed. */
-  atomic_store(&appExitProgram, true);
-} /*** end of AppInterruptSignalHandler ***/
+  /* Log the message, if the logger runs and is configured to log transmitted ones. */
+  (void)LoggerMessage(msg, true);
+  /* Capture the message, if the pcapng capture writer runs and is configured to capture
+   * transmitted ones.
+   */
+  (void)PcapngMessage(msg, true);
+  /* Capture the message, if the compressed capture writer runs and is configured to
+   * capture transmitted ones.
+   */
+  (void)PackMessage(msg, true);
+  /* Keep the message in memory, if the pre/post-trigger capture runs and is configured
+   * to capture transmitted ones.
+   */
+  (void)TriggerMessage(msg, true);
+  /* Add the message to the bus load, if the bus load monitor runs. */
+  BusloadMessage(msg, true);
+} /*** end of AppMessageTransmittedCallback ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when a signal is pending on the
+**            signal file descriptor. This happens when CTRL+C was pressed (SIGINT), upon
+**            a termination request (SIGTERM) or when the terminal hung up (SIGHUP).
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void AppSignalLoopEvent(int fd, uint32_t events, void * context)
+{
+  struct signalfd_siginfo sigInfo;
+
+  /* Consume the pending signal. */
+  if (read(fd, &sigInfo, sizeof(sigInfo)) == (ssize_t)sizeof(sigInfo))
+  {
+    /* Request the program exit by stopping the event loop. */
+    LoopStop();
+  }
+} /*** end of AppSignalLoopEvent ***/
 
 
 /************************************************************************************//**
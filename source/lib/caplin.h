@@ -24,6 +24,22 @@ extern "C" {
 #include "can.h"                            /* CAN driver                              */
 #include "timer.h"                          /* Timer driver                            */
 #include "keys.h"                           /* Input key detection driver              */
+#include "dispatch.h"                       /* Sharded message dispatcher              */
+#include "seq.h"                            /* Coroutine based test sequences          */
+#include "corr.h"                           /* Request/response correlation            */
+#include "ctrl.h"                           /* Control channel                         */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "format.h"                         /* CAN message text formatter              */
+#include "replay.h"                         /* Log file replay                         */
+#include "capture.h"                        /* Indexed capture file                    */
+#include "pcapng.h"                         /* Asynchronous pcapng capture writer      */
+#include "pack.h"                           /* Compressed capture file                 */
+#include "trigger.h"                        /* Pre/post-trigger capture                */
+#include "dbc.h"                            /* Generated DBC code types                */
+#include "extract.h"                        /* Batch signal extraction                 */
+#include "latest.h"                         /* Latest value table                      */
+#include "stats.h"                          /* Per-identifier statistics               */
+#include "busload.h"                        /* Bus load monitor                        */
 
 
 /****************************************************************************************
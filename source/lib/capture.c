@@ -0,0 +1,665 @@
+/************************************************************************************//**
+* \file         capture.c
+* \brief        Indexed capture file source file.
+* \details      Stores CAN messages in a binary capture file that can be searched without
+*               reading it completely. The fixed-size records of the logger are grouped
+*               into chunks of CAPTURE_CHUNK_RECORDS records. An index at the end of the
+*               file holds the time range of each chunk and a filter with the CAN
+*               identifiers that occur in it. The reader maps the capture file into
+*               memory. It finds the first chunk of a time range with a binary search on
+*               the index and skips the chunks whose filter rules out the requested CAN
+*               identifier, without touching their records.
+*
+*               A capture file starts with a tCaptureFileHeader, followed by the chunks
+*               with the tLoggerRecord records, the tCaptureChunk index entries and a
+*               tCaptureFileTrailer. All are in the byte order of the host. The records
+*               must be added in the order of their timestamps, as the CAN driver
+*               reports them.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <fcntl.h>                          /* File control options                    */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <sys/mman.h>                       /* Memory mapping                          */
+#include <sys/stat.h>                       /* File status                             */
+#include "can.h"                            /* CAN driver                              */
+#include "util.h"                           /* Utility functions                       */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+#include "replay.h"                         /* Log file replay                         */
+#include "capture.h"                        /* Indexed capture file                    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define CAPTURE_INVALID_FD             (-1)
+
+/** \brief Number of index entries that are allocated at first. The allocation doubles
+ *  each time it is full.
+ */
+#define CAPTURE_CHUNKS_INITIAL         (64U)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static bool CaptureWriterAddRecord(tCaptureWriter * writer, tLoggerRecord const * record);
+static bool CaptureWriterFlushChunk(tCaptureWriter * writer);
+static void CaptureFilterBits(uint32_t id, bool ext, uint32_t bits[2]);
+
+
+/************************************************************************************//**
+** \brief     Creates a capture file and prepares the writer for adding CAN messages to
+**            it. The writer is not thread safe.
+** \param     writer Pointer to the writer.
+** \param     path Path of the capture file.
+** \param     startTime System time in microseconds, to which the timestamps of the CAN
+**            messages are relative, for example CanStartTime().
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool CaptureWriterOpen(tCaptureWriter * writer, char const * path, uint64_t startTime)
+{
+  bool result = false;
+  tCaptureFileHeader header;
+
+  /* Verify parameters. */
+  assert(writer != NULL);
+  assert(path != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (writer != NULL) && (path != NULL) )
+  {
+    /* Initialize the writer. */
+    memset(writer, 0, sizeof(*writer));
+    writer->chunk.firstTime = UINT64_MAX;
+    writer->offset = sizeof(header);
+    writer->records = malloc(CAPTURE_CHUNK_RECORDS * sizeof(tLoggerRecord));
+    writer->chunks = malloc(CAPTURE_CHUNKS_INITIAL * sizeof(tCaptureChunk));
+    writer->chunkSize = CAPTURE_CHUNKS_INITIAL;
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    /* Write the header. */
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.recordSize = sizeof(tLoggerRecord);
+    header.chunkRecords = CAPTURE_CHUNK_RECORDS;
+    header.startTime = startTime;
+    if ( (writer->records != NULL) && (writer->chunks != NULL) &&
+         (writer->fd != CAPTURE_INVALID_FD) &&
+         (UtilWriteAll(writer->fd, &header, sizeof(header))) )
+    {
+      result = true;
+    }
+    /* Clean up on error. */
+    else
+    {
+      if (writer->fd != CAPTURE_INVALID_FD)
+      {
+        close(writer->fd);
+        (void)unlink(path);
+      }
+      free(writer->records);
+      free(writer->chunks);
+      memset(writer, 0, sizeof(*writer));
+      writer->fd = CAPTURE_INVALID_FD;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureWriterOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a CAN message to the capture file.
+** \param     writer Pointer to the writer.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool CaptureWriterAdd(tCaptureWriter * writer, tCanMsg const * msg, bool transmitted)
+{
+  bool result = false;
+  tLoggerRecord record;
+
+  /* Verify parameters. */
+  assert(writer != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (writer != NULL) && (msg != NULL) )
+  {
+    /* Convert the CAN message to a record. */
+    WriterMakeRecord(&record, msg, transmitted);
+    result = CaptureWriterAddRecord(writer, &record);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureWriterAdd ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the last chunk, the index and the trailer, and closes the capture
+**            file.
+** \param     writer Pointer to the writer.
+** \return    True if the complete capture file was written, false otherwise.
+**
+****************************************************************************************/
+bool CaptureWriterClose(tCaptureWriter * writer)
+{
+  bool result = false;
+  tCaptureFileTrailer trailer;
+
+  /* Verify parameter. */
+  assert(writer != NULL);
+
+  /* Only continue with valid parameter and an opened capture file. */
+  if ( (writer != NULL) && (writer->fd != CAPTURE_INVALID_FD) )
+  {
+    /* Write the last chunk, even if it is not full. */
+    if (writer->chunk.count > 0)
+    {
+      (void)CaptureWriterFlushChunk(writer);
+    }
+
+    /* Write the index and the trailer that locates it. */
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.indexOffset = writer->offset;
+    trailer.chunkCount = writer->chunkCount;
+    memcpy(trailer.magic, CAPTURE_MAGIC, sizeof(trailer.magic));
+    if ( (!writer->error) &&
+         (UtilWriteAll(writer->fd, writer->chunks,
+                       writer->chunkCount * sizeof(tCaptureChunk))) &&
+         (UtilWriteAll(writer->fd, &trailer, sizeof(trailer))) )
+    {
+      result = true;
+    }
+
+    /* Release the resources. */
+    if (close(writer->fd) != 0)
+    {
+      result = false;
+    }
+    free(writer->records);
+    free(writer->chunks);
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = CAPTURE_INVALID_FD;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureWriterClose ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a log file to a capture file. Reads the binary log files of the
+**            logger and text log files, just like the replay module. The direction and
+**            bus number of the records in a binary log file are preserved.
+** \param     source Path of the log file.
+** \param     destination Path of the capture file.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool CaptureConvert(char const * source, char const * destination)
+{
+  bool result = false;
+  tReplayFile file;
+  tCaptureWriter writer;
+  tLoggerFileHeader header;
+  tLoggerRecord record;
+  tCanMsg msg;
+  uint64_t startTime = 0;
+
+  /* Verify parameters. */
+  assert(source != NULL);
+  assert(destination != NULL);
+
+  /* Only continue with valid parameters and an opened log file. */
+  if ( (source != NULL) && (destination != NULL) && (ReplayFileOpen(&file, source)) )
+  {
+    /* The records of a binary log file are relative to the start time in its header. */
+    if (file.binary)
+    {
+      if ( (fseek(file.file, 0, SEEK_SET) == 0) &&
+           (fread(&header, sizeof(header), 1, file.file) == 1) )
+      {
+        startTime = header.startTime;
+      }
+      (void)fseek(file.file, file.dataOffset, SEEK_SET);
+    }
+
+    if (CaptureWriterOpen(&writer, destination, startTime))
+    {
+      /* Copy the records of a binary log file as they are. */
+      if (file.binary)
+      {
+        while ( (!writer.error) && (fread(&record, sizeof(record), 1, file.file) == 1) )
+        {
+          (void)CaptureWriterAddRecord(&writer, &record);
+        }
+      }
+      /* Convert the CAN messages of a text log file. */
+      else
+      {
+        while ( (!writer.error) && (ReplayFileRead(&file, &msg)) )
+        {
+          (void)CaptureWriterAdd(&writer, &msg, false);
+        }
+      }
+      result = ( (ferror(file.file) == 0) && (CaptureWriterClose(&writer)) );
+    }
+    ReplayFileClose(&file);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureConvert ***/
+
+
+/************************************************************************************//**
+** \brief     Opens a capture file for reading, by mapping it into memory.
+** \param     reader Pointer to the reader.
+** \param     path Path of the capture file.
+** \return    True if successful, false if the file could not be opened or is not a
+**            complete capture file.
+**
+****************************************************************************************/
+bool CaptureReaderOpen(tCaptureReader * reader, char const * path)
+{
+  bool result = false;
+  int fd;
+  struct stat st;
+  void * map;
+  tCaptureFileHeader const * header;
+  tCaptureFileTrailer const * trailer;
+  size_t indexSize;
+
+  /* Verify parameters. */
+  assert(reader != NULL);
+  assert(path != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (reader != NULL) && (path != NULL) )
+  {
+    memset(reader, 0, sizeof(*reader));
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != CAPTURE_INVALID_FD)
+    {
+      /* Map the complete capture file. The mapping stays valid after closing the file
+       * descriptor.
+       */
+      if ( (fstat(fd, &st) == 0) &&
+           ((size_t)st.st_size >= (sizeof(tCaptureFileHeader) +
+                                   sizeof(tCaptureFileTrailer))) )
+      {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+          reader->map = map;
+          reader->size = (size_t)st.st_size;
+        }
+      }
+      close(fd);
+    }
+
+    /* Check the header and the trailer. */
+    if (reader->map != NULL)
+    {
+      header = (tCaptureFileHeader const *)reader->map;
+      trailer = (tCaptureFileTrailer const *)(reader->map + reader->size -
+                                              sizeof(tCaptureFileTrailer));
+      indexSize = reader->size - sizeof(tCaptureFileHeader) - sizeof(tCaptureFileTrailer);
+      if ( (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) == 0) &&
+           (header->version == CAPTURE_VERSION) &&
+           (header->recordSize == sizeof(tLoggerRecord)) &&
+           (memcmp(trailer->magic, CAPTURE_MAGIC, sizeof(trailer->magic)) == 0) &&
+           (trailer->indexOffset >= sizeof(tCaptureFileHeader)) &&
+           (trailer->chunkCount <= (indexSize / sizeof(tCaptureChunk))) &&
+           ((trailer->indexOffset + (trailer->chunkCount * sizeof(tCaptureChunk)) +
+             sizeof(tCaptureFileTrailer)) == reader->size) )
+      {
+        reader->header = header;
+        reader->chunks = (tCaptureChunk const *)(reader->map + trailer->indexOffset);
+        reader->chunkCount = (size_t)trailer->chunkCount;
+        result = true;
+      }
+      else
+      {
+        CaptureReaderClose(reader);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureReaderOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Closes a capture file. Records that were obtained from it are no longer
+**            valid afterwards.
+** \param     reader Pointer to the reader.
+**
+****************************************************************************************/
+void CaptureReaderClose(tCaptureReader * reader)
+{
+  /* Verify parameter. */
+  assert(reader != NULL);
+
+  /* Only continue with valid parameter. */
+  if (reader != NULL)
+  {
+    if (reader->map != NULL)
+    {
+      (void)munmap((void *)reader->map, reader->size);
+    }
+    memset(reader, 0, sizeof(*reader));
+  }
+} /*** end of CaptureReaderClose ***/
+
+
+/************************************************************************************//**
+** \brief     Positions a cursor at the first record of a time range, for iterating over
+**            all records in that time range.
+** \param     cursor Pointer to the cursor.
+** \param     reader Pointer to the reader of the capture file.
+** \param     from Lowest record timestamp to report.
+** \param     to Highest record timestamp to report. UINT64_MAX for the end of the file.
+**
+****************************************************************************************/
+void CaptureSeek(tCaptureCursor * cursor, tCaptureReader const * reader, uint64_t from,
+                 uint64_t to)
+{
+  size_t low;
+  size_t high;
+  size_t middle;
+
+  /* Verify parameters. */
+  assert(cursor != NULL);
+  assert(reader != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (cursor != NULL) && (reader != NULL) )
+  {
+    cursor->reader = reader;
+    cursor->from = from;
+    cursor->to = to;
+    cursor->matchId = false;
+    cursor->id = 0;
+    cursor->ext = false;
+    cursor->record = 0;
+
+    /* Search the first chunk that can hold a record at or after the start of the time
+     * range. The highest timestamp of the chunks never decreases.
+     */
+    low = 0;
+    high = reader->chunkCount;
+    while (low < high)
+    {
+      middle = low + ((high - low) / 2U);
+      if (reader->chunks[middle].lastTime < from)
+      {
+        low = middle + 1U;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    cursor->chunk = low;
+  }
+} /*** end of CaptureSeek ***/
+
+
+/************************************************************************************//**
+** \brief     Positions a cursor at the first record of a time range, for iterating over
+**            the records of one CAN identifier in that time range. Chunks without this
+**            CAN identifier are skipped.
+** \param     cursor Pointer to the cursor.
+** \param     reader Pointer to the reader of the capture file.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     from Lowest record timestamp to report.
+** \param     to Highest record timestamp to report. UINT64_MAX for the end of the file.
+**
+****************************************************************************************/
+void CaptureSeekId(tCaptureCursor * cursor, tCaptureReader const * reader, uint32_t id,
+                   bool ext, uint64_t from, uint64_t to)
+{
+  /* Verify parameters. */
+  assert(cursor != NULL);
+  assert(reader != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (cursor != NULL) && (reader != NULL) )
+  {
+    CaptureSeek(cursor, reader, from, to);
+    cursor->matchId = true;
+    cursor->id = id;
+    cursor->ext = ext;
+  }
+} /*** end of CaptureSeekId ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the next record of a cursor. The record is not copied. It stays
+**            valid until the capture file is closed.
+** \param     cursor Pointer to the cursor.
+** \return    Pointer to the record, or NULL when there are no more records.
+**
+****************************************************************************************/
+tLoggerRecord const * CaptureNext(tCaptureCursor * cursor)
+{
+  tLoggerRecord const * result = NULL;
+  tCaptureReader const * reader;
+  tCaptureChunk const * chunk;
+  tLoggerRecord const * records;
+  uint32_t bits[2] = { 0 };
+  uint8_t flags;
+  bool skip;
+
+  /* Verify parameter. */
+  assert(cursor != NULL);
+
+  /* Only continue with valid parameter. */
+  if ( (cursor != NULL) && (cursor->reader != NULL) )
+  {
+    reader = cursor->reader;
+    flags = cursor->ext ? LOGGER_FLAG_EXT : 0U;
+    if (cursor->matchId)
+    {
+      CaptureFilterBits(cursor->id, cursor->ext, bits);
+    }
+
+    while ( (result == NULL) && (cursor->chunk < reader->chunkCount) )
+    {
+      chunk = &reader->chunks[cursor->chunk];
+      /* Skip chunks that lie outside of the capture file. */
+      skip = (chunk->offset > reader->size) ||
+             (chunk->count > ((reader->size - chunk->offset) / sizeof(tLoggerRecord)));
+      /* Skip chunks without the CAN identifier, before touching their records. */
+      if ( (cursor->matchId) && (cursor->record == 0) )
+      {
+        skip = skip ||
+               (((chunk->filter[bits[0] / 64U] >> (bits[0] % 64U)) & 1U) == 0) ||
+               (((chunk->filter[bits[1] / 64U] >> (bits[1] % 64U)) & 1U) == 0);
+      }
+
+      /* All done, once a chunk starts after the time range. */
+      if (chunk->firstTime > cursor->to)
+      {
+        cursor->chunk = reader->chunkCount;
+      }
+      else if (skip)
+      {
+        cursor->record = 0;
+        cursor->chunk++;
+      }
+      /* Scan the records of the chunk. */
+      else
+      {
+        records = (tLoggerRecord const *)(reader->map + chunk->offset);
+        while ( (result == NULL) && (cursor->record < chunk->count) )
+        {
+          if ( (records[cursor->record].timestamp >= cursor->from) &&
+               (records[cursor->record].timestamp <= cursor->to) &&
+               ( (!cursor->matchId) ||
+                 ( (records[cursor->record].id == cursor->id) &&
+                   ((records[cursor->record].flags & LOGGER_FLAG_EXT) == flags) ) ) )
+          {
+            result = &records[cursor->record];
+          }
+          cursor->record++;
+        }
+        /* Continue with the next chunk, once this one is done. */
+        if (cursor->record >= chunk->count)
+        {
+          cursor->chunk++;
+          cursor->record = 0;
+        }
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureNext ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a record to the current chunk of the capture file. Writes the chunk,
+**            once it is full.
+** \param     writer Pointer to the writer.
+** \param     record Pointer to the record.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool CaptureWriterAddRecord(tCaptureWriter * writer, tLoggerRecord const * record)
+{
+  bool result = false;
+  uint32_t bits[2];
+
+  /* Only continue with an opened capture file that had no write errors. */
+  if ( (writer->fd != CAPTURE_INVALID_FD) && (!writer->error) )
+  {
+    /* Add the record to the chunk and update its index entry. */
+    writer->records[writer->chunk.count++] = *record;
+    if (record->timestamp < writer->chunk.firstTime)
+    {
+      writer->chunk.firstTime = record->timestamp;
+    }
+    if (record->timestamp > writer->chunk.lastTime)
+    {
+      writer->chunk.lastTime = record->timestamp;
+    }
+    CaptureFilterBits(record->id, ((record->flags & LOGGER_FLAG_EXT) != 0), bits);
+    writer->chunk.filter[bits[0] / 64U] |= (uint64_t)1U << (bits[0] % 64U);
+    writer->chunk.filter[bits[1] / 64U] |= (uint64_t)1U << (bits[1] % 64U);
+    result = true;
+
+    /* Write the chunk, once it is full. */
+    if (writer->chunk.count >= CAPTURE_CHUNK_RECORDS)
+    {
+      result = CaptureWriterFlushChunk(writer);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureWriterAddRecord ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the records of the current chunk to the capture file and adds its
+**            entry to the index.
+** \param     writer Pointer to the writer.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool CaptureWriterFlushChunk(tCaptureWriter * writer)
+{
+  bool result = false;
+  tCaptureChunk * chunks;
+  uint64_t lastTime;
+
+  /* Make room in the index, if needed. */
+  if (writer->chunkCount >= writer->chunkSize)
+  {
+    chunks = realloc(writer->chunks, 2U * writer->chunkSize * sizeof(tCaptureChunk));
+    if (chunks != NULL)
+    {
+      writer->chunks = chunks;
+      writer->chunkSize *= 2U;
+    }
+  }
+
+  /* Write the records and add the index entry. */
+  if ( (writer->chunkCount < writer->chunkSize) &&
+       (UtilWriteAll(writer->fd, writer->records,
+                     writer->chunk.count * sizeof(tLoggerRecord))) )
+  {
+    writer->chunk.offset = writer->offset;
+    writer->chunks[writer->chunkCount++] = writer->chunk;
+    writer->offset += writer->chunk.count * sizeof(tLoggerRecord);
+    result = true;
+  }
+  else
+  {
+    writer->error = true;
+  }
+
+  /* Start the next chunk. Its highest timestamp includes the previous chunks, so it
+   * never decreases.
+   */
+  lastTime = writer->chunk.lastTime;
+  memset(&writer->chunk, 0, sizeof(writer->chunk));
+  writer->chunk.firstTime = UINT64_MAX;
+  writer->chunk.lastTime = lastTime;
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CaptureWriterFlushChunk ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the bits of the identifier filter of a chunk for a CAN
+**            identifier. An 11-bit identifier maps to its own bit. A 29-bit identifier
+**            is hashed to two bits.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     bits Array where the two bit numbers are stored.
+**
+****************************************************************************************/
+static void CaptureFilterBits(uint32_t id, bool ext, uint32_t bits[2])
+{
+  if (ext)
+  {
+    /* Two independent multiplicative hashes. The top bits are the best mixed. */
+    bits[0] = (id * 2654435761U) >> 21;
+    bits[1] = ((id ^ (id >> 15)) * 2246822519U) >> 21;
+  }
+  else
+  {
+    bits[0] = id & (CAPTURE_FILTER_BITS - 1U);
+    bits[1] = bits[0];
+  }
+} /*** end of CaptureFilterBits ***/
+
+
+/*********************************** end of capture.c **********************************/
@@ -0,0 +1,172 @@
+/************************************************************************************//**
+* \file         capture.h
+* \brief        Indexed capture file header file.
+*
+****************************************************************************************/
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of records per chunk of a capture file. The index holds one entry per
+ *  chunk, so larger chunks make a smaller index, but more records to scan per chunk.
+ */
+#ifndef CAPTURE_CHUNK_RECORDS
+#define CAPTURE_CHUNK_RECORDS          (16384U)
+#endif
+
+/** \brief Number of bits in the identifier filter of a chunk. 11-bit identifiers map
+ *  directly to a bit, 29-bit identifiers are hashed to two bits.
+ */
+#define CAPTURE_FILTER_BITS            (2048U)
+
+/** \brief Magic value at the start and at the end of each capture file. */
+#define CAPTURE_MAGIC                  "CAPLNIDX"
+
+/** \brief Version of the capture file format. */
+#define CAPTURE_VERSION                (1U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Header at the start of each capture file. All fields are in the byte order of
+ *  the host. The chunks with the records of the logger follow it.
+ */
+typedef struct
+{
+  /** \brief Magic value CAPTURE_MAGIC, without string termination. */
+  char     magic[8];
+  /** \brief Version of the capture file format, CAPTURE_VERSION. */
+  uint16_t version;
+  /** \brief Size of one record in bytes. */
+  uint16_t recordSize;
+  /** \brief Number of records per chunk. Only the last chunk can hold fewer. */
+  uint32_t chunkRecords;
+  /** \brief System time in microseconds, to which the record timestamps are relative. */
+  uint64_t startTime;
+} tCaptureFileHeader;
+
+/** \brief Index entry of one chunk. The index follows the last chunk. */
+typedef struct
+{
+  /** \brief File offset of the first record of the chunk. */
+  uint64_t offset;
+  /** \brief Number of records in the chunk. */
+  uint32_t count;
+  /** \brief Reserved for future use. Always zero. */
+  uint32_t reserved;
+  /** \brief Lowest record timestamp in the chunk. */
+  uint64_t firstTime;
+  /** \brief Highest record timestamp in this and all previous chunks. Never decreases
+   *  from one chunk to the next, so the index can be searched by time.
+   */
+  uint64_t lastTime;
+  /** \brief Identifier filter. A cleared bit means that none of the records in the
+   *  chunk has an identifier that maps to the bit.
+   */
+  uint64_t filter[CAPTURE_FILTER_BITS / 64U];
+} tCaptureChunk;
+
+/** \brief Trailer at the end of each capture file. It locates the index. */
+typedef struct
+{
+  /** \brief File offset of the index. */
+  uint64_t indexOffset;
+  /** \brief Number of entries in the index. */
+  uint64_t chunkCount;
+  /** \brief Magic value CAPTURE_MAGIC, without string termination. */
+  char     magic[8];
+} tCaptureFileTrailer;
+
+/** \brief Writer of a capture file. It collects the records of a chunk in memory and
+ *  writes the index, once the capture file is closed.
+ */
+typedef struct
+{
+  /** \brief File descriptor of the capture file. */
+  int             fd;
+  /** \brief File offset of the next chunk. */
+  uint64_t        offset;
+  /** \brief Records of the current chunk. */
+  tLoggerRecord * records;
+  /** \brief Index entry of the current chunk. */
+  tCaptureChunk   chunk;
+  /** \brief Index entries of the chunks that were written. */
+  tCaptureChunk * chunks;
+  /** \brief Number of index entries that were written. */
+  size_t          chunkCount;
+  /** \brief Number of index entries that fit in the allocated memory. */
+  size_t          chunkSize;
+  /** \brief True once writing the capture file failed. */
+  bool            error;
+} tCaptureWriter;
+
+/** \brief Reader of a capture file. It maps the capture file into memory, so records are
+ *  accessed in place and only the parts of the file that are visited are read.
+ */
+typedef struct
+{
+  /** \brief Start of the mapped capture file. */
+  uint8_t const             * map;
+  /** \brief Size of the mapped capture file in bytes. */
+  size_t                      size;
+  /** \brief Header of the capture file. */
+  tCaptureFileHeader const  * header;
+  /** \brief Index of the capture file. */
+  tCaptureChunk const       * chunks;
+  /** \brief Number of entries in the index. */
+  size_t                      chunkCount;
+} tCaptureReader;
+
+/** \brief Cursor that iterates over the records of a capture file, within a time range
+ *  and optionally for one CAN identifier only.
+ */
+typedef struct
+{
+  /** \brief The capture file. */
+  tCaptureReader const * reader;
+  /** \brief Lowest record timestamp to report. */
+  uint64_t               from;
+  /** \brief Highest record timestamp to report. */
+  uint64_t               to;
+  /** \brief True to only report the records with the CAN identifier below. */
+  bool                   matchId;
+  /** \brief CAN identifier to report. */
+  uint32_t               id;
+  /** \brief True if the CAN identifier to report is a 29-bit one. */
+  bool                   ext;
+  /** \brief Index of the current chunk. */
+  size_t                 chunk;
+  /** \brief Index of the next record in the current chunk. */
+  size_t                 record;
+} tCaptureCursor;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+bool CaptureWriterOpen(tCaptureWriter * writer, char const * path, uint64_t startTime);
+bool CaptureWriterAdd(tCaptureWriter * writer, tCanMsg const * msg, bool transmitted);
+bool CaptureWriterClose(tCaptureWriter * writer);
+bool CaptureConvert(char const * source, char const * destination);
+bool CaptureReaderOpen(tCaptureReader * reader, char const * path);
+void CaptureReaderClose(tCaptureReader * reader);
+void CaptureSeek(tCaptureCursor * cursor, tCaptureReader const * reader, uint64_t from,
+                 uint64_t to);
+void CaptureSeekId(tCaptureCursor * cursor, tCaptureReader const * reader, uint32_t id,
+                   bool ext, uint64_t from, uint64_t to);
+tLoggerRecord const * CaptureNext(tCaptureCursor * cursor);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_H */
+/*********************************** end of capture.h **********************************/
@@ -0,0 +1,625 @@
+/************************************************************************************//**
+* \file         corr.c
+* \brief        Request/response correlation source file.
+* \details      Keeps track of many expected responses at the same time, for example
+*               the responses to diagnostic requests. Expected responses for one
+*               specific CAN identifier are kept in hash buckets, so matching a received
+*               CAN message only looks at the expected responses with the same
+*               identifier. The timeouts of all expected responses share one timing
+*               wheel, which is advanced by a single timer.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <endian.h>                         /* Byte order conversions                  */
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "timer.h"                          /* Timer driver                            */
+#include "corr.h"                           /* Request/response correlation            */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Duration of one tick of the timing wheel in milliseconds. */
+#define CORR_TICK_MS                   (1U)
+
+/** \brief Index of the list for expected responses that match a range of CAN
+ *  identifiers. The lists before it are the hash buckets.
+ */
+#define CORR_LIST_WILDCARD             (CORR_BUCKETS)
+
+/** \brief Value of the free list link that marks the end of the list. */
+#define CORR_POOL_END                  (UINT16_MAX)
+
+/** \brief Constructs a handle from a generation and a pool index. Note that the index
+ *  is stored plus one, to make sure a valid handle never equals NULL.
+ */
+#define CORR_HANDLE(generation, idx)   \
+  ((tCorrRequest)(((uintptr_t)(generation) << 16U) | ((uintptr_t)(idx) + 1U)))
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief An expected response. */
+typedef struct t_corr_entry
+{
+  /** \brief Acceptance filter for the identifier of the response. */
+  tCanFilter filter;
+  /** \brief Payload mask and payload to match, as little endian 64-bit values. */
+  uint64_t dataMask;
+  uint64_t data;
+  /** \brief Minimum payload length to cover all masked bytes. */
+  uint8_t dataLen;
+  /** \brief Callback and its user context pointer. */
+  tCorrCallback callbackFcn;
+  void * context;
+  /** \brief Tick at which the expected response times out. */
+  uint64_t expiryTick;
+  /** \brief Boolean flag that is set while the response is expected. */
+  bool pending;
+  /** \brief Generation counter. Incremented each time the entry is released. */
+  uint16_t generation;
+  /** \brief Pool index of the next entry in the free list. */
+  uint16_t nextFree;
+  /** \brief Index of the list that holds the entry. */
+  uint16_t list;
+  /** \brief Links in the hash bucket or wildcard list. */
+  struct t_corr_entry * listPrev;
+  struct t_corr_entry * listNext;
+  /** \brief Links in the timing wheel slot. */
+  struct t_corr_entry * wheelPrev;
+  struct t_corr_entry * wheelNext;
+  /** \brief Link in the list of expected responses that timed out. */
+  struct t_corr_entry * expiredNext;
+} tCorrEntry;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Pool with the entries. */
+static tCorrEntry corrPool[CORR_POOL_SIZE];
+
+/** \brief Pool index of the first entry in the free list. */
+static uint16_t corrPoolFree;
+
+/** \brief Number of expected responses that are pending. Only modified with mutual
+ *  exclusive access to the entries, but atomic because it is also read without.
+ */
+static atomic_size_t corrPendingCount;
+
+/** \brief Hash buckets, followed by the wildcard list. Entries are appended, such that
+ *  the oldest matching expected response gets the response.
+ */
+static tCorrEntry * corrListHead[CORR_BUCKETS + 1U];
+static tCorrEntry * corrListTail[CORR_BUCKETS + 1U];
+
+/** \brief Slots of the timing wheel. */
+static tCorrEntry * corrWheel[CORR_WHEEL_SLOTS];
+
+/** \brief System time that corresponds to tick zero. */
+static uint64_t corrTimeBase;
+
+/** \brief Last tick that the timing wheel processed. */
+static uint64_t corrLastTick;
+
+/** \brief Timer that advances the timing wheel, while responses are pending. */
+static tTimer corrTimer;
+
+/** \brief Boolean flag that is set while the timer runs. */
+static bool corrTimerRunning;
+
+/** \brief Mutex for mutual exclusive access to the entries. Responses arrive on the CAN
+ *  event thread, while the timeouts are processed on the timer thread.
+ */
+static mtx_t corrMutex;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void CorrTimerEvent(void);
+static uint64_t CorrCurrentTick(void);
+static tCorrEntry * CorrLookup(tCorrRequest request);
+static void CorrUnlink(tCorrEntry * entry);
+static void CorrRelease(tCorrEntry * entry);
+
+
+/************************************************************************************//**
+** \brief     Initializes the correlation module. Should be called after the timer
+**            driver was initialized.
+**
+****************************************************************************************/
+void CorrInit(void)
+{
+  /* Initialize locals. */
+  corrPoolFree = CORR_POOL_END;
+  for (uint16_t idx = CORR_POOL_SIZE; idx > 0; idx--)
+  {
+    corrPool[idx - 1].pending = false;
+    corrPool[idx - 1].nextFree = corrPoolFree;
+    corrPoolFree = idx - 1;
+  }
+  atomic_init(&corrPendingCount, 0);
+  for (size_t idx = 0; idx < (CORR_BUCKETS + 1U); idx++)
+  {
+    corrListHead[idx] = NULL;
+    corrListTail[idx] = NULL;
+  }
+  for (size_t idx = 0; idx < CORR_WHEEL_SLOTS; idx++)
+  {
+    corrWheel[idx] = NULL;
+  }
+  corrTimeBase = UtilSystemTime();
+  corrLastTick = 0;
+  corrTimerRunning = false;
+
+  /* Initialize the mutex. */
+  if (mtx_init(&corrMutex, mtx_plain) != thrd_success)
+  {
+    assert(false);
+  }
+
+  /* Create the timer that advances the timing wheel. */
+  corrTimer = TimerCreate(CorrTimerEvent);
+} /*** end of CorrInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the correlation module. Pending expected responses are
+**            discarded, without calling their callbacks.
+**
+****************************************************************************************/
+void CorrTerminate(void)
+{
+  /* Delete the timer. */
+  TimerDelete(corrTimer);
+  corrTimer = NULL;
+
+  /* Destroy the mutex. */
+  mtx_destroy(&corrMutex);
+} /*** end of CorrTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Registers an expected response. The callback is called once, either with
+**            the first CAN message that matches, or with NULL upon timeout. Can be
+**            called from any thread.
+** \param     expect Pointer to the description of the expected response.
+** \return    Handle of the expected response, or NULL if no more responses can be
+**            expected at this point.
+**
+****************************************************************************************/
+tCorrRequest CorrExpect(tCorrExpect const * expect)
+{
+  tCorrRequest result = NULL;
+  tCorrEntry * entry;
+  uint16_t idx;
+  uint32_t fullMask;
+
+  /* Verify parameter. */
+  assert(expect != NULL);
+
+  /* Only continue with valid parameter. */
+  if ( (expect != NULL) && (expect->callbackFcn != NULL) )
+  {
+    /* Obtain mutual exclusive access to the entries. */
+    mtx_lock(&corrMutex);
+    /* Take an entry from the free list. */
+    if (corrPoolFree != CORR_POOL_END)
+    {
+      idx = corrPoolFree;
+      entry = &corrPool[idx];
+      corrPoolFree = entry->nextFree;
+      /* Store the description. The payload is compared as one 64-bit value. */
+      entry->filter = expect->filter;
+      entry->dataMask = 0;
+      entry->data = 0;
+      entry->dataLen = 0;
+      for (uint8_t byteIdx = 0; byteIdx < CAN_DATA_LEN_MAX; byteIdx++)
+      {
+        entry->dataMask |= (uint64_t)expect->dataMask[byteIdx] << (byteIdx * 8U);
+        entry->data |= (uint64_t)(expect->data[byteIdx] & expect->dataMask[byteIdx]) <<
+                       (byteIdx * 8U);
+        if (expect->dataMask[byteIdx] != 0)
+        {
+          entry->dataLen = byteIdx + 1U;
+        }
+      }
+      entry->callbackFcn = expect->callbackFcn;
+      entry->context = expect->context;
+      entry->expiryTick = CorrCurrentTick() +
+                          ((expect->timeout + (CORR_TICK_MS - 1U)) / CORR_TICK_MS) + 1U;
+      entry->pending = true;
+      /* Append it to the hash bucket of its identifier, if it expects one specific
+       * identifier. Otherwise to the wildcard list.
+       */
+      fullMask = expect->filter.ext ? CAN_EFF_MASK : CAN_SFF_MASK;
+      if ((expect->filter.mask & fullMask) == fullMask)
+      {
+        entry->list = (uint16_t)(expect->filter.id & (CORR_BUCKETS - 1U));
+      }
+      else
+      {
+        entry->list = CORR_LIST_WILDCARD;
+      }
+      entry->listNext = NULL;
+      entry->listPrev = corrListTail[entry->list];
+      if (entry->listPrev != NULL)
+      {
+        entry->listPrev->listNext = entry;
+      }
+      else
+      {
+        corrListHead[entry->list] = entry;
+      }
+      corrListTail[entry->list] = entry;
+      /* Add it to the slot of the timing wheel in which it expires. */
+      entry->wheelPrev = NULL;
+      entry->wheelNext = corrWheel[entry->expiryTick & (CORR_WHEEL_SLOTS - 1U)];
+      if (entry->wheelNext != NULL)
+      {
+        entry->wheelNext->wheelPrev = entry;
+      }
+      corrWheel[entry->expiryTick & (CORR_WHEEL_SLOTS - 1U)] = entry;
+      atomic_fetch_add_explicit(&corrPendingCount, 1, memory_order_relaxed);
+      /* Start the timer that advances the timing wheel, if it does not yet run. */
+      if (!corrTimerRunning)
+      {
+        corrLastTick = CorrCurrentTick();
+        corrTimerRunning = true;
+        TimerStart(corrTimer, CORR_TICK_MS);
+      }
+      result = CORR_HANDLE(entry->generation, idx);
+    }
+    /* Release mutual exclusive access to the entries. */
+    mtx_unlock(&corrMutex);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CorrExpect ***/
+
+
+/************************************************************************************//**
+** \brief     Registers an expected response and then transmits the request. Registering
+**            first makes sure that a fast response is not missed.
+** \param     msg Pointer to the CAN message with the request.
+** \param     expect Pointer to the description of the expected response.
+** \return    Handle of the expected response, or NULL if the response could not be
+**            registered or the request could not be transmitted.
+**
+****************************************************************************************/
+tCorrRequest CorrTransmit(tCanMsg const * msg, tCorrExpect const * expect)
+{
+  tCorrRequest result = NULL;
+
+  /* Verify parameters. */
+  assert(msg != NULL);
+  assert(expect != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (msg != NULL) && (expect != NULL) )
+  {
+    /* Register the expected response. */
+    result = CorrExpect(expect);
+    /* Transmit the request. */
+    if (result != NULL)
+    {
+      if (!CanTransmit(msg))
+      {
+        (void)CorrCancel(result);
+        result = NULL;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CorrTransmit ***/
+
+
+/************************************************************************************//**
+** \brief     Cancels an expected response. Its callback is not called.
+** \param     request Handle of the expected response.
+** \return    True if cancelled, false if it already completed.
+**
+****************************************************************************************/
+bool CorrCancel(tCorrRequest request)
+{
+  bool result = false;
+  tCorrEntry * entry;
+
+  /* Obtain mutual exclusive access to the entries. */
+  mtx_lock(&corrMutex);
+  /* Look up the entry and release it, if still pending. */
+  entry = CorrLookup(request);
+  if ( (entry != NULL) && (entry->pending) )
+  {
+    CorrUnlink(entry);
+    CorrRelease(entry);
+    result = true;
+  }
+  /* Release mutual exclusive access to the entries. */
+  mtx_unlock(&corrMutex);
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CorrCancel ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the number of expected responses that are pending.
+** \return    Number of pending expected responses.
+**
+****************************************************************************************/
+size_t CorrPending(void)
+{
+  size_t result;
+
+  /* Read the counter with mutual exclusive access to the entries. */
+  mtx_lock(&corrMutex);
+  result = atomic_load_explicit(&corrPendingCount, memory_order_relaxed);
+  mtx_unlock(&corrMutex);
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CorrPending ***/
+
+
+/************************************************************************************//**
+** \brief     Completes the oldest expected response that matches the received CAN
+**            message. Should be called for each received CAN message.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+void CorrMessageReceived(tCanMsg const * msg)
+{
+  tCorrEntry * entry = NULL;
+  tCorrCallback callbackFcn = NULL;
+  void * context = NULL;
+  tCorrRequest request = NULL;
+  uint64_t data = 0;
+  size_t lists[2];
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter. No need to lock, if nothing is pending. The
+   * unprotected read is fine, because a response to a request that is registered at
+   * the same time cannot be in flight yet.
+   */
+  if ( (msg != NULL) && 
+       (atomic_load_explicit(&corrPendingCount, memory_order_relaxed) > 0) )
+  {
+    /* Convert the payload to a little endian 64-bit value for comparing it in one go,
+     * like the expected payload.
+     */
+    memcpy(&data, msg->data, (msg->len <= CAN_DATA_LEN_MAX) ? msg->len : CAN_DATA_LEN_MAX);
+    data = le64toh(data);
+    lists[0] = msg->id & (CORR_BUCKETS - 1U);
+    lists[1] = CORR_LIST_WILDCARD;
+
+    /* Obtain mutual exclusive access to the entries. */
+    mtx_lock(&corrMutex);
+    /* Look for the oldest match in the hash bucket of the identifier first and then in
+     * the wildcard list.
+     */
+    for (size_t listIdx = 0; (listIdx < 2) && (callbackFcn == NULL); listIdx++)
+    {
+      for (entry = corrListHead[lists[listIdx]]; entry != NULL; entry = entry->listNext)
+      {
+        if ( (CanFilterMatch(&entry->filter, msg)) && (msg->len >= entry->dataLen) &&
+             (((data ^ entry->data) & entry->dataMask) == 0) )
+        {
+          /* Complete it. */
+          callbackFcn = entry->callbackFcn;
+          context = entry->context;
+          request = CORR_HANDLE(entry->generation, entry - corrPool);
+          CorrUnlink(entry);
+          CorrRelease(entry);
+          break;
+        }
+      }
+    }
+    /* Release mutual exclusive access to the entries. */
+    mtx_unlock(&corrMutex);
+
+    /* Call the callback without holding the lock, so it can register the next expected
+     * response.
+     */
+    if (callbackFcn != NULL)
+    {
+      callbackFcn(request, msg, context);
+    }
+  }
+} /*** end of CorrMessageReceived ***/
+
+
+/************************************************************************************//**
+** \brief     Timer callback that advances the timing wheel and calls the callbacks of
+**            the expected responses that timed out.
+**
+****************************************************************************************/
+static void CorrTimerEvent(void)
+{
+  tCorrEntry * expired = NULL;
+  tCorrEntry * entry;
+  tCorrEntry * next;
+  uint64_t now;
+  uint64_t tick;
+
+  /* Obtain mutual exclusive access to the entries. */
+  mtx_lock(&corrMutex);
+  /* Visit the slots of all ticks since the last pass. No need to visit a slot more than
+   * once.
+   */
+  now = CorrCurrentTick();
+  tick = corrLastTick + 1U;
+  if ((now - corrLastTick) > CORR_WHEEL_SLOTS)
+  {
+    tick = now - CORR_WHEEL_SLOTS + 1U;
+  }
+  for (; tick <= now; tick++)
+  {
+    entry = corrWheel[tick & (CORR_WHEEL_SLOTS - 1U)];
+    while (entry != NULL)
+    {
+      next = entry->wheelNext;
+      /* Entries of later rounds of the wheel share the slot. */
+      if (entry->expiryTick <= now)
+      {
+        /* Move it to the list of expired entries. Keep it out of the free list, until
+         * its callback was called.
+         */
+        CorrUnlink(entry);
+        entry->expiredNext = expired;
+        expired = entry;
+      }
+      entry = next;
+    }
+  }
+  corrLastTick = now;
+  /* Keep the timer running while responses are pending. Timer events are one-shot. */
+  if (atomic_load_explicit(&corrPendingCount, memory_order_relaxed) > 0)
+  {
+    TimerStart(corrTimer, CORR_TICK_MS);
+  }
+  else
+  {
+    corrTimerRunning = false;
+  }
+  /* Release mutual exclusive access to the entries. */
+  mtx_unlock(&corrMutex);
+
+  /* Call the callbacks of the expired entries without holding the lock. */
+  for (entry = expired; entry != NULL; entry = entry->expiredNext)
+  {
+    entry->callbackFcn(CORR_HANDLE(entry->generation, entry - corrPool), NULL,
+                       entry->context);
+  }
+  /* Return the expired entries to the free list. */
+  if (expired != NULL)
+  {
+    mtx_lock(&corrMutex);
+    while (expired != NULL)
+    {
+      next = expired->expiredNext;
+      CorrRelease(expired);
+      expired = next;
+    }
+    mtx_unlock(&corrMutex);
+  }
+} /*** end of CorrTimerEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the current tick of the timing wheel.
+** \return    The current tick.
+**
+****************************************************************************************/
+static uint64_t CorrCurrentTick(void)
+{
+  /* Give the result back to the caller. */
+  return (UtilSystemTime() - corrTimeBase) / (CORR_TICK_MS * 1000U);
+} /*** end of CorrCurrentTick ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a handle to its entry. Should be called with mutual exclusive
+**            access to the entries.
+** \param     request Handle of the expected response.
+** \return    Pointer to the entry, or NULL if the handle is no longer valid.
+**
+****************************************************************************************/
+static tCorrEntry * CorrLookup(tCorrRequest request)
+{
+  tCorrEntry * result = NULL;
+  uintptr_t value = (uintptr_t)request;
+  uintptr_t idx = value & 0xFFFFU;
+
+  /* Check the index and the generation of the handle. */
+  if ( (idx > 0) && (idx <= CORR_POOL_SIZE) )
+  {
+    if (corrPool[idx - 1].generation == (uint16_t)(value >> 16U))
+    {
+      result = &corrPool[idx - 1];
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CorrLookup ***/
+
+
+/************************************************************************************//**
+** \brief     Removes a pending entry from its list and from the timing wheel. Should be
+**            called with mutual exclusive access to the entries.
+** \param     entry Pointer to the entry.
+**
+****************************************************************************************/
+static void CorrUnlink(tCorrEntry * entry)
+{
+  /* Remove it from its hash bucket or the wildcard list. */
+  if (entry->listPrev != NULL)
+  {
+    entry->listPrev->listNext = entry->listNext;
+  }
+  else
+  {
+    corrListHead[entry->list] = entry->listNext;
+  }
+  if (entry->listNext != NULL)
+  {
+    entry->listNext->listPrev = entry->listPrev;
+  }
+  else
+  {
+    corrListTail[entry->list] = entry->listPrev;
+  }
+  /* Remove it from its slot of the timing wheel. */
+  if (entry->wheelPrev != NULL)
+  {
+    entry->wheelPrev->wheelNext = entry->wheelNext;
+  }
+  else
+  {
+    corrWheel[entry->expiryTick & (CORR_WHEEL_SLOTS - 1U)] = entry->wheelNext;
+  }
+  if (entry->wheelNext != NULL)
+  {
+    entry->wheelNext->wheelPrev = entry->wheelPrev;
+  }
+  /* It is no longer pending. */
+  entry->pending = false;
+  atomic_fetch_sub_explicit(&corrPendingCount, 1, memory_order_relaxed);
+} /*** end of CorrUnlink ***/
+
+
+/************************************************************************************//**
+** \brief     Returns an entry to the free list and invalidates its handle. Should be
+**            called with mutual exclusive access to the entries.
+** \param     entry Pointer to the entry.
+**
+****************************************************************************************/
+static void CorrRelease(tCorrEntry * entry)
+{
+  entry->generation++;
+  entry->nextFree = corrPoolFree;
+  corrPoolFree = (uint16_t)(entry - corrPool);
+} /*** end of CorrRelease ***/
+
+
+/*********************************** end of corr.c *************************************/
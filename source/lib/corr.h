@@ -0,0 +1,88 @@
+/************************************************************************************//**
+* \file         corr.h
+* \brief        Request/response correlation header file.
+*
+****************************************************************************************/
+#ifndef CORR_H
+#define CORR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of expected responses that can be pending at the same time.
+ *  Must not exceed 65535.
+ */
+#ifndef CORR_POOL_SIZE
+#define CORR_POOL_SIZE                 (1024U)
+#endif
+
+/** \brief Number of hash buckets for the expected responses. Must be a power of two. */
+#ifndef CORR_BUCKETS
+#define CORR_BUCKETS                   (1024U)
+#endif
+
+/** \brief Number of slots of the timing wheel. One slot per tick. Must be a power of
+ *  two.
+ */
+#ifndef CORR_WHEEL_SLOTS
+#define CORR_WHEEL_SLOTS               (256U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Handle of an expected response. Encodes the pool index and the generation of
+ *  the entry, such that a handle of a response that already completed is detected and
+ *  ignored.
+ */
+typedef void * tCorrRequest;
+
+/** \brief Function type for the completion callback handler. The response parameter is
+ *  NULL when no matching response was received before the timeout.
+ */
+typedef void (* tCorrCallback)(tCorrRequest request, tCanMsg const * response,
+                               void * context);
+
+/** \brief Description of an expected response. */
+typedef struct
+{
+  /** \brief Acceptance filter for the identifier of the response. */
+  tCanFilter filter;
+  /** \brief Mask with the payload bits that must match. All zeros to not match the
+   *  payload.
+   */
+  uint8_t dataMask[CAN_DATA_LEN_MAX];
+  /** \brief Payload to match, for the bits selected by the data mask. */
+  uint8_t data[CAN_DATA_LEN_MAX];
+  /** \brief Timeout in milliseconds. */
+  uint32_t timeout;
+  /** \brief Callback that is called upon the response or the timeout. */
+  tCorrCallback callbackFcn;
+  /** \brief User context pointer that is passed on to the callback. */
+  void * context;
+} tCorrExpect;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void         CorrInit(void);
+void         CorrTerminate(void);
+tCorrRequest CorrExpect(tCorrExpect const * expect);
+tCorrRequest CorrTransmit(tCanMsg const * msg, tCorrExpect const * expect);
+bool         CorrCancel(tCorrRequest request);
+size_t       CorrPending(void);
+void         CorrMessageReceived(tCanMsg const * msg);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORR_H */
+/*********************************** end of corr.h *************************************/
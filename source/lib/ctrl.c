@@ -0,0 +1,932 @@
+/************************************************************************************//**
+* \file         ctrl.c
+* \brief        Control channel source file.
+* \details      Optional control channel on a Unix domain socket, serviced by the event
+*               loop. External tools connect to it and send text commands, one per line,
+*               to inject CAN messages, start and stop cyclic CAN messages, change the
+*               acceptance filters and obtain statistics. Each command is answered with
+*               one line that starts with "OK" or "ERR". Send "help" for an overview.
+*
+*               CAN messages are written as <id>#<data>, like the can-utils do. The
+*               identifier is hexadecimal, with more than three digits for a 29-bit
+*               identifier. The data is written as up to eight hexadecimal byte values,
+*               optionally separated by dots. For example: 123#DEADBEEF.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#define _GNU_SOURCE                         /* for accept4()                           */
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <ctype.h>                          /* Character classification                */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <sys/socket.h>                     /* Sockets                                 */
+#include <sys/un.h>                         /* Unix domain sockets                     */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+#include "can.h"                            /* CAN driver                              */
+#include "timer.h"                          /* Timer driver                            */
+#include "loop.h"                           /* Event loop driver                       */
+#include "seq.h"                            /* Coroutine based test sequences          */
+#include "corr.h"                           /* Request/response correlation            */
+#include "dispatch.h"                       /* Sharded message dispatcher              */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "stats.h"                          /* Per-identifier statistics               */
+#include "idtable.h"                        /* CAN identifier table                    */
+#include "ctrl.h"                           /* Control channel                         */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define CTRL_INVALID_FD                (-1)
+
+/** \brief Maximum length of a reply line, including the line ending. */
+#define CTRL_REPLY_MAX                 (1024U)
+
+/** \brief Characters that separate the arguments of a command. */
+#define CTRL_SEPARATORS                " \t\r"
+
+/** \brief Constructs the timer context of a cyclic CAN message from the generation of
+ *  its slot and the slot index.
+ */
+#define CTRL_CYCLIC_CONTEXT(generation, idx) \
+  ((void *)(((uintptr_t)(generation) * CTRL_CYCLIC_MAX) + (uintptr_t)(idx)))
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief A connected client with the command line that it is sending. */
+typedef struct
+{
+  /** \brief Socket of the client, or CTRL_INVALID_FD if this slot is free. */
+  int fd;
+  /** \brief Number of characters in the line buffer. */
+  size_t len;
+  /** \brief Line buffer. One extra character for the string termination. */
+  char line[CTRL_LINE_MAX + 1U];
+} tCtrlClient;
+
+/** \brief A cyclic CAN message. */
+typedef struct
+{
+  /** \brief Timer that triggers the transmission, or NULL if this slot is free. */
+  tTimer timer;
+  /** \brief The CAN message to transmit. */
+  tCanMsg msg;
+  /** \brief Cycle time in milliseconds. */
+  uint32_t period;
+  /** \brief Sequence counter that protects the CAN message, because the timer callback
+   *  reads it on the timer thread. Each start and stop changes it, so it is also the
+   *  generation of the slot.
+   */
+  atomic_uint sequence;
+} tCtrlCyclic;
+
+/** \brief Function type of a command handler. It writes the reply without line ending. */
+typedef void (* tCtrlCommandHandler)(char * args, char * reply, size_t size);
+
+/** \brief Entry of the command table. */
+typedef struct
+{
+  /** \brief Name of the command. */
+  char const * name;
+  /** \brief Usage information, as shown by the help command. */
+  char const * usage;
+  /** \brief The command handler. */
+  tCtrlCommandHandler handler;
+} tCtrlCommand;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void CtrlAcceptEvent(int fd, uint32_t events, void * context);
+static void CtrlClientEvent(int fd, uint32_t events, void * context);
+static void CtrlCloseClient(tCtrlClient * client);
+static void CtrlExecute(tCtrlClient * client, char * line);
+static void CtrlCyclicEvent(tTimer timer, void * context);
+static void CtrlCyclicStop(tCtrlCyclic * cyclic);
+static bool CtrlParseFrame(char const * text, tCanMsg * msg);
+static bool CtrlParseFilter(char const * text, tCanFilter * filter);
+static char const * CtrlUsage(char const * name);
+static void CtrlCmdSend(char * args, char * reply, size_t size);
+static void CtrlCmdCyclic(char * args, char * reply, size_t size);
+static void CtrlCmdFilter(char * args, char * reply, size_t size);
+static void CtrlCmdStats(char * args, char * reply, size_t size);
+static void CtrlCmdIdStats(char * args, char * reply, size_t size);
+static void CtrlCmdHelp(char * args, char * reply, size_t size);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Table with the supported commands. The quit command is handled separately,
+ *  because it closes the connection.
+ */
+static const tCtrlCommand ctrlCommands[] =
+{
+  { "send",    "send <frame> [<frame> ...]",                      CtrlCmdSend    },
+  { "cyclic",  "cyclic start <ms> <frame> | cyclic stop <n>|all", CtrlCmdCyclic  },
+  { "filter",  "filter <id>:<mask>[x] [...] | filter clear",      CtrlCmdFilter  },
+  { "stats",   "stats",                                           CtrlCmdStats   },
+  { "idstats", "idstats <id> | idstats reset",                    CtrlCmdIdStats },
+  { "help",    "help",                                            CtrlCmdHelp    }
+};
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Listening socket, or CTRL_INVALID_FD if the control channel is closed. */
+static int ctrlListenFd = CTRL_INVALID_FD;
+
+/** \brief Path of the listening socket, removed again when closing. */
+static char ctrlPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/** \brief The connected clients. */
+static tCtrlClient ctrlClients[CTRL_CLIENTS_MAX];
+
+/** \brief The cyclic CAN messages. */
+static tCtrlCyclic ctrlCyclic[CTRL_CYCLIC_MAX];
+
+
+/************************************************************************************//**
+** \brief     Initializes the control channel module. The control channel itself is only
+**            opened with CtrlOpen().
+**
+****************************************************************************************/
+void CtrlInit(void)
+{
+  /* Initialize locals. */
+  ctrlListenFd = CTRL_INVALID_FD;
+  ctrlPath[0] = '\0';
+  for (size_t idx = 0; idx < CTRL_CLIENTS_MAX; idx++)
+  {
+    ctrlClients[idx].fd = CTRL_INVALID_FD;
+    ctrlClients[idx].len = 0;
+  }
+  for (size_t idx = 0; idx < CTRL_CYCLIC_MAX; idx++)
+  {
+    ctrlCyclic[idx].timer = NULL;
+    atomic_init(&ctrlCyclic[idx].sequence, 0U);
+  }
+} /*** end of CtrlInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the control channel module. Closes the control channel and
+**            stops the cyclic CAN messages. Should be called before the timer driver
+**            and the event loop are terminated.
+**
+****************************************************************************************/
+void CtrlTerminate(void)
+{
+  /* Close the control channel. */
+  CtrlClose();
+
+  /* Stop the cyclic CAN messages. */
+  for (size_t idx = 0; idx < CTRL_CYCLIC_MAX; idx++)
+  {
+    if (ctrlCyclic[idx].timer != NULL)
+    {
+      CtrlCyclicStop(&ctrlCyclic[idx]);
+    }
+  }
+} /*** end of CtrlTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Opens the control channel on a Unix domain socket. A stale socket file at
+**            the same path is replaced.
+** \param     path File system path of the socket.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool CtrlOpen(char const * path)
+{
+  bool result = false;
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+  /* Verify parameter. */
+  assert(path != NULL);
+
+  /* Only continue with valid parameter, a path that fits and when not yet open. */
+  if ( (path != NULL) && (strlen(path) < sizeof(addr.sun_path)) &&
+       (ctrlListenFd == CTRL_INVALID_FD) )
+  {
+    /* Create the listening socket. */
+    strcpy(addr.sun_path, path);
+    ctrlListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ctrlListenFd != CTRL_INVALID_FD)
+    {
+      /* Remove a stale socket file and bind to the path. */
+      (void)unlink(path);
+      if ( (bind(ctrlListenFd, (struct sockaddr *)&addr, sizeof(addr)) == 0) &&
+           (listen(ctrlListenFd, CTRL_CLIENTS_MAX) == 0) &&
+           (LoopAdd(ctrlListenFd, EPOLLIN, CtrlAcceptEvent, NULL)) )
+      {
+        strcpy(ctrlPath, path);
+        result = true;
+      }
+      else
+      {
+        close(ctrlListenFd);
+        ctrlListenFd = CTRL_INVALID_FD;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CtrlOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Closes the control channel and disconnects all clients. The cyclic CAN
+**            messages keep running.
+**
+****************************************************************************************/
+void CtrlClose(void)
+{
+  /* Disconnect all clients. */
+  for (size_t idx = 0; idx < CTRL_CLIENTS_MAX; idx++)
+  {
+    CtrlCloseClient(&ctrlClients[idx]);
+  }
+
+  /* Close the listening socket and remove its socket file. */
+  if (ctrlListenFd != CTRL_INVALID_FD)
+  {
+    LoopRemove(ctrlListenFd);
+    close(ctrlListenFd);
+    ctrlListenFd = CTRL_INVALID_FD;
+    (void)unlink(ctrlPath);
+    ctrlPath[0] = '\0';
+  }
+} /*** end of CtrlClose ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when a client connects.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void CtrlAcceptEvent(int fd, uint32_t events, void * context)
+{
+  tCtrlClient * client = NULL;
+  int clientFd;
+
+  /* Accept the connection. */
+  clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (clientFd != CTRL_INVALID_FD)
+  {
+    /* Find a free client slot. */
+    for (size_t idx = 0; idx < CTRL_CLIENTS_MAX; idx++)
+    {
+      if (ctrlClients[idx].fd == CTRL_INVALID_FD)
+      {
+        client = &ctrlClients[idx];
+        break;
+      }
+    }
+    /* Register the client with the event loop. */
+    if ( (client != NULL) && (LoopAdd(clientFd, EPOLLIN, CtrlClientEvent, client)) )
+    {
+      client->fd = clientFd;
+      client->len = 0;
+    }
+    /* Too many clients. */
+    else
+    {
+      close(clientFd);
+    }
+  }
+} /*** end of CtrlAcceptEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when a client sent data. Executes all
+**            complete command lines.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context Pointer to the client.
+**
+****************************************************************************************/
+static void CtrlClientEvent(int fd, uint32_t events, void * context)
+{
+  tCtrlClient * client = context;
+  ssize_t count;
+  char * lineStart;
+  char * lineEnd;
+
+  /* Append the received data to the line buffer. */
+  count = read(fd, &client->line[client->len], CTRL_LINE_MAX - client->len);
+  if (count <= 0)
+  {
+    /* Connection closed or in error. */
+    CtrlCloseClient(client);
+    return;
+  }
+  client->len += (size_t)count;
+  client->line[client->len] = '\0';
+
+  /* Execute all complete lines. */
+  lineStart = client->line;
+  while ((lineEnd = strchr(lineStart, '\n')) != NULL)
+  {
+    *lineEnd = '\0';
+    CtrlExecute(client, lineStart);
+    /* Stop if the client quit. */
+    if (client->fd == CTRL_INVALID_FD)
+    {
+      return;
+    }
+    lineStart = lineEnd + 1;
+  }
+  /* Keep the incomplete line for the next time. */
+  client->len = strlen(lineStart);
+  memmove(client->line, lineStart, client->len);
+  /* A line that does not fit cannot be executed. Discard it. */
+  if (client->len == CTRL_LINE_MAX)
+  {
+    client->len = 0;
+    (void)send(fd, "ERR line too long\n", 18, MSG_NOSIGNAL | MSG_DONTWAIT);
+  }
+} /*** end of CtrlClientEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Disconnects a client.
+** \param     client Pointer to the client.
+**
+****************************************************************************************/
+static void CtrlCloseClient(tCtrlClient * client)
+{
+  if (client->fd != CTRL_INVALID_FD)
+  {
+    LoopRemove(client->fd);
+    close(client->fd);
+    client->fd = CTRL_INVALID_FD;
+    client->len = 0;
+  }
+} /*** end of CtrlCloseClient ***/
+
+
+/************************************************************************************//**
+** \brief     Executes a command line and sends the reply to the client.
+** \param     client Pointer to the client.
+** \param     line The command line, without line ending.
+**
+****************************************************************************************/
+static void CtrlExecute(tCtrlClient * client, char * line)
+{
+  char reply[CTRL_REPLY_MAX];
+  char * name;
+  char * args;
+  size_t len;
+
+  /* Split off the command name. Ignore empty lines. */
+  name = strtok_r(line, CTRL_SEPARATORS, &args);
+  if (name == NULL)
+  {
+    return;
+  }
+  /* Quit closes the connection without a reply. */
+  if (strcmp(name, "quit") == 0)
+  {
+    CtrlCloseClient(client);
+    return;
+  }
+
+  /* Look up the command and execute it. */
+  snprintf(reply, sizeof(reply), "ERR unknown command");
+  for (size_t idx = 0; idx < (sizeof(ctrlCommands) / sizeof(ctrlCommands[0])); idx++)
+  {
+    if (strcmp(name, ctrlCommands[idx].name) == 0)
+    {
+      ctrlCommands[idx].handler(args, reply, sizeof(reply) - 1U);
+      break;
+    }
+  }
+
+  /* Send the reply. Replies are dropped for a client that does not read them, rather
+   * than stalling the event loop.
+   */
+  len = strlen(reply);
+  reply[len++] = '\n';
+  (void)send(client->fd, reply, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+} /*** end of CtrlExecute ***/
+
+
+/************************************************************************************//**
+** \brief     Timer callback that transmits a cyclic CAN message.
+** \param     timer Handle of the timer that expired.
+** \param     context Slot index and generation of the cyclic CAN message, as
+**            constructed by CTRL_CYCLIC_CONTEXT.
+**
+****************************************************************************************/
+static void CtrlCyclicEvent(tTimer timer, void * context)
+{
+  size_t idx = (size_t)((uintptr_t)context % CTRL_CYCLIC_MAX);
+  tCtrlCyclic * cyclic = &ctrlCyclic[idx];
+  tCanMsg msg;
+  unsigned int sequence;
+
+  /* Copy the CAN message until the copy is consistent. The callback of a stopped timer
+   * can still run, while the control channel stores a new CAN message in its slot.
+   */
+  do
+  {
+    sequence = IdTableReadBegin(&cyclic->sequence);
+    msg = cyclic->msg;
+  }
+  while (!IdTableReadEnd(&cyclic->sequence, sequence));
+
+  /* Only continue if the slot still belongs to this timer. Otherwise the cyclic CAN
+   * message was stopped in the meantime and the copy is not of this timer.
+   */
+  if (CTRL_CYCLIC_CONTEXT(sequence, idx) == context)
+  {
+    (void)CanTransmit(&msg);
+    /* Timer events are one-shot, so restart it for the next cycle. Restarting it from
+     * the previous deadline, instead of from now, keeps the cycle time from drifting.
+     */
+    TimerRestart(timer);
+  }
+} /*** end of CtrlCyclicEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Stops a cyclic CAN message and frees its slot.
+** \param     cyclic Pointer to the cyclic CAN message.
+**
+****************************************************************************************/
+static void CtrlCyclicStop(tCtrlCyclic * cyclic)
+{
+  unsigned int sequence;
+
+  /* Outdate the generation of the slot, so that a callback of its timer that still
+   * runs does not transmit. Then delete the timer.
+   */
+  sequence = IdTableWriteBegin(&cyclic->sequence);
+  IdTableWriteEnd(&cyclic->sequence, sequence);
+  TimerDelete(cyclic->timer);
+  cyclic->timer = NULL;
+} /*** end of CtrlCyclicStop ***/
+
+
+/************************************************************************************//**
+** \brief     Parses a CAN message in the <id>#<data> format.
+** \param     text The text to parse.
+** \param     msg Pointer to where the CAN message is stored.
+** \return    True if successful, false if the text is not a valid CAN message.
+**
+****************************************************************************************/
+static bool CtrlParseFrame(char const * text, tCanMsg * msg)
+{
+  bool result = false;
+  char * end;
+  unsigned long id;
+  char digits[3] = { 0 };
+
+  /* Parse the identifier. More than three digits make it a 29-bit identifier. */
+  id = strtoul(text, &end, 16);
+  if ( (end != text) && (*end == '#') && (isxdigit((unsigned char)*text)) )
+  {
+    memset(msg, 0, sizeof(tCanMsg));
+    msg->ext = ((end - text) > 3);
+    msg->id = (uint32_t)id;
+    if (msg->id <= (msg->ext ? CAN_EFF_MASK : CAN_SFF_MASK))
+    {
+      /* Parse the data bytes. */
+      result = true;
+      text = end + 1;
+      while ( (*text != '\0') && (result) )
+      {
+        if (*text == '.')
+        {
+          text++;
+        }
+        else if ( (msg->len < CAN_DATA_LEN_MAX) && (isxdigit((unsigned char)text[0])) &&
+                  (isxdigit((unsigned char)text[1])) )
+        {
+          digits[0] = text[0];
+          digits[1] = text[1];
+          msg->data[msg->len++] = (uint8_t)strtoul(digits, NULL, 16);
+          text += 2;
+        }
+        else
+        {
+          result = false;
+        }
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CtrlParseFrame ***/
+
+
+/************************************************************************************//**
+** \brief     Parses an acceptance filter in the <id>:<mask>[x] format. The x suffix
+**            selects 29-bit identifiers. The identifier and the mask must fit in an
+**            identifier of the selected type.
+** \param     text The text to parse.
+** \param     filter Pointer to where the acceptance filter is stored.
+** \return    True if successful, false if the text is not a valid filter.
+**
+****************************************************************************************/
+static bool CtrlParseFilter(char const * text, tCanFilter * filter)
+{
+  bool result = false;
+  unsigned long id;
+  unsigned long mask;
+  unsigned long limit;
+  char * end;
+
+  /* Parse the identifier and the mask. */
+  id = strtoul(text, &end, 16);
+  if ( (end != text) && (*end == ':') )
+  {
+    text = end + 1;
+    mask = strtoul(text, &end, 16);
+    if (end != text)
+    {
+      /* Parse the optional suffix. */
+      filter->ext = (*end == 'x');
+      if (filter->ext)
+      {
+        end++;
+      }
+      /* Check the ranges of the identifier and the mask. */
+      limit = filter->ext ? CAN_EFF_MASK : CAN_SFF_MASK;
+      if ( (*end == '\0') && (id <= limit) && (mask <= limit) )
+      {
+        filter->id = (uint32_t)id;
+        filter->mask = (uint32_t)mask;
+        result = true;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CtrlParseFilter ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the usage information of a command from the command table.
+** \param     name Name of the command.
+** \return    The usage information, or an empty string if the command does not exist.
+**
+****************************************************************************************/
+static char const * CtrlUsage(char const * name)
+{
+  char const * result = "";
+
+  /* Look up the command. */
+  for (size_t idx = 0; idx < (sizeof(ctrlCommands) / sizeof(ctrlCommands[0])); idx++)
+  {
+    if (strcmp(name, ctrlCommands[idx].name) == 0)
+    {
+      result = ctrlCommands[idx].usage;
+      break;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CtrlUsage ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that transmits one or more CAN messages.
+** \param     args The command arguments.
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdSend(char * args, char * reply, size_t size)
+{
+  tCanMsg msg;
+  char * token;
+  size_t count = 0;
+  size_t failed = 0;
+
+  /* Transmit the CAN messages one-by-one. */
+  while ((token = strtok_r(NULL, CTRL_SEPARATORS, &args)) != NULL)
+  {
+    if (!CtrlParseFrame(token, &msg))
+    {
+      snprintf(reply, size, "ERR invalid frame %s, sent %zu", token, count);
+      return;
+    }
+    if (CanTransmit(&msg))
+    {
+      count++;
+    }
+    else
+    {
+      failed++;
+    }
+  }
+  if (failed > 0)
+  {
+    snprintf(reply, size, "ERR sent %zu, failed %zu", count, failed);
+  }
+  else
+  {
+    snprintf(reply, size, "OK %zu", count);
+  }
+} /*** end of CtrlCmdSend ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that starts or stops cyclic CAN messages.
+** \param     args The command arguments.
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdCyclic(char * args, char * reply, size_t size)
+{
+  char * action = strtok_r(NULL, CTRL_SEPARATORS, &args);
+  char * first = strtok_r(NULL, CTRL_SEPARATORS, &args);
+  char * second = strtok_r(NULL, CTRL_SEPARATORS, &args);
+  tCtrlCyclic * cyclic = NULL;
+  tCanMsg msg;
+  unsigned long period;
+  unsigned long slot;
+  unsigned int sequence;
+  char * end;
+
+  /* Start a cyclic CAN message? */
+  if ( (action != NULL) && (strcmp(action, "start") == 0) && (second != NULL) )
+  {
+    period = strtoul(first, &end, 10);
+    if ( (*end != '\0') || (period == 0) || (period > UINT32_MAX) )
+    {
+      snprintf(reply, size, "ERR invalid period");
+      return;
+    }
+    /* Find a free slot. */
+    for (slot = 0; slot < CTRL_CYCLIC_MAX; slot++)
+    {
+      if (ctrlCyclic[slot].timer == NULL)
+      {
+        cyclic = &ctrlCyclic[slot];
+        break;
+      }
+    }
+    if (cyclic == NULL)
+    {
+      snprintf(reply, size, "ERR too many cyclic messages");
+    }
+    else if (!CtrlParseFrame(second, &msg))
+    {
+      snprintf(reply, size, "ERR invalid frame %s", second);
+    }
+    else
+    {
+      /* Store the CAN message. This starts a new generation of the slot, so that the
+       * callback of a timer that used it before does not transmit it.
+       */
+      sequence = IdTableWriteBegin(&cyclic->sequence);
+      cyclic->msg = msg;
+      cyclic->period = (uint32_t)period;
+      IdTableWriteEnd(&cyclic->sequence, sequence);
+      /* Create its timer for the new generation and start it. */
+      cyclic->timer = TimerCreateContext(CtrlCyclicEvent,
+                                         CTRL_CYCLIC_CONTEXT(sequence + 2U, slot));
+      if (cyclic->timer == NULL)
+      {
+        snprintf(reply, size, "ERR no timer available");
+      }
+      else
+      {
+        TimerStart(cyclic->timer, cyclic->period);
+        snprintf(reply, size, "OK %lu", slot);
+      }
+    }
+  }
+  /* Stop one or all cyclic CAN messages? */
+  else if ( (action != NULL) && (strcmp(action, "stop") == 0) && (first != NULL) )
+  {
+    slot = strtoul(first, &end, 10);
+    if (strcmp(first, "all") == 0)
+    {
+      for (slot = 0; slot < CTRL_CYCLIC_MAX; slot++)
+      {
+        if (ctrlCyclic[slot].timer != NULL)
+        {
+          CtrlCyclicStop(&ctrlCyclic[slot]);
+        }
+      }
+      snprintf(reply, size, "OK");
+    }
+    else if ( (*end != '\0') || (slot >= CTRL_CYCLIC_MAX) ||
+              (ctrlCyclic[slot].timer == NULL) )
+    {
+      snprintf(reply, size, "ERR no such cyclic message");
+    }
+    else
+    {
+      CtrlCyclicStop(&ctrlCyclic[slot]);
+      snprintf(reply, size, "OK");
+    }
+  }
+  else
+  {
+    snprintf(reply, size, "ERR usage: %s", CtrlUsage("cyclic"));
+  }
+} /*** end of CtrlCmdCyclic ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that configures the acceptance filters of the CAN socket.
+** \param     args The command arguments.
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdFilter(char * args, char * reply, size_t size)
+{
+  tCanFilter filters[CAN_FILTERS_MAX];
+  size_t count = 0;
+  char * token = strtok_r(NULL, CTRL_SEPARATORS, &args);
+
+  /* Removing all filters takes the explicit clear keyword, on its own. */
+  if ( (token == NULL) ||
+       ( (strcmp(token, "clear") == 0) &&
+         (strtok_r(NULL, CTRL_SEPARATORS, &args) != NULL) ) )
+  {
+    snprintf(reply, size, "ERR usage: %s", CtrlUsage("filter"));
+    return;
+  }
+  /* Otherwise parse the filters. */
+  if (strcmp(token, "clear") != 0)
+  {
+    while (token != NULL)
+    {
+      if ( (count == CAN_FILTERS_MAX) || (!CtrlParseFilter(token, &filters[count])) )
+      {
+        snprintf(reply, size, "ERR invalid filter %s", token);
+        return;
+      }
+      count++;
+      token = strtok_r(NULL, CTRL_SEPARATORS, &args);
+    }
+  }
+  /* Configure them. */
+  if (CanSetFilters(filters, count))
+  {
+    snprintf(reply, size, "OK %zu", count);
+  }
+  else
+  {
+    snprintf(reply, size, "ERR could not set filters");
+  }
+} /*** end of CtrlCmdFilter ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that reports the statistics as key=value pairs.
+** \param     args The command arguments (not used).
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdStats(char * args, char * reply, size_t size)
+{
+  tCanStats canStats;
+  tDispatchStats dispatchStats;
+  tLoggerStats loggerStats;
+  size_t cyclicCount = 0;
+  size_t len;
+
+  /* Collect the counters. */
+  CanGetStats(&canStats);
+  LoggerGetStats(&loggerStats);
+  for (size_t idx = 0; idx < CTRL_CYCLIC_MAX; idx++)
+  {
+    if (ctrlCyclic[idx].timer != NULL)
+    {
+      cyclicCount++;
+    }
+  }
+  len = (size_t)snprintf(reply, size,
+                         "OK rx=%llu tx=%llu txerr=%llu cyclic=%zu sequences=%zu "
+                         "pending=%zu logged=%llu logdrop=%llu workers=%zu",
+                         (unsigned long long)canStats.rxCount,
+                         (unsigned long long)canStats.txCount,
+                         (unsigned long long)canStats.txErrors, cyclicCount, SeqCount(),
+                         CorrPending(), (unsigned long long)loggerStats.written,
+                         (unsigned long long)loggerStats.dropped, DispatchWorkerCount());
+  /* Add the queue statistics of each worker. */
+  for (size_t idx = 0; (idx < DispatchWorkerCount()) && (len < size); idx++)
+  {
+    if (DispatchGetStats(idx, &dispatchStats))
+    {
+      len += (size_t)snprintf(&reply[len], size - len,
+                              " w%zu=%llu/%llu/%llu/%zu/%zu", idx,
+                              (unsigned long long)dispatchStats.dispatched,
+                              (unsigned long long)dispatchStats.processed,
+                              (unsigned long long)dispatchStats.dropped,
+                              dispatchStats.depth, dispatchStats.highWater);
+    }
+  }
+} /*** end of CtrlCmdStats ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that reports the statistics of one CAN identifier, or
+**            resets the statistics of all CAN identifiers. More than three digits make
+**            it a 29-bit identifier.
+** \param     args The command arguments.
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdIdStats(char * args, char * reply, size_t size)
+{
+  char * token = strtok_r(NULL, CTRL_SEPARATORS, &args);
+  tStatsSnapshot snapshot;
+  unsigned long id;
+  char * end;
+  bool ext;
+
+  /* Reset the statistics? */
+  if ( (token != NULL) && (strcmp(token, "reset") == 0) )
+  {
+    StatsReset();
+    snprintf(reply, size, "OK");
+  }
+  /* Report the statistics of a CAN identifier? */
+  else if ( (token != NULL) && (isxdigit((unsigned char)*token)) )
+  {
+    id = strtoul(token, &end, 16);
+    ext = ((end - token) > 3);
+    if ( (*end != '\0') || (id > (ext ? CAN_EFF_MASK : CAN_SFF_MASK)) )
+    {
+      snprintf(reply, size, "ERR invalid identifier %s", token);
+    }
+    else if (!StatsGet((uint32_t)id, ext, &snapshot))
+    {
+      snprintf(reply, size, "ERR not received");
+    }
+    else
+    {
+      snprintf(reply, size,
+               "OK count=%llu rate=%.1f min=%u avg=%.1f max=%u jitter=%.1f dlc=%u "
+               "last=%llu", (unsigned long long)snapshot.count, snapshot.rate,
+               snapshot.intervalMin, snapshot.intervalAvg, snapshot.intervalMax,
+               snapshot.jitter, snapshot.len, (unsigned long long)snapshot.timestamp);
+    }
+  }
+  else
+  {
+    snprintf(reply, size, "ERR usage: %s", CtrlUsage("idstats"));
+  }
+} /*** end of CtrlCmdIdStats ***/
+
+
+/************************************************************************************//**
+** \brief     Command handler that lists the supported commands.
+** \param     args The command arguments (not used).
+** \param     reply Buffer for the reply.
+** \param     size Size of the reply buffer.
+**
+****************************************************************************************/
+static void CtrlCmdHelp(char * args, char * reply, size_t size)
+{
+  size_t len;
+
+  /* List the usage of all commands on one line. */
+  len = (size_t)snprintf(reply, size, "OK");
+  for (size_t idx = 0; (idx < (sizeof(ctrlCommands) / sizeof(ctrlCommands[0]))) &&
+                       (len < size); idx++)
+  {
+    len += (size_t)snprintf(&reply[len], size - len, " [%s]", ctrlCommands[idx].usage);
+  }
+  if (len < size)
+  {
+    snprintf(&reply[len], size - len, " [quit]");
+  }
+} /*** end of CtrlCmdHelp ***/
+
+
+/*********************************** end of ctrl.c *************************************/
@@ -0,0 +1,46 @@
+/************************************************************************************//**
+* \file         ctrl.h
+* \brief        Control channel header file.
+*
+****************************************************************************************/
+#ifndef CTRL_H
+#define CTRL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of clients that can be connected at the same time. */
+#ifndef CTRL_CLIENTS_MAX
+#define CTRL_CLIENTS_MAX               (8U)
+#endif
+
+/** \brief Maximum length of a command line, including the line ending. */
+#ifndef CTRL_LINE_MAX
+#define CTRL_LINE_MAX                  (4096U)
+#endif
+
+/** \brief Maximum number of cyclic messages that can run at the same time. */
+#ifndef CTRL_CYCLIC_MAX
+#define CTRL_CYCLIC_MAX                (64U)
+#endif
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void CtrlInit(void);
+void CtrlTerminate(void);
+bool CtrlOpen(char const * path);
+void CtrlClose(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CTRL_H */
+/*********************************** end of ctrl.h *************************************/
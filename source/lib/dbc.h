@@ -0,0 +1,59 @@
+/************************************************************************************//**
+* \file         dbc.h
+* \brief        Types of the code that is generated from DBC files header file.
+* \details      The caplin_add_dbc() CMake function runs the dbcgen tool on a DBC file at
+*               build time. For each CAN message it generates a structure with the
+*               signals, plus functions to decode, encode and handle the CAN message.
+*               Each generated file also holds a table with all its CAN messages. Its
+*               entries have the types of this header file.
+*
+****************************************************************************************/
+#ifndef DBC_H
+#define DBC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of a generated decoder. It stores the signals of the CAN message
+ *  in the structure of the CAN message and returns false if the CAN message is too
+ *  short.
+ */
+typedef bool (* tDbcDecodeFcn)(tCanMsg const * msg, void * signals);
+
+/** \brief Function type of a generated encoder. It builds the CAN message from the
+ *  signals in the structure of the CAN message.
+ */
+typedef void (* tDbcEncodeFcn)(void const * signals, tCanMsg * msg);
+
+/** \brief Entry of the generated table with the CAN messages of a DBC file. */
+typedef struct
+{
+  /** \brief Name of the CAN message in the DBC file. */
+  char const  * name;
+  /** \brief CAN identifier. */
+  uint32_t      id;
+  /** \brief True for a 29-bit CAN identifier, false for 11-bit. */
+  bool          ext;
+  /** \brief Data length of the CAN message. */
+  uint8_t       len;
+  /** \brief Number of signals. */
+  uint8_t       signalCount;
+  /** \brief Size in bytes of the structure with the signals. */
+  size_t        size;
+  /** \brief Decoder of the CAN message. */
+  tDbcDecodeFcn decodeFcn;
+  /** \brief Encoder of the CAN message. */
+  tDbcEncodeFcn encodeFcn;
+} tDbcMessage;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DBC_H */
+/*********************************** end of dbc.h **************************************/
@@ -0,0 +1,627 @@
+/************************************************************************************//**
+* \file         dispatch.c
+* \brief        Sharded message dispatcher source file.
+* \details      Optionally spreads the handling of received CAN messages over multiple
+*               worker threads. The CAN event thread hashes each CAN message by its
+*               identifier into the queue of one worker, so all CAN messages with the
+*               same identifier are handled in order by the same worker, while CAN
+*               messages with different identifiers are handled in parallel.
+*
+*               Besides the general handler, a handler can be registered for the CAN
+*               messages with a specific identifier. It is called right before the
+*               general handler, from the same thread. Looking it up takes one table
+*               access for an 11-bit identifier and a short hash table probe for a 29-bit
+*               one.
+*
+*               A handler can also be registered to only run when the data of the CAN
+*               message changed, optionally only in the bytes and bits of a mask, or when
+*               a heartbeat time passed since it last ran. The data bytes are compared
+*               with those of the last CAN message that the handler saw, as one 64-bit
+*               value. Bytes beyond the data length do not take part in the comparison.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#define _GNU_SOURCE                         /* for the CPU affinity functions          */
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <sched.h>                          /* CPU sets                                */
+#include <pthread.h>                        /* CPU affinity of threads                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <endian.h>                         /* Byte order conversions                  */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "loop.h"                           /* Event loop driver                       */
+#include "idtable.h"                        /* CAN identifier table                    */
+#include "dispatch.h"                       /* Sharded message dispatcher              */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Handler that is registered for the CAN messages with one identifier. */
+typedef struct
+{
+  /** \brief Handler function, or NULL for none. */
+  tDispatchHandler handlerFcn;
+  /** \brief Context pointer that is passed to the handler. */
+  void           * context;
+  /** \brief Data bytes that the handler saw last, as a little endian 64-bit value. */
+  uint64_t         data;
+  /** \brief Mask of the data bits that are compared, as a little endian 64-bit value. */
+  uint64_t         mask;
+  /** \brief Timestamp of the CAN message that the handler saw last. */
+  uint64_t         timestamp;
+  /** \brief Heartbeat time in microseconds, or zero for none. */
+  uint64_t         heartbeat;
+  /** \brief Data length of the CAN message that the handler saw last. */
+  uint8_t          len;
+  /** \brief True if the handler only runs on a change or a heartbeat. */
+  bool             onChange;
+  /** \brief True if the handler saw a CAN message since it was registered. */
+  bool             seen;
+} tDispatchEntry;
+
+/** \brief Worker thread with its queue. The counters that the CAN event thread updates
+ *  and the counter that the worker updates are on separate cache lines.
+ */
+typedef struct
+{
+  /** \brief Queue with the CAN messages for this worker. */
+  tRing queue;
+  /** \brief Number of CAN messages that were queued. Only written by the CAN event
+   *  thread.
+   */
+  alignas(RING_CACHE_LINE_SIZE) atomic_uint_fast64_t dispatched;
+  /** \brief Number of CAN messages that were dropped. Only written by the CAN event
+   *  thread.
+   */
+  atomic_uint_fast64_t dropped;
+  /** \brief Highest queue depth. Only written by the CAN event thread. */
+  atomic_size_t highWater;
+  /** \brief Number of CAN messages that were handled. Only written by the worker. */
+  alignas(RING_CACHE_LINE_SIZE) atomic_uint_fast64_t processed;
+  /** \brief Set while the worker waits for CAN messages. */
+  atomic_bool waiting;
+  /** \brief Mutex and condition variable for waiting on CAN messages. */
+  mtx_t mutex;
+  cnd_t condition;
+  /** \brief Identifier of the worker thread. */
+  thrd_t threadId;
+  /** \brief CPU to pin the worker thread to, or DISPATCH_CPU_ANY. */
+  int cpu;
+} tDispatchWorker;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief The worker threads. */
+static tDispatchWorker dispatchWorkers[DISPATCH_WORKERS_MAX];
+
+/** \brief Number of running worker threads. Zero when dispatching is not enabled. */
+static size_t dispatchWorkerCount;
+
+/** \brief Function pointer for the handler that the worker threads call for each CAN
+ *  message.
+ */
+static tCanReceivedCallback dispatchHandler;
+
+/** \brief Atomic boolean that is used to inform the worker threads to stop running. */
+static atomic_bool dispatchStopWorkers;
+
+/** \brief Handlers for the 11-bit CAN identifiers, followed by those for the 29-bit
+ *  ones.
+ */
+static tDispatchEntry dispatchHandlers[IDTABLE_STD_IDS + DISPATCH_EXT_HANDLERS];
+
+/** \brief Keys of the handler slots for the 29-bit CAN identifiers. */
+static atomic_uint dispatchKeys[DISPATCH_EXT_HANDLERS];
+
+/** \brief Table that assigns the handler slots to the CAN identifiers. */
+static tIdTable dispatchTable;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static int  DispatchWorkerThread(void * param);
+static bool DispatchChanged(tDispatchEntry * entry, tCanMsg const * msg);
+
+
+/************************************************************************************//**
+** \brief     Initializes the dispatcher. Dispatching is not enabled until the worker
+**            threads are started with DispatchStart().
+** \param     handlerFcn Handler that the worker threads call for each CAN message.
+**
+****************************************************************************************/
+void DispatchInit(tCanReceivedCallback handlerFcn)
+{
+  /* Initialize locals. */
+  dispatchWorkerCount = 0;
+  dispatchHandler = handlerFcn;
+  atomic_init(&dispatchStopWorkers, false);
+  memset(dispatchHandlers, 0, sizeof(dispatchHandlers));
+  IdTableInit(&dispatchTable, dispatchKeys, DISPATCH_EXT_HANDLERS);
+} /*** end of DispatchInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the dispatcher.
+**
+****************************************************************************************/
+void DispatchTerminate(void)
+{
+  /* Stop the worker threads, in case they still run. */
+  DispatchStop();
+
+  /* Reset locals. */
+  dispatchHandler = NULL;
+} /*** end of DispatchTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts the worker threads and enables the dispatching of received CAN
+**            messages to them. Call it from OnPreStart, before the first CAN message is
+**            received. Not available in single-threaded mode.
+** \param     workers Number of worker threads. Zero for one per online CPU.
+** \param     cpus Array with the CPU to pin each worker thread to, or NULL to not pin
+**            the worker threads. Use DISPATCH_CPU_ANY for a worker thread that should
+**            not be pinned.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool DispatchStart(size_t workers, int const * cpus)
+{
+  bool result = false;
+  long onlineCpus;
+
+  /* Verify parameter. */
+  assert(workers <= DISPATCH_WORKERS_MAX);
+
+  /* Only continue with valid parameter, when not yet started and when not running in
+   * single-threaded mode. The latter promises that all callbacks run on the main thread.
+   */
+  if ( (workers <= DISPATCH_WORKERS_MAX) && (dispatchWorkerCount == 0) &&
+       (!LoopSingleThreaded()) )
+  {
+    /* Determine the number of workers, if not specified. */
+    if (workers == 0)
+    {
+      onlineCpus = sysconf(_SC_NPROCESSORS_ONLN);
+      workers = (onlineCpus > 0) ? (size_t)onlineCpus : 1U;
+      if (workers > DISPATCH_WORKERS_MAX)
+      {
+        workers = DISPATCH_WORKERS_MAX;
+      }
+    }
+
+    /* Set positive result at this point and negate upon error detected. */
+    result = true;
+    atomic_store(&dispatchStopWorkers, false);
+
+    /* Start the worker threads one-by-one. */
+    for (size_t idx = 0; idx < workers; idx++)
+    {
+      tDispatchWorker * worker = &dispatchWorkers[idx];
+
+      /* Initialize the worker. */
+      atomic_init(&worker->dispatched, 0);
+      atomic_init(&worker->dropped, 0);
+      atomic_init(&worker->highWater, 0);
+      atomic_init(&worker->processed, 0);
+      atomic_init(&worker->waiting, false);
+      worker->cpu = (cpus != NULL) ? cpus[idx] : DISPATCH_CPU_ANY;
+      if (!RingInit(&worker->queue, sizeof(tCanMsg), DISPATCH_QUEUE_SIZE))
+      {
+        result = false;
+        break;
+      }
+      if ( (mtx_init(&worker->mutex, mtx_plain) != thrd_success) ||
+           (cnd_init(&worker->condition) != thrd_success) )
+      {
+        assert(false);
+      }
+      /* Start the worker thread. */
+      if (thrd_create(&worker->threadId, DispatchWorkerThread, worker) != thrd_success)
+      {
+        cnd_destroy(&worker->condition);
+        mtx_destroy(&worker->mutex);
+        RingTerminate(&worker->queue);
+        result = false;
+        break;
+      }
+      dispatchWorkerCount++;
+    }
+
+    /* Stop the workers that did start, in case of an error. */
+    if (!result)
+    {
+      DispatchStop();
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops the worker threads, after they handled all CAN messages that are
+**            still queued. Afterwards, dispatching is disabled.
+**
+****************************************************************************************/
+void DispatchStop(void)
+{
+  /* Request the worker threads to stop. */
+  atomic_store(&dispatchStopWorkers, true);
+  for (size_t idx = 0; idx < dispatchWorkerCount; idx++)
+  {
+    mtx_lock(&dispatchWorkers[idx].mutex);
+    cnd_signal(&dispatchWorkers[idx].condition);
+    mtx_unlock(&dispatchWorkers[idx].mutex);
+  }
+
+  /* Wait until the worker threads terminated and release their resources. */
+  for (size_t idx = 0; idx < dispatchWorkerCount; idx++)
+  {
+    thrd_join(dispatchWorkers[idx].threadId, NULL);
+    cnd_destroy(&dispatchWorkers[idx].condition);
+    mtx_destroy(&dispatchWorkers[idx].mutex);
+    RingTerminate(&dispatchWorkers[idx].queue);
+  }
+
+  /* Reset locals. */
+  dispatchWorkerCount = 0;
+} /*** end of DispatchStop ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a received CAN message for the worker that handles its identifier.
+**            Should only be called from the CAN event thread.
+** \param     msg Pointer to the received CAN message.
+** \return    True if the dispatcher took care of the CAN message, false if dispatching
+**            is not enabled and the caller should handle it directly.
+**
+****************************************************************************************/
+bool DispatchMessage(tCanMsg const * msg)
+{
+  bool result = false;
+  tDispatchWorker * worker;
+  uint32_t key;
+  size_t depth;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when dispatching is enabled. */
+  if ( (msg != NULL) && (dispatchWorkerCount > 0) )
+  {
+    /* Select the worker by hashing the identifier. Standard and extended identifiers
+     * with the same value are different CAN messages.
+     */
+    key = msg->id | (msg->ext ? 0x80000000UL : 0U);
+    key *= 0x9E3779B1UL;
+    key = (uint32_t)(((uint64_t)key * dispatchWorkerCount) >> 32);
+    worker = &dispatchWorkers[key];
+
+    /* Queue the CAN message. */
+    if (RingPush(&worker->queue, msg))
+    {
+      atomic_fetch_add_explicit(&worker->dispatched, 1, memory_order_relaxed);
+      /* Keep track of the highest queue depth. */
+      depth = RingCount(&worker->queue);
+      if (depth > atomic_load_explicit(&worker->highWater, memory_order_relaxed))
+      {
+        atomic_store_explicit(&worker->highWater, depth, memory_order_relaxed);
+      }
+      /* Wake up the worker, if it waits for CAN messages. The fence pairs with the one
+       * in the worker thread, so that either the worker sees the CAN message or this
+       * thread sees that the worker waits.
+       */
+      atomic_thread_fence(memory_order_seq_cst);
+      if (atomic_load_explicit(&worker->waiting, memory_order_relaxed))
+      {
+        mtx_lock(&worker->mutex);
+        cnd_signal(&worker->condition);
+        mtx_unlock(&worker->mutex);
+      }
+    }
+    else
+    {
+      atomic_fetch_add_explicit(&worker->dropped, 1, memory_order_relaxed);
+    }
+    /* Update the result. */
+    result = true;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the number of running worker threads.
+** \return    Number of worker threads. Zero if dispatching is not enabled.
+**
+****************************************************************************************/
+size_t DispatchWorkerCount(void)
+{
+  /* Give the result back to the caller. */
+  return dispatchWorkerCount;
+} /*** end of DispatchWorkerCount ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the queue statistics of a worker. Can be called from any thread.
+** \param     worker Index of the worker.
+** \param     stats Pointer to where the statistics are stored.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool DispatchGetStats(size_t worker, tDispatchStats * stats)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (stats != NULL) && (worker < dispatchWorkerCount) )
+  {
+    stats->dispatched = atomic_load(&dispatchWorkers[worker].dispatched);
+    stats->processed = atomic_load(&dispatchWorkers[worker].processed);
+    stats->dropped = atomic_load(&dispatchWorkers[worker].dropped);
+    stats->depth = RingCount(&dispatchWorkers[worker].queue);
+    stats->highWater = atomic_load(&dispatchWorkers[worker].highWater);
+    result = true;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Registers a handler for the CAN messages with the specified identifier.
+**            It replaces the handler that was registered before, if any. Call it from
+**            OnPreStart, before the first CAN message is received.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     handlerFcn Handler function, or NULL to remove the handler.
+** \param     context Context pointer that is passed to the handler.
+** \return    True if successful, false if the identifier is invalid or if there is no
+**            room for another handler of a 29-bit CAN identifier.
+**
+****************************************************************************************/
+bool DispatchRegister(uint32_t id, bool ext, tDispatchHandler handlerFcn, void * context)
+{
+  bool result = false;
+  tDispatchEntry * entry;
+  size_t idx;
+
+  /* Only continue with a valid identifier. */
+  if ( (ext) ? (id <= 0x1FFFFFFFUL) : (id < IDTABLE_STD_IDS) )
+  {
+    /* Find the slot of the identifier, or take a free one. */
+    idx = IdTableLookup(&dispatchTable, id, ext, true);
+    if (idx != IDTABLE_NONE)
+    {
+      entry = &dispatchHandlers[idx];
+      entry->handlerFcn = handlerFcn;
+      entry->context = context;
+      entry->onChange = false;
+      result = true;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchRegister ***/
+
+
+/************************************************************************************//**
+** \brief     Registers a handler for the CAN messages with the specified identifier,
+**            which only runs when their data changed or when the heartbeat time passed
+**            since it last ran. It always runs for the first CAN message and when the
+**            data length changed. It replaces the handler that was registered before,
+**            if any. Call it from OnPreStart, before the first CAN message is received.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     handlerFcn Handler function, or NULL to remove the handler.
+** \param     context Context pointer that is passed to the handler.
+** \param     mask Array with CAN_DATA_LEN_MAX bytes, whose set bits select the data
+**            bits that are compared, or NULL to compare all data bits.
+** \param     heartbeat Time in milliseconds after which the handler runs, even if the
+**            data did not change, or zero for no heartbeat.
+** \return    True if successful, false if the identifier is invalid or if there is no
+**            room for another handler of a 29-bit CAN identifier.
+**
+****************************************************************************************/
+bool DispatchRegisterOnChange(uint32_t id, bool ext, tDispatchHandler handlerFcn,
+                              void * context, uint8_t const * mask, uint32_t heartbeat)
+{
+  bool result = false;
+  tDispatchEntry * entry;
+  size_t idx;
+  uint64_t word = UINT64_MAX;
+
+  /* Only continue with a valid identifier. */
+  if ( (ext) ? (id <= 0x1FFFFFFFUL) : (id < IDTABLE_STD_IDS) )
+  {
+    /* Find the slot of the identifier, or take a free one. */
+    idx = IdTableLookup(&dispatchTable, id, ext, true);
+    if (idx != IDTABLE_NONE)
+    {
+      entry = &dispatchHandlers[idx];
+      if (mask != NULL)
+      {
+        memcpy(&word, mask, sizeof(word));
+      }
+      entry->handlerFcn = handlerFcn;
+      entry->context = context;
+      entry->mask = le64toh(word);
+      entry->heartbeat = (uint64_t)heartbeat * 1000U;
+      entry->seen = false;
+      entry->onChange = true;
+      result = true;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchRegisterOnChange ***/
+
+
+/************************************************************************************//**
+** \brief     Handles a CAN message on the calling thread. Calls the handler that is
+**            registered for its identifier, if any, followed by the general handler.
+**            The worker threads call it for each CAN message. Without dispatching, the
+**            CAN event thread calls it directly.
+** \param     msg Pointer to the CAN message.
+**
+****************************************************************************************/
+void DispatchHandle(tCanMsg const * msg)
+{
+  tDispatchEntry * entry = NULL;
+  size_t idx;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter. */
+  if (msg != NULL)
+  {
+    /* Call the handler of the identifier, if one is registered. */
+    idx = IdTableLookup(&dispatchTable, msg->id, msg->ext, false);
+    if (idx != IDTABLE_NONE)
+    {
+      entry = &dispatchHandlers[idx];
+    }
+    if ( (entry != NULL) && (entry->handlerFcn != NULL) )
+    {
+      /* A handler for changes only runs if the CAN message changed. */
+      if ( (!entry->onChange) || (DispatchChanged(entry, msg)) )
+      {
+        entry->handlerFcn(msg, entry->context);
+      }
+    }
+    /* Call the general handler. */
+    if (dispatchHandler != NULL)
+    {
+      dispatchHandler(msg);
+    }
+  }
+} /*** end of DispatchHandle ***/
+
+
+/************************************************************************************//**
+** \brief     Worker thread that handles the CAN messages from its queue.
+** \param     param Pointer to the worker.
+** \return    Thread return value.
+**
+****************************************************************************************/
+static int DispatchWorkerThread(void * param)
+{
+  tDispatchWorker * worker = param;
+  cpu_set_t cpuSet;
+  tCanMsg msg;
+
+  /* Pin the thread to its CPU, if configured. */
+  if (worker->cpu != DISPATCH_CPU_ANY)
+  {
+    CPU_ZERO(&cpuSet);
+    CPU_SET(worker->cpu, &cpuSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+  }
+
+  /* Enter the thread's loop and run it, until a stop is requested and the queue is
+   * empty.
+   */
+  while (true)
+  {
+    /* Handle the next CAN message, if one is queued. */
+    if (RingPop(&worker->queue, &msg))
+    {
+      DispatchHandle(&msg);
+      atomic_fetch_add_explicit(&worker->processed, 1, memory_order_relaxed);
+      continue;
+    }
+    /* Queue is empty. Done if a stop is requested. */
+    if (atomic_load(&dispatchStopWorkers))
+    {
+      break;
+    }
+    /* Wait for the next CAN message. Announce the wait before checking the queue once
+     * more, so a CAN message that is queued in the meantime is not missed.
+     */
+    atomic_store_explicit(&worker->waiting, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    mtx_lock(&worker->mutex);
+    while ( (RingCount(&worker->queue) == 0) && (!atomic_load(&dispatchStopWorkers)) )
+    {
+      cnd_wait(&worker->condition, &worker->mutex);
+    }
+    mtx_unlock(&worker->mutex);
+    atomic_store_explicit(&worker->waiting, false, memory_order_relaxed);
+  }
+
+  /* Shut down the thread. */
+  thrd_exit(EXIT_SUCCESS);
+} /*** end of DispatchWorkerThread ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if the handler of a CAN identifier for changes should run for a
+**            CAN message. If so, it remembers the CAN message as the one that the
+**            handler saw last. All CAN messages of one identifier are handled by the
+**            same thread, so the slot needs no protection.
+** \param     entry Pointer to the handler slot.
+** \param     msg Pointer to the CAN message.
+** \return    True if the handler should run, false otherwise.
+**
+****************************************************************************************/
+static bool DispatchChanged(tDispatchEntry * entry, tCanMsg const * msg)
+{
+  bool result;
+  uint64_t data;
+
+  /* Obtain the data bytes as one value, without the bytes beyond the data length. */
+  memcpy(&data, msg->data, sizeof(data));
+  data = le64toh(data);
+  if (msg->len < CAN_DATA_LEN_MAX)
+  {
+    data &= (1ULL << (msg->len * 8U)) - 1U;
+  }
+
+  /* Run the handler for the first CAN message, a change of the data length, a change
+   * of the compared data bits or when the heartbeat time passed.
+   */
+  result = (!entry->seen) || (msg->len != entry->len) ||
+           (((data ^ entry->data) & entry->mask) != 0) ||
+           ( (entry->heartbeat > 0) &&
+             ((msg->timestamp - entry->timestamp) >= entry->heartbeat) );
+
+  /* Remember the CAN message that the handler sees. */
+  if (result)
+  {
+    entry->seen = true;
+    entry->data = data;
+    entry->len = msg->len;
+    entry->timestamp = msg->timestamp;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DispatchChanged ***/
+
+
+/*********************************** end of dispatch.c *********************************/
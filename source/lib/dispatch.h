@@ -0,0 +1,86 @@
+/************************************************************************************//**
+* \file         dispatch.h
+* \brief        Sharded message dispatcher header file.
+*
+****************************************************************************************/
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of worker threads. */
+#ifndef DISPATCH_WORKERS_MAX
+#define DISPATCH_WORKERS_MAX           (64U)
+#endif
+
+/** \brief Number of CAN messages that each worker queue can hold. Messages that do not
+ *  fit anymore are dropped and counted.
+ */
+#ifndef DISPATCH_QUEUE_SIZE
+#define DISPATCH_QUEUE_SIZE            (4096U)
+#endif
+
+/** \brief Value to specify in the CPU list, for a worker thread that should not be
+ *  pinned to a specific CPU.
+ */
+#define DISPATCH_CPU_ANY               (-1)
+
+/** \brief Number of handlers that can be registered for 29-bit CAN identifiers. Each
+ *  11-bit CAN identifier has its own handler slot.
+ */
+#ifndef DISPATCH_EXT_HANDLERS
+#define DISPATCH_EXT_HANDLERS          (512U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of a handler for the CAN messages with one identifier. */
+typedef void (* tDispatchHandler)(tCanMsg const * msg, void * context);
+
+/** \brief Queue statistics of one worker. */
+typedef struct
+{
+  /** \brief Number of CAN messages that were queued for the worker. */
+  uint64_t dispatched;
+  /** \brief Number of CAN messages that the worker handled. */
+  uint64_t processed;
+  /** \brief Number of CAN messages that were dropped, because the queue was full. */
+  uint64_t dropped;
+  /** \brief Number of CAN messages that are currently queued. */
+  size_t depth;
+  /** \brief Highest number of CAN messages that were queued at the same time. */
+  size_t highWater;
+} tDispatchStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void   DispatchInit(tCanReceivedCallback handlerFcn);
+void   DispatchTerminate(void);
+bool   DispatchStart(size_t workers, int const * cpus);
+void   DispatchStop(void);
+bool   DispatchMessage(tCanMsg const * msg);
+size_t DispatchWorkerCount(void);
+bool   DispatchGetStats(size_t worker, tDispatchStats * stats);
+bool   DispatchRegister(uint32_t id, bool ext, tDispatchHandler handlerFcn,
+                        void * context);
+bool   DispatchRegisterOnChange(uint32_t id, bool ext, tDispatchHandler handlerFcn,
+                                void * context, uint8_t const * mask,
+                                uint32_t heartbeat);
+void   DispatchHandle(tCanMsg const * msg);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISPATCH_H */
+/*********************************** end of dispatch.h *********************************/
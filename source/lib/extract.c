@@ -0,0 +1,449 @@
+/************************************************************************************//**
+* \file         extract.c
+* \brief        Batch signal extraction source file.
+* \details      Extracts signals from large arrays of CAN messages with the same
+*               identifier, for example from a log file, into one array of physical
+*               values per signal. The data bytes of a block of CAN messages are first
+*               collected as 64-bit values, once in little endian and once in big endian
+*               byte order. Each signal is then a constant shift and mask of one of
+*               these, followed by the sign extension and the scaling, which run on
+*               multiple CAN messages at once with SIMD instructions.
+*
+*               On x86-64, the kernel uses AVX2 when the CPU supports it and SSE2
+*               otherwise. Other architectures use a scalar kernel. The SIMD kernels
+*               convert the raw value to a double with the exponent bias trick, which
+*               is exact for signals of up to 52 bits. Larger signals use the scalar
+*               kernel. All kernels give the exact same results.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <endian.h>                         /* Byte order conversions                  */
+#if defined(__x86_64__)
+#include <immintrin.h>                      /* SSE2 and AVX2 intrinsics                */
+#endif
+#include "can.h"                            /* CAN driver                              */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "extract.h"                        /* Batch signal extraction                 */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Largest signal size in bits that the SIMD kernels convert exactly. */
+#define EXTRACT_SIMD_BITS_MAX          (52U)
+
+/** \brief 2^52 as a double. Its bit pattern with a raw value of up to 52 bits in the
+ *  mantissa is the double 2^52 plus that raw value.
+ */
+#define EXTRACT_MAGIC                  (4503599627370496.0)
+
+/** \brief Bit pattern of EXTRACT_MAGIC. */
+#define EXTRACT_MAGIC_BITS             (0x4330000000000000ULL)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Signal layout, converted to the operations of the kernels. */
+typedef struct
+{
+  /** \brief Number of bits to shift the 64-bit value to the right. */
+  uint32_t shift;
+  /** \brief Mask of the raw value after the shift. */
+  uint64_t mask;
+  /** \brief Sign bit of the raw value, or zero for an unsigned signal. */
+  uint64_t sign;
+  /** \brief Scaling of the raw value to the physical value. */
+  double   factor;
+  double   offset;
+} tExtractLayout;
+
+/** \brief Function type of a kernel that extracts a signal from the collected 64-bit
+ *  values.
+ */
+typedef void (* tExtractKernel)(uint64_t const * words, size_t count,
+                                tExtractLayout const * layout, double * values);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static bool ExtractBatch(uint8_t const * base, size_t stride, size_t dataOffset,
+                         size_t lenOffset, size_t count, tExtractSignal const * signals,
+                         size_t signalCount, double * const * columns);
+static bool ExtractPrepare(tExtractSignal const * signal, tExtractLayout * layout);
+static tExtractKernel ExtractSelectKernel(void);
+static void ExtractKernelScalar(uint64_t const * words, size_t count,
+                                tExtractLayout const * layout, double * values);
+#if defined(__x86_64__)
+static void ExtractKernelSse2(uint64_t const * words, size_t count,
+                              tExtractLayout const * layout, double * values);
+static void ExtractKernelAvx2(uint64_t const * words, size_t count,
+                              tExtractLayout const * layout, double * values);
+#endif
+
+
+/************************************************************************************//**
+** \brief     Extracts signals from an array of CAN messages with the same identifier.
+**            Data bytes beyond the data length of a CAN message count as zero.
+** \param     msgs Array with the CAN messages.
+** \param     count Number of CAN messages.
+** \param     signals Array with the layouts of the signals.
+** \param     signalCount Number of signals.
+** \param     columns Array with one array of count physical values per signal.
+** \return    True if successful, false if a signal does not fit in the data bytes.
+**
+****************************************************************************************/
+bool ExtractMessages(tCanMsg const * msgs, size_t count,
+                     tExtractSignal const * signals, size_t signalCount,
+                     double * const * columns)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert( (msgs != NULL) || (count == 0) );
+  assert(signals != NULL);
+  assert(columns != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( ( (msgs != NULL) || (count == 0) ) && (signals != NULL) && (columns != NULL) )
+  {
+    result = ExtractBatch((uint8_t const *)msgs, sizeof(tCanMsg),
+                          offsetof(tCanMsg, data), offsetof(tCanMsg, len), count,
+                          signals, signalCount, columns);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractMessages ***/
+
+
+/************************************************************************************//**
+** \brief     Extracts signals from an array of log file records with the same
+**            identifier. Data bytes beyond the data length of a record count as zero.
+** \param     records Array with the records.
+** \param     count Number of records.
+** \param     signals Array with the layouts of the signals.
+** \param     signalCount Number of signals.
+** \param     columns Array with one array of count physical values per signal.
+** \return    True if successful, false if a signal does not fit in the data bytes.
+**
+****************************************************************************************/
+bool ExtractRecords(tLoggerRecord const * records, size_t count,
+                    tExtractSignal const * signals, size_t signalCount,
+                    double * const * columns)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert( (records != NULL) || (count == 0) );
+  assert(signals != NULL);
+  assert(columns != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( ( (records != NULL) || (count == 0) ) && (signals != NULL) && (columns != NULL) )
+  {
+    result = ExtractBatch((uint8_t const *)records, sizeof(tLoggerRecord),
+                          offsetof(tLoggerRecord, data), offsetof(tLoggerRecord, len),
+                          count, signals, signalCount, columns);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractRecords ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the name of the SIMD kernel that the CPU supports.
+** \return    "avx2", "sse2" or "scalar".
+**
+****************************************************************************************/
+char const * ExtractKernelName(void)
+{
+  char const * result = "scalar";
+
+#if defined(__x86_64__)
+  result = (ExtractSelectKernel() == ExtractKernelAvx2) ? "avx2" : "sse2";
+#endif
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractKernelName ***/
+
+
+/************************************************************************************//**
+** \brief     Extracts signals from an array of structures with the data bytes and the
+**            data length at fixed offsets.
+** \param     base Pointer to the first structure.
+** \param     stride Size of a structure.
+** \param     dataOffset Offset of the data bytes in a structure.
+** \param     lenOffset Offset of the data length in a structure.
+** \param     count Number of structures.
+** \param     signals Array with the layouts of the signals.
+** \param     signalCount Number of signals.
+** \param     columns Array with one array of count physical values per signal.
+** \return    True if successful, false if a signal does not fit in the data bytes.
+**
+****************************************************************************************/
+static bool ExtractBatch(uint8_t const * base, size_t stride, size_t dataOffset,
+                         size_t lenOffset, size_t count, tExtractSignal const * signals,
+                         size_t signalCount, double * const * columns)
+{
+  bool result = true;
+  uint64_t little[EXTRACT_BLOCK_MESSAGES];
+  uint64_t big[EXTRACT_BLOCK_MESSAGES];
+  tExtractKernel kernel = ExtractSelectKernel();
+  tExtractLayout layout;
+  bool needLittle = false;
+  bool needBig = false;
+  uint8_t const * entry;
+  uint64_t word;
+  uint8_t len;
+  size_t blockCount;
+
+  /* Check the layouts and determine which byte orders are needed. */
+  for (size_t sig = 0; (sig < signalCount) && (result); sig++)
+  {
+    result = ExtractPrepare(&signals[sig], &layout);
+    needLittle = needLittle || (!signals[sig].motorola);
+    needBig = needBig || (signals[sig].motorola);
+  }
+
+  /* Handle the CAN messages block by block. */
+  for (size_t first = 0; (first < count) && (result); first += blockCount)
+  {
+    blockCount = count - first;
+    if (blockCount > EXTRACT_BLOCK_MESSAGES)
+    {
+      blockCount = EXTRACT_BLOCK_MESSAGES;
+    }
+    /* Collect the data bytes as 64-bit values. Clear the bytes beyond the data
+     * length.
+     */
+    for (size_t idx = 0; idx < blockCount; idx++)
+    {
+      entry = base + ((first + idx) * stride);
+      memcpy(&word, entry + dataOffset, sizeof(word));
+      len = entry[lenOffset];
+      if (len < CAN_DATA_LEN_MAX)
+      {
+        memset((uint8_t *)&word + len, 0, sizeof(word) - len);
+      }
+      if (needLittle)
+      {
+        little[idx] = le64toh(word);
+      }
+      if (needBig)
+      {
+        big[idx] = be64toh(word);
+      }
+    }
+    /* Extract each signal from the collected values. */
+    for (size_t sig = 0; sig < signalCount; sig++)
+    {
+      (void)ExtractPrepare(&signals[sig], &layout);
+      if (signals[sig].size > EXTRACT_SIMD_BITS_MAX)
+      {
+        ExtractKernelScalar(signals[sig].motorola ? big : little, blockCount, &layout,
+                            &columns[sig][first]);
+      }
+      else
+      {
+        kernel(signals[sig].motorola ? big : little, blockCount, &layout,
+               &columns[sig][first]);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractBatch ***/
+
+
+/************************************************************************************//**
+** \brief     Converts the layout of a signal to the operations of the kernels.
+** \param     signal Pointer to the layout of the signal.
+** \param     layout Pointer to where the operations are stored.
+** \return    True if successful, false if the signal does not fit in the data bytes.
+**
+****************************************************************************************/
+static bool ExtractPrepare(tExtractSignal const * signal, tExtractLayout * layout)
+{
+  bool result = false;
+  uint32_t position;
+
+  /* Only continue with a valid size. */
+  if ( (signal->size >= 1U) && (signal->size <= 64U) )
+  {
+    /* A little endian signal starts at its least significant bit. */
+    if (!signal->motorola)
+    {
+      if ((signal->start + signal->size) <= 64U)
+      {
+        layout->shift = signal->start;
+        result = true;
+      }
+    }
+    /* A big endian signal starts at its most significant bit, numbered within its
+     * byte. Count it from the most significant bit of the big endian value instead.
+     */
+    else
+    {
+      position = ((signal->start / 8U) * 8U) + (7U - (signal->start % 8U));
+      if ((position + signal->size) <= 64U)
+      {
+        layout->shift = 64U - position - signal->size;
+        result = true;
+      }
+    }
+    layout->mask = (signal->size == 64U) ? UINT64_MAX : ((1ULL << signal->size) - 1U);
+    layout->sign = (signal->sign) ? (1ULL << (signal->size - 1U)) : 0U;
+    layout->factor = signal->factor;
+    layout->offset = signal->offset;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractPrepare ***/
+
+
+/************************************************************************************//**
+** \brief     Selects the fastest kernel that the CPU supports.
+** \return    The kernel.
+**
+****************************************************************************************/
+static tExtractKernel ExtractSelectKernel(void)
+{
+  tExtractKernel result = ExtractKernelScalar;
+
+#if defined(__x86_64__)
+  result = (__builtin_cpu_supports("avx2")) ? ExtractKernelAvx2 : ExtractKernelSse2;
+#endif
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractSelectKernel ***/
+
+
+/************************************************************************************//**
+** \brief     Scalar kernel that extracts a signal from the collected 64-bit values.
+** \param     words Array with the 64-bit values.
+** \param     count Number of values.
+** \param     layout Pointer to the operations of the signal.
+** \param     values Array where the physical values are stored.
+**
+****************************************************************************************/
+static void ExtractKernelScalar(uint64_t const * words, size_t count,
+                                tExtractLayout const * layout, double * values)
+{
+  uint64_t raw;
+
+  for (size_t idx = 0; idx < count; idx++)
+  {
+    /* Shift, mask and sign extend the raw value, then scale it. */
+    raw = (words[idx] >> layout->shift) & layout->mask;
+    if (layout->sign != 0)
+    {
+      values[idx] = ((double)(int64_t)((raw ^ layout->sign) - layout->sign) *
+                     layout->factor) + layout->offset;
+    }
+    else
+    {
+      values[idx] = ((double)raw * layout->factor) + layout->offset;
+    }
+  }
+} /*** end of ExtractKernelScalar ***/
+
+
+#if defined(__x86_64__)
+/************************************************************************************//**
+** \brief     SSE2 kernel that extracts a signal from the collected 64-bit values, two
+**            at a time. The signal must not be larger than EXTRACT_SIMD_BITS_MAX bits.
+** \param     words Array with the 64-bit values.
+** \param     count Number of values.
+** \param     layout Pointer to the operations of the signal.
+** \param     values Array where the physical values are stored.
+**
+****************************************************************************************/
+static void ExtractKernelSse2(uint64_t const * words, size_t count,
+                              tExtractLayout const * layout, double * values)
+{
+  __m128i shift = _mm_cvtsi32_si128((int)layout->shift);
+  __m128i mask = _mm_set1_epi64x((long long)layout->mask);
+  __m128i sign = _mm_set1_epi64x((long long)layout->sign);
+  __m128i magic = _mm_set1_epi64x((long long)EXTRACT_MAGIC_BITS);
+  __m128d bias = _mm_set1_pd(EXTRACT_MAGIC + (double)layout->sign);
+  __m128d factor = _mm_set1_pd(layout->factor);
+  __m128d offset = _mm_set1_pd(layout->offset);
+  __m128i raw;
+  __m128d value;
+  size_t idx = 0;
+
+  for (; (idx + 2U) <= count; idx += 2U)
+  {
+    /* Shift and mask the raw values. Flipping the sign bit makes them unsigned. */
+    raw = _mm_loadu_si128((__m128i const *)&words[idx]);
+    raw = _mm_and_si128(_mm_srl_epi64(raw, shift), mask);
+    raw = _mm_xor_si128(raw, sign);
+    /* Convert them to doubles, undo the sign bit flip and scale them. */
+    value = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(raw, magic)), bias);
+    value = _mm_add_pd(_mm_mul_pd(value, factor), offset);
+    _mm_storeu_pd(&values[idx], value);
+  }
+
+  /* Handle the remaining value. */
+  ExtractKernelScalar(&words[idx], count - idx, layout, &values[idx]);
+} /*** end of ExtractKernelSse2 ***/
+
+
+/************************************************************************************//**
+** \brief     AVX2 kernel that extracts a signal from the collected 64-bit values, four
+**            at a time. The signal must not be larger than EXTRACT_SIMD_BITS_MAX bits.
+** \param     words Array with the 64-bit values.
+** \param     count Number of values.
+** \param     layout Pointer to the operations of the signal.
+** \param     values Array where the physical values are stored.
+**
+****************************************************************************************/
+__attribute__((target("avx2")))
+static void ExtractKernelAvx2(uint64_t const * words, size_t count,
+                              tExtractLayout const * layout, double * values)
+{
+  __m128i shift = _mm_cvtsi32_si128((int)layout->shift);
+  __m256i mask = _mm256_set1_epi64x((long long)layout->mask);
+  __m256i sign = _mm256_set1_epi64x((long long)layout->sign);
+  __m256i magic = _mm256_set1_epi64x((long long)EXTRACT_MAGIC_BITS);
+  __m256d bias = _mm256_set1_pd(EXTRACT_MAGIC + (double)layout->sign);
+  __m256d factor = _mm256_set1_pd(layout->factor);
+  __m256d offset = _mm256_set1_pd(layout->offset);
+  __m256i raw;
+  __m256d value;
+  size_t idx = 0;
+
+  for (; (idx + 4U) <= count; idx += 4U)
+  {
+    /* Shift and mask the raw values. Flipping the sign bit makes them unsigned. */
+    raw = _mm256_loadu_si256((__m256i const *)&words[idx]);
+    raw = _mm256_and_si256(_mm256_srl_epi64(raw, shift), mask);
+    raw = _mm256_xor_si256(raw, sign);
+    /* Convert them to doubles, undo the sign bit flip and scale them. */
+    value = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(raw, magic)), bias);
+    value = _mm256_add_pd(_mm256_mul_pd(value, factor), offset);
+    _mm256_storeu_pd(&values[idx], value);
+  }
+
+  /* Handle the remaining values. */
+  ExtractKernelScalar(&words[idx], count - idx, layout, &values[idx]);
+} /*** end of ExtractKernelAvx2 ***/
+#endif
+
+
+/*********************************** end of extract.c **********************************/
@@ -0,0 +1,66 @@
+/************************************************************************************//**
+* \file         extract.h
+* \brief        Batch signal extraction header file.
+*
+****************************************************************************************/
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of CAN messages whose data bytes are collected, before the signals are
+ *  extracted from them. The collected data bytes stay in the first level cache.
+ */
+#ifndef EXTRACT_BLOCK_MESSAGES
+#define EXTRACT_BLOCK_MESSAGES         (256U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Layout of a signal in the data bytes of a CAN message, as specified in a DBC
+ *  file. The physical value is the raw value times the factor plus the offset.
+ */
+typedef struct
+{
+  /** \brief Start bit. The least significant bit for little endian signals and the
+   *  most significant bit for big endian signals, numbered like in a DBC file.
+   */
+  uint8_t start;
+  /** \brief Size in bits [1..64]. */
+  uint8_t size;
+  /** \brief True for big endian (Motorola) byte order, false for little endian. */
+  bool    motorola;
+  /** \brief True for a signed raw value. */
+  bool    sign;
+  /** \brief Factor of the physical value. */
+  double  factor;
+  /** \brief Offset of the physical value. */
+  double  offset;
+} tExtractSignal;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+bool         ExtractMessages(tCanMsg const * msgs, size_t count,
+                             tExtractSignal const * signals, size_t signalCount,
+                             double * const * columns);
+bool         ExtractRecords(tLoggerRecord const * records, size_t count,
+                            tExtractSignal const * signals, size_t signalCount,
+                            double * const * columns);
+char const * ExtractKernelName(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXTRACT_H */
+/*********************************** end of extract.h **********************************/
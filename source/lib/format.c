@@ -0,0 +1,571 @@
+/************************************************************************************//**
+* \file         format.c
+* \brief        CAN message text formatter source file.
+* \details      Renders CAN messages as text lines, without the overhead of printf. The
+*               hexadecimal digits come from lookup tables and the timestamps are
+*               converted with integer arithmetic, so they keep their microsecond
+*               resolution regardless of their magnitude. A tFormatBuffer collects the
+*               lines and writes many of them with one system call. Lines in any of the
+*               styles can also be parsed back into CAN messages.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+#include "can.h"                            /* CAN driver                              */
+#include "util.h"                           /* Utility functions                       */
+#include "format.h"                         /* CAN message text formatter              */
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Lookup table with the lower case hexadecimal digits. */
+static const char formatHexLower[16] = "0123456789abcdef";
+
+/** \brief Lookup table with the upper case hexadecimal digits. */
+static const char formatHexUpper[16] = "0123456789ABCDEF";
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static char * FormatTimestamp(char * out, uint64_t timestamp);
+static char * FormatHex(char * out, uint32_t value, uint8_t digits, char const * table);
+static char * FormatData(char * out, tCanMsg const * msg, bool spaced,
+                         char const * table);
+static char const * FormatParseTimestamp(char const * in, uint64_t * timestamp);
+static char const * FormatParseHex(char const * in, uint32_t * value, size_t * digits);
+static char const * FormatParseData(char const * in, tCanMsg * msg, bool spaced);
+
+
+/************************************************************************************//**
+** \brief     Renders a CAN message as a text line, including the line ending. The line
+**            is not terminated with a null character.
+** \param     config Pointer to the formatter configuration.
+** \param     msg Pointer to the CAN message.
+** \param     buffer Buffer to render the line into.
+** \param     size Size of the buffer. Must be at least FORMAT_LINE_MAX.
+** \return    Number of characters in the line, or 0 in case of an error.
+**
+****************************************************************************************/
+size_t FormatMessage(tFormatConfig const * config, tCanMsg const * msg, char * buffer,
+                     size_t size)
+{
+  size_t result = 0;
+  char * out = buffer;
+  char const * interface;
+  uint8_t digits;
+
+  /* Verify parameters. */
+  assert(config != NULL);
+  assert(msg != NULL);
+  assert(buffer != NULL);
+  assert(size >= FORMAT_LINE_MAX);
+
+  /* Only continue with valid parameters. */
+  if ( (config != NULL) && (msg != NULL) && (buffer != NULL) &&
+       (size >= FORMAT_LINE_MAX) )
+  {
+    switch (config->style)
+    {
+      /* "(12.345678) 123  [2] de ad" */
+      case FORMAT_CAPLIN:
+        *out++ = '(';
+        out = FormatTimestamp(out, config->startTime + msg->timestamp);
+        *out++ = ')';
+        *out++ = ' ';
+        /* Identifier without leading zeros. */
+        digits = 1;
+        while ( (digits < 8) && ((msg->id >> (4U * digits)) != 0) )
+        {
+          digits++;
+        }
+        out = FormatHex(out, msg->id, digits, formatHexLower);
+        *out++ = msg->ext ? 'x' : ' ';
+        *out++ = ' ';
+        *out++ = '[';
+        *out++ = (char)('0' + ((msg->len <= 9) ? msg->len : 9));
+        *out++ = ']';
+        out = FormatData(out, msg, true, formatHexLower);
+        break;
+
+      /* "(12.345678) can0 123#DEAD" */
+      case FORMAT_CANDUMP:
+        *out++ = '(';
+        out = FormatTimestamp(out, config->startTime + msg->timestamp);
+        *out++ = ')';
+        *out++ = ' ';
+        interface = (config->interface != NULL) ? config->interface : "can0";
+        for (size_t idx = 0; (idx < FORMAT_INTERFACE_MAX) && (interface[idx] != '\0');
+             idx++)
+        {
+          *out++ = interface[idx];
+        }
+        *out++ = ' ';
+        out = FormatHex(out, msg->id, msg->ext ? 8 : 3, formatHexUpper);
+        *out++ = '#';
+        out = FormatData(out, msg, false, formatHexUpper);
+        break;
+
+      /* "12.345678,123,0,2,DEAD" */
+      case FORMAT_CSV:
+        out = FormatTimestamp(out, config->startTime + msg->timestamp);
+        *out++ = ',';
+        out = FormatHex(out, msg->id, msg->ext ? 8 : 3, formatHexUpper);
+        *out++ = ',';
+        *out++ = msg->ext ? '1' : '0';
+        *out++ = ',';
+        *out++ = (char)('0' + ((msg->len <= 9) ? msg->len : 9));
+        *out++ = ',';
+        out = FormatData(out, msg, false, formatHexUpper);
+        break;
+
+      default:
+        break;
+    }
+    /* Add the line ending, unless the style was unknown. */
+    if (out != buffer)
+    {
+      *out++ = '\n';
+      result = (size_t)(out - buffer);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Initializes an output buffer.
+** \param     buffer Pointer to the output buffer.
+** \param     fd File descriptor to write to, for example STDOUT_FILENO.
+** \param     config Pointer to the formatter configuration.
+**
+****************************************************************************************/
+void FormatBufferInit(tFormatBuffer * buffer, int fd, tFormatConfig const * config)
+{
+  /* Verify parameters. */
+  assert(buffer != NULL);
+  assert(config != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (buffer != NULL) && (config != NULL) )
+  {
+    buffer->config = *config;
+    buffer->fd = fd;
+    buffer->len = 0;
+  }
+} /*** end of FormatBufferInit ***/
+
+
+/************************************************************************************//**
+** \brief     Renders a CAN message into the output buffer. Writes the buffer first, if
+**            the line might not fit anymore.
+** \param     buffer Pointer to the output buffer.
+** \param     msg Pointer to the CAN message.
+** \return    True if successful, false if writing the buffer failed.
+**
+****************************************************************************************/
+bool FormatBufferAppend(tFormatBuffer * buffer, tCanMsg const * msg)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert(buffer != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (buffer != NULL) && (msg != NULL) )
+  {
+    /* Make room for the line. */
+    result = true;
+    if ((FORMAT_BUFFER_SIZE - buffer->len) < FORMAT_LINE_MAX)
+    {
+      result = FormatBufferFlush(buffer);
+    }
+    /* Render the line into the buffer. */
+    buffer->len += FormatMessage(&buffer->config, msg, &buffer->data[buffer->len],
+                                 FORMAT_BUFFER_SIZE - buffer->len);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatBufferAppend ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the contents of the output buffer to its file descriptor. The
+**            buffer is empty afterwards, also when writing failed.
+** \param     buffer Pointer to the output buffer.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool FormatBufferFlush(tFormatBuffer * buffer)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(buffer != NULL);
+
+  /* Only continue with valid parameter. */
+  if (buffer != NULL)
+  {
+    /* Write all data and empty the buffer. */
+    result = UtilWriteAll(buffer->fd, buffer->data, buffer->len);
+    buffer->len = 0;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatBufferFlush ***/
+
+
+/************************************************************************************//**
+** \brief     Parses a text line in any of the styles back into a CAN message. The style
+**            is detected from the line itself. The timestamp is taken over as it is in
+**            the line, so it is absolute for a candump log.
+** \param     line The text line. A line ending is allowed.
+** \param     msg Pointer to where the CAN message is stored.
+** \return    True if successful, false if the line does not hold a CAN message. This is
+**            also the case for remote frames and CAN FD frames in a candump log.
+**
+****************************************************************************************/
+bool FormatParseMessage(char const * line, tCanMsg * msg)
+{
+  bool result = false;
+  char const * in = line;
+  char const * next;
+  uint32_t value;
+  size_t digits;
+
+  /* Verify parameters. */
+  assert(line != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (line != NULL) && (msg != NULL) )
+  {
+    memset(msg, 0, sizeof(tCanMsg));
+    /* CAPLin or candump style, which both start with the timestamp in parentheses. */
+    if (*in == '(')
+    {
+      in = FormatParseTimestamp(in + 1, &msg->timestamp);
+      if ( (in != NULL) && (*in == ')') && (in[1] == ' ') )
+      {
+        in += 2;
+        /* The CAPLin style continues with the identifier and "[len]", while the
+         * candump style continues with the interface name and "id#data".
+         */
+        next = in;
+        while ( (*next != ' ') && (*next != '\0') )
+        {
+          next++;
+        }
+        while (*next == ' ')
+        {
+          next++;
+        }
+        if (*next == '[')
+        {
+          /* "123  [2] de ad" or "1abcdef0x [8] ...". */
+          in = FormatParseHex(in, &value, &digits);
+          if (in != NULL)
+          {
+            msg->id = value;
+            msg->ext = (*in == 'x');
+            if ( (next[1] >= '0') && (next[1] <= '8') && (next[2] == ']') )
+            {
+              msg->len = (uint8_t)(next[1] - '0');
+              in = FormatParseData(&next[3], msg, true);
+              result = (in != NULL);
+            }
+          }
+        }
+        else
+        {
+          /* "123#DEAD" or "1ABCDEF0#DEAD". More than three digits for 29-bit. */
+          in = FormatParseHex(next, &value, &digits);
+          if ( (in != NULL) && (*in == '#') && (in[1] != '#') && (in[1] != 'R') )
+          {
+            msg->id = value;
+            msg->ext = (digits > 3);
+            in = FormatParseData(in + 1, msg, false);
+            result = (in != NULL);
+          }
+        }
+      }
+    }
+    /* CSV style, "12.345678,123,0,2,DEAD". */
+    else
+    {
+      in = FormatParseTimestamp(in, &msg->timestamp);
+      if ( (in != NULL) && (*in == ',') )
+      {
+        in = FormatParseHex(in + 1, &value, &digits);
+        if ( (in != NULL) && (in[0] == ',') && ((in[1] == '0') || (in[1] == '1')) &&
+             (in[2] == ',') && (in[3] >= '0') && (in[3] <= '8') && (in[4] == ',') )
+        {
+          msg->id = value;
+          msg->ext = (in[1] == '1');
+          msg->len = (uint8_t)(in[3] - '0');
+          in = FormatParseData(&in[5], msg, false);
+          result = (in != NULL);
+        }
+      }
+    }
+    /* Make sure the identifier fits. */
+    if ( (result) && (msg->id > (msg->ext ? CAN_EFF_MASK : CAN_SFF_MASK)) )
+    {
+      result = false;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatParseMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Renders a timestamp in microseconds as seconds with six decimals.
+** \param     out Where to render the text.
+** \param     timestamp Timestamp in microseconds.
+** \return    Position right after the rendered text.
+**
+****************************************************************************************/
+static char * FormatTimestamp(char * out, uint64_t timestamp)
+{
+  char digits[20];
+  size_t count = 0;
+  uint64_t seconds = timestamp / 1000000U;
+  uint32_t micros = (uint32_t)(timestamp % 1000000U);
+
+  /* Render the seconds, starting with the least significant digit. */
+  do
+  {
+    digits[count++] = (char)('0' + (seconds % 10U));
+    seconds /= 10U;
+  }
+  while (seconds != 0);
+  while (count > 0)
+  {
+    *out++ = digits[--count];
+  }
+  /* Render the six decimals. */
+  *out++ = '.';
+  for (int idx = 5; idx >= 0; idx--)
+  {
+    out[idx] = (char)('0' + (micros % 10U));
+    micros /= 10U;
+  }
+
+  /* Give the result back to the caller. */
+  return out + 6;
+} /*** end of FormatTimestamp ***/
+
+
+/************************************************************************************//**
+** \brief     Renders a value as a fixed number of hexadecimal digits.
+** \param     out Where to render the text.
+** \param     value The value.
+** \param     digits Number of digits.
+** \param     table Lookup table with the hexadecimal digits.
+** \return    Position right after the rendered text.
+**
+****************************************************************************************/
+static char * FormatHex(char * out, uint32_t value, uint8_t digits, char const * table)
+{
+  /* Render the digits, starting with the least significant one. */
+  for (int idx = (int)digits - 1; idx >= 0; idx--)
+  {
+    out[idx] = table[value & 0x0FU];
+    value >>= 4;
+  }
+
+  /* Give the result back to the caller. */
+  return out + digits;
+} /*** end of FormatHex ***/
+
+
+/************************************************************************************//**
+** \brief     Renders the data bytes of a CAN message in hexadecimal.
+** \param     out Where to render the text.
+** \param     msg Pointer to the CAN message.
+** \param     spaced True to precede each byte with a space.
+** \param     table Lookup table with the hexadecimal digits.
+** \return    Position right after the rendered text.
+**
+****************************************************************************************/
+static char * FormatData(char * out, tCanMsg const * msg, bool spaced,
+                         char const * table)
+{
+  uint8_t len = (msg->len <= CAN_DATA_LEN_MAX) ? msg->len : CAN_DATA_LEN_MAX;
+
+  /* Render the bytes one-by-one. */
+  for (uint8_t idx = 0; idx < len; idx++)
+  {
+    if (spaced)
+    {
+      *out++ = ' ';
+    }
+    *out++ = table[msg->data[idx] >> 4];
+    *out++ = table[msg->data[idx] & 0x0FU];
+  }
+
+  /* Give the result back to the caller. */
+  return out;
+} /*** end of FormatData ***/
+
+
+/************************************************************************************//**
+** \brief     Parses a timestamp in seconds with up to six decimals.
+** \param     in Text to parse.
+** \param     timestamp Pointer to where the timestamp in microseconds is stored.
+** \return    Position right after the parsed text, or NULL if it is not a timestamp.
+**
+****************************************************************************************/
+static char const * FormatParseTimestamp(char const * in, uint64_t * timestamp)
+{
+  char const * result = NULL;
+  uint64_t seconds = 0;
+  uint32_t micros = 0;
+  uint32_t scale = 100000U;
+
+  /* Parse the seconds. */
+  if ( (*in >= '0') && (*in <= '9') )
+  {
+    while ( (*in >= '0') && (*in <= '9') )
+    {
+      seconds = (seconds * 10U) + (uint64_t)(*in++ - '0');
+    }
+    /* Parse the decimals. Those beyond the sixth one are ignored. */
+    if (*in == '.')
+    {
+      in++;
+      while ( (*in >= '0') && (*in <= '9') )
+      {
+        micros += (uint32_t)(*in++ - '0') * scale;
+        scale /= 10U;
+      }
+    }
+    *timestamp = (seconds * 1000000U) + micros;
+    result = in;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatParseTimestamp ***/
+
+
+/************************************************************************************//**
+** \brief     Parses a hexadecimal value of up to eight digits.
+** \param     in Text to parse.
+** \param     value Pointer to where the value is stored.
+** \param     digits Pointer to where the number of digits is stored.
+** \return    Position right after the parsed text, or NULL if it is not a value.
+**
+****************************************************************************************/
+static char const * FormatParseHex(char const * in, uint32_t * value, size_t * digits)
+{
+  char const * result = NULL;
+  uint32_t nibble;
+
+  /* Parse the digits one-by-one. */
+  *value = 0;
+  *digits = 0;
+  while (*digits <= 8)
+  {
+    if ( (*in >= '0') && (*in <= '9') )
+    {
+      nibble = (uint32_t)(*in - '0');
+    }
+    else if ( (*in >= 'a') && (*in <= 'f') )
+    {
+      nibble = (uint32_t)(*in - 'a') + 10U;
+    }
+    else if ( (*in >= 'A') && (*in <= 'F') )
+    {
+      nibble = (uint32_t)(*in - 'A') + 10U;
+    }
+    else
+    {
+      break;
+    }
+    *value = (*value << 4) | nibble;
+    (*digits)++;
+    in++;
+  }
+  if ( (*digits > 0) && (*digits <= 8) )
+  {
+    result = in;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatParseHex ***/
+
+
+/************************************************************************************//**
+** \brief     Parses the data bytes of a CAN message. Whitespace or the end of the text
+**            must follow them.
+** \param     in Text to parse.
+** \param     msg Pointer to the CAN message. If spaced, its length must already be set.
+**            Otherwise the length follows from the number of bytes, if not yet set.
+** \param     spaced True if each byte is preceded by a space.
+** \return    Position right after the parsed text, or NULL if the data is invalid.
+**
+****************************************************************************************/
+static char const * FormatParseData(char const * in, tCanMsg * msg, bool spaced)
+{
+  char const * result = NULL;
+  uint8_t count = 0;
+  uint32_t value;
+  size_t digits;
+  char pair[3] = { 0 };
+
+  /* Parse the bytes one-by-one. */
+  while (count < CAN_DATA_LEN_MAX)
+  {
+    if (spaced)
+    {
+      if ( (count == msg->len) || (*in != ' ') )
+      {
+        break;
+      }
+      in++;
+    }
+    pair[0] = in[0];
+    pair[1] = (in[0] != '\0') ? in[1] : '\0';
+    if ( (FormatParseHex(pair, &value, &digits) == NULL) || (digits != 2) )
+    {
+      break;
+    }
+    msg->data[count++] = (uint8_t)value;
+    in += 2;
+  }
+  /* Check the number of bytes and what follows them. */
+  if ( (!spaced) && (msg->len == 0) )
+  {
+    msg->len = count;
+  }
+  if ( (count == msg->len) &&
+       ( (*in == '\0') || (*in == ' ') || (*in == '\t') || (*in == '\r') ||
+         (*in == '\n') ) )
+  {
+    result = in;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of FormatParseData ***/
+
+
+/*********************************** end of format.c ***********************************/
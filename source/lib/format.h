@@ -0,0 +1,100 @@
+/************************************************************************************//**
+* \file         format.h
+* \brief        CAN message text formatter header file.
+*
+****************************************************************************************/
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Minimum size of the buffer that FormatMessage() renders a CAN message into.
+ *  Large enough for the longest line of each style, including the line ending.
+ */
+#define FORMAT_LINE_MAX                (128U)
+
+/** \brief Maximum number of characters of the interface name that is shown in the
+ *  candump style. Longer names are truncated.
+ */
+#define FORMAT_INTERFACE_MAX           (16U)
+
+/** \brief Size of the buffer in a tFormatBuffer. */
+#ifndef FORMAT_BUFFER_SIZE
+#define FORMAT_BUFFER_SIZE             (64U * 1024U)
+#endif
+
+/** \brief Header line with the column names of the CSV style. */
+#define FORMAT_CSV_HEADER              "timestamp,id,ext,len,data\n"
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Text styles in which a CAN message can be rendered. */
+typedef enum
+{
+  /** \brief CAPLin style, as printed by CanPrintMessage, for example
+   *  "(12.345678) 123  [2] de ad".
+   */
+  FORMAT_CAPLIN = 0,
+  /** \brief Log file style of candump -L, which canplayer and log2asc read, for example
+   *  "(12.345678) can0 123#DEAD".
+   */
+  FORMAT_CANDUMP,
+  /** \brief Comma separated values with the columns of FORMAT_CSV_HEADER, for example
+   *  "12.345678,123,0,2,DEAD".
+   */
+  FORMAT_CSV
+} tFormatStyle;
+
+/** \brief Configuration of the formatter. */
+typedef struct
+{
+  /** \brief Text style. */
+  tFormatStyle style;
+  /** \brief Interface name that is shown in the candump style, or NULL for "can0". */
+  char const * interface;
+  /** \brief System time in microseconds that is added to the timestamps, for example
+   *  CanStartTime() for absolute timestamps. Zero to show them as they are.
+   */
+  uint64_t     startTime;
+} tFormatConfig;
+
+/** \brief Output buffer that collects formatted CAN messages and writes them to a file
+ *  descriptor with one system call, once the buffer is full or flushed.
+ */
+typedef struct
+{
+  /** \brief Configuration of the formatter. */
+  tFormatConfig config;
+  /** \brief File descriptor to write to. */
+  int           fd;
+  /** \brief Number of characters in the buffer. */
+  size_t        len;
+  /** \brief The buffer. */
+  char          data[FORMAT_BUFFER_SIZE];
+} tFormatBuffer;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+size_t FormatMessage(tFormatConfig const * config, tCanMsg const * msg, char * buffer,
+                     size_t size);
+void   FormatBufferInit(tFormatBuffer * buffer, int fd, tFormatConfig const * config);
+bool   FormatBufferAppend(tFormatBuffer * buffer, tCanMsg const * msg);
+bool   FormatBufferFlush(tFormatBuffer * buffer);
+bool   FormatParseMessage(char const * line, tCanMsg * msg);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORMAT_H */
+/*********************************** end of format.h ***********************************/
@@ -0,0 +1,254 @@
+/************************************************************************************//**
+* \file         idtable.c
+* \brief        CAN identifier table source file.
+* \details      Assigns a slot to each CAN identifier, for the modules that keep data per
+*               CAN identifier. The 11-bit CAN identifiers index the slots directly. The
+*               29-bit CAN identifiers get a slot in a hash table when they are first
+*               inserted. It is a Fibonacci hash, whose collisions are resolved by linear
+*               probing. Once it is full, further 29-bit CAN identifiers get no slot.
+*
+*               Only one thread inserts CAN identifiers, but any thread can look them up
+*               without locks. Slots are never freed, so a lookup that reaches a free
+*               slot knows that the CAN identifier is not in the table.
+*
+*               The table also offers a sequence counter, with which the inserting thread
+*               publishes the updates of a slot. It makes the counter odd before it
+*               updates the slot and even again afterwards. A reader copies the slot and
+*               retries if the counter was odd or changed in the meantime, so it always
+*               obtains a consistent copy.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "idtable.h"                        /* CAN identifier table                    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Bit that marks the key of a used slot, so that the 29-bit CAN identifier zero
+ *  also has a non-zero key.
+ */
+#define IDTABLE_KEY_USED               (0x80000000UL)
+
+
+/************************************************************************************//**
+** \brief     Initializes a table. All slots for the 29-bit CAN identifiers are freed.
+** \param     table Pointer to the table.
+** \param     keys Array with the keys of the slots for the 29-bit CAN identifiers.
+** \param     extSlots Number of slots for the 29-bit CAN identifiers.
+**
+****************************************************************************************/
+void IdTableInit(tIdTable * table, atomic_uint * keys, size_t extSlots)
+{
+  /* Verify parameters. */
+  assert(table != NULL);
+  assert( (keys != NULL) || (extSlots == 0) );
+
+  /* Only continue with valid parameters. */
+  if ( (table != NULL) && ((keys != NULL) || (extSlots == 0)) )
+  {
+    table->keys = keys;
+    table->extSlots = extSlots;
+    for (size_t idx = 0; idx < extSlots; idx++)
+    {
+      atomic_init(&keys[idx], 0U);
+    }
+  }
+} /*** end of IdTableInit ***/
+
+
+/************************************************************************************//**
+** \brief     Finds the slot of a CAN identifier.
+** \param     table Pointer to the table.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     insert True to take a free slot for a 29-bit CAN identifier that does not
+**            have one yet. Only one thread should do this.
+** \return    Index of the slot, or IDTABLE_NONE if not found.
+**
+****************************************************************************************/
+size_t IdTableLookup(tIdTable * table, uint32_t id, bool ext, bool insert)
+{
+  size_t result = IDTABLE_NONE;
+  uint32_t key;
+  uint32_t hash;
+  uint32_t slotKey;
+  size_t idx;
+
+  /* Verify parameter. */
+  assert(table != NULL);
+
+  /* Only continue with valid parameter. */
+  if (table != NULL)
+  {
+    /* An 11-bit identifier indexes the slots directly. */
+    if (!ext)
+    {
+      if (id < IDTABLE_STD_IDS)
+      {
+        result = id;
+      }
+    }
+    /* A 29-bit identifier is hashed. Probe until the identifier or a free slot is
+     * found, or all slots were visited.
+     */
+    else if ( (id <= 0x1FFFFFFFUL) && (table->extSlots > 0) )
+    {
+      key = id | IDTABLE_KEY_USED;
+      hash = id * 0x9E3779B1UL;
+      idx = (size_t)(((uint64_t)hash * table->extSlots) >> 32);
+      for (size_t probe = 0; probe < table->extSlots; probe++)
+      {
+        slotKey = atomic_load_explicit(&table->keys[idx], memory_order_acquire);
+        if (slotKey == 0)
+        {
+          if (insert)
+          {
+            atomic_store_explicit(&table->keys[idx], key, memory_order_release);
+            result = IDTABLE_STD_IDS + idx;
+          }
+          break;
+        }
+        if (slotKey == key)
+        {
+          result = IDTABLE_STD_IDS + idx;
+          break;
+        }
+        if (++idx == table->extSlots)
+        {
+          idx = 0;
+        }
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of IdTableLookup ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the CAN identifier that a slot belongs to.
+** \param     table Pointer to the table.
+** \param     idx Index of the slot.
+** \param     id Pointer to where the CAN identifier is stored.
+** \param     ext Pointer to where the type of CAN identifier is stored. True for a
+**            29-bit CAN identifier, false for 11-bit.
+** \return    True if successful, false if the slot is free or the index is invalid.
+**
+****************************************************************************************/
+bool IdTableGetId(tIdTable * table, size_t idx, uint32_t * id, bool * ext)
+{
+  bool result = false;
+  uint32_t slotKey;
+
+  /* Verify parameters. */
+  assert(table != NULL);
+  assert(id != NULL);
+  assert(ext != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (table != NULL) && (id != NULL) && (ext != NULL) )
+  {
+    /* The slots of the 11-bit identifiers are always taken. */
+    if (idx < IDTABLE_STD_IDS)
+    {
+      *id = (uint32_t)idx;
+      *ext = false;
+      result = true;
+    }
+    else if (idx < (IDTABLE_STD_IDS + table->extSlots))
+    {
+      slotKey = atomic_load_explicit(&table->keys[idx - IDTABLE_STD_IDS],
+                                     memory_order_acquire);
+      if (slotKey != 0)
+      {
+        *id = slotKey & ~IDTABLE_KEY_USED;
+        *ext = true;
+        result = true;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of IdTableGetId ***/
+
+
+/************************************************************************************//**
+** \brief     Marks the start of an update of a slot, by making its sequence counter
+**            odd. Should only be called from the thread that inserts CAN identifiers.
+** \param     sequence Pointer to the sequence counter of the slot.
+** \return    Value of the sequence counter before the update, for IdTableWriteEnd().
+**
+****************************************************************************************/
+unsigned int IdTableWriteBegin(atomic_uint * sequence)
+{
+  unsigned int result;
+
+  /* Make the sequence counter odd. The fence keeps the updates of the slot behind it. */
+  result = atomic_load_explicit(sequence, memory_order_relaxed);
+  atomic_store_explicit(sequence, result + 1U, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of IdTableWriteBegin ***/
+
+
+/************************************************************************************//**
+** \brief     Marks the end of an update of a slot and publishes it, by making its
+**            sequence counter even again.
+** \param     sequence Pointer to the sequence counter of the slot.
+** \param     begin Value that IdTableWriteBegin() returned.
+**
+****************************************************************************************/
+void IdTableWriteEnd(atomic_uint * sequence, unsigned int begin)
+{
+  atomic_store_explicit(sequence, begin + 2U, memory_order_release);
+} /*** end of IdTableWriteEnd ***/
+
+
+/************************************************************************************//**
+** \brief     Marks the start of copying a slot. Can be called from any thread.
+** \param     sequence Pointer to the sequence counter of the slot.
+** \return    Value of the sequence counter, for IdTableReadEnd().
+**
+****************************************************************************************/
+unsigned int IdTableReadBegin(atomic_uint * sequence)
+{
+  /* Give the result back to the caller. */
+  return atomic_load_explicit(sequence, memory_order_acquire);
+} /*** end of IdTableReadBegin ***/
+
+
+/************************************************************************************//**
+** \brief     Marks the end of copying a slot and determines if the copy is consistent.
+** \param     sequence Pointer to the sequence counter of the slot.
+** \param     begin Value that IdTableReadBegin() returned.
+** \return    True if the copy is consistent, false if the slot was updated in the
+**            meantime and the caller should copy it again.
+**
+****************************************************************************************/
+bool IdTableReadEnd(atomic_uint * sequence, unsigned int begin)
+{
+  unsigned int end;
+
+  /* The fence keeps the copying of the slot ahead of the second look at the counter. */
+  atomic_thread_fence(memory_order_acquire);
+  end = atomic_load_explicit(sequence, memory_order_relaxed);
+
+  /* Give the result back to the caller. */
+  return (begin == end) && ((begin & 1U) == 0);
+} /*** end of IdTableReadEnd ***/
+
+
+/*********************************** end of idtable.c **********************************/
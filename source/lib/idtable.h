@@ -0,0 +1,64 @@
+/************************************************************************************//**
+* \file         idtable.h
+* \brief        CAN identifier table header file.
+*
+****************************************************************************************/
+#ifndef IDTABLE_H
+#define IDTABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <stdatomic.h>                      /* Atomic operations                       */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of 11-bit CAN identifiers. Each one has its own slot, at the index
+ *  that equals the identifier.
+ */
+#define IDTABLE_STD_IDS                (2048U)
+
+/** \brief Index that IdTableLookup() returns when the CAN identifier has no slot. */
+#define IDTABLE_NONE                   (SIZE_MAX)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Assigns slot indices to CAN identifiers. The slots themselves are an array of
+ *  the user of the table, with IDTABLE_STD_IDS slots for the 11-bit CAN identifiers,
+ *  followed by extSlots slots for the 29-bit ones.
+ */
+typedef struct
+{
+  /** \brief Keys of the slots for the 29-bit CAN identifiers. */
+  atomic_uint * keys;
+  /** \brief Number of slots for the 29-bit CAN identifiers. */
+  size_t        extSlots;
+} tIdTable;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void         IdTableInit(tIdTable * table, atomic_uint * keys, size_t extSlots);
+size_t       IdTableLookup(tIdTable * table, uint32_t id, bool ext, bool insert);
+bool         IdTableGetId(tIdTable * table, size_t idx, uint32_t * id, bool * ext);
+unsigned int IdTableWriteBegin(atomic_uint * sequence);
+void         IdTableWriteEnd(atomic_uint * sequence, unsigned int begin);
+unsigned int IdTableReadBegin(atomic_uint * sequence);
+bool         IdTableReadEnd(atomic_uint * sequence, unsigned int begin);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IDTABLE_H */
+/*********************************** end of idtable.h **********************************/
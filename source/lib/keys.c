@@ -17,10 +17,21 @@
 #include <unistd.h>                         /* UNIX standard functions                 */
 #include <threads.h>                        /* Multithreading                          */
 #include <stdatomic.h>                      /* Atomic operations                       */
+#include <poll.h>                           /* Waiting for file descriptor events      */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/eventfd.h>                    /* Event notification file descriptor      */
 #include "util.h"                           /* Utility functions                       */
+#include "loop.h"                           /* Event loop driver                       */
 #include "keys.h"                           /* Input key detection driver              */
 
 
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define KEYS_INVALID_FD                (-1)
+
+
 /****************************************************************************************
 * Local data declarations
 ****************************************************************************************/
@@ -40,11 +51,28 @@ static bool keysEventThreadRunning;
 /** \brief Atomic boolean that is used to inform the event thread to stop running. */
 static atomic_bool keysStopEventThread;
 
+/** \brief Event file descriptor that KeysTerminate signals, to wake up the event thread
+ *  that blocks while waiting for a key.
+ */
+static int keysWakeupFd = KEYS_INVALID_FD;
+
+/** \brief Boolean flag that indicates if the standard input is serviced by the event
+ *  loop.
+ */
+static bool keysLoopRegistered;
+
+/** \brief Original standard input parameters, restored when the event loop no longer
+ *  services the standard input.
+ */
+static struct termios keysTermiosDefault;
+
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
 static int KeysEventThread(void * param);
+static void KeysLoopEvent(int fd, uint32_t events, void * context);
+static void KeysEnterRawMode(struct termios const * termiosDefault);
 
 
 /************************************************************************************//**
@@ -60,6 +88,7 @@ void KeysInit(tKeysEventCallback callbackFcn)
   keysEventThreadId = 0;
   keysEventThreadRunning = false;
   atomic_init(&keysStopEventThread, false);
+  keysLoopRegistered = false;
 
   /* Verify parameter. */
   assert(callbackFcn != NULL);
@@ -71,12 +100,41 @@ void KeysInit(tKeysEventCallback callbackFcn)
     keysEventCallback = callbackFcn;
   }
 
-  /* Start the key pressed detection thread. */
-  if (thrd_create(&keysEventThreadId, (thrd_start_t)KeysEventThread, NULL) 
-      == thrd_success)
+  /* Only a terminal produces key events. When the standard input is redirected or
+   * closed, for example when running as a service, there is nothing to monitor.
+   */
+  if (!isatty(STDIN_FILENO))
+  {
+    /* Nothing to do. */
+  }
+  /* Is the standard input serviced by the event loop? */
+  else if (LoopSingleThreaded())
   {
-    /* Set flag. */
-    keysEventThreadRunning = true;
+    /* Obtain current default standard input parameters. */
+    tcgetattr(STDIN_FILENO, &keysTermiosDefault);
+    /* Register the standard input with the event loop. */
+    if (LoopAdd(STDIN_FILENO, EPOLLIN, KeysLoopEvent, NULL))
+    {
+      /* Set flag. */
+      keysLoopRegistered = true;
+      /* Configure standard input for raw mode. */
+      KeysEnterRawMode(&keysTermiosDefault);
+    }
+  }
+  else
+  {
+    /* Create the event file descriptor for waking up the event thread. */
+    keysWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (keysWakeupFd != KEYS_INVALID_FD)
+    {
+      /* Start the key pressed detection thread. */
+      if (thrd_create(&keysEventThreadId, (thrd_start_t)KeysEventThread, NULL) 
+          == thrd_success)
+      {
+        /* Set flag. */
+        keysEventThreadRunning = true;
+      }
+    }
   }
 } /*** end of KeysInit ***/
 
@@ -88,15 +146,35 @@ void KeysInit(tKeysEventCallback callbackFcn)
 ****************************************************************************************/
 void KeysTerminate(void)
 {
+  uint64_t increment = 1;
+
   /* Stop the key pressed detection thread. */
   if (keysEventThreadRunning)
   {
     /* Set atomic boolean flag to request the thread to stop. */
     atomic_store(&keysStopEventThread, true);
+    /* Wake up the thread, which blocks while waiting for a key. */
+    (void)write(keysWakeupFd, &increment, sizeof(increment));
     /* Wait until the thread terminated. */
     thrd_join(keysEventThreadId, NULL);
   }
 
+  /* Close the event file descriptor. */
+  if (keysWakeupFd != KEYS_INVALID_FD)
+  {
+    close(keysWakeupFd);
+    keysWakeupFd = KEYS_INVALID_FD;
+  }
+
+  /* Unregister the standard input from the event loop. */
+  if (keysLoopRegistered)
+  {
+    LoopRemove(STDIN_FILENO);
+    /* Restore the original standard input parameters. */
+    tcsetattr(STDIN_FILENO, TCSANOW, &keysTermiosDefault);
+    keysLoopRegistered = false;
+  }
+
   /* Reset locals. */
   atomic_init(&keysStopEventThread, false);
   keysEventThreadRunning = false;
@@ -106,56 +184,69 @@ void KeysTerminate(void)
 
 
 /************************************************************************************//**
-** \brief     Event thread that handles the asynchronous reception of data from the CAN
-**            interface.
+** \brief     Event thread that handles the key presses on the standard input. It blocks
+**            until a key is pressed or until KeysTerminate wakes it up. It also stops
+**            when the standard input is closed.
 ** \param     arg Pointer to thread parameters.
 ** \return    Thread return value.
 **
 ****************************************************************************************/
 static int KeysEventThread(void * param)
 {
-  struct termios termiosDefault, termiosRaw;
-  struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
-  fd_set fs;
+  struct termios termiosDefault;
+  struct pollfd fds[2];
+  char keys[32];
+  ssize_t count;
+  bool inputClosed = false;
 
   /* Obtain current default standard input parameters. */
   tcgetattr(STDIN_FILENO, &termiosDefault);
 
-  /* Initialize standard input parameters for raw (non-canonical) mode and disabled 
-   * echo.
-   */
-  termiosRaw = termiosDefault;
-  termiosRaw.c_lflag &= ~(ICANON | ECHO | ECHOE | ECHOK | ECHONL | ECHOPRT | ECHOKE);
-
   /* Configure standard input for raw mode. */
-  tcsetattr(STDIN_FILENO, TCSANOW, &termiosRaw);
+  KeysEnterRawMode(&termiosDefault);
 
-  /* Enter the thread's loop and run it, until a stop is requested. */
-  while (!atomic_load(&keysStopEventThread))
+  /* Monitor the standard input and the event file descriptor. */
+  fds[0].fd = STDIN_FILENO;
+  fds[0].events = POLLIN;
+  fds[1].fd = keysWakeupFd;
+  fds[1].events = POLLIN;
+
+  /* Enter the thread's loop and run it, until a stop is requested or until the standard
+   * input is closed.
+   */
+  while ( (!atomic_load(&keysStopEventThread)) && (!inputClosed) )
   {
-    /* Initialize the standard input file descriptor set. */
-    FD_ZERO(&fs);
-    FD_SET(STDIN_FILENO, &fs);
-    /* Check for activity on the standard input without timeout, so non-blocking. */
-    select(STDIN_FILENO + 1, &fs, 0, 0, &tv);
-    /* Was activity detected? */
-    if (FD_ISSET(STDIN_FILENO, &fs))
+    /* Block until a key is pressed or until a wakeup is signalled. */
+    if (poll(fds, 2, -1) <= 0)
+    {
+      continue;
+    }
+    /* Key pressed? */
+    if (fds[0].revents & POLLIN)
     {
-      /* Read the input character from the standard input. */
-      int c = getchar();
-      /* Was it a valid character? */
-      if (c != EOF)
+      /* Read all input characters that are currently available. Bypass the stdio
+       * buffer, because poll does not know about characters that are buffered there.
+       */
+      count = read(STDIN_FILENO, keys, sizeof(keys));
+      /* Call the key pressed callback for each character. */
+      for (ssize_t idx = 0; idx < count; idx++)
       {
-        /* Call the key pressed callback. */
         if (keysEventCallback != NULL)
         {
-          keysEventCallback((char)c);
+          keysEventCallback(keys[idx]);
         }
       }
+      /* Standard input closed? */
+      if (count == 0)
+      {
+        inputClosed = true;
+      }
+    }
+    /* Standard input hung up or in error? */
+    else if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL))
+    {
+      inputClosed = true;
     }
-
-    /* Wait a little to not starve the CPU. */
-    UtilSleep(5 * 1000);
   }
 
   /* Restore the original standard input parameters. */
@@ -166,4 +257,64 @@ static int KeysEventThread(void * param)
 } /*** end of KeysEventThread ***/
 
 
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when the standard input has data.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void KeysLoopEvent(int fd, uint32_t events, void * context)
+{
+  char keys[32];
+  ssize_t count;
+
+  /* Read all input characters that are currently available. Bypass the stdio buffer,
+   * because epoll does not know about characters that are buffered there.
+   */
+  count = read(fd, keys, sizeof(keys));
+  /* Standard input closed or in error? */
+  if (count <= 0)
+  {
+    /* Stop monitoring it. Otherwise the event loop would keep reporting it. */
+    if ( (count == 0) || (events & (EPOLLHUP | EPOLLERR)) )
+    {
+      LoopRemove(fd);
+    }
+  }
+  else
+  {
+    /* Call the key pressed callback for each character. */
+    for (ssize_t idx = 0; idx < count; idx++)
+    {
+      if (keysEventCallback != NULL)
+      {
+        keysEventCallback(keys[idx]);
+      }
+    }
+  }
+} /*** end of KeysLoopEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Configures the standard input for raw (non-canonical) mode with disabled
+**            echo.
+** \param     termiosDefault Pointer to the current default standard input parameters.
+**
+****************************************************************************************/
+static void KeysEnterRawMode(struct termios const * termiosDefault)
+{
+  struct termios termiosRaw;
+
+  /* Initialize standard input parameters for raw (non-canonical) mode and disabled 
+   * echo.
+   */
+  termiosRaw = *termiosDefault;
+  termiosRaw.c_lflag &= ~(ICANON | ECHO | ECHOE | ECHOK | ECHONL | ECHOPRT | ECHOKE);
+
+  /* Configure standard input for raw mode. */
+  tcsetattr(STDIN_FILENO, TCSANOW, &termiosRaw);
+} /*** end of KeysEnterRawMode ***/
+
+
 /*********************************** end of keys.c *************************************/
@@ -0,0 +1,159 @@
+/************************************************************************************//**
+* \file         latest.c
+* \brief        Latest value table source file.
+* \details      Keeps the CAN message that was received last for each CAN identifier,
+*               together with the number of times it was received. The CAN event thread
+*               updates the table right before the CAN message is handled. Any thread,
+*               for example a timer callback, can read the latest value of a CAN
+*               identifier without locks.
+*
+*               The slots are assigned by a CAN identifier table, whose sequence counter
+*               protects each slot, so a reader always obtains a consistent CAN message.
+*               Once the table is full, further 29-bit CAN identifiers are not stored.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "can.h"                            /* CAN driver                              */
+#include "idtable.h"                        /* CAN identifier table                    */
+#include "latest.h"                         /* Latest value table                      */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Slot with the latest value of one CAN identifier. */
+typedef struct
+{
+  /** \brief Sequence counter. Odd while the CAN event thread updates the slot. */
+  atomic_uint   sequence;
+  /** \brief Number of received CAN messages. Zero if none was received yet. */
+  uint64_t      count;
+  /** \brief Timestamp of the latest CAN message. */
+  uint64_t      timestamp;
+  /** \brief Data length of the latest CAN message. */
+  uint8_t       len;
+  /** \brief Data bytes of the latest CAN message. */
+  uint8_t       data[CAN_DATA_LEN_MAX];
+} tLatestSlot;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Slots for the 11-bit CAN identifiers, followed by those for the 29-bit ones. */
+static tLatestSlot latestSlots[IDTABLE_STD_IDS + LATEST_EXT_SLOTS];
+
+/** \brief Keys of the slots for the 29-bit CAN identifiers. */
+static atomic_uint latestKeys[LATEST_EXT_SLOTS];
+
+/** \brief Table that assigns the slots to the CAN identifiers. */
+static tIdTable latestTable;
+
+
+/************************************************************************************//**
+** \brief     Initializes the latest value table. All slots are emptied.
+**
+****************************************************************************************/
+void LatestInit(void)
+{
+  /* Initialize locals. */
+  memset(latestSlots, 0, sizeof(latestSlots));
+  IdTableInit(&latestTable, latestKeys, LATEST_EXT_SLOTS);
+} /*** end of LatestInit ***/
+
+
+/************************************************************************************//**
+** \brief     Stores a received CAN message as the latest value of its identifier.
+**            Should only be called from the CAN event thread.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+void LatestMessage(tCanMsg const * msg)
+{
+  tLatestSlot * slot;
+  size_t idx;
+  unsigned int sequence;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter. */
+  if (msg != NULL)
+  {
+    /* Find the slot of the identifier, or take a free one. */
+    idx = IdTableLookup(&latestTable, msg->id, msg->ext, true);
+    if (idx != IDTABLE_NONE)
+    {
+      /* Update the slot. */
+      slot = &latestSlots[idx];
+      sequence = IdTableWriteBegin(&slot->sequence);
+      slot->count++;
+      slot->timestamp = msg->timestamp;
+      slot->len = msg->len;
+      memcpy(slot->data, msg->data, CAN_DATA_LEN_MAX);
+      IdTableWriteEnd(&slot->sequence, sequence);
+    }
+  }
+} /*** end of LatestMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the CAN message that was received last with the specified
+**            identifier. Can be called from any thread.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     value Pointer to where the latest value is stored.
+** \return    True if successful, false if no CAN message with this identifier was
+**            received yet.
+**
+****************************************************************************************/
+bool LatestGet(uint32_t id, bool ext, tLatestValue * value)
+{
+  bool result = false;
+  tLatestSlot * slot;
+  size_t idx;
+  unsigned int sequence;
+
+  /* Verify parameter. */
+  assert(value != NULL);
+
+  /* Only continue with valid parameter. */
+  if (value != NULL)
+  {
+    /* Find the slot of the identifier. */
+    idx = IdTableLookup(&latestTable, id, ext, false);
+    if (idx != IDTABLE_NONE)
+    {
+      /* Copy the slot until the copy is consistent. */
+      slot = &latestSlots[idx];
+      do
+      {
+        sequence = IdTableReadBegin(&slot->sequence);
+        value->count = slot->count;
+        value->msg.timestamp = slot->timestamp;
+        value->msg.len = slot->len;
+        memcpy(value->msg.data, slot->data, CAN_DATA_LEN_MAX);
+      }
+      while (!IdTableReadEnd(&slot->sequence, sequence));
+      value->msg.id = id;
+      value->msg.ext = ext;
+      /* Update the result. */
+      result = (value->count > 0);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LatestGet ***/
+
+
+/*********************************** end of latest.c ***********************************/
@@ -0,0 +1,50 @@
+/************************************************************************************//**
+* \file         latest.h
+* \brief        Latest value table header file.
+*
+****************************************************************************************/
+#ifndef LATEST_H
+#define LATEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of 29-bit CAN identifiers whose latest value can be stored. Each 11-bit
+ *  CAN identifier has its own slot.
+ */
+#ifndef LATEST_EXT_SLOTS
+#define LATEST_EXT_SLOTS               (512U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Latest value of one CAN identifier. */
+typedef struct
+{
+  /** \brief The CAN message that was received last, with its timestamp. */
+  tCanMsg  msg;
+  /** \brief Number of CAN messages with this identifier that were received. */
+  uint64_t count;
+} tLatestValue;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void LatestInit(void);
+void LatestMessage(tCanMsg const * msg);
+bool LatestGet(uint32_t id, bool ext, tLatestValue * value);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATEST_H */
+/*********************************** end of latest.h ***********************************/
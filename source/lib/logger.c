@@ -0,0 +1,413 @@
+/************************************************************************************//**
+* \file         logger.c
+* \brief        Asynchronous binary CAN message logger source file.
+* \details      Logs CAN messages to binary log files, without ever blocking the thread
+*               that reports them. It builds on the asynchronous record writer, which
+*               queues the records for a writer thread. That thread collects the records
+*               into large blocks and writes each block to the log file with one system
+*               call. Disk space is preallocated ahead of the writes and log files are
+*               rotated by size and/or time.
+*
+*               A log file starts with a tLoggerFileHeader, followed by tLoggerRecord
+*               records. Both are in the byte order of the host.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#define _GNU_SOURCE                         /* for fallocate()                         */
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <limits.h>                         /* for PATH_MAX                            */
+#include <errno.h>                          /* Error numbers                           */
+#include <time.h>                           /* Date and time utilities                 */
+#include <fcntl.h>                          /* File control options                    */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define LOGGER_INVALID_FD              (-1)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void LoggerCollect(tLoggerRecord const * record);
+static void LoggerWriteBlock(void);
+static bool LoggerOpenFile(uint64_t now);
+static void LoggerCloseFile(void);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Configuration of the asynchronous record writer. */
+static tWriterConfig const loggerWriterConfig =
+{
+  .queueSize = LOGGER_QUEUE_SIZE,
+  .wakeCount = LOGGER_BLOCK_RECORDS,
+  .flushInterval = LOGGER_FLUSH_INTERVAL,
+  .recordFcn = LoggerCollect,
+  .flushFcn = LoggerWriteBlock,
+  .closeFcn = LoggerCloseFile
+};
+
+/** \brief Asynchronous record writer with the queue and the writer thread. */
+static tWriter loggerWriter;
+
+/** \brief Configuration of the logger. The prefix points to loggerPrefix. */
+static tLoggerConfig loggerConfig;
+
+/** \brief Copy of the path and file name prefix of the log files. */
+static char loggerPrefix[PATH_MAX];
+
+/** \brief Block with the records that the writer thread collected. */
+static tLoggerRecord loggerBlock[LOGGER_BLOCK_RECORDS];
+
+/** \brief Number of records in the block. */
+static size_t loggerBlockCount;
+
+/** \brief File descriptor of the current log file. Only used by the writer thread. */
+static int loggerFd;
+
+/** \brief Size in bytes of the current log file. */
+static uint64_t loggerFileSize;
+
+/** \brief Disk space in bytes that was preallocated for the current log file. */
+static uint64_t loggerFileAllocated;
+
+/** \brief System time in microseconds at which the current log file was created. */
+static uint64_t loggerFileCreated;
+
+/** \brief Sequence number of the next log file. */
+static uint32_t loggerFileIndex;
+
+/** \brief Counters that the writer thread updates. */
+static atomic_uint_fast64_t loggerWritten;
+static atomic_uint_fast64_t loggerWriteErrors;
+static atomic_uint_fast64_t loggerFiles;
+
+
+/************************************************************************************//**
+** \brief     Initializes the logger. Logging does not start until LoggerStart() is
+**            called.
+**
+****************************************************************************************/
+void LoggerInit(void)
+{
+  /* Initialize locals. */
+  atomic_init(&loggerWritten, 0);
+  atomic_init(&loggerWriteErrors, 0);
+  atomic_init(&loggerFiles, 0);
+  loggerBlockCount = 0;
+  loggerFd = LOGGER_INVALID_FD;
+  loggerFileIndex = 0;
+  WriterInit(&loggerWriter, &loggerWriterConfig);
+} /*** end of LoggerInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the logger. Stops logging, in case it still runs.
+**
+****************************************************************************************/
+void LoggerTerminate(void)
+{
+  /* Stop logging and release the writer. */
+  WriterTerminate(&loggerWriter);
+} /*** end of LoggerTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts logging the CAN messages to log files. Call it from OnPreStart to
+**            log all CAN messages from the start.
+** \param     config Pointer to the logger configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool LoggerStart(tLoggerConfig const * config)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter and when not yet running. A log file must at
+   * least be large enough for the file header and one record.
+   */
+  if ( (config != NULL) && (config->prefix != NULL) && (!WriterRunning(&loggerWriter)) &&
+       (strlen(config->prefix) < sizeof(loggerPrefix)) &&
+       ( (config->maxFileSize == 0) ||
+         (config->maxFileSize >= (sizeof(tLoggerFileHeader) + sizeof(tLoggerRecord))) ) )
+  {
+    /* Store the configuration. */
+    strcpy(loggerPrefix, config->prefix);
+    loggerConfig = *config;
+    loggerConfig.prefix = loggerPrefix;
+    /* Start the writer thread. */
+    loggerBlockCount = 0;
+    result = WriterStart(&loggerWriter);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LoggerStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops logging. The writer thread writes all queued records, before the log
+**            file is closed.
+**
+****************************************************************************************/
+void LoggerStop(void)
+{
+  /* Stop the writer thread. */
+  WriterStop(&loggerWriter);
+} /*** end of LoggerStop ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a CAN message for logging. Never blocks. Can be called from any
+**            thread.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if the CAN message was queued, false if the logger does not run, is
+**            not configured to log transmitted CAN messages or its queue is full.
+**
+****************************************************************************************/
+bool LoggerMessage(tCanMsg const * msg, bool transmitted)
+{
+  bool result = false;
+  tLoggerRecord record;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when running. */
+  if ( (msg != NULL) && (WriterRunning(&loggerWriter)) &&
+       ( (!transmitted) || (loggerConfig.logTransmitted) ) )
+  {
+    /* Convert the CAN message to a record and queue it. */
+    WriterMakeRecord(&record, msg, transmitted);
+    record.bus = loggerConfig.bus;
+    result = WriterPush(&loggerWriter, &record);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LoggerMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the logger statistics. Can be called from any thread.
+** \param     stats Pointer to where the statistics are stored.
+**
+****************************************************************************************/
+void LoggerGetStats(tLoggerStats * stats)
+{
+  tWriterStats writerStats;
+
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    WriterGetStats(&loggerWriter, &writerStats);
+    stats->queued = writerStats.queued;
+    stats->dropped = writerStats.dropped;
+    stats->written = atomic_load(&loggerWritten);
+    stats->writeErrors = atomic_load(&loggerWriteErrors);
+    stats->files = atomic_load(&loggerFiles);
+    stats->highWater = writerStats.highWater;
+  }
+} /*** end of LoggerGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a record to the block. Writes the block as soon as it is complete.
+**            Called by the writer thread for each queued record.
+** \param     record Pointer to the record.
+**
+****************************************************************************************/
+static void LoggerCollect(tLoggerRecord const * record)
+{
+  loggerBlock[loggerBlockCount] = *record;
+  if (++loggerBlockCount == LOGGER_BLOCK_RECORDS)
+  {
+    LoggerWriteBlock();
+  }
+} /*** end of LoggerCollect ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the collected records to the log file. Opens and rotates the log
+**            files as needed. Records never span two log files. Called by the writer
+**            thread once the queue is empty, which also rotates the log file by time.
+**
+****************************************************************************************/
+static void LoggerWriteBlock(void)
+{
+  uint64_t now = UtilSystemTime();
+  size_t idx = 0;
+  size_t count;
+  uint64_t size;
+  uint64_t room;
+
+  /* Rotate the log file by time, if it is due. */
+  if ( (loggerFd != LOGGER_INVALID_FD) && (loggerConfig.rotateInterval > 0) &&
+       ((now - loggerFileCreated) >= ((uint64_t)loggerConfig.rotateInterval * 1000000U)) )
+  {
+    LoggerCloseFile();
+  }
+
+  /* Write the records, possibly spread over multiple log files. */
+  while (idx < loggerBlockCount)
+  {
+    /* Make sure a log file is open. The records are lost, if this fails. */
+    if ( (loggerFd == LOGGER_INVALID_FD) && (!LoggerOpenFile(now)) )
+    {
+      atomic_fetch_add(&loggerWriteErrors, loggerBlockCount - idx);
+      break;
+    }
+    /* Determine how many records still fit in the log file. Rotate it, when full. */
+    count = loggerBlockCount - idx;
+    if (loggerConfig.maxFileSize > 0)
+    {
+      room = (loggerConfig.maxFileSize - loggerFileSize) / sizeof(tLoggerRecord);
+      if (room == 0)
+      {
+        LoggerCloseFile();
+        continue;
+      }
+      if (count > room)
+      {
+        count = (size_t)room;
+      }
+    }
+    size = (uint64_t)count * sizeof(tLoggerRecord);
+    /* Preallocate disk space ahead of the writes. This keeps the log file contiguous
+     * on disk and reports a full disk early. The file size itself does not change.
+     */
+    if ((loggerFileSize + size) > loggerFileAllocated)
+    {
+      loggerFileAllocated += LOGGER_PREALLOC_SIZE;
+      if ( (loggerConfig.maxFileSize > 0) &&
+           (loggerFileAllocated > loggerConfig.maxFileSize) )
+      {
+        loggerFileAllocated = loggerConfig.maxFileSize;
+      }
+      if (loggerFileAllocated < (loggerFileSize + size))
+      {
+        loggerFileAllocated = loggerFileSize + size;
+      }
+      (void)fallocate(loggerFd, FALLOC_FL_KEEP_SIZE, (off_t)loggerFileSize,
+                      (off_t)(loggerFileAllocated - loggerFileSize));
+    }
+    /* Write the records. Continue with a new log file after a write error. */
+    if (UtilWriteAll(loggerFd, &loggerBlock[idx], (size_t)size))
+    {
+      loggerFileSize += size;
+      atomic_fetch_add(&loggerWritten, count);
+    }
+    else
+    {
+      atomic_fetch_add(&loggerWriteErrors, count);
+      LoggerCloseFile();
+    }
+    idx += count;
+  }
+
+  /* The block is empty again. */
+  loggerBlockCount = 0;
+} /*** end of LoggerWriteBlock ***/
+
+
+/************************************************************************************//**
+** \brief     Creates a new log file and writes its header.
+** \param     now Current system time in microseconds.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool LoggerOpenFile(uint64_t now)
+{
+  bool result = false;
+  char path[PATH_MAX];
+  char timeText[32];
+  tLoggerFileHeader header = { 0 };
+  time_t seconds = (time_t)(now / 1000000U);
+  struct tm localTime;
+
+  /* Construct the file name from the prefix, the local time and the sequence number. */
+  if (localtime_r(&seconds, &localTime) == NULL)
+  {
+    memset(&localTime, 0, sizeof(localTime));
+  }
+  (void)strftime(timeText, sizeof(timeText), "%Y%m%d_%H%M%S", &localTime);
+  if (snprintf(path, sizeof(path), "%s_%s_%04u.clog", loggerPrefix, timeText,
+               loggerFileIndex) < (int)sizeof(path))
+  {
+    loggerFileIndex++;
+    /* Create the log file. */
+    loggerFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (loggerFd != LOGGER_INVALID_FD)
+    {
+      loggerFileSize = 0;
+      loggerFileAllocated = 0;
+      loggerFileCreated = now;
+      atomic_fetch_add(&loggerFiles, 1);
+      /* Write the file header. */
+      memcpy(header.magic, LOGGER_MAGIC, sizeof(header.magic));
+      header.version = LOGGER_VERSION;
+      header.recordSize = sizeof(tLoggerRecord);
+      header.bus = loggerConfig.bus;
+      header.startTime = CanStartTime();
+      if (UtilWriteAll(loggerFd, &header, sizeof(header)))
+      {
+        loggerFileSize = sizeof(header);
+        result = true;
+      }
+      else
+      {
+        LoggerCloseFile();
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LoggerOpenFile ***/
+
+
+/************************************************************************************//**
+** \brief     Closes the current log file, if one is open. Releases the disk space that
+**            was preallocated, but not used.
+**
+****************************************************************************************/
+static void LoggerCloseFile(void)
+{
+  if (loggerFd != LOGGER_INVALID_FD)
+  {
+    (void)ftruncate(loggerFd, (off_t)loggerFileSize);
+    close(loggerFd);
+    loggerFd = LOGGER_INVALID_FD;
+  }
+} /*** end of LoggerCloseFile ***/
+
+
+/*********************************** end of logger.c ***********************************/
@@ -0,0 +1,154 @@
+/************************************************************************************//**
+* \file         logger.h
+* \brief        Asynchronous binary CAN message logger header file.
+*
+****************************************************************************************/
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of records that the queue between the CAN event thread and the writer
+ *  thread can hold. Records that do not fit anymore are dropped and counted. Must be a
+ *  power of two.
+ */
+#ifndef LOGGER_QUEUE_SIZE
+#define LOGGER_QUEUE_SIZE              (65536U)
+#endif
+
+/** \brief Number of records that the writer thread collects, before writing them to the
+ *  log file with one system call.
+ */
+#ifndef LOGGER_BLOCK_RECORDS
+#define LOGGER_BLOCK_RECORDS           (8192U)
+#endif
+
+/** \brief Maximum time in milliseconds that a record waits in the queue, before the
+ *  writer thread writes it to the log file.
+ */
+#ifndef LOGGER_FLUSH_INTERVAL
+#define LOGGER_FLUSH_INTERVAL          (250U)
+#endif
+
+/** \brief Number of bytes by which a log file's disk space is preallocated ahead of the
+ *  writes.
+ */
+#ifndef LOGGER_PREALLOC_SIZE
+#define LOGGER_PREALLOC_SIZE           (64UL * 1024UL * 1024UL)
+#endif
+
+/** \brief Magic value at the start of each log file. */
+#define LOGGER_MAGIC                   "CAPLNLOG"
+
+/** \brief Version of the log file format. */
+#define LOGGER_VERSION                 (1U)
+
+/** \brief Record flag for a CAN message with a 29-bit identifier. */
+#define LOGGER_FLAG_EXT                (0x01U)
+
+/** \brief Record flag for a transmitted CAN message. */
+#define LOGGER_FLAG_TX                 (0x02U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Header at the start of each log file. All fields are in the byte order of the
+ *  host. It has the same size as a record.
+ */
+typedef struct
+{
+  /** \brief Magic value LOGGER_MAGIC, without string termination. */
+  char     magic[8];
+  /** \brief Version of the log file format, LOGGER_VERSION. */
+  uint16_t version;
+  /** \brief Size of one record in bytes. */
+  uint16_t recordSize;
+  /** \brief Bus number of the records, as configured when the logger was started. */
+  uint8_t  bus;
+  /** \brief Reserved for future use. Always zero. */
+  uint8_t  reserved[3];
+  /** \brief System time in microseconds, to which the record timestamps are relative. */
+  uint64_t startTime;
+} tLoggerFileHeader;
+
+/** \brief Record with one logged CAN message. */
+typedef struct
+{
+  /** \brief Timestamp in microseconds, relative to the start time in the file header. */
+  uint64_t timestamp;
+  /** \brief CAN message identifier. */
+  uint32_t id;
+  /** \brief CAN message data length. */
+  uint8_t  len;
+  /** \brief Combination of the LOGGER_FLAG_xxx flags. */
+  uint8_t  flags;
+  /** \brief Bus number, as configured when the logger was started. */
+  uint8_t  bus;
+  /** \brief Reserved for future use. Always zero. */
+  uint8_t  reserved;
+  /** \brief Data bytes of the CAN message. Unused bytes are zero. */
+  uint8_t  data[CAN_DATA_LEN_MAX];
+} tLoggerRecord;
+
+/** \brief Configuration of the logger. */
+typedef struct
+{
+  /** \brief Path and file name prefix of the log files. The date, time and a sequence
+   *  number are appended to it, for example "/var/log/can0_20240131_235959_0001.clog".
+   */
+  char const * prefix;
+  /** \brief Maximum size of a log file in bytes, or 0 to not rotate by size. */
+  uint64_t maxFileSize;
+  /** \brief Maximum time in seconds to write to the same log file, or 0 to not rotate by
+   *  time.
+   */
+  uint32_t rotateInterval;
+  /** \brief Bus number that is stored in the records, to tell the buses apart when the
+   *  log files of several buses are combined.
+   */
+  uint8_t  bus;
+  /** \brief True to also log the transmitted CAN messages. */
+  bool     logTransmitted;
+} tLoggerConfig;
+
+/** \brief Logger statistics. */
+typedef struct
+{
+  /** \brief Number of records that were queued for writing. */
+  uint64_t queued;
+  /** \brief Number of records that were dropped, because the queue was full. */
+  uint64_t dropped;
+  /** \brief Number of records that were written to the log files. */
+  uint64_t written;
+  /** \brief Number of records that were lost, because writing them failed. */
+  uint64_t writeErrors;
+  /** \brief Number of log files that were created. */
+  uint64_t files;
+  /** \brief Highest number of records that were queued at the same time. */
+  size_t   highWater;
+} tLoggerStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void LoggerInit(void);
+void LoggerTerminate(void);
+bool LoggerStart(tLoggerConfig const * config);
+void LoggerStop(void);
+bool LoggerMessage(tCanMsg const * msg, bool transmitted);
+void LoggerGetStats(tLoggerStats * stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOGGER_H */
+/*********************************** end of logger.h ***********************************/
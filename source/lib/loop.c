@@ -0,0 +1,330 @@
+/************************************************************************************//**
+* \file         loop.c
+* \brief        Event loop driver source file.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <errno.h>                          /* Error numbers                           */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/eventfd.h>                    /* Event notification file descriptor      */
+#include "loop.h"                           /* Event loop driver                       */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define LOOP_INVALID_FD                (-1)
+
+/** \brief Maximum number of events to obtain with one epoll_wait() call. */
+#define LOOP_EVENTS_MAX                (16U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+typedef struct
+{
+  /** \brief File descriptor or LOOP_INVALID_FD if the entry is not in use. */
+  int fd;
+  /** \brief Incremented each time the entry is released, such that events that were
+   *  already obtained for a removed file descriptor are not reported.
+   */
+  uint32_t generation;
+  /** \brief Callback function to call upon an event on the file descriptor. */
+  tLoopEventCallback callbackFcn;
+  /** \brief User context pointer that is passed to the callback function. */
+  void * context;
+} tLoopSource;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Boolean flag that indicates if all event sources are serviced by the event
+ *  loop, instead of by their own threads.
+ */
+static bool loopSingleThreaded;
+
+/** \brief The epoll instance. */
+static int loopEpollFd = LOOP_INVALID_FD;
+
+/** \brief Event file descriptor to wake up the loop when a stop is requested. */
+static int loopWakeupFd = LOOP_INVALID_FD;
+
+/** \brief Atomic boolean that is used to inform the loop to stop running. */
+static atomic_bool loopStopRequested;
+
+/** \brief Table with the registered event sources. */
+static tLoopSource loopSources[LOOP_SOURCES_MAX];
+
+
+/************************************************************************************//**
+** \brief     Initializes the event loop driver. Think of it as the constructor, if this
+**            driver was a C++ class.
+** \param     singleThreaded True if all drivers should register their file descriptors
+**            with the event loop, instead of running their own threads. In this mode,
+**            all callbacks are invoked serially from the thread that calls LoopRun().
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool LoopInit(bool singleThreaded)
+{
+  bool result = false;
+  struct epoll_event event = { 0 };
+
+  /* Initialize locals. */
+  loopSingleThreaded = false;
+  atomic_init(&loopStopRequested, false);
+  for (size_t idx = 0; idx < LOOP_SOURCES_MAX; idx++)
+  {
+    loopSources[idx].fd = LOOP_INVALID_FD;
+    loopSources[idx].generation = 0;
+    loopSources[idx].callbackFcn = NULL;
+    loopSources[idx].context = NULL;
+  }
+
+  /* Create the epoll instance and the event file descriptor for waking up the loop. */
+  loopEpollFd = epoll_create1(EPOLL_CLOEXEC);
+  loopWakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if ( (loopEpollFd != LOOP_INVALID_FD) && (loopWakeupFd != LOOP_INVALID_FD) )
+  {
+    /* Register the wakeup event file descriptor. Its data is all ones, which can never
+     * match a source table entry.
+     */
+    event.events = EPOLLIN;
+    event.data.u64 = UINT64_MAX;
+    if (epoll_ctl(loopEpollFd, EPOLL_CTL_ADD, loopWakeupFd, &event) == 0)
+    {
+      /* Store the mode and update the result. */
+      loopSingleThreaded = singleThreaded;
+      result = true;
+    }
+  }
+
+  /* Clean up in case of an error. */
+  if (!result)
+  {
+    LoopTerminate();
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LoopInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the event loop driver. Think of it as the destructor if this
+**            driver was a C++ class.
+**
+****************************************************************************************/
+void LoopTerminate(void)
+{
+  /* Close the file descriptors owned by the event loop. */
+  if (loopWakeupFd != LOOP_INVALID_FD)
+  {
+    close(loopWakeupFd);
+  }
+  if (loopEpollFd != LOOP_INVALID_FD)
+  {
+    close(loopEpollFd);
+  }
+
+  /* Reset locals. Note that the registered file descriptors are owned by the drivers
+   * that registered them.
+   */
+  for (size_t idx = 0; idx < LOOP_SOURCES_MAX; idx++)
+  {
+    loopSources[idx].fd = LOOP_INVALID_FD;
+    loopSources[idx].callbackFcn = NULL;
+    loopSources[idx].context = NULL;
+  }
+  loopWakeupFd = LOOP_INVALID_FD;
+  loopEpollFd = LOOP_INVALID_FD;
+  loopSingleThreaded = false;
+} /*** end of LoopTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if the event loop services all event sources. Drivers call this
+**            function to decide between registering their file descriptors with the
+**            event loop and running their own thread.
+** \return    True if running in single-threaded mode, false otherwise.
+**
+****************************************************************************************/
+bool LoopSingleThreaded(void)
+{
+  /* Give the result back to the caller. */
+  return loopSingleThreaded;
+} /*** end of LoopSingleThreaded ***/
+
+
+/************************************************************************************//**
+** \brief     Registers a file descriptor with the event loop.
+** \param     fd File descriptor.
+** \param     events The epoll events to monitor, typically EPOLLIN.
+** \param     callbackFcn Callback function to call upon an event on the file descriptor.
+** \param     context User context pointer that is passed to the callback function.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool LoopAdd(int fd, uint32_t events, tLoopEventCallback callbackFcn, void * context)
+{
+  bool result = false;
+  struct epoll_event event = { 0 };
+
+  /* Verify parameters. */
+  assert(fd != LOOP_INVALID_FD);
+  assert(callbackFcn != NULL);
+
+  /* Only continue with valid parameters and an initialized event loop. */
+  if ( (fd != LOOP_INVALID_FD) && (callbackFcn != NULL) && 
+       (loopEpollFd != LOOP_INVALID_FD) )
+  {
+    /* Find a free entry in the source table. */
+    for (size_t idx = 0; idx < LOOP_SOURCES_MAX; idx++)
+    {
+      if (loopSources[idx].fd == LOOP_INVALID_FD)
+      {
+        /* Register the file descriptor. The event data holds the generation and the
+         * index of the entry.
+         */
+        event.events = events;
+        event.data.u64 = ((uint64_t)loopSources[idx].generation << 32) | idx;
+        if (epoll_ctl(loopEpollFd, EPOLL_CTL_ADD, fd, &event) == 0)
+        {
+          /* Store the entry. */
+          loopSources[idx].fd = fd;
+          loopSources[idx].callbackFcn = callbackFcn;
+          loopSources[idx].context = context;
+          result = true;
+        }
+        /* No need to continue the search. */
+        break;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of LoopAdd ***/
+
+
+/************************************************************************************//**
+** \brief     Removes a file descriptor from the event loop. Can be called from inside
+**            an event callback. Note that the file descriptor is not closed.
+** \param     fd File descriptor.
+**
+****************************************************************************************/
+void LoopRemove(int fd)
+{
+  /* Only continue with an initialized event loop. */
+  if ( (fd != LOOP_INVALID_FD) && (loopEpollFd != LOOP_INVALID_FD) )
+  {
+    /* Find the entry in the source table. */
+    for (size_t idx = 0; idx < LOOP_SOURCES_MAX; idx++)
+    {
+      if (loopSources[idx].fd == fd)
+      {
+        /* Unregister the file descriptor and release the entry. */
+        (void)epoll_ctl(loopEpollFd, EPOLL_CTL_DEL, fd, NULL);
+        loopSources[idx].fd = LOOP_INVALID_FD;
+        loopSources[idx].generation++;
+        loopSources[idx].callbackFcn = NULL;
+        loopSources[idx].context = NULL;
+        break;
+      }
+    }
+  }
+} /*** end of LoopRemove ***/
+
+
+/************************************************************************************//**
+** \brief     Runs the event loop on the calling thread, until LoopStop() is called. It
+**            blocks until one of the registered file descriptors reports an event and
+**            invokes the callbacks one after the other.
+**
+****************************************************************************************/
+void LoopRun(void)
+{
+  struct epoll_event events[LOOP_EVENTS_MAX];
+  tLoopSource * source;
+  uint64_t counter;
+  uint32_t idx;
+  int count;
+
+  /* Enter the loop and run it, until a stop is requested. */
+  while (!atomic_load(&loopStopRequested))
+  {
+    /* Wait for events. */
+    count = epoll_wait(loopEpollFd, events, LOOP_EVENTS_MAX, -1);
+    /* Interrupted by a signal or a real error? */
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+
+    /* Process the events one-by-one. */
+    for (int eventIdx = 0; eventIdx < count; eventIdx++)
+    {
+      /* Wakeup event? */
+      if (events[eventIdx].data.u64 == UINT64_MAX)
+      {
+        /* Reset the event counter. The stop flag is checked by the loop itself. */
+        (void)read(loopWakeupFd, &counter, sizeof(counter));
+        continue;
+      }
+      /* Look up the source. Skip the event if its source was removed in the meantime,
+       * for example from inside another callback.
+       */
+      idx = (uint32_t)(events[eventIdx].data.u64 & UINT32_MAX);
+      source = &loopSources[idx];
+      if ( (source->fd == LOOP_INVALID_FD) || 
+           (source->generation != (uint32_t)(events[eventIdx].data.u64 >> 32)) )
+      {
+        continue;
+      }
+      /* Invoke the callback. */
+      source->callbackFcn(source->fd, events[eventIdx].events, source->context);
+    }
+  }
+
+  /* Reset the stop flag, such that the loop can be run again. */
+  atomic_store(&loopStopRequested, false);
+} /*** end of LoopRun ***/
+
+
+/************************************************************************************//**
+** \brief     Requests the event loop to stop. Can be called from any thread and from
+**            inside an event callback.
+**
+****************************************************************************************/
+void LoopStop(void)
+{
+  uint64_t counter = 1;
+
+  /* Set atomic boolean flag to request the loop to stop. */
+  atomic_store(&loopStopRequested, true);
+  /* Wake up the loop, in case it is waiting for events. */
+  if (loopWakeupFd != LOOP_INVALID_FD)
+  {
+    (void)write(loopWakeupFd, &counter, sizeof(counter));
+  }
+} /*** end of LoopStop ***/
+
+
+/*********************************** end of loop.c *************************************/
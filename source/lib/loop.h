@@ -0,0 +1,48 @@
+/************************************************************************************//**
+* \file         loop.h
+* \brief        Event loop driver header file.
+*
+****************************************************************************************/
+#ifndef LOOP_H
+#define LOOP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of file descriptors that can be registered with the event
+ *  loop at the same time.
+ */
+#define LOOP_SOURCES_MAX     (32U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type for the file descriptor event callback handler. The events
+ *  parameter holds the epoll event flags that were reported for the file descriptor.
+ */
+typedef void (* tLoopEventCallback)(int fd, uint32_t events, void * context);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+bool LoopInit(bool singleThreaded);
+void LoopTerminate(void);
+bool LoopSingleThreaded(void);
+bool LoopAdd(int fd, uint32_t events, tLoopEventCallback callbackFcn, void * context);
+void LoopRemove(int fd);
+void LoopRun(void);
+void LoopStop(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOOP_H */
+/*********************************** end of loop.h *************************************/
@@ -0,0 +1,848 @@
+/************************************************************************************//**
+* \file         pack.c
+* \brief        Compressed capture file source file.
+* \details      Writes the CAN messages to a compressed capture file, for recordings
+*               that run for weeks. CAN traffic is very redundant. Most CAN identifiers
+*               are sent cyclically, at a fixed period and with mostly unchanged data.
+*               The encoder therefore stores each CAN message relative to the previous
+*               one with the same identifier:
+*
+*               - The identifier is an index in a dictionary that both the encoder and
+*                 the decoder build up, as new identifiers appear.
+*               - The timestamp is the change of the time between two CAN messages with
+*                 this identifier, which is close to zero for a cyclic CAN message.
+*               - The data bytes are XOR'ed with the previous ones. Only the bytes that
+*                 changed are stored, after a byte with a bit for each of them.
+*
+*               Numbers are stored as variable-length integers, seven bits per byte. A
+*               cyclic CAN message with unchanged data takes up three bytes, instead of
+*               the 24 bytes of a record of the logger.
+*
+*               Just like the logger, it builds on the asynchronous record writer, so the
+*               thread that reports a CAN message never blocks. The writer thread encodes
+*               the records into large blocks and writes each block with one system call.
+*
+*               A capture file starts with a tPackFileHeader, followed by the encoded CAN
+*               messages. Each one starts with a byte with the following bits:
+*
+*               - Bit 0..3: number of data bytes.
+*               - Bit 4:    set for a transmitted CAN message.
+*               - Bit 5:    set for a 29-bit CAN identifier.
+*               - Bit 6:    set for a new CAN identifier. The identifier follows, and it
+*                           is added to the dictionary. Otherwise its index follows.
+*               - Bit 7:    set if the data bytes changed. The byte with the changed
+*                           bytes and the XOR'ed bytes follow after the timestamp.
+*
+*               A byte PACK_TAG_RESET in front of an encoded CAN message tells that the
+*               encoder started over. The decoder then starts over too. The encoder does
+*               this after a write error, because the decoder never sees the CAN messages
+*               that were lost.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <time.h>                           /* Date and time utilities                 */
+#include <fcntl.h>                          /* File control options                    */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+#include "pack.h"                           /* Compressed capture file                 */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define PACK_INVALID_FD                (-1)
+
+/** \brief Bits of the first byte of an encoded CAN message. */
+#define PACK_TAG_LEN_MASK              (0x0FU)
+#define PACK_TAG_TX                    (0x10U)
+#define PACK_TAG_EXT                   (0x20U)
+#define PACK_TAG_NEW                   (0x40U)
+#define PACK_TAG_DATA                  (0x80U)
+
+/** \brief Byte that tells the decoder to start over. A CAN message never has more than
+ *  CAN_DATA_LEN_MAX data bytes, so no encoded CAN message starts with it.
+ */
+#define PACK_TAG_RESET                 (0x0FU)
+
+/** \brief Bit of a dictionary key that is set for a 29-bit CAN identifier. */
+#define PACK_KEY_EXT                   (0x80000000UL)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void   PackCollect(tLoggerRecord const * record);
+static void   PackWriteBlock(void);
+static void   PackCloseFile(void);
+static size_t PackPutVarint(uint8_t * out, uint64_t value);
+static size_t PackGetVarint(uint8_t const * in, size_t size, uint64_t * value);
+static tPackEntry * PackAddEntry(tPackCodec * codec, uint32_t key, uint64_t timestamp);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Configuration of the asynchronous record writer. The writer thread is woken
+ *  up once enough records are queued to most likely fill a block.
+ */
+static tWriterConfig const packWriterConfig =
+{
+  .queueSize = PACK_QUEUE_SIZE,
+  .wakeCount = PACK_BLOCK_SIZE / PACK_RECORD_MAX,
+  .flushInterval = PACK_FLUSH_INTERVAL,
+  .recordFcn = PackCollect,
+  .flushFcn = PackWriteBlock,
+  .closeFcn = PackCloseFile
+};
+
+/** \brief Asynchronous record writer with the queue and the writer thread. The
+ *  timestamps of its records are absolute.
+ */
+static tWriter packWriter;
+
+/** \brief True to also capture the transmitted CAN messages. */
+static bool packLogTransmitted;
+
+/** \brief Encoder state. Only used by the writer thread. */
+static tPackCodec packEncoder;
+
+/** \brief Block with the encoded CAN messages that the writer thread collected. */
+static uint8_t packBlock[PACK_BLOCK_SIZE];
+
+/** \brief Number of bytes in the block. */
+static size_t packBlockSize;
+
+/** \brief Number of CAN messages in the block. */
+static size_t packBlockCount;
+
+/** \brief Set after a write error, to start the next block with PACK_TAG_RESET. */
+static bool packResync;
+
+/** \brief File descriptor of the capture file. Only used by the writer thread, once it
+ *  runs.
+ */
+static int packFd;
+
+/** \brief Size in bytes of the capture file, up to the last block that was written
+ *  completely.
+ */
+static uint64_t packFileSize;
+
+/** \brief Counters that the writer thread updates. */
+static atomic_uint_fast64_t packWritten;
+static atomic_uint_fast64_t packWriteErrors;
+static atomic_uint_fast64_t packBytes;
+
+
+/************************************************************************************//**
+** \brief     Initializes the compressed capture writer. Capturing does not start until
+**            PackStart() is called.
+**
+****************************************************************************************/
+void PackInit(void)
+{
+  /* Initialize locals. */
+  atomic_init(&packWritten, 0);
+  atomic_init(&packWriteErrors, 0);
+  atomic_init(&packBytes, 0);
+  packLogTransmitted = false;
+  packBlockSize = 0;
+  packBlockCount = 0;
+  packResync = false;
+  packFd = PACK_INVALID_FD;
+  packFileSize = 0;
+  WriterInit(&packWriter, &packWriterConfig);
+} /*** end of PackInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the compressed capture writer. Stops capturing, in case it still
+**            runs.
+**
+****************************************************************************************/
+void PackTerminate(void)
+{
+  /* Stop capturing and release the writer. */
+  WriterTerminate(&packWriter);
+} /*** end of PackTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Creates the capture file and starts capturing the CAN messages to it. Call
+**            it from OnPreStart to capture all CAN messages from the start.
+** \param     config Pointer to the configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool PackStart(tPackConfig const * config)
+{
+  bool result = false;
+  tPackFileHeader header;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter and when not yet running. */
+  if ( (config != NULL) && (config->path != NULL) && (!WriterRunning(&packWriter)) )
+  {
+    /* Create the capture file and write its header. The timestamps of the CAN messages
+     * are relative to the start time of the CAN driver, which is not known before it
+     * connected. The encoder therefore stores absolute timestamps.
+     */
+    packFd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.version = PACK_VERSION;
+    header.bus = config->bus;
+    header.startTime = 0;
+    if ( (packFd != PACK_INVALID_FD) && (!UtilWriteAll(packFd, &header, sizeof(header))) )
+    {
+      PackCloseFile();
+    }
+
+    if (packFd != PACK_INVALID_FD)
+    {
+      packLogTransmitted = config->logTransmitted;
+      PackCodecReset(&packEncoder);
+      packFileSize = sizeof(header);
+      packBlockSize = 0;
+      packBlockCount = 0;
+      packResync = false;
+      /* Start the writer thread, which closes the capture file once it stops. */
+      result = WriterStart(&packWriter);
+      if (!result)
+      {
+        PackCloseFile();
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops capturing. The writer thread writes all queued CAN messages, before
+**            the capture file is closed.
+**
+****************************************************************************************/
+void PackStop(void)
+{
+  /* Stop the writer thread. */
+  WriterStop(&packWriter);
+} /*** end of PackStop ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a CAN message for capturing. Never blocks. Can be called from any
+**            thread.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if the CAN message was queued, false if the writer does not run, is
+**            not configured to capture transmitted CAN messages or its queue is full.
+**
+****************************************************************************************/
+bool PackMessage(tCanMsg const * msg, bool transmitted)
+{
+  bool result = false;
+  tLoggerRecord record;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when running. */
+  if ( (msg != NULL) && (WriterRunning(&packWriter)) &&
+       ( (!transmitted) || (packLogTransmitted) ) )
+  {
+    /* Convert the CAN message to a record with an absolute timestamp and queue it. */
+    WriterMakeRecord(&record, msg, transmitted);
+    record.timestamp = CanStartTime() + msg->timestamp;
+    result = WriterPush(&packWriter, &record);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the compressed capture writer statistics. Can be called from any
+**            thread.
+** \param     stats Pointer to where the statistics are stored.
+**
+****************************************************************************************/
+void PackGetStats(tPackStats * stats)
+{
+  tWriterStats writerStats;
+
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    WriterGetStats(&packWriter, &writerStats);
+    stats->queued = writerStats.queued;
+    stats->dropped = writerStats.dropped;
+    stats->written = atomic_load(&packWritten);
+    stats->writeErrors = atomic_load(&packWriteErrors);
+    stats->bytes = atomic_load(&packBytes);
+    stats->highWater = writerStats.highWater;
+  }
+} /*** end of PackGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Resets the state of an encoder or decoder, for the start of a capture file.
+** \param     codec Pointer to the encoder or decoder state.
+**
+****************************************************************************************/
+void PackCodecReset(tPackCodec * codec)
+{
+  /* Verify parameter. */
+  assert(codec != NULL);
+
+  /* Only continue with valid parameter. */
+  if (codec != NULL)
+  {
+    codec->count = 0;
+    codec->timestamp = 0;
+    memset(codec->hash, 0, sizeof(codec->hash));
+  }
+} /*** end of PackCodecReset ***/
+
+
+/************************************************************************************//**
+** \brief     Encodes a record.
+** \param     codec Pointer to the encoder state.
+** \param     record Pointer to the record.
+** \param     out Pointer to where the encoded record is stored. Must have room for
+**            PACK_RECORD_MAX bytes.
+** \return    Number of bytes of the encoded record.
+**
+****************************************************************************************/
+size_t PackEncode(tPackCodec * codec, tLoggerRecord const * record, uint8_t * out)
+{
+  size_t result = 0;
+  uint32_t key;
+  uint32_t slot;
+  uint16_t index;
+  tPackEntry * entry;
+  int64_t delta;
+  int64_t change;
+  uint8_t len;
+  uint8_t changed = 0;
+  uint8_t tag;
+
+  /* Verify parameters. */
+  assert(codec != NULL);
+  assert(record != NULL);
+  assert(out != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (codec != NULL) && (record != NULL) && (out != NULL) )
+  {
+    len = (record->len <= CAN_DATA_LEN_MAX) ? record->len : CAN_DATA_LEN_MAX;
+    tag = len;
+    tag |= ((record->flags & LOGGER_FLAG_TX) != 0) ? PACK_TAG_TX : 0U;
+    key = record->id;
+    if ((record->flags & LOGGER_FLAG_EXT) != 0)
+    {
+      tag |= PACK_TAG_EXT;
+      key = (record->id & 0x1FFFFFFFUL) | PACK_KEY_EXT;
+    }
+    else
+    {
+      key = record->id & 0x7FFUL;
+    }
+
+    /* Find the dictionary entry of the CAN identifier. */
+    slot = (key * 2654435761UL) & (PACK_HASH_SIZE - 1U);
+    while ( (codec->hash[slot] != 0) &&
+            (codec->entries[codec->hash[slot] - 1U].key != key) )
+    {
+      slot = (slot + 1U) & (PACK_HASH_SIZE - 1U);
+    }
+    index = codec->hash[slot];
+
+    /* Known CAN identifier. Store its index. */
+    if (index != 0)
+    {
+      entry = &codec->entries[index - 1U];
+      result = 1U + PackPutVarint(&out[1], index - 1U);
+    }
+    /* New CAN identifier. Store it and add it to the dictionary. The dictionary starts
+     * over once it is full, just like it does in the decoder.
+     */
+    else
+    {
+      tag |= PACK_TAG_NEW;
+      result = 1U + PackPutVarint(&out[1], key & ~PACK_KEY_EXT);
+      if (codec->count >= PACK_DICTIONARY_SIZE)
+      {
+        PackCodecReset(codec);
+        slot = (key * 2654435761UL) & (PACK_HASH_SIZE - 1U);
+      }
+      entry = PackAddEntry(codec, key, codec->timestamp);
+      codec->hash[slot] = (uint16_t)codec->count;
+    }
+
+    /* Store the change of the time between two CAN messages with this identifier, in
+     * zigzag coding, so small negative changes also take up few bytes.
+     */
+    delta = (int64_t)(record->timestamp - entry->timestamp);
+    change = delta - entry->delta;
+    result += PackPutVarint(&out[result], ((uint64_t)change << 1) ^
+                                          (uint64_t)(change >> 63));
+    entry->timestamp = record->timestamp;
+    entry->delta = ((tag & PACK_TAG_NEW) != 0) ? 0 : delta;
+    codec->timestamp = record->timestamp;
+
+    /* Store the data bytes that changed, XOR'ed with their previous value. */
+    for (uint8_t idx = 0; idx < CAN_DATA_LEN_MAX; idx++)
+    {
+      if (record->data[idx] != entry->data[idx])
+      {
+        changed |= (uint8_t)(1U << idx);
+      }
+    }
+    if (changed != 0)
+    {
+      tag |= PACK_TAG_DATA;
+      out[result++] = changed;
+      for (uint8_t idx = 0; idx < CAN_DATA_LEN_MAX; idx++)
+      {
+        if ((changed & (1U << idx)) != 0)
+        {
+          out[result++] = record->data[idx] ^ entry->data[idx];
+        }
+      }
+      memcpy(entry->data, record->data, CAN_DATA_LEN_MAX);
+    }
+    out[0] = tag;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackEncode ***/
+
+
+/************************************************************************************//**
+** \brief     Decodes a record. Starts over first, if the record is preceded by
+**            PACK_TAG_RESET.
+** \param     codec Pointer to the decoder state.
+** \param     in Pointer to the encoded record.
+** \param     size Number of bytes that are available at the pointer.
+** \param     record Pointer to where the decoded record is stored. Its bus is zero.
+** \return    Number of bytes of the encoded record, or 0 if the available bytes do not
+**            hold a complete record or it is invalid.
+**
+****************************************************************************************/
+size_t PackDecode(tPackCodec * codec, uint8_t const * in, size_t size,
+                  tLoggerRecord * record)
+{
+  size_t result = 0;
+  size_t used;
+  size_t start = 0;
+  size_t pos;
+  size_t dataPos = 0;
+  uint64_t value = 0;
+  uint64_t zigzag = 0;
+  tPackEntry * entry = NULL;
+  int64_t delta;
+  uint8_t tag;
+  uint8_t changed = 0;
+  bool valid;
+
+  /* Verify parameters. */
+  assert(codec != NULL);
+  assert(in != NULL);
+  assert(record != NULL);
+
+  /* Start over, if the encoder did. Doing so again, when the record that follows is not
+   * yet complete and the caller retries with more bytes, does no harm.
+   */
+  if ( (codec != NULL) && (in != NULL) && (size > 0) && (in[0] == PACK_TAG_RESET) )
+  {
+    PackCodecReset(codec);
+    start = 1;
+  }
+  pos = start + 1U;
+
+  /* Only continue with valid parameters and at least the first byte. */
+  if ( (codec != NULL) && (in != NULL) && (record != NULL) && (size > start) )
+  {
+    tag = in[start];
+    /* Obtain the CAN identifier or its index, and the change of the time. */
+    used = PackGetVarint(&in[pos], size - pos, &value);
+    pos += used;
+    valid = (used > 0) && ((tag & PACK_TAG_LEN_MASK) <= CAN_DATA_LEN_MAX);
+    if (valid)
+    {
+      used = PackGetVarint(&in[pos], size - pos, &zigzag);
+      pos += used;
+      valid = (used > 0);
+    }
+    /* Obtain the changed data bytes. */
+    if ( (valid) && ((tag & PACK_TAG_DATA) != 0) )
+    {
+      valid = (pos < size);
+      if (valid)
+      {
+        changed = in[pos++];
+        dataPos = pos;
+        pos += (size_t)__builtin_popcount(changed);
+        valid = (pos <= size);
+      }
+    }
+
+    /* Only update the decoder state, once the complete record is available. */
+    if (valid)
+    {
+      /* Look up or add the dictionary entry of the CAN identifier. The dictionary
+       * starts over once it is full, just like it does in the encoder.
+       */
+      if ((tag & PACK_TAG_NEW) != 0)
+      {
+        if (codec->count >= PACK_DICTIONARY_SIZE)
+        {
+          PackCodecReset(codec);
+        }
+        entry = PackAddEntry(codec, (uint32_t)value |
+                                    (((tag & PACK_TAG_EXT) != 0) ? PACK_KEY_EXT : 0U),
+                             codec->timestamp);
+      }
+      else if (value < codec->count)
+      {
+        entry = &codec->entries[value];
+      }
+    }
+
+    if (entry != NULL)
+    {
+      /* Reconstruct the timestamp. */
+      delta = entry->delta + (int64_t)((zigzag >> 1) ^ (~(zigzag & 1U) + 1U));
+      record->timestamp = entry->timestamp + (uint64_t)delta;
+      entry->timestamp = record->timestamp;
+      entry->delta = ((tag & PACK_TAG_NEW) != 0) ? 0 : delta;
+      codec->timestamp = record->timestamp;
+
+      /* Reconstruct the data bytes. */
+      for (uint8_t idx = 0; idx < CAN_DATA_LEN_MAX; idx++)
+      {
+        if ((changed & (1U << idx)) != 0)
+        {
+          entry->data[idx] ^= in[dataPos++];
+        }
+      }
+
+      record->id = entry->key & ~PACK_KEY_EXT;
+      record->len = tag & PACK_TAG_LEN_MASK;
+      record->flags = (((entry->key & PACK_KEY_EXT) != 0) ? LOGGER_FLAG_EXT : 0U) |
+                      (((tag & PACK_TAG_TX) != 0) ? LOGGER_FLAG_TX : 0U);
+      record->bus = 0;
+      record->reserved = 0;
+      memcpy(record->data, entry->data, CAN_DATA_LEN_MAX);
+      result = pos;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackDecode ***/
+
+
+/************************************************************************************//**
+** \brief     Opens a compressed capture file for reading.
+** \param     reader Pointer to the reader. It is large, so better not place it on the
+**            stack.
+** \param     path Path of the capture file.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool PackReaderOpen(tPackReader * reader, char const * path)
+{
+  bool result = false;
+
+  /* Verify parameters. */
+  assert(reader != NULL);
+  assert(path != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (reader != NULL) && (path != NULL) )
+  {
+    reader->offset = 0;
+    reader->size = 0;
+    PackCodecReset(&reader->codec);
+    reader->file = fopen(path, "rb");
+    if (reader->file != NULL)
+    {
+      /* The read buffer of the reader is large already. */
+      (void)setvbuf(reader->file, NULL, _IONBF, 0);
+      if ( (fread(&reader->header, sizeof(reader->header), 1, reader->file) == 1) &&
+           (memcmp(reader->header.magic, PACK_MAGIC, sizeof(reader->header.magic)) == 0) &&
+           (reader->header.version == PACK_VERSION) )
+      {
+        result = true;
+      }
+      else
+      {
+        PackReaderClose(reader);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackReaderOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Reads the next record from a compressed capture file. Its timestamp is
+**            relative to the start time in the header of the capture file.
+** \param     reader Pointer to the reader.
+** \param     record Pointer to where the record is stored.
+** \return    True if successful, false at the end of the capture file or once it turns
+**            out to be damaged.
+**
+****************************************************************************************/
+bool PackReaderRead(tPackReader * reader, tLoggerRecord * record)
+{
+  bool result = false;
+  size_t used;
+  size_t count;
+
+  /* Verify parameters. */
+  assert(reader != NULL);
+  assert(record != NULL);
+
+  /* Only continue with valid parameters and an opened capture file. */
+  if ( (reader != NULL) && (record != NULL) && (reader->file != NULL) )
+  {
+    used = PackDecode(&reader->codec, &reader->buffer[reader->offset],
+                      reader->size - reader->offset, record);
+    /* Refill the read buffer, if it does not hold a complete record. */
+    if ( (used == 0) && ((reader->size - reader->offset) < PACK_RECORD_MAX) )
+    {
+      memmove(reader->buffer, &reader->buffer[reader->offset],
+              reader->size - reader->offset);
+      reader->size -= reader->offset;
+      reader->offset = 0;
+      count = fread(&reader->buffer[reader->size], 1U,
+                    sizeof(reader->buffer) - reader->size, reader->file);
+      reader->size += count;
+      used = PackDecode(&reader->codec, reader->buffer, reader->size, record);
+    }
+    if (used > 0)
+    {
+      reader->offset += used;
+      record->timestamp -= reader->header.startTime;
+      record->bus = reader->header.bus;
+      result = true;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackReaderRead ***/
+
+
+/************************************************************************************//**
+** \brief     Closes a compressed capture file.
+** \param     reader Pointer to the reader.
+**
+****************************************************************************************/
+void PackReaderClose(tPackReader * reader)
+{
+  /* Verify parameter. */
+  assert(reader != NULL);
+
+  /* Only continue with valid parameter and an opened capture file. */
+  if ( (reader != NULL) && (reader->file != NULL) )
+  {
+    fclose(reader->file);
+    reader->file = NULL;
+  }
+} /*** end of PackReaderClose ***/
+
+
+/************************************************************************************//**
+** \brief     Encodes a record into the block. Writes the block as soon as it is full.
+**            Called by the writer thread for each queued record.
+** \param     record Pointer to the record.
+**
+****************************************************************************************/
+static void PackCollect(tLoggerRecord const * record)
+{
+  /* The encoder started over after a write error. Tell the decoder to do so too. */
+  if (packResync)
+  {
+    packBlock[packBlockSize++] = PACK_TAG_RESET;
+    packResync = false;
+  }
+  packBlockSize += PackEncode(&packEncoder, record, &packBlock[packBlockSize]);
+  packBlockCount++;
+  if ((packBlockSize + PACK_RECORD_MAX) > PACK_BLOCK_SIZE)
+  {
+    PackWriteBlock();
+  }
+} /*** end of PackCollect ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the encoded records to the capture file. Called by the writer thread
+**            once the queue is empty. After a write error, the capture file is cut off
+**            at the end of the previous block and both encoder and decoder start over
+**            with the next block. If cutting it off fails, the capture file is closed.
+**
+****************************************************************************************/
+static void PackWriteBlock(void)
+{
+  /* Only continue if there is something to write. */
+  if (packBlockSize > 0)
+  {
+    if (UtilWriteAll(packFd, packBlock, packBlockSize))
+    {
+      packFileSize += packBlockSize;
+      atomic_fetch_add(&packWritten, packBlockCount);
+      atomic_fetch_add(&packBytes, packBlockSize);
+    }
+    else
+    {
+      /* The records of the block are lost, but the encoder already stored them in its
+       * dictionary. Start over and tell the decoder to do so too, at the same record.
+       */
+      atomic_fetch_add(&packWriteErrors, packBlockCount);
+      PackCodecReset(&packEncoder);
+      packResync = true;
+      /* Cut off what did get written of the block, which the decoder cannot make sense
+       * of.
+       */
+      if ( (packFd != PACK_INVALID_FD) &&
+           ( (ftruncate(packFd, (off_t)packFileSize) != 0) ||
+             (lseek(packFd, (off_t)packFileSize, SEEK_SET) != (off_t)packFileSize) ) )
+      {
+        PackCloseFile();
+      }
+    }
+    /* The block is empty again. */
+    packBlockSize = 0;
+    packBlockCount = 0;
+  }
+} /*** end of PackWriteBlock ***/
+
+
+/************************************************************************************//**
+** \brief     Closes the capture file, if it is open.
+**
+****************************************************************************************/
+static void PackCloseFile(void)
+{
+  if (packFd != PACK_INVALID_FD)
+  {
+    close(packFd);
+    packFd = PACK_INVALID_FD;
+  }
+} /*** end of PackCloseFile ***/
+
+
+/************************************************************************************//**
+** \brief     Stores a variable-length integer, seven bits per byte, least significant
+**            bits first. The highest bit of a byte is set if another byte follows.
+** \param     out Pointer to where the bytes are stored. Must have room for 10 bytes.
+** \param     value The value.
+** \return    Number of bytes stored.
+**
+****************************************************************************************/
+static size_t PackPutVarint(uint8_t * out, uint64_t value)
+{
+  size_t result = 0;
+
+  /* Store seven bits at a time. */
+  while (value >= 0x80U)
+  {
+    out[result++] = (uint8_t)(value | 0x80U);
+    value >>= 7;
+  }
+  out[result++] = (uint8_t)value;
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackPutVarint ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains a variable-length integer.
+** \param     in Pointer to the bytes.
+** \param     size Number of bytes that are available at the pointer.
+** \param     value Pointer to where the value is stored.
+** \return    Number of bytes used, or 0 if the available bytes do not hold a complete
+**            variable-length integer.
+**
+****************************************************************************************/
+static size_t PackGetVarint(uint8_t const * in, size_t size, uint64_t * value)
+{
+  size_t result = 0;
+  size_t idx = 0;
+  uint64_t collected = 0;
+
+  /* Collect seven bits at a time, until the last byte. At most 10 bytes. */
+  while ( (result == 0) && (idx < size) && (idx < 10U) )
+  {
+    collected |= (uint64_t)(in[idx] & 0x7FU) << (7U * idx);
+    if ((in[idx] & 0x80U) == 0)
+    {
+      result = idx + 1U;
+    }
+    idx++;
+  }
+  *value = collected;
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackGetVarint ***/
+
+
+/************************************************************************************//**
+** \brief     Adds an entry to the dictionary. The dictionary must not be full.
+** \param     codec Pointer to the encoder or decoder state.
+** \param     key CAN identifier, with bit 31 set for a 29-bit one.
+** \param     timestamp Timestamp that the first CAN message with this identifier is
+**            stored relative to.
+** \return    Pointer to the new entry.
+**
+****************************************************************************************/
+static tPackEntry * PackAddEntry(tPackCodec * codec, uint32_t key, uint64_t timestamp)
+{
+  tPackEntry * result = &codec->entries[codec->count++];
+
+  /* Start from the previous CAN message and all data bytes zero. */
+  result->key = key;
+  result->timestamp = timestamp;
+  result->delta = 0;
+  memset(result->data, 0, sizeof(result->data));
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackAddEntry ***/
+
+
+/*********************************** end of pack.c *************************************/
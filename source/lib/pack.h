@@ -0,0 +1,183 @@
+/************************************************************************************//**
+* \file         pack.h
+* \brief        Compressed capture file header file.
+*
+****************************************************************************************/
+#ifndef PACK_H
+#define PACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <stdio.h>                          /* for standard input/output functions     */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of CAN messages that the queue between the CAN event thread and the
+ *  encoder thread can hold. CAN messages that do not fit anymore are dropped and counted.
+ *  Must be a power of two.
+ */
+#ifndef PACK_QUEUE_SIZE
+#define PACK_QUEUE_SIZE                (65536U)
+#endif
+
+/** \brief Size in bytes of the block that the encoder thread fills, before writing it to
+ *  the capture file with one system call.
+ */
+#ifndef PACK_BLOCK_SIZE
+#define PACK_BLOCK_SIZE                (256U * 1024U)
+#endif
+
+/** \brief Maximum time in milliseconds that a CAN message waits in the queue, before the
+ *  encoder thread writes it to the capture file.
+ */
+#ifndef PACK_FLUSH_INTERVAL
+#define PACK_FLUSH_INTERVAL            (250U)
+#endif
+
+/** \brief Number of CAN identifiers in the dictionary. Once it is full, the dictionary
+ *  starts over.
+ */
+#define PACK_DICTIONARY_SIZE           (4096U)
+
+/** \brief Number of slots in the hash table of the encoder that finds the dictionary
+ *  entry of a CAN identifier. Must be a power of two and larger than the dictionary.
+ */
+#define PACK_HASH_SIZE                 (2U * PACK_DICTIONARY_SIZE)
+
+/** \brief Maximum number of bytes of one encoded CAN message, including a reset byte. */
+#define PACK_RECORD_MAX                (32U)
+
+/** \brief Magic value at the start of each capture file. */
+#define PACK_MAGIC                     "CAPLNPCK"
+
+/** \brief Version of the capture file format. */
+#define PACK_VERSION                   (1U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Header at the start of each compressed capture file. All fields are in the
+ *  byte order of the host. The encoded CAN messages follow it.
+ */
+typedef struct
+{
+  /** \brief Magic value PACK_MAGIC, without string termination. */
+  char     magic[8];
+  /** \brief Version of the capture file format, PACK_VERSION. */
+  uint16_t version;
+  /** \brief Bus number of the CAN messages. */
+  uint8_t  bus;
+  /** \brief Reserved for future use. Always zero. */
+  uint8_t  reserved[5];
+  /** \brief System time in microseconds, to which the timestamps are relative. */
+  uint64_t startTime;
+} tPackFileHeader;
+
+/** \brief State of a CAN identifier in the dictionary. Encoder and decoder keep the same
+ *  state, so each CAN message only needs to store what changed.
+ */
+typedef struct
+{
+  /** \brief Timestamp of the previous CAN message with this identifier. */
+  uint64_t timestamp;
+  /** \brief Time between the previous two CAN messages with this identifier. */
+  int64_t  delta;
+  /** \brief Data bytes of the previous CAN message with this identifier. */
+  uint8_t  data[CAN_DATA_LEN_MAX];
+  /** \brief CAN identifier, with bit 31 set for a 29-bit one. */
+  uint32_t key;
+} tPackEntry;
+
+/** \brief State of an encoder or decoder. */
+typedef struct
+{
+  /** \brief Dictionary of the CAN identifiers. */
+  tPackEntry entries[PACK_DICTIONARY_SIZE];
+  /** \brief Number of entries in the dictionary. */
+  size_t     count;
+  /** \brief Timestamp of the previous CAN message. */
+  uint64_t   timestamp;
+  /** \brief Hash table with the dictionary index plus one of each key. Zero for an
+   *  empty slot. Only used by the encoder.
+   */
+  uint16_t   hash[PACK_HASH_SIZE];
+} tPackCodec;
+
+/** \brief Reader of a compressed capture file. */
+typedef struct
+{
+  /** \brief The opened capture file. */
+  FILE       * file;
+  /** \brief Header of the capture file. */
+  tPackFileHeader header;
+  /** \brief Decoder state. */
+  tPackCodec   codec;
+  /** \brief Read buffer. */
+  uint8_t      buffer[PACK_BLOCK_SIZE];
+  /** \brief Offset of the next encoded CAN message in the read buffer. */
+  size_t       offset;
+  /** \brief Number of bytes in the read buffer. */
+  size_t       size;
+} tPackReader;
+
+/** \brief Configuration of the compressed capture writer. */
+typedef struct
+{
+  /** \brief Path of the capture file. An existing file is overwritten. */
+  char const * path;
+  /** \brief Bus number that is stored in the file header. */
+  uint8_t      bus;
+  /** \brief True to also capture the transmitted CAN messages. */
+  bool         logTransmitted;
+} tPackConfig;
+
+/** \brief Compressed capture writer statistics. */
+typedef struct
+{
+  /** \brief Number of CAN messages that were queued for writing. */
+  uint64_t queued;
+  /** \brief Number of CAN messages that were dropped, because the queue was full. */
+  uint64_t dropped;
+  /** \brief Number of CAN messages that were written to the capture file. */
+  uint64_t written;
+  /** \brief Number of CAN messages that were lost, because writing them failed. */
+  uint64_t writeErrors;
+  /** \brief Number of bytes that the CAN messages take up in the capture file. */
+  uint64_t bytes;
+  /** \brief Highest number of CAN messages that were queued at the same time. */
+  size_t   highWater;
+} tPackStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void   PackInit(void);
+void   PackTerminate(void);
+bool   PackStart(tPackConfig const * config);
+void   PackStop(void);
+bool   PackMessage(tCanMsg const * msg, bool transmitted);
+void   PackGetStats(tPackStats * stats);
+void   PackCodecReset(tPackCodec * codec);
+size_t PackEncode(tPackCodec * codec, tLoggerRecord const * record, uint8_t * out);
+size_t PackDecode(tPackCodec * codec, uint8_t const * in, size_t size,
+                  tLoggerRecord * record);
+bool   PackReaderOpen(tPackReader * reader, char const * path);
+bool   PackReaderRead(tPackReader * reader, tLoggerRecord * record);
+void   PackReaderClose(tPackReader * reader);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACK_H */
+/*********************************** end of pack.h *************************************/
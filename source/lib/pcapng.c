@@ -0,0 +1,507 @@
+/************************************************************************************//**
+* \file         pcapng.c
+* \brief        Asynchronous pcapng capture writer source file.
+* \details      Writes the CAN messages to a capture file in the pcapng format, which
+*               Wireshark and tcpdump open directly. Each CAN bus gets an interface
+*               description block with the SocketCAN link type and nanosecond timestamp
+*               resolution. Each CAN message becomes an enhanced packet block with the
+*               SocketCAN frame and a direction flag.
+*
+*               Just like the logger, it builds on the asynchronous record writer, so the
+*               thread that reports a CAN message never blocks. The writer thread converts
+*               the records to packet blocks, collects them into large blocks and writes
+*               each block with one system call. This avoids running candump next to the
+*               application, which receives every CAN frame a second time through its
+*               own socket.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <time.h>                           /* Date and time utilities                 */
+#include <fcntl.h>                          /* File control options                    */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <arpa/inet.h>                      /* Byte order conversion                   */
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+#include "pcapng.h"                         /* Asynchronous pcapng capture writer      */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define PCAPNG_INVALID_FD              (-1)
+
+/** \brief Block types. */
+#define PCAPNG_BLOCK_SECTION_HEADER    (0x0A0D0D0AU)
+#define PCAPNG_BLOCK_INTERFACE         (0x00000001U)
+#define PCAPNG_BLOCK_ENHANCED_PACKET   (0x00000006U)
+
+/** \brief Value that tells the byte order of the section. */
+#define PCAPNG_BYTE_ORDER_MAGIC        (0x1A2B3C4DU)
+
+/** \brief Option codes. */
+#define PCAPNG_OPT_ENDOFOPT            (0U)
+#define PCAPNG_OPT_SHB_USERAPPL        (4U)
+#define PCAPNG_OPT_IF_NAME             (2U)
+#define PCAPNG_OPT_IF_TSRESOL          (9U)
+#define PCAPNG_OPT_EPB_FLAGS           (2U)
+
+/** \brief Direction bits of the packet flags. */
+#define PCAPNG_FLAGS_INBOUND           (0x00000001U)
+#define PCAPNG_FLAGS_OUTBOUND          (0x00000002U)
+
+/** \brief Maximum size of a section header or interface description block. */
+#define PCAPNG_HEADER_BLOCK_MAX        (64U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enhanced packet block with one CAN frame, the packet flags option and the end
+ *  of options. All CAN frames have the same size, so all packet blocks too.
+ */
+typedef struct
+{
+  uint32_t type;
+  uint32_t length;
+  uint32_t interfaceId;
+  uint32_t timestampHigh;
+  uint32_t timestampLow;
+  uint32_t capturedLength;
+  uint32_t originalLength;
+  /** \brief CAN frame in the SocketCAN format. Its identifier is big endian. */
+  uint32_t canId;
+  uint8_t  canLen;
+  uint8_t  canReserved[3];
+  uint8_t  canData[CAN_DATA_LEN_MAX];
+  /** \brief Packet flags option. */
+  uint16_t flagsCode;
+  uint16_t flagsLength;
+  uint32_t flags;
+  /** \brief End of options. */
+  uint32_t endOfOptions;
+  uint32_t lengthTrailer;
+} tPcapngPacketBlock;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void   PcapngCollect(tLoggerRecord const * record);
+static void   PcapngWriteBlock(void);
+static void   PcapngCloseFile(void);
+static bool   PcapngWriteHeader(tPcapngConfig const * config);
+static size_t PcapngAddOption(uint8_t * block, size_t size, uint16_t code,
+                              void const * value, uint16_t length);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Configuration of the asynchronous record writer. */
+static tWriterConfig const pcapngWriterConfig =
+{
+  .queueSize = PCAPNG_QUEUE_SIZE,
+  .wakeCount = PCAPNG_BLOCK_PACKETS,
+  .flushInterval = PCAPNG_FLUSH_INTERVAL,
+  .recordFcn = PcapngCollect,
+  .flushFcn = PcapngWriteBlock,
+  .closeFcn = PcapngCloseFile
+};
+
+/** \brief Asynchronous record writer with the queue and the writer thread. The
+ *  timestamps of its records are absolute and the bus holds the interface number.
+ */
+static tWriter pcapngWriter;
+
+/** \brief Number of interfaces in the capture file. */
+static size_t pcapngInterfaceCount;
+
+/** \brief True to also capture the transmitted CAN messages. */
+static bool pcapngLogTransmitted;
+
+/** \brief Block with the packets that the writer thread collected. */
+static tPcapngPacketBlock pcapngBlock[PCAPNG_BLOCK_PACKETS];
+
+/** \brief Number of packets in the block. */
+static size_t pcapngBlockCount;
+
+/** \brief File descriptor of the capture file. Only used by the writer thread, once it
+ *  runs.
+ */
+static int pcapngFd;
+
+/** \brief Counters that the writer thread updates. */
+static atomic_uint_fast64_t pcapngWritten;
+static atomic_uint_fast64_t pcapngWriteErrors;
+
+
+/************************************************************************************//**
+** \brief     Initializes the pcapng capture writer. Capturing does not start until
+**            PcapngStart() is called.
+**
+****************************************************************************************/
+void PcapngInit(void)
+{
+  /* Initialize locals. */
+  atomic_init(&pcapngWritten, 0);
+  atomic_init(&pcapngWriteErrors, 0);
+  pcapngInterfaceCount = 0;
+  pcapngLogTransmitted = false;
+  pcapngBlockCount = 0;
+  pcapngFd = PCAPNG_INVALID_FD;
+  WriterInit(&pcapngWriter, &pcapngWriterConfig);
+} /*** end of PcapngInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the pcapng capture writer. Stops capturing, in case it still
+**            runs.
+**
+****************************************************************************************/
+void PcapngTerminate(void)
+{
+  /* Stop capturing and release the writer. */
+  WriterTerminate(&pcapngWriter);
+} /*** end of PcapngTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Creates the capture file and starts capturing the CAN messages to it. Call
+**            it from OnPreStart to capture all CAN messages from the start.
+** \param     config Pointer to the configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool PcapngStart(tPcapngConfig const * config)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter and when not yet running. */
+  if ( (config != NULL) && (config->path != NULL) && (!WriterRunning(&pcapngWriter)) &&
+       (config->interfaceCount <= PCAPNG_INTERFACES_MAX) &&
+       ( (config->interfaces != NULL) || (config->interfaceCount == 0) ) )
+  {
+    /* Create the capture file and write the section header and the interfaces. */
+    pcapngFd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if ( (pcapngFd != PCAPNG_INVALID_FD) && (!PcapngWriteHeader(config)) )
+    {
+      PcapngCloseFile();
+    }
+
+    if (pcapngFd != PCAPNG_INVALID_FD)
+    {
+      pcapngInterfaceCount = (config->interfaceCount > 0) ? config->interfaceCount : 1U;
+      pcapngLogTransmitted = config->logTransmitted;
+      /* Start the writer thread, which closes the capture file once it stops. */
+      pcapngBlockCount = 0;
+      result = WriterStart(&pcapngWriter);
+      if (!result)
+      {
+        PcapngCloseFile();
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PcapngStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops capturing. The writer thread writes all queued CAN messages, before
+**            the capture file is closed.
+**
+****************************************************************************************/
+void PcapngStop(void)
+{
+  /* Stop the writer thread. */
+  WriterStop(&pcapngWriter);
+} /*** end of PcapngStop ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a CAN message of the first CAN bus for capturing. Never blocks. Can
+**            be called from any thread.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if the CAN message was queued, false otherwise.
+**
+****************************************************************************************/
+bool PcapngMessage(tCanMsg const * msg, bool transmitted)
+{
+  /* Give the result back to the caller. */
+  return PcapngBusMessage(0, msg, transmitted);
+} /*** end of PcapngMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a CAN message for capturing. Never blocks. Can be called from any
+**            thread.
+** \param     bus Bus number, which is the index of the interface in the configuration.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if the CAN message was queued, false if the writer does not run, is
+**            not configured to capture transmitted CAN messages or for this bus, or its
+**            queue is full.
+**
+****************************************************************************************/
+bool PcapngBusMessage(uint8_t bus, tCanMsg const * msg, bool transmitted)
+{
+  bool result = false;
+  tLoggerRecord record;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when running. */
+  if ( (msg != NULL) && (WriterRunning(&pcapngWriter)) &&
+       (bus < pcapngInterfaceCount) && ( (!transmitted) || (pcapngLogTransmitted) ) )
+  {
+    /* Convert the CAN message to a record. The timestamp is made absolute here, because
+     * the start time is reset once the CAN driver disconnects.
+     */
+    WriterMakeRecord(&record, msg, transmitted);
+    record.timestamp = CanStartTime() + msg->timestamp;
+    record.bus = bus;
+    /* Queue the record. */
+    result = WriterPush(&pcapngWriter, &record);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PcapngBusMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the pcapng capture writer statistics. Can be called from any
+**            thread.
+** \param     stats Pointer to where the statistics are stored.
+**
+****************************************************************************************/
+void PcapngGetStats(tPcapngStats * stats)
+{
+  tWriterStats writerStats;
+
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    WriterGetStats(&pcapngWriter, &writerStats);
+    stats->queued = writerStats.queued;
+    stats->dropped = writerStats.dropped;
+    stats->written = atomic_load(&pcapngWritten);
+    stats->writeErrors = atomic_load(&pcapngWriteErrors);
+    stats->highWater = writerStats.highWater;
+  }
+} /*** end of PcapngGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a record to a packet block and adds it to the block. Writes the
+**            block as soon as it is complete. Called by the writer thread for each
+**            queued record.
+** \param     record Pointer to the record.
+**
+****************************************************************************************/
+static void PcapngCollect(tLoggerRecord const * record)
+{
+  tPcapngPacketBlock * packet;
+  uint64_t timestamp;
+
+  /* Convert the record to a packet block. */
+  packet = &pcapngBlock[pcapngBlockCount];
+  timestamp = record->timestamp * 1000U;
+  packet->type = PCAPNG_BLOCK_ENHANCED_PACKET;
+  packet->length = sizeof(tPcapngPacketBlock);
+  packet->interfaceId = record->bus;
+  packet->timestampHigh = (uint32_t)(timestamp >> 32);
+  packet->timestampLow = (uint32_t)timestamp;
+  packet->capturedLength = sizeof(struct can_frame);
+  packet->originalLength = sizeof(struct can_frame);
+  packet->canId = htonl(((record->flags & LOGGER_FLAG_EXT) != 0) ?
+                        ((record->id & CAN_EFF_MASK) | CAN_EFF_FLAG) :
+                        (record->id & CAN_SFF_MASK));
+  packet->canLen = record->len;
+  memset(packet->canReserved, 0, sizeof(packet->canReserved));
+  memcpy(packet->canData, record->data, sizeof(packet->canData));
+  packet->flagsCode = PCAPNG_OPT_EPB_FLAGS;
+  packet->flagsLength = sizeof(packet->flags);
+  packet->flags = ((record->flags & LOGGER_FLAG_TX) != 0) ? PCAPNG_FLAGS_OUTBOUND :
+                                                          PCAPNG_FLAGS_INBOUND;
+  packet->endOfOptions = PCAPNG_OPT_ENDOFOPT;
+  packet->lengthTrailer = sizeof(tPcapngPacketBlock);
+  /* Write the block as soon as it is complete. */
+  if (++pcapngBlockCount == PCAPNG_BLOCK_PACKETS)
+  {
+    PcapngWriteBlock();
+  }
+} /*** end of PcapngCollect ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the collected packets to the capture file. Called by the writer
+**            thread once the queue is empty.
+**
+****************************************************************************************/
+static void PcapngWriteBlock(void)
+{
+  /* Only continue if there is something to write. */
+  if (pcapngBlockCount > 0)
+  {
+    if (UtilWriteAll(pcapngFd, pcapngBlock,
+                     pcapngBlockCount * sizeof(tPcapngPacketBlock)))
+    {
+      atomic_fetch_add(&pcapngWritten, pcapngBlockCount);
+    }
+    else
+    {
+      atomic_fetch_add(&pcapngWriteErrors, pcapngBlockCount);
+    }
+    /* The block is empty again. */
+    pcapngBlockCount = 0;
+  }
+} /*** end of PcapngWriteBlock ***/
+
+
+/************************************************************************************//**
+** \brief     Closes the capture file, if it is open.
+**
+****************************************************************************************/
+static void PcapngCloseFile(void)
+{
+  if (pcapngFd != PCAPNG_INVALID_FD)
+  {
+    close(pcapngFd);
+    pcapngFd = PCAPNG_INVALID_FD;
+  }
+} /*** end of PcapngCloseFile ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the section header block and an interface description block for
+**            each CAN bus to the capture file.
+** \param     config Pointer to the configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool PcapngWriteHeader(tPcapngConfig const * config)
+{
+  bool result = false;
+  uint8_t block[PCAPNG_HEADER_BLOCK_MAX];
+  size_t size;
+  uint32_t value32;
+  uint16_t value16;
+  int64_t sectionLength = -1;
+  uint8_t resolution = 9;
+  char const * name;
+  size_t count = (config->interfaceCount > 0) ? config->interfaceCount : 1U;
+  static char const application[] = "CAPLin";
+
+  /* Section header block, with the byte order and an unknown section length. */
+  value32 = PCAPNG_BLOCK_SECTION_HEADER;
+  memcpy(&block[0], &value32, sizeof(value32));
+  value32 = PCAPNG_BYTE_ORDER_MAGIC;
+  memcpy(&block[8], &value32, sizeof(value32));
+  value16 = 1U;
+  memcpy(&block[12], &value16, sizeof(value16));
+  value16 = 0U;
+  memcpy(&block[14], &value16, sizeof(value16));
+  memcpy(&block[16], &sectionLength, sizeof(sectionLength));
+  size = PcapngAddOption(block, 24U, PCAPNG_OPT_SHB_USERAPPL, application,
+                         sizeof(application) - 1U);
+  size = PcapngAddOption(block, size, PCAPNG_OPT_ENDOFOPT, NULL, 0U);
+  value32 = (uint32_t)size + 4U;
+  memcpy(&block[4], &value32, sizeof(value32));
+  memcpy(&block[size], &value32, sizeof(value32));
+  result = UtilWriteAll(pcapngFd, block, size + 4U);
+
+  /* Interface description block for each CAN bus, with its name and nanosecond
+   * timestamp resolution.
+   */
+  for (size_t idx = 0; (idx < count) && (result); idx++)
+  {
+    name = (config->interfaceCount > 0) ? config->interfaces[idx] : NULL;
+    if (name == NULL)
+    {
+      name = "can0";
+    }
+    value32 = PCAPNG_BLOCK_INTERFACE;
+    memcpy(&block[0], &value32, sizeof(value32));
+    value16 = PCAPNG_LINKTYPE_CAN_SOCKETCAN;
+    memcpy(&block[8], &value16, sizeof(value16));
+    value16 = 0U;
+    memcpy(&block[10], &value16, sizeof(value16));
+    value32 = sizeof(struct can_frame);
+    memcpy(&block[12], &value32, sizeof(value32));
+    size = PcapngAddOption(block, 16U, PCAPNG_OPT_IF_NAME, name,
+                           (uint16_t)strnlen(name, PCAPNG_INTERFACE_NAME_MAX - 1U));
+    size = PcapngAddOption(block, size, PCAPNG_OPT_IF_TSRESOL, &resolution,
+                           sizeof(resolution));
+    size = PcapngAddOption(block, size, PCAPNG_OPT_ENDOFOPT, NULL, 0U);
+    value32 = (uint32_t)size + 4U;
+    memcpy(&block[4], &value32, sizeof(value32));
+    memcpy(&block[size], &value32, sizeof(value32));
+    result = UtilWriteAll(pcapngFd, block, size + 4U);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PcapngWriteHeader ***/
+
+
+/************************************************************************************//**
+** \brief     Adds an option to a block that is being constructed. The option value is
+**            padded to a multiple of 4 bytes.
+** \param     block Pointer to the block.
+** \param     size Current size of the block in bytes.
+** \param     code Option code.
+** \param     value Pointer to the option value, or NULL if it has none.
+** \param     length Length of the option value in bytes.
+** \return    New size of the block in bytes.
+**
+****************************************************************************************/
+static size_t PcapngAddOption(uint8_t * block, size_t size, uint16_t code,
+                              void const * value, uint16_t length)
+{
+  size_t padded = ((size_t)length + 3U) & ~(size_t)3U;
+
+  /* The block must have room for the option and the trailing block length. */
+  assert((size + 4U + padded + 4U) <= PCAPNG_HEADER_BLOCK_MAX);
+
+  /* Add the option code, the length and the padded value. */
+  memcpy(&block[size], &code, sizeof(code));
+  memcpy(&block[size + 2U], &length, sizeof(length));
+  memset(&block[size + 4U], 0, padded);
+  if (value != NULL)
+  {
+    memcpy(&block[size + 4U], value, length);
+  }
+
+  /* Give the result back to the caller. */
+  return size + 4U + padded;
+} /*** end of PcapngAddOption ***/
+
+
+/*********************************** end of pcapng.c ***********************************/
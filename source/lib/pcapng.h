@@ -0,0 +1,99 @@
+/************************************************************************************//**
+* \file         pcapng.h
+* \brief        Asynchronous pcapng capture writer header file.
+*
+****************************************************************************************/
+#ifndef PCAPNG_H
+#define PCAPNG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of CAN messages that the queue between the CAN event thread and the
+ *  writer thread can hold. CAN messages that do not fit anymore are dropped and counted.
+ *  Must be a power of two.
+ */
+#ifndef PCAPNG_QUEUE_SIZE
+#define PCAPNG_QUEUE_SIZE              (65536U)
+#endif
+
+/** \brief Number of packets that the writer thread collects, before writing them to the
+ *  capture file with one system call.
+ */
+#ifndef PCAPNG_BLOCK_PACKETS
+#define PCAPNG_BLOCK_PACKETS           (8192U)
+#endif
+
+/** \brief Maximum time in milliseconds that a CAN message waits in the queue, before the
+ *  writer thread writes it to the capture file.
+ */
+#ifndef PCAPNG_FLUSH_INTERVAL
+#define PCAPNG_FLUSH_INTERVAL          (250U)
+#endif
+
+/** \brief Maximum number of interfaces, one for each CAN bus. */
+#define PCAPNG_INTERFACES_MAX          (8U)
+
+/** \brief Maximum length of an interface name, including the string termination. */
+#define PCAPNG_INTERFACE_NAME_MAX      (16U)
+
+/** \brief Link type for CAN frames in the SocketCAN format. */
+#define PCAPNG_LINKTYPE_CAN_SOCKETCAN  (227U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Configuration of the pcapng capture writer. */
+typedef struct
+{
+  /** \brief Path of the capture file. An existing file is overwritten. */
+  char const *         path;
+  /** \brief Names of the interfaces, one for each CAN bus. The bus number of a CAN
+   *  message is the index in this array. NULL for one interface, named "can0".
+   */
+  char const * const * interfaces;
+  /** \brief Number of interfaces, at most PCAPNG_INTERFACES_MAX. */
+  size_t               interfaceCount;
+  /** \brief True to also capture the transmitted CAN messages. */
+  bool                 logTransmitted;
+} tPcapngConfig;
+
+/** \brief Pcapng capture writer statistics. */
+typedef struct
+{
+  /** \brief Number of CAN messages that were queued for writing. */
+  uint64_t queued;
+  /** \brief Number of CAN messages that were dropped, because the queue was full. */
+  uint64_t dropped;
+  /** \brief Number of packets that were written to the capture file. */
+  uint64_t written;
+  /** \brief Number of packets that were lost, because writing them failed. */
+  uint64_t writeErrors;
+  /** \brief Highest number of CAN messages that were queued at the same time. */
+  size_t   highWater;
+} tPcapngStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void PcapngInit(void);
+void PcapngTerminate(void);
+bool PcapngStart(tPcapngConfig const * config);
+void PcapngStop(void);
+bool PcapngMessage(tCanMsg const * msg, bool transmitted);
+bool PcapngBusMessage(uint8_t bus, tCanMsg const * msg, bool transmitted);
+void PcapngGetStats(tPcapngStats * stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCAPNG_H */
+/*********************************** end of pcapng.h ***********************************/
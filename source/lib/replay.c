@@ -0,0 +1,592 @@
+/************************************************************************************//**
+* \file         replay.c
+* \brief        Log file replay source file.
+* \details      Replays a log file on the CAN bus, for example to reproduce traffic that
+*               was captured in the field on the bench. A replay thread reads the CAN
+*               messages from the log file and transmits them with the original gaps in
+*               between, optionally sped up or slowed down. Each CAN message has an
+*               absolute deadline, relative to the start of the replay, so timing errors
+*               do not add up. The thread sleeps until shortly before the deadline and
+*               spins for the remaining time, because a sleep alone is not more accurate
+*               than the wake-up latency of the system.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <time.h>                           /* Date and time utilities                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "loop.h"                           /* Event loop driver                       */
+#include "format.h"                         /* CAN message text formatter              */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "replay.h"                         /* Log file replay                         */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Size of the read buffer of a log file. */
+#define REPLAY_READ_BUFFER_SIZE        (1024U * 1024U)
+
+/** \brief Longest time in nanoseconds that the replay thread sleeps in one go, so it
+ *  notices a stop request in time.
+ */
+#define REPLAY_SLEEP_MAX               (100000000LL)
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Configuration of the running replay. The filters point to replayFilters. */
+static tReplayConfig replayConfig;
+
+/** \brief Copy of the acceptance filters. */
+static tCanFilter replayFilters[CAN_FILTERS_MAX];
+
+/** \brief The log file that is replayed. */
+static tReplayFile replayFile;
+
+/** \brief Results of the last replay. */
+static tReplayReport replayReport;
+
+/** \brief Identifier of the replay thread. */
+static thrd_t replayThreadId;
+
+/** \brief Boolean flag to determine if the replay thread was started and not yet
+ *  joined.
+ */
+static bool replayThreadStarted;
+
+/** \brief Set while the replay thread runs. */
+static atomic_bool replayRunning;
+
+/** \brief Atomic boolean that is used to inform the replay thread to stop running. */
+static atomic_bool replayStopThread;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static int     ReplayThread(void * param);
+static bool    ReplayAccept(tCanMsg const * msg);
+static bool    ReplayWaitUntil(int64_t deadline);
+static int64_t ReplayNow(void);
+
+
+/************************************************************************************//**
+** \brief     Initializes the replay module.
+**
+****************************************************************************************/
+void ReplayInit(void)
+{
+  /* Initialize locals. */
+  replayThreadStarted = false;
+  replayFile.file = NULL;
+  atomic_init(&replayRunning, false);
+  atomic_init(&replayStopThread, false);
+  memset(&replayReport, 0, sizeof(replayReport));
+} /*** end of ReplayInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the replay module. Stops the replay, in case it still runs.
+**
+****************************************************************************************/
+void ReplayTerminate(void)
+{
+  /* Stop the replay. */
+  ReplayStop();
+} /*** end of ReplayTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts replaying a log file on the CAN bus. The transform hook and the done
+**            callback are called from the replay thread. Not available in single-
+**            threaded mode, because the replay needs its own thread for accurate timing.
+** \param     config Pointer to the replay configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool ReplayStart(tReplayConfig const * config)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter, when not running in single-threaded mode and
+   * when no other replay is in progress.
+   */
+  if ( (config != NULL) && (config->path != NULL) &&
+       ( (config->speed == 0) || (config->speed >= REPLAY_SPEED_MIN) ) &&
+       (config->filterCount <= CAN_FILTERS_MAX) &&
+       ( (config->filterCount == 0) || (config->filters != NULL) ) &&
+       (!LoopSingleThreaded()) && (!atomic_load(&replayRunning)) )
+  {
+    /* Join the thread of the previous replay, which finished by itself. */
+    ReplayStop();
+
+    /* Store the configuration. */
+    replayConfig = *config;
+    if (config->filterCount > 0)
+    {
+      memcpy(replayFilters, config->filters, config->filterCount * sizeof(tCanFilter));
+    }
+    replayConfig.filters = replayFilters;
+
+    /* Open the log file and start the replay thread. */
+    if (ReplayFileOpen(&replayFile, config->path))
+    {
+      atomic_store(&replayStopThread, false);
+      atomic_store(&replayRunning, true);
+      if (thrd_create(&replayThreadId, ReplayThread, NULL) == thrd_success)
+      {
+        replayThreadStarted = true;
+        result = true;
+      }
+      else
+      {
+        atomic_store(&replayRunning, false);
+        ReplayFileClose(&replayFile);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops the replay and waits until the replay thread terminated. The done
+**            callback still receives the results.
+**
+****************************************************************************************/
+void ReplayStop(void)
+{
+  /* Only continue if the replay thread was started. */
+  if (replayThreadStarted)
+  {
+    atomic_store(&replayStopThread, true);
+    thrd_join(replayThreadId, NULL);
+    replayThreadStarted = false;
+  }
+} /*** end of ReplayStop ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if a replay is in progress.
+** \return    True if a replay is in progress, false otherwise.
+**
+****************************************************************************************/
+bool ReplayRunning(void)
+{
+  /* Give the result back to the caller. */
+  return atomic_load(&replayRunning);
+} /*** end of ReplayRunning ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the results of the last replay.
+** \param     report Pointer to where the results are stored.
+** \return    True if successful, false if a replay is still in progress.
+**
+****************************************************************************************/
+bool ReplayGetReport(tReplayReport * report)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(report != NULL);
+
+  /* Only continue with valid parameter and when no replay is in progress. */
+  if ( (report != NULL) && (!atomic_load(&replayRunning)) )
+  {
+    *report = replayReport;
+    result = true;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayGetReport ***/
+
+
+/************************************************************************************//**
+** \brief     Opens a log file for reading. The type of log file is detected from its
+**            contents.
+** \param     file Pointer to the log file reader.
+** \param     path Path of the log file.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool ReplayFileOpen(tReplayFile * file, char const * path)
+{
+  bool result = false;
+  tLoggerFileHeader header;
+
+  /* Verify parameters. */
+  assert(file != NULL);
+  assert(path != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (file != NULL) && (path != NULL) )
+  {
+    file->file = fopen(path, "rb");
+    if (file->file != NULL)
+    {
+      /* Read in large blocks. Log files can be huge. */
+      (void)setvbuf(file->file, NULL, _IOFBF, REPLAY_READ_BUFFER_SIZE);
+      /* A binary log file starts with the header of the logger. */
+      file->binary = false;
+      file->dataOffset = 0;
+      if ( (fread(&header, sizeof(header), 1, file->file) == 1) &&
+           (memcmp(header.magic, LOGGER_MAGIC, sizeof(header.magic)) == 0) )
+      {
+        if ( (header.version == LOGGER_VERSION) &&
+             (header.recordSize == sizeof(tLoggerRecord)) )
+        {
+          file->binary = true;
+          file->dataOffset = (long)sizeof(header);
+          result = true;
+        }
+      }
+      else
+      {
+        result = true;
+      }
+      /* Position at the first CAN message. */
+      if ( (!result) || (fseek(file->file, file->dataOffset, SEEK_SET) != 0) )
+      {
+        ReplayFileClose(file);
+        result = false;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayFileOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Reads the next CAN message from a log file. Lines of a text log file that
+**            do not hold a CAN message are skipped.
+** \param     file Pointer to the log file reader.
+** \param     msg Pointer to where the CAN message is stored.
+** \return    True if successful, false at the end of the log file.
+**
+****************************************************************************************/
+bool ReplayFileRead(tReplayFile * file, tCanMsg * msg)
+{
+  bool result = false;
+  tLoggerRecord record;
+  size_t len;
+
+  /* Verify parameters. */
+  assert(file != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters and an opened log file. */
+  if ( (file != NULL) && (msg != NULL) && (file->file != NULL) )
+  {
+    /* Binary log file. */
+    if (file->binary)
+    {
+      if (fread(&record, sizeof(record), 1, file->file) == 1)
+      {
+        msg->timestamp = record.timestamp;
+        msg->id = record.id;
+        msg->ext = ((record.flags & LOGGER_FLAG_EXT) != 0);
+        msg->len = (record.len <= CAN_DATA_LEN_MAX) ? record.len : CAN_DATA_LEN_MAX;
+        memcpy(msg->data, record.data, CAN_DATA_LEN_MAX);
+        result = true;
+      }
+    }
+    /* Text log file. */
+    else
+    {
+      while ( (!result) && (fgets(file->line, sizeof(file->line), file->file) != NULL) )
+      {
+        len = strlen(file->line);
+        /* Skip the rest of a line that was too long. */
+        if ( (len == (sizeof(file->line) - 1U)) && (file->line[len - 1U] != '\n') )
+        {
+          while ( (fgets(file->line, sizeof(file->line), file->file) != NULL) &&
+                  (file->line[strlen(file->line) - 1U] != '\n') )
+          {
+            ;
+          }
+          continue;
+        }
+        result = FormatParseMessage(file->line, msg);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayFileRead ***/
+
+
+/************************************************************************************//**
+** \brief     Continues reading a log file from its first CAN message.
+** \param     file Pointer to the log file reader.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool ReplayFileRewind(tReplayFile * file)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(file != NULL);
+
+  /* Only continue with valid parameter and an opened log file. */
+  if ( (file != NULL) && (file->file != NULL) )
+  {
+    result = (fseek(file->file, file->dataOffset, SEEK_SET) == 0);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayFileRewind ***/
+
+
+/************************************************************************************//**
+** \brief     Closes a log file.
+** \param     file Pointer to the log file reader.
+**
+****************************************************************************************/
+void ReplayFileClose(tReplayFile * file)
+{
+  /* Verify parameter. */
+  assert(file != NULL);
+
+  /* Only continue with valid parameter and an opened log file. */
+  if ( (file != NULL) && (file->file != NULL) )
+  {
+    fclose(file->file);
+    file->file = NULL;
+  }
+} /*** end of ReplayFileClose ***/
+
+
+/************************************************************************************//**
+** \brief     Replay thread that transmits the CAN messages of the log file.
+** \param     param Thread parameter (not used).
+** \return    Thread return value.
+**
+****************************************************************************************/
+static int ReplayThread(void * param)
+{
+  tCanMsg msg;
+  bool first = true;
+  uint64_t firstTimestamp = 0;
+  int64_t base = 0;
+  int64_t deadline;
+  int64_t error;
+  int64_t retryEnd;
+  uint64_t errorSum = 0;
+  uint64_t timedFrames = 0;
+  int64_t start = ReplayNow();
+  bool transmitted;
+
+  /* Reset the results. */
+  memset(&replayReport, 0, sizeof(replayReport));
+
+  /* Replay the log file the configured number of times, or until a stop is requested. */
+  while (!atomic_load(&replayStopThread))
+  {
+    /* Get the next CAN message. At the end of the log file, start over if configured. */
+    if (!ReplayFileRead(&replayFile, &msg))
+    {
+      replayReport.loops++;
+      if ( ( (replayConfig.loops != 0) && (replayReport.loops >= replayConfig.loops) ) ||
+           (!ReplayFileRewind(&replayFile)) || (first) )
+      {
+        break;
+      }
+      /* The next loop follows right away, with its own time base. */
+      first = true;
+      continue;
+    }
+    /* Apply the acceptance filters and the transform hook. The hook runs before the
+     * wait, so its run time does not affect the timing.
+     */
+    if ( (!ReplayAccept(&msg)) ||
+         ( (replayConfig.transformFcn != NULL) &&
+           (!replayConfig.transformFcn(&msg, replayConfig.context)) ) )
+    {
+      replayReport.skipped++;
+      continue;
+    }
+
+    /* Wait until the deadline of the CAN message, if not replaying at maximum speed.
+     * The first CAN message of each loop sets the time base.
+     */
+    if (first)
+    {
+      firstTimestamp = msg.timestamp;
+      base = ReplayNow();
+      first = false;
+    }
+    if (replayConfig.speed > 0)
+    {
+      deadline = base;
+      if (msg.timestamp > firstTimestamp)
+      {
+        deadline += (int64_t)((double)(msg.timestamp - firstTimestamp) * 1000.0 /
+                              replayConfig.speed);
+      }
+      if (!ReplayWaitUntil(deadline))
+      {
+        break;
+      }
+      /* Keep track of the timing error. */
+      error = ReplayNow() - deadline;
+      error = (error > 0) ? error : 0;
+      errorSum += (uint64_t)error;
+      timedFrames++;
+      if ((uint64_t)error > replayReport.maxError)
+      {
+        replayReport.maxError = (uint64_t)error;
+      }
+    }
+
+    /* Transmit the CAN message. Retry for a while, if the transmit queue is full. */
+    transmitted = CanTransmit(&msg);
+    retryEnd = ReplayNow() + ((int64_t)REPLAY_TX_RETRY_TIME * 1000);
+    while ( (!transmitted) && (ReplayNow() < retryEnd) &&
+            (!atomic_load(&replayStopThread)) )
+    {
+      UtilSleep(100);
+      transmitted = CanTransmit(&msg);
+    }
+    if (transmitted)
+    {
+      replayReport.frames++;
+    }
+    else
+    {
+      replayReport.errors++;
+    }
+  }
+
+  /* Complete the results. */
+  replayReport.duration = (uint64_t)((ReplayNow() - start) / 1000);
+  if (replayReport.duration > 0)
+  {
+    replayReport.rate = (double)replayReport.frames * 1000000.0 /
+                        (double)replayReport.duration;
+  }
+  if (timedFrames > 0)
+  {
+    replayReport.meanError = errorSum / timedFrames;
+  }
+  ReplayFileClose(&replayFile);
+  atomic_store(&replayRunning, false);
+
+  /* Pass on the results. */
+  if (replayConfig.doneFcn != NULL)
+  {
+    replayConfig.doneFcn(&replayReport, replayConfig.context);
+  }
+
+  /* Shut down the thread. */
+  thrd_exit(EXIT_SUCCESS);
+} /*** end of ReplayThread ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if a CAN message passes the configured acceptance filters.
+** \param     msg Pointer to the CAN message.
+** \return    True if it passes, false otherwise.
+**
+****************************************************************************************/
+static bool ReplayAccept(tCanMsg const * msg)
+{
+  bool result = (replayConfig.filterCount == 0);
+
+  /* Check the filters one-by-one, until one matches. */
+  for (size_t idx = 0; (idx < replayConfig.filterCount) && (!result); idx++)
+  {
+    result = CanFilterMatch(&replayFilters[idx], msg);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayAccept ***/
+
+
+/************************************************************************************//**
+** \brief     Waits until the deadline. Sleeps until REPLAY_SPIN_TIME before it and spins
+**            for the remaining time.
+** \param     deadline The deadline on the monotonic clock in nanoseconds.
+** \return    True if the deadline was reached, false if a stop was requested.
+**
+****************************************************************************************/
+static bool ReplayWaitUntil(int64_t deadline)
+{
+  bool result = true;
+  int64_t now = ReplayNow();
+  int64_t wake;
+  struct timespec wakeTime;
+
+  /* Sleep in steps, until it is time to spin. */
+  while ((deadline - now) > ((int64_t)REPLAY_SPIN_TIME * 1000))
+  {
+    if (atomic_load(&replayStopThread))
+    {
+      result = false;
+      break;
+    }
+    wake = deadline - ((int64_t)REPLAY_SPIN_TIME * 1000);
+    if ((wake - now) > REPLAY_SLEEP_MAX)
+    {
+      wake = now + REPLAY_SLEEP_MAX;
+    }
+    wakeTime.tv_sec = (time_t)(wake / 1000000000LL);
+    wakeTime.tv_nsec = (long)(wake % 1000000000LL);
+    (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL);
+    now = ReplayNow();
+  }
+  /* Spin for the remaining time. */
+  while ( (result) && (now < deadline) )
+  {
+    now = ReplayNow();
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ReplayWaitUntil ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time of the monotonic clock.
+** \return    Time in nanoseconds.
+**
+****************************************************************************************/
+static int64_t ReplayNow(void)
+{
+  struct timespec now;
+
+  /* Obtain the time. */
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+  /* Give the result back to the caller. */
+  return ((int64_t)now.tv_sec * 1000000000LL) + (int64_t)now.tv_nsec;
+} /*** end of ReplayNow ***/
+
+
+/*********************************** end of replay.c ***********************************/
@@ -0,0 +1,142 @@
+/************************************************************************************//**
+* \file         replay.h
+* \brief        Log file replay header file.
+*
+****************************************************************************************/
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <stdio.h>                          /* for standard input/output functions     */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Lowest speed multiplier, besides 0 for as fast as possible. */
+#define REPLAY_SPEED_MIN               (0.1)
+
+/** \brief Time in microseconds before a deadline, at which the replay thread stops
+ *  sleeping and spins until the deadline. The sleep itself is not more accurate than
+ *  the wake-up latency of the system.
+ */
+#ifndef REPLAY_SPIN_TIME
+#define REPLAY_SPIN_TIME               (100U)
+#endif
+
+/** \brief Time in microseconds that the transmission of a CAN message is retried, while
+ *  the transmit queue of the CAN interface is full.
+ */
+#ifndef REPLAY_TX_RETRY_TIME
+#define REPLAY_TX_RETRY_TIME           (10000U)
+#endif
+
+/** \brief Maximum length of a line in a text log file. Longer lines are skipped. */
+#define REPLAY_LINE_MAX                (256U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Reader for a log file. Reads binary log files of the logger and text log files
+ *  in any of the styles of the formatter, such as candump -L.
+ */
+typedef struct
+{
+  /** \brief The opened log file. */
+  FILE   * file;
+  /** \brief True for a binary log file of the logger. */
+  bool     binary;
+  /** \brief Offset of the first CAN message in the log file. */
+  long     dataOffset;
+  /** \brief Line buffer for text log files. */
+  char     line[REPLAY_LINE_MAX];
+} tReplayFile;
+
+/** \brief Function type of the transform hook. It can modify each CAN message before it
+ *  is transmitted. Return false to skip the CAN message.
+ */
+typedef bool (* tReplayTransformCallback)(tCanMsg * msg, void * context);
+
+/** \brief Results of a replay. Timing errors are measured between the moment at which a
+ *  CAN message should have been transmitted and the moment it was handed to the CAN
+ *  driver.
+ */
+typedef struct
+{
+  /** \brief Number of CAN messages that were transmitted. */
+  uint64_t frames;
+  /** \brief Number of CAN messages that were skipped by the filter or transform hook. */
+  uint64_t skipped;
+  /** \brief Number of CAN messages that could not be transmitted. */
+  uint64_t errors;
+  /** \brief Number of times the log file was replayed completely. */
+  uint32_t loops;
+  /** \brief Duration of the replay in microseconds. */
+  uint64_t duration;
+  /** \brief Achieved rate in CAN messages per second. */
+  double   rate;
+  /** \brief Average timing error in nanoseconds. Zero when replayed at maximum speed. */
+  uint64_t meanError;
+  /** \brief Largest timing error in nanoseconds. Zero when replayed at maximum speed. */
+  uint64_t maxError;
+} tReplayReport;
+
+/** \brief Function type of the callback that receives the results, once the replay
+ *  finished.
+ */
+typedef void (* tReplayDoneCallback)(tReplayReport const * report, void * context);
+
+/** \brief Configuration of a replay. */
+typedef struct
+{
+  /** \brief Path of the log file. */
+  char const * path;
+  /** \brief Speed multiplier. 1.0 keeps the original timing, 2.0 replays twice as fast
+   *  and 0 replays as fast as possible. Otherwise at least REPLAY_SPEED_MIN.
+   */
+  double speed;
+  /** \brief Array with acceptance filters. Only CAN messages that pass at least one of
+   *  them are replayed. NULL to replay all CAN messages.
+   */
+  tCanFilter const * filters;
+  /** \brief Number of acceptance filters, at most CAN_FILTERS_MAX. */
+  size_t filterCount;
+  /** \brief Number of times to replay the log file, or 0 to repeat until stopped. */
+  uint32_t loops;
+  /** \brief Optional transform hook, or NULL. */
+  tReplayTransformCallback transformFcn;
+  /** \brief Optional callback that receives the results, or NULL. */
+  tReplayDoneCallback doneFcn;
+  /** \brief Context pointer that is passed to the callbacks. */
+  void * context;
+} tReplayConfig;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void ReplayInit(void);
+void ReplayTerminate(void);
+bool ReplayStart(tReplayConfig const * config);
+void ReplayStop(void);
+bool ReplayRunning(void);
+bool ReplayGetReport(tReplayReport * report);
+bool ReplayFileOpen(tReplayFile * file, char const * path);
+bool ReplayFileRead(tReplayFile * file, tCanMsg * msg);
+bool ReplayFileRewind(tReplayFile * file);
+void ReplayFileClose(tReplayFile * file);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
+/*********************************** end of replay.h ***********************************/
@@ -0,0 +1,278 @@
+/************************************************************************************//**
+* \file         ring.c
+* \brief        Lock-free ring buffer source file.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Obtains a pointer to the sequence number of the cell at the specified
+ *  position.
+ */
+#define RING_CELL_SEQ(ring, pos)   \
+  ((atomic_size_t *)&(ring)->cells[((pos) & (ring)->mask) * (ring)->cellSize])
+
+/** \brief Obtains a pointer to the element of the cell at the specified position. */
+#define RING_CELL_ELEM(ring, pos)  \
+  (&(ring)->cells[(((pos) & (ring)->mask) * (ring)->cellSize) + sizeof(atomic_size_t)])
+
+
+/************************************************************************************//**
+** \brief     Initializes the ring buffer. Allocates the memory for all its cells, so
+**            pushing and popping elements never needs to allocate memory.
+** \param     ring Pointer to the ring buffer.
+** \param     elemSize Size of one element in bytes.
+** \param     capacity Maximum number of elements. Rounded up to a power of two.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool RingInit(tRing * ring, size_t elemSize, size_t capacity)
+{
+  bool result = false;
+  size_t cellCount = 2;
+
+  /* Verify parameters. */
+  assert(ring != NULL);
+  assert(elemSize > 0);
+  assert(capacity > 0);
+
+  /* Only continue with valid parameters. */
+  if ( (ring != NULL) && (elemSize > 0) && (capacity > 0) )
+  {
+    /* Round the capacity up to a power of two, such that a mask can be used to convert
+     * a position to a cell index.
+     */
+    while (cellCount < capacity)
+    {
+      cellCount <<= 1;
+    }
+    /* Each cell stores its sequence number, followed by the element. Keep the cells
+     * aligned to the sequence number.
+     */
+    ring->elemSize = elemSize;
+    ring->cellSize = sizeof(atomic_size_t) + elemSize;
+    ring->cellSize = (ring->cellSize + (alignof(atomic_size_t) - 1U)) & 
+                     ~(alignof(atomic_size_t) - 1U);
+    ring->mask = cellCount - 1;
+    /* Allocate memory for the cells. The size must be a multiple of the alignment. */
+    ring->cells = aligned_alloc(RING_CACHE_LINE_SIZE, 
+                                ((ring->cellSize * cellCount) + 
+                                 (RING_CACHE_LINE_SIZE - 1U)) & 
+                                ~(RING_CACHE_LINE_SIZE - 1U));
+    /* Verify that memory could be allocated. */
+    assert(ring->cells != NULL);
+
+    /* Only continue when memory was allocated. */
+    if (ring->cells != NULL)
+    {
+      /* A cell is free for the producer at position pos, when its sequence equals pos. */
+      for (size_t pos = 0; pos < cellCount; pos++)
+      {
+        atomic_init(RING_CELL_SEQ(ring, pos), pos);
+      }
+      atomic_init(&ring->head, 0);
+      atomic_init(&ring->tail, 0);
+      /* Update the result. */
+      result = true;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of RingInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the ring buffer and releases its memory. Elements that are
+**            still stored in the ring are discarded.
+** \param     ring Pointer to the ring buffer.
+**
+****************************************************************************************/
+void RingTerminate(tRing * ring)
+{
+  /* Verify parameter. */
+  assert(ring != NULL);
+
+  /* Only continue with valid parameter. */
+  if (ring != NULL)
+  {
+    /* Release the memory of the cells. */
+    free(ring->cells);
+    ring->cells = NULL;
+    ring->mask = 0;
+  }
+} /*** end of RingTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Pushes an element into the ring buffer. Can be called from any thread.
+** \param     ring Pointer to the ring buffer.
+** \param     elem Pointer to the element to copy into the ring buffer.
+** \return    True if successful, false if the ring buffer is full.
+**
+****************************************************************************************/
+bool RingPush(tRing * ring, void const * elem)
+{
+  bool result = false;
+  size_t pos;
+  size_t seq;
+  intptr_t diff;
+
+  /* Verify parameters. */
+  assert(ring != NULL);
+  assert(elem != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (ring != NULL) && (elem != NULL) )
+  {
+    pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (;;)
+    {
+      seq = atomic_load_explicit(RING_CELL_SEQ(ring, pos), memory_order_acquire);
+      diff = (intptr_t)seq - (intptr_t)pos;
+      /* Is the cell free for this position? */
+      if (diff == 0)
+      {
+        /* Attempt to claim the cell. Upon failure, pos is updated to the latest head. */
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+          /* Cell claimed. Store the element and publish it to the consumers. */
+          memcpy(RING_CELL_ELEM(ring, pos), elem, ring->elemSize);
+          atomic_store_explicit(RING_CELL_SEQ(ring, pos), pos + 1, memory_order_release);
+          result = true;
+          break;
+        }
+      }
+      /* Is the cell still occupied by an element from the previous lap? */
+      else if (diff < 0)
+      {
+        /* Ring buffer is full. */
+        break;
+      }
+      /* Another producer claimed this position already. */
+      else
+      {
+        pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of RingPush ***/
+
+
+/************************************************************************************//**
+** \brief     Pops the oldest element from the ring buffer. Can be called from any thread.
+** \param     ring Pointer to the ring buffer.
+** \param     elem Pointer to where the element should be copied to.
+** \return    True if successful, false if the ring buffer is empty.
+**
+****************************************************************************************/
+bool RingPop(tRing * ring, void * elem)
+{
+  bool result = false;
+  size_t pos;
+  size_t seq;
+  intptr_t diff;
+
+  /* Verify parameters. */
+  assert(ring != NULL);
+  assert(elem != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (ring != NULL) && (elem != NULL) )
+  {
+    pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (;;)
+    {
+      seq = atomic_load_explicit(RING_CELL_SEQ(ring, pos), memory_order_acquire);
+      diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      /* Does the cell hold a published element for this position? */
+      if (diff == 0)
+      {
+        /* Attempt to claim the element. Upon failure, pos is updated to the latest
+         * tail.
+         */
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+          /* Element claimed. Copy it and hand the cell back to the producers for their
+           * next lap.
+           */
+          memcpy(elem, RING_CELL_ELEM(ring, pos), ring->elemSize);
+          atomic_store_explicit(RING_CELL_SEQ(ring, pos), pos + ring->mask + 1,
+                                memory_order_release);
+          result = true;
+          break;
+        }
+      }
+      /* Is the cell not yet published? */
+      else if (diff < 0)
+      {
+        /* Ring buffer is empty. */
+        break;
+      }
+      /* Another consumer claimed this position already. */
+      else
+      {
+        pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of RingPop ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the number of elements currently stored in the ring buffer. Only
+**            a snapshot when other threads access the ring buffer concurrently.
+** \param     ring Pointer to the ring buffer.
+** \return    Number of stored elements.
+**
+****************************************************************************************/
+size_t RingCount(tRing * ring)
+{
+  size_t result = 0;
+  size_t head;
+  size_t tail;
+
+  /* Verify parameter. */
+  assert(ring != NULL);
+
+  /* Only continue with valid parameter. */
+  if (ring != NULL)
+  {
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    /* The tail could have moved on after reading it. */
+    if (head > tail)
+    {
+      result = head - tail;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of RingCount ***/
+
+
+/*********************************** end of ring.c *************************************/
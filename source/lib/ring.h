@@ -0,0 +1,68 @@
+/************************************************************************************//**
+* \file         ring.h
+* \brief        Lock-free ring buffer header file.
+*
+****************************************************************************************/
+#ifndef RING_H
+#define RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <stdalign.h>                       /* Alignment specifiers                    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Size of a cache line in bytes. */
+#define RING_CACHE_LINE_SIZE (64U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Bounded ring buffer with fixed-size elements. Any number of threads can push
+ *  and pop elements concurrently, without locks. All memory is allocated upfront in
+ *  RingInit.
+ */
+typedef struct
+{
+  /** \brief Position at which the next element is pushed. On its own cache line, to
+   *  prevent false sharing between producers and consumers.
+   */
+  alignas(RING_CACHE_LINE_SIZE) atomic_size_t head;
+  /** \brief Position from which the next element is popped. */
+  alignas(RING_CACHE_LINE_SIZE) atomic_size_t tail;
+  /** \brief Storage for the cells. Each cell holds a sequence number and an element. */
+  alignas(RING_CACHE_LINE_SIZE) uint8_t * cells;
+  /** \brief Capacity of the ring minus one. The capacity is a power of two. */
+  size_t mask;
+  /** \brief Size of one element in bytes. */
+  size_t elemSize;
+  /** \brief Size of one cell in bytes. */
+  size_t cellSize;
+} tRing;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+bool   RingInit(tRing * ring, size_t elemSize, size_t capacity);
+void   RingTerminate(tRing * ring);
+bool   RingPush(tRing * ring, void const * elem);
+bool   RingPop(tRing * ring, void * elem);
+size_t RingCount(tRing * ring);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_H */
+/*********************************** end of ring.h *************************************/
@@ -0,0 +1,948 @@
+/************************************************************************************//**
+* \file         seq.c
+* \brief        Coroutine based test sequences source file.
+* \details      A sequence is a function that runs as a coroutine on the thread of the
+*               event loop. It has its own stack, so it can wait for a CAN message or a
+*               delay in the middle of its code with CanAwaitMessage() and Delay(). While
+*               it waits, the event loop continues with other events and sequences. This
+*               way, thousands of sequences can run at the same time on one thread.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <time.h>                           /* Time functions                          */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <ucontext.h>                       /* User thread contexts                    */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include <sys/mman.h>                       /* Memory management                       */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/eventfd.h>                    /* Event notification file descriptor      */
+#include <sys/timerfd.h>                    /* Timer file descriptor                   */
+#include <linux/can.h>                      /* CAN kernel definitions                  */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "loop.h"                           /* Event loop driver                       */
+#include "seq.h"                            /* Coroutine based test sequences          */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define SEQ_INVALID_FD                 (-1)
+
+/** \brief Index of the wait list for sequences that wait for a range of CAN
+ *  identifiers. The lists before it are the hash buckets.
+ */
+#define SEQ_WAIT_LIST_WILDCARD         (SEQ_BUCKETS)
+
+/** \brief Wait list index of a sequence that does not wait for a CAN message. */
+#define SEQ_WAIT_LIST_NONE             (SEQ_BUCKETS + 1U)
+
+/** \brief Heap index of a sequence that does not wait with a timeout. */
+#define SEQ_HEAP_NONE                  (SIZE_MAX)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief A sequence with its coroutine context and its wait state. */
+typedef struct t_seq_node
+{
+  /** \brief Saved execution context of the coroutine. */
+  ucontext_t context;
+  /** \brief Memory of the coroutine's stack. */
+  void * stack;
+  /** \brief The sequence function and its context parameter. */
+  tSeqFunction seqFcn;
+  void * seqContext;
+  /** \brief Filter of the CAN message that the sequence waits for. */
+  tCanFilter filter;
+  /** \brief Where to store the CAN message that the sequence waits for. */
+  tCanMsg * msg;
+  /** \brief Result of the wait. True if a CAN message was received. */
+  bool received;
+  /** \brief Set once the sequence function returned. */
+  bool finished;
+  /** \brief System time at which the wait times out. */
+  uint64_t deadline;
+  /** \brief Index in the timeout heap or SEQ_HEAP_NONE. */
+  size_t heapIdx;
+  /** \brief Index of the wait list or SEQ_WAIT_LIST_NONE. */
+  size_t waitList;
+  /** \brief Links in the wait list. */
+  struct t_seq_node * waitPrev;
+  struct t_seq_node * waitNext;
+  /** \brief Link in the list of sequences that are ready to resume. Also used for the
+   *  list of sequences that were started, but did not yet run.
+   */
+  struct t_seq_node * readyNext;
+  /** \brief Links in the list with all sequences. */
+  struct t_seq_node * allPrev;
+  struct t_seq_node * allNext;
+} tSeqNode;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Execution context of the event loop, to which the sequences switch back
+ *  when they wait.
+ */
+static ucontext_t seqLoopContext;
+
+/** \brief The sequence that currently runs, or NULL if none. */
+static tSeqNode * seqCurrent;
+
+/** \brief List with all sequences. Only accessed by the event loop thread. */
+static tSeqNode * seqAll;
+
+/** \brief Wait lists. One per hash bucket, for sequences that wait for one specific
+ *  CAN identifier, followed by one for the sequences that wait for a range of CAN
+ *  identifiers.
+ */
+static tSeqNode * seqWaitLists[SEQ_BUCKETS + 1U];
+
+/** \brief List with sequences that are ready to resume. */
+static tSeqNode * seqReadyHead;
+static tSeqNode * seqReadyTail;
+
+/** \brief Binary min-heap with the sequences that wait with a timeout, ordered by
+ *  their deadline.
+ */
+static tSeqNode ** seqHeap;
+static size_t seqHeapCount;
+static size_t seqHeapCapacity;
+
+/** \brief Number of sequences that were started and did not yet finish. */
+static atomic_size_t seqActive;
+
+/** \brief Lock-free stack with the sequences that were started, but did not yet run.
+ *  Other threads push onto it, while the event loop thread takes all of them at once.
+ */
+static _Atomic(tSeqNode *) seqStarted;
+
+/** \brief Queue with the CAN messages received on another thread. */
+static tRing seqMessageQueue;
+
+/** \brief Event file descriptor that other threads signal after queueing. */
+static int seqWakeupFd = SEQ_INVALID_FD;
+
+/** \brief Set while a signal of the event file descriptor is pending. Prevents a system
+ *  call for each queued CAN message.
+ */
+static atomic_bool seqWakeupPending;
+
+/** \brief Timer file descriptor that expires when the next wait times out. */
+static int seqTimerFd = SEQ_INVALID_FD;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void SeqLoopEvent(int fd, uint32_t events, void * context);
+static void SeqRunStarted(void);
+static void SeqEntry(void);
+static bool SeqWait(uint32_t timeout_us);
+static void SeqResumeReady(void);
+static void SeqMakeReady(tSeqNode * node, bool received);
+static void SeqProcessMessage(tCanMsg const * msg);
+static void SeqProcessTimeouts(uint64_t now);
+static void SeqRelease(tSeqNode * node);
+static void SeqWakeup(void);
+static void SeqArm(void);
+static bool SeqHeapPush(tSeqNode * node);
+static void SeqHeapRemove(tSeqNode * node);
+static void SeqHeapSwap(size_t a, size_t b);
+
+
+/************************************************************************************//**
+** \brief     Initializes the sequence module. Should be called after the event loop was
+**            initialized.
+**
+****************************************************************************************/
+void SeqInit(void)
+{
+  /* Initialize locals. */
+  seqCurrent = NULL;
+  seqAll = NULL;
+  for (size_t idx = 0; idx < (SEQ_BUCKETS + 1U); idx++)
+  {
+    seqWaitLists[idx] = NULL;
+  }
+  seqReadyHead = NULL;
+  seqReadyTail = NULL;
+  seqHeap = NULL;
+  seqHeapCount = 0;
+  seqHeapCapacity = 0;
+  atomic_init(&seqActive, 0);
+  atomic_init(&seqWakeupPending, false);
+  atomic_init(&seqStarted, NULL);
+
+  /* Create the message queue. */
+  if (!RingInit(&seqMessageQueue, sizeof(tCanMsg), SEQ_QUEUE_SIZE))
+  {
+    assert(false);
+  }
+
+  /* Create the file descriptors and register them with the event loop. */
+  seqWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  seqTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if ( (seqWakeupFd == SEQ_INVALID_FD) || (seqTimerFd == SEQ_INVALID_FD) ||
+       (!LoopAdd(seqWakeupFd, EPOLLIN, SeqLoopEvent, NULL)) ||
+       (!LoopAdd(seqTimerFd, EPOLLIN, SeqLoopEvent, NULL)) )
+  {
+    assert(false);
+  }
+} /*** end of SeqInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the sequence module. Sequences that did not yet finish are
+**            discarded. Should be called after the event loop stopped.
+**
+****************************************************************************************/
+void SeqTerminate(void)
+{
+  tSeqNode * node;
+  tSeqNode * next;
+
+  /* Unregister from the event loop and close the file descriptors. */
+  if (seqWakeupFd != SEQ_INVALID_FD)
+  {
+    LoopRemove(seqWakeupFd);
+    close(seqWakeupFd);
+    seqWakeupFd = SEQ_INVALID_FD;
+  }
+  if (seqTimerFd != SEQ_INVALID_FD)
+  {
+    LoopRemove(seqTimerFd);
+    close(seqTimerFd);
+    seqTimerFd = SEQ_INVALID_FD;
+  }
+
+  /* Release the sequences that did not run yet. */
+  node = atomic_exchange(&seqStarted, NULL);
+  while (node != NULL)
+  {
+    next = node->readyNext;
+    SeqRelease(node);
+    node = next;
+  }
+  /* Release the sequences that are still waiting. */
+  while (seqAll != NULL)
+  {
+    SeqRelease(seqAll);
+  }
+
+  /* Release the message queue and the heap. */
+  RingTerminate(&seqMessageQueue);
+  free(seqHeap);
+
+  /* Reset locals. */
+  seqHeap = NULL;
+  seqHeapCount = 0;
+  seqHeapCapacity = 0;
+  seqReadyHead = NULL;
+  seqReadyTail = NULL;
+  for (size_t idx = 0; idx < (SEQ_BUCKETS + 1U); idx++)
+  {
+    seqWaitLists[idx] = NULL;
+  }
+} /*** end of SeqTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts a new sequence. It runs on the event loop thread, as soon as the
+**            event loop gets to it. Can be called from any thread, including from
+**            within another sequence.
+** \param     seqFcn The sequence function.
+** \param     context Parameter that is passed on to the sequence function.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool SeqStart(tSeqFunction seqFcn, void * context)
+{
+  bool result = false;
+  tSeqNode * node;
+
+  /* Verify parameter. */
+  assert(seqFcn != NULL);
+
+  /* Only continue with valid parameter. */
+  if (seqFcn != NULL)
+  {
+    /* Allocate the sequence and its stack. The lowest page of the stack is a guard
+     * page, such that a stack overflow faults instead of corrupting memory.
+     */
+    node = calloc(1, sizeof(tSeqNode));
+    if (node != NULL)
+    {
+      node->stack = mmap(NULL, SEQ_STACK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+      if (node->stack == MAP_FAILED)
+      {
+        free(node);
+        node = NULL;
+      }
+      else
+      {
+        (void)mprotect(node->stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+      }
+    }
+
+    /* Prepare the coroutine context. */
+    if (node != NULL)
+    {
+      node->seqFcn = seqFcn;
+      node->seqContext = context;
+      node->heapIdx = SEQ_HEAP_NONE;
+      node->waitList = SEQ_WAIT_LIST_NONE;
+      if (getcontext(&node->context) == 0)
+      {
+        node->context.uc_stack.ss_sp = node->stack;
+        node->context.uc_stack.ss_size = SEQ_STACK_SIZE;
+        node->context.uc_link = NULL;
+        makecontext(&node->context, SeqEntry, 0);
+        /* Hand it over to the event loop thread. */
+        atomic_fetch_add(&seqActive, 1);
+        node->readyNext = atomic_load(&seqStarted);
+        while (!atomic_compare_exchange_weak(&seqStarted, &node->readyNext, node))
+        {
+          ;
+        }
+        SeqWakeup();
+        result = true;
+      }
+      /* Clean up in case of an error. */
+      if (!result)
+      {
+        munmap(node->stack, SEQ_STACK_SIZE);
+        free(node);
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of SeqStart ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the number of sequences that were started and did not yet finish.
+** \return    Number of sequences.
+**
+****************************************************************************************/
+size_t SeqCount(void)
+{
+  /* Give the result back to the caller. */
+  return atomic_load(&seqActive);
+} /*** end of SeqCount ***/
+
+
+/************************************************************************************//**
+** \brief     Passes a received CAN message on to the sequences that wait for it. Should
+**            be called for each received CAN message. Cheap if no sequences run.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+void SeqMessageReceived(tCanMsg const * msg)
+{
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when sequences run. A sequence that is about
+   * to wait for a CAN message might still be running, so do not check for waiting
+   * sequences here.
+   */
+  if ( (msg != NULL) && (atomic_load_explicit(&seqActive, memory_order_relaxed) > 0) )
+  {
+    /* Already on the event loop thread? In offline mode, the CAN driver delivers from
+     * the event loop in both threading modes. The resumed sequences might wait with a
+     * new timeout, so rearm the timer file descriptor afterwards.
+     */
+    if ( (LoopSingleThreaded()) || (UtilVirtualTime()) )
+    {
+      SeqProcessMessage(msg);
+      SeqArm();
+    }
+    /* Queue the CAN message for the event loop thread. */
+    else if (RingPush(&seqMessageQueue, msg))
+    {
+      SeqWakeup();
+    }
+  }
+} /*** end of SeqMessageReceived ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time at which the first wait of a sequence times out. Should
+**            be called from the event loop thread.
+** \param     deadline Pointer to where the system time of the timeout is stored.
+** \return    True if a sequence waits with a timeout, false otherwise.
+**
+****************************************************************************************/
+bool SeqNextTimeout(uint64_t * deadline)
+{
+  bool result = false;
+
+  /* Verify parameter. */
+  assert(deadline != NULL);
+
+  /* Only continue with valid parameter and when a sequence waits with a timeout. */
+  if ( (deadline != NULL) && (seqHeapCount > 0) )
+  {
+    *deadline = seqHeap[0]->deadline;
+    result = true;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of SeqNextTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Runs the sequences that were started and resumes the sequences whose wait
+**            timed out at or before the specified time of the virtual clock. In offline
+**            mode, the CAN driver calls this before each CAN message and as the virtual
+**            clock passes the timeouts, so the timer file descriptor is not used. Should
+**            be called from the event loop thread.
+** \param     now Time of the virtual clock in microseconds.
+**
+****************************************************************************************/
+void SeqAdvance(uint64_t now)
+{
+  /* Only continue when the virtual clock is used. */
+  if (UtilVirtualTime())
+  {
+    if (atomic_load_explicit(&seqStarted, memory_order_relaxed) != NULL)
+    {
+      SeqRunStarted();
+    }
+    SeqProcessTimeouts(now);
+  }
+} /*** end of SeqAdvance ***/
+
+
+/************************************************************************************//**
+** \brief     Waits for a CAN message that matches the filter. Should be called from
+**            within a sequence. The event loop continues while the sequence waits.
+** \param     filter Pointer to the acceptance filter.
+** \param     timeout_us Maximum time to wait in microseconds, or SEQ_WAIT_FOREVER.
+** \param     msg Pointer to where the received CAN message is stored. Can be NULL.
+** \return    True if a matching CAN message was received, false upon timeout.
+**
+****************************************************************************************/
+bool CanAwaitMessage(tCanFilter const * filter, uint32_t timeout_us, tCanMsg * msg)
+{
+  bool result = false;
+  tSeqNode * node = seqCurrent;
+  uint32_t fullMask;
+
+  /* Verify parameters. */
+  assert(filter != NULL);
+  assert(node != NULL);
+
+  /* Only continue with valid parameters and when called from within a sequence. */
+  if ( (filter != NULL) && (node != NULL) )
+  {
+    node->filter = *filter;
+    node->msg = msg;
+    /* Sequences that wait for one specific CAN identifier go into the hash bucket of
+     * that identifier. All others go into the wildcard list.
+     */
+    fullMask = filter->ext ? CAN_EFF_MASK : CAN_SFF_MASK;
+    if ((filter->mask & fullMask) == fullMask)
+    {
+      node->waitList = filter->id & (SEQ_BUCKETS - 1U);
+    }
+    else
+    {
+      node->waitList = SEQ_WAIT_LIST_WILDCARD;
+    }
+    /* Insert it at the front of the wait list. */
+    node->waitPrev = NULL;
+    node->waitNext = seqWaitLists[node->waitList];
+    if (node->waitNext != NULL)
+    {
+      node->waitNext->waitPrev = node;
+    }
+    seqWaitLists[node->waitList] = node;
+    /* Wait for the CAN message or the timeout. */
+    result = SeqWait(timeout_us);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of CanAwaitMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Delays the sequence. Should be called from within a sequence. The event
+**            loop continues while the sequence waits. When called outside of a
+**            sequence, it blocks the calling thread instead.
+** \param     us Delay time in microseconds.
+**
+****************************************************************************************/
+void Delay(uint32_t us)
+{
+  /* Called from within a sequence? */
+  if (seqCurrent != NULL)
+  {
+    /* Wait for the timeout, without waiting for a CAN message. */
+    (void)SeqWait(us);
+  }
+  else
+  {
+    /* Block the thread. */
+    UtilSleep(us);
+  }
+} /*** end of Delay ***/
+
+
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when another thread queued something
+**            or when the timer file descriptor expired.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void SeqLoopEvent(int fd, uint32_t events, void * context)
+{
+  uint64_t counter;
+  tCanMsg msg;
+
+  /* Reset the event or expiration counter of the file descriptor. */
+  (void)read(fd, &counter, sizeof(counter));
+
+  /* Queued by another thread? */
+  if (fd == seqWakeupFd)
+  {
+    /* Clear the flag before emptying the queues, such that items queued afterwards
+     * signal the event file descriptor again.
+     */
+    atomic_store(&seqWakeupPending, false);
+    /* Run the sequences that were started. */
+    SeqRunStarted();
+    /* Pass on the queued CAN messages. */
+    while (RingPop(&seqMessageQueue, &msg))
+    {
+      SeqProcessMessage(&msg);
+    }
+  }
+  /* Wait timed out. */
+  else
+  {
+    SeqProcessTimeouts(UtilSystemTime());
+  }
+
+  /* Rearm the timer file descriptor for the next timeout. */
+  SeqArm();
+} /*** end of SeqLoopEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Runs the sequences that were started, until they wait for the first time.
+**
+****************************************************************************************/
+static void SeqRunStarted(void)
+{
+  tSeqNode * node;
+  tSeqNode * started = NULL;
+
+  /* Take the sequences that were started. Reverse the stack, such that they run in the
+   * order they were started.
+   */
+  node = atomic_exchange(&seqStarted, NULL);
+  while (node != NULL)
+  {
+    tSeqNode * next = node->readyNext;
+    node->readyNext = started;
+    started = node;
+    node = next;
+  }
+  /* Run them, until they wait for the first time. */
+  while (started != NULL)
+  {
+    node = started;
+    started = node->readyNext;
+    node->allPrev = NULL;
+    node->allNext = seqAll;
+    if (seqAll != NULL)
+    {
+      seqAll->allPrev = node;
+    }
+    seqAll = node;
+    SeqMakeReady(node, false);
+    SeqResumeReady();
+  }
+} /*** end of SeqRunStarted ***/
+
+
+/************************************************************************************//**
+** \brief     Entry point of the coroutines. Runs the sequence function and switches
+**            back to the event loop for good, once it returned.
+**
+****************************************************************************************/
+static void SeqEntry(void)
+{
+  tSeqNode * node = seqCurrent;
+
+  /* Run the sequence function. */
+  node->seqFcn(node->seqContext);
+  /* Mark the sequence as finished. The event loop releases it. */
+  node->finished = true;
+  (void)swapcontext(&node->context, &seqLoopContext);
+} /*** end of SeqEntry ***/
+
+
+/************************************************************************************//**
+** \brief     Suspends the current sequence until it is made ready again, because a CAN
+**            message was received or the timeout expired.
+** \param     timeout_us Maximum time to wait in microseconds, or SEQ_WAIT_FOREVER.
+** \return    True if a CAN message was received, false upon timeout.
+**
+****************************************************************************************/
+static bool SeqWait(uint32_t timeout_us)
+{
+  tSeqNode * node = seqCurrent;
+
+  /* Add it to the timeout heap, unless it should wait forever. */
+  node->received = false;
+  if (timeout_us != SEQ_WAIT_FOREVER)
+  {
+    node->deadline = UtilSystemTime() + timeout_us;
+    if (!SeqHeapPush(node))
+    {
+      /* Out of memory. Time out right away. */
+      SeqMakeReady(node, false);
+    }
+  }
+  /* Switch back to the event loop. It resumes this sequence once it is ready. */
+  (void)swapcontext(&node->context, &seqLoopContext);
+
+  /* Give the result back to the caller. */
+  return node->received;
+} /*** end of SeqWait ***/
+
+
+/************************************************************************************//**
+** \brief     Resumes all sequences that are ready, one after the other. Releases the
+**            sequences that finished.
+**
+****************************************************************************************/
+static void SeqResumeReady(void)
+{
+  tSeqNode * node;
+
+  /* Resume the sequences in the order they became ready. */
+  while (seqReadyHead != NULL)
+  {
+    node = seqReadyHead;
+    seqReadyHead = node->readyNext;
+    if (seqReadyHead == NULL)
+    {
+      seqReadyTail = NULL;
+    }
+    /* Switch to the sequence, until it waits again or finishes. */
+    seqCurrent = node;
+    (void)swapcontext(&seqLoopContext, &node->context);
+    seqCurrent = NULL;
+    /* Release it, if it finished. This cannot be done on its own stack. */
+    if (node->finished)
+    {
+      SeqRelease(node);
+    }
+  }
+} /*** end of SeqResumeReady ***/
+
+
+/************************************************************************************//**
+** \brief     Ends the wait of a sequence and adds it to the list of sequences that are
+**            ready to resume.
+** \param     node The sequence.
+** \param     received True if a CAN message was received, false upon timeout.
+**
+****************************************************************************************/
+static void SeqMakeReady(tSeqNode * node, bool received)
+{
+  /* Remove it from its wait list. */
+  if (node->waitList != SEQ_WAIT_LIST_NONE)
+  {
+    if (node->waitPrev != NULL)
+    {
+      node->waitPrev->waitNext = node->waitNext;
+    }
+    else
+    {
+      seqWaitLists[node->waitList] = node->waitNext;
+    }
+    if (node->waitNext != NULL)
+    {
+      node->waitNext->waitPrev = node->waitPrev;
+    }
+    node->waitList = SEQ_WAIT_LIST_NONE;
+  }
+  /* Remove it from the timeout heap. */
+  if (node->heapIdx != SEQ_HEAP_NONE)
+  {
+    SeqHeapRemove(node);
+  }
+  /* Append it to the ready list. */
+  node->received = received;
+  node->readyNext = NULL;
+  if (seqReadyTail != NULL)
+  {
+    seqReadyTail->readyNext = node;
+  }
+  else
+  {
+    seqReadyHead = node;
+  }
+  seqReadyTail = node;
+} /*** end of SeqMakeReady ***/
+
+
+/************************************************************************************//**
+** \brief     Resumes the sequences that wait for the received CAN message.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+static void SeqProcessMessage(tCanMsg const * msg)
+{
+  tSeqNode * node;
+  tSeqNode * next;
+  size_t lists[2];
+
+  /* Only the hash bucket of the identifier and the wildcard list can hold sequences
+   * that wait for this CAN message.
+   */
+  lists[0] = msg->id & (SEQ_BUCKETS - 1U);
+  lists[1] = SEQ_WAIT_LIST_WILDCARD;
+  for (size_t idx = 0; idx < 2; idx++)
+  {
+    node = seqWaitLists[lists[idx]];
+    while (node != NULL)
+    {
+      next = node->waitNext;
+      if (CanFilterMatch(&node->filter, msg))
+      {
+        if (node->msg != NULL)
+        {
+          *node->msg = *msg;
+        }
+        SeqMakeReady(node, true);
+      }
+      node = next;
+    }
+  }
+  /* Resume them right away, such that they can wait for the next CAN message. */
+  SeqResumeReady();
+} /*** end of SeqProcessMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Resumes the sequences whose wait timed out.
+** \param     now Current system time.
+**
+****************************************************************************************/
+static void SeqProcessTimeouts(uint64_t now)
+{
+  /* Take all sequences that timed out from the heap. */
+  while ( (seqHeapCount > 0) && (seqHeap[0]->deadline <= now) )
+  {
+    SeqMakeReady(seqHeap[0], false);
+  }
+  /* Resume them. */
+  SeqResumeReady();
+} /*** end of SeqProcessTimeouts ***/
+
+
+/************************************************************************************//**
+** \brief     Releases a sequence and its stack.
+** \param     node The sequence.
+**
+****************************************************************************************/
+static void SeqRelease(tSeqNode * node)
+{
+  /* Remove it from the list with all sequences, if it was added. */
+  if (node->allPrev != NULL)
+  {
+    node->allPrev->allNext = node->allNext;
+  }
+  else if (seqAll == node)
+  {
+    seqAll = node->allNext;
+  }
+  if (node->allNext != NULL)
+  {
+    node->allNext->allPrev = node->allPrev;
+  }
+  /* Release its memory. */
+  munmap(node->stack, SEQ_STACK_SIZE);
+  free(node);
+  atomic_fetch_sub(&seqActive, 1);
+} /*** end of SeqRelease ***/
+
+
+/************************************************************************************//**
+** \brief     Signals the event file descriptor, unless a signal is already pending.
+**
+****************************************************************************************/
+static void SeqWakeup(void)
+{
+  uint64_t increment = 1;
+
+  if (!atomic_exchange(&seqWakeupPending, true))
+  {
+    (void)write(seqWakeupFd, &increment, sizeof(increment));
+  }
+} /*** end of SeqWakeup ***/
+
+
+/************************************************************************************//**
+** \brief     Arms the timer file descriptor such that it expires when the next wait
+**            times out. Disarms it if no sequence waits with a timeout.
+**
+****************************************************************************************/
+static void SeqArm(void)
+{
+  struct itimerspec spec = { 0 };
+  uint64_t now;
+  uint64_t delay_us = 1;
+
+  /* Does a sequence wait with a timeout? A zero expiration value disarms the timer file
+   * descriptor. On the virtual clock, SeqAdvance() handles the timeouts instead.
+   */
+  if ( (seqHeapCount > 0) && (!UtilVirtualTime()) )
+  {
+    /* Determine how long to wait. Overdue timeouts must still arm the timer file
+     * descriptor, so wait at least one microsecond.
+     */
+    now = UtilSystemTime();
+    if (seqHeap[0]->deadline > now)
+    {
+      delay_us = seqHeap[0]->deadline - now;
+    }
+    spec.it_value.tv_sec = (time_t)(delay_us / (1000 * 1000));
+    spec.it_value.tv_nsec = (long)((delay_us % (1000 * 1000)) * 1000);
+  }
+  (void)timerfd_settime(seqTimerFd, 0, &spec, NULL);
+} /*** end of SeqArm ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a sequence to the timeout heap.
+** \param     node The sequence.
+** \return    True if successful, false if out of memory.
+**
+****************************************************************************************/
+static bool SeqHeapPush(tSeqNode * node)
+{
+  bool result = true;
+  tSeqNode ** newHeap;
+  size_t idx;
+
+  /* Grow the heap, if it is full. */
+  if (seqHeapCount == seqHeapCapacity)
+  {
+    newHeap = realloc(seqHeap, ((seqHeapCapacity > 0) ? (seqHeapCapacity * 2U) : 64U) *
+                      sizeof(tSeqNode *));
+    if (newHeap != NULL)
+    {
+      seqHeap = newHeap;
+      seqHeapCapacity = (seqHeapCapacity > 0) ? (seqHeapCapacity * 2U) : 64U;
+    }
+    else
+    {
+      result = false;
+    }
+  }
+
+  /* Add it at the bottom and sift it up. */
+  if (result)
+  {
+    idx = seqHeapCount++;
+    seqHeap[idx] = node;
+    node->heapIdx = idx;
+    while ( (idx > 0) && (seqHeap[(idx - 1U) / 2U]->deadline > seqHeap[idx]->deadline) )
+    {
+      SeqHeapSwap(idx, (idx - 1U) / 2U);
+      idx = (idx - 1U) / 2U;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of SeqHeapPush ***/
+
+
+/************************************************************************************//**
+** \brief     Removes a sequence from the timeout heap.
+** \param     node The sequence.
+**
+****************************************************************************************/
+static void SeqHeapRemove(tSeqNode * node)
+{
+  size_t idx = node->heapIdx;
+  size_t child;
+
+  /* Move the bottom one into its place. */
+  seqHeapCount--;
+  if (idx != seqHeapCount)
+  {
+    SeqHeapSwap(idx, seqHeapCount);
+    /* Sift it up, if it expires before its parent. */
+    while ( (idx > 0) && (seqHeap[(idx - 1U) / 2U]->deadline > seqHeap[idx]->deadline) )
+    {
+      SeqHeapSwap(idx, (idx - 1U) / 2U);
+      idx = (idx - 1U) / 2U;
+    }
+    /* Otherwise sift it down. */
+    while ((child = (2U * idx) + 1U) < seqHeapCount)
+    {
+      if ( ((child + 1U) < seqHeapCount) &&
+           (seqHeap[child + 1U]->deadline < seqHeap[child]->deadline) )
+      {
+        child++;
+      }
+      if (seqHeap[child]->deadline >= seqHeap[idx]->deadline)
+      {
+        break;
+      }
+      SeqHeapSwap(idx, child);
+      idx = child;
+    }
+  }
+  node->heapIdx = SEQ_HEAP_NONE;
+} /*** end of SeqHeapRemove ***/
+
+
+/************************************************************************************//**
+** \brief     Swaps two entries of the timeout heap.
+** \param     a Index of the first entry.
+** \param     b Index of the second entry.
+**
+****************************************************************************************/
+static void SeqHeapSwap(size_t a, size_t b)
+{
+  tSeqNode * node = seqHeap[a];
+
+  seqHeap[a] = seqHeap[b];
+  seqHeap[b] = node;
+  seqHeap[a]->heapIdx = a;
+  seqHeap[b]->heapIdx = b;
+} /*** end of SeqHeapSwap ***/
+
+
+/*********************************** end of seq.c **************************************/
@@ -0,0 +1,68 @@
+/************************************************************************************//**
+* \file         seq.h
+* \brief        Coroutine based test sequences header file.
+*
+****************************************************************************************/
+#ifndef SEQ_H
+#define SEQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Stack size in bytes of each sequence. The memory is only committed when the
+ *  sequence actually uses it.
+ */
+#ifndef SEQ_STACK_SIZE
+#define SEQ_STACK_SIZE                 (64U * 1024U)
+#endif
+
+/** \brief Number of CAN messages that can be queued for the sequences, before they are
+ *  dropped. Only used when the CAN messages are received on another thread than the
+ *  one that runs the event loop.
+ */
+#ifndef SEQ_QUEUE_SIZE
+#define SEQ_QUEUE_SIZE                 (4096U)
+#endif
+
+/** \brief Number of hash buckets for sequences that wait for one specific CAN
+ *  identifier. Must be a power of two.
+ */
+#ifndef SEQ_BUCKETS
+#define SEQ_BUCKETS                    (256U)
+#endif
+
+/** \brief Timeout value to wait without a timeout. */
+#define SEQ_WAIT_FOREVER               (UINT32_MAX)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of a sequence. The sequence ends when the function returns. */
+typedef void (* tSeqFunction)(void * context);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void   SeqInit(void);
+void   SeqTerminate(void);
+bool   SeqStart(tSeqFunction seqFcn, void * context);
+size_t SeqCount(void);
+void   SeqMessageReceived(tCanMsg const * msg);
+bool   SeqNextTimeout(uint64_t * deadline);
+void   SeqAdvance(uint64_t now);
+bool   CanAwaitMessage(tCanFilter const * filter, uint32_t timeout_us, tCanMsg * msg);
+void   Delay(uint32_t us);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEQ_H */
+/*********************************** end of seq.h **************************************/
@@ -0,0 +1,333 @@
+/************************************************************************************//**
+* \file         stats.c
+* \brief        Per-identifier statistics source file.
+* \details      Keeps statistics for each received CAN identifier: the number of CAN
+*               messages, their rate, the shortest, longest and average time between
+*               them, the jitter of that time and the data length and timestamp of the
+*               latest one. The CAN event thread updates them for each CAN message, with
+*               a handful of additions and comparisons on a single slot. The averages
+*               are only calculated when the statistics are read.
+*
+*               The jitter is estimated like the interarrival jitter of RTP (RFC 3550):
+*               each CAN message moves it 1/16 of the way towards the difference between
+*               its time since the previous CAN message and the one before.
+*
+*               The slots are assigned by a CAN identifier table, whose sequence counter
+*               protects each slot, so any thread can read consistent statistics without
+*               locks. A reset only increments a generation counter. The CAN event thread
+*               clears a slot once it sees that its generation is outdated, and readers
+*               treat such a slot as empty.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <string.h>                         /* for string library                      */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "can.h"                            /* CAN driver                              */
+#include "idtable.h"                        /* CAN identifier table                    */
+#include "stats.h"                          /* Per-identifier statistics               */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Largest difference between successive times between two CAN messages, that
+ *  the jitter takes into account. Keeps the scaled jitter within 32 bits.
+ */
+#define STATS_JITTER_DELTA_MAX         (0x0FFFFFFFUL)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Slot with the statistics of one CAN identifier. Only the CAN event thread
+ *  writes to it. The times are in microseconds.
+ */
+typedef struct
+{
+  /** \brief Sequence counter. Odd while the CAN event thread updates the slot. */
+  atomic_uint sequence;
+  /** \brief Generation of the statistics. Outdated after a reset. */
+  uint32_t    generation;
+  /** \brief Time between the latest two CAN messages. */
+  uint32_t    interval;
+  /** \brief Number of received CAN messages. */
+  uint64_t    count;
+  /** \brief Timestamps of the first and the latest CAN message. */
+  uint64_t    first;
+  uint64_t    last;
+  /** \brief Shortest and longest time between two CAN messages. */
+  uint32_t    intervalMin;
+  uint32_t    intervalMax;
+  /** \brief Sum of the times between two CAN messages. */
+  uint64_t    intervalSum;
+  /** \brief Jitter, times 16. */
+  uint32_t    jitter;
+  /** \brief Data length of the latest CAN message. */
+  uint8_t     len;
+} tStatsSlot;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Slots for the 11-bit CAN identifiers, followed by those for the 29-bit ones. */
+static tStatsSlot statsSlots[IDTABLE_STD_IDS + STATS_EXT_SLOTS];
+
+/** \brief Keys of the slots for the 29-bit CAN identifiers. */
+static atomic_uint statsKeys[STATS_EXT_SLOTS];
+
+/** \brief Table that assigns the slots to the CAN identifiers. */
+static tIdTable statsTable;
+
+/** \brief Current generation of the statistics. Incremented by a reset. */
+static atomic_uint statsGeneration;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static bool StatsRead(tStatsSlot * slot, uint32_t id, bool ext,
+                      tStatsSnapshot * snapshot);
+
+
+/************************************************************************************//**
+** \brief     Initializes the statistics. All slots are emptied.
+**
+****************************************************************************************/
+void StatsInit(void)
+{
+  /* Initialize locals. The slots start out with generation zero, so they are outdated
+   * right away.
+   */
+  memset(statsSlots, 0, sizeof(statsSlots));
+  IdTableInit(&statsTable, statsKeys, STATS_EXT_SLOTS);
+  atomic_init(&statsGeneration, 1U);
+} /*** end of StatsInit ***/
+
+
+/************************************************************************************//**
+** \brief     Updates the statistics of the identifier of a received CAN message.
+**            Should only be called from the CAN event thread.
+** \param     msg Pointer to the received CAN message.
+**
+****************************************************************************************/
+void StatsMessage(tCanMsg const * msg)
+{
+  tStatsSlot * slot;
+  size_t idx;
+  unsigned int sequence;
+  uint32_t generation;
+  uint64_t elapsed;
+  uint32_t interval;
+  uint32_t delta;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter. */
+  if (msg != NULL)
+  {
+    /* Find the slot of the identifier, or take a free one. */
+    idx = IdTableLookup(&statsTable, msg->id, msg->ext, true);
+    if (idx != IDTABLE_NONE)
+    {
+      slot = &statsSlots[idx];
+      sequence = IdTableWriteBegin(&slot->sequence);
+      /* Start over if the statistics were reset in the meantime. */
+      generation = atomic_load_explicit(&statsGeneration, memory_order_relaxed);
+      if (slot->generation != generation)
+      {
+        slot->generation = generation;
+        slot->count = 0;
+        slot->intervalMin = UINT32_MAX;
+        slot->intervalMax = 0;
+        slot->intervalSum = 0;
+        slot->jitter = 0;
+      }
+      /* Update the times between the CAN messages. */
+      if (slot->count > 0)
+      {
+        elapsed = msg->timestamp - slot->last;
+        interval = (elapsed < UINT32_MAX) ? (uint32_t)elapsed : UINT32_MAX;
+        slot->intervalMin = (interval < slot->intervalMin) ? interval : slot->intervalMin;
+        slot->intervalMax = (interval > slot->intervalMax) ? interval : slot->intervalMax;
+        slot->intervalSum += interval;
+        /* Move the jitter towards the change of the time between the CAN messages. */
+        if (slot->count > 1)
+        {
+          delta = (interval > slot->interval) ? (interval - slot->interval) :
+                                                (slot->interval - interval);
+          delta = (delta < STATS_JITTER_DELTA_MAX) ? delta : STATS_JITTER_DELTA_MAX;
+          slot->jitter += delta - ((slot->jitter + 8U) >> 4);
+        }
+        slot->interval = interval;
+      }
+      else
+      {
+        slot->first = msg->timestamp;
+      }
+      slot->count++;
+      slot->last = msg->timestamp;
+      slot->len = msg->len;
+      IdTableWriteEnd(&slot->sequence, sequence);
+    }
+  }
+} /*** end of StatsMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the statistics of a CAN identifier. Can be called from any thread.
+** \param     id CAN identifier.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     snapshot Pointer to where the statistics are stored.
+** \return    True if successful, false if no CAN message with this identifier was
+**            received since the last reset.
+**
+****************************************************************************************/
+bool StatsGet(uint32_t id, bool ext, tStatsSnapshot * snapshot)
+{
+  bool result = false;
+  size_t idx;
+
+  /* Verify parameter. */
+  assert(snapshot != NULL);
+
+  /* Only continue with valid parameter. */
+  if (snapshot != NULL)
+  {
+    /* Find the slot of the identifier and read it. */
+    idx = IdTableLookup(&statsTable, id, ext, false);
+    if (idx != IDTABLE_NONE)
+    {
+      result = StatsRead(&statsSlots[idx], id, ext, snapshot);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of StatsGet ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the statistics of all CAN identifiers that were received since the
+**            last reset. First the 11-bit CAN identifiers in ascending order, followed
+**            by the 29-bit ones. Can be called from any thread.
+** \param     snapshots Array where the statistics are stored.
+** \param     max Maximum number of entries that fit in the array.
+** \return    Number of stored entries.
+**
+****************************************************************************************/
+size_t StatsList(tStatsSnapshot * snapshots, size_t max)
+{
+  size_t result = 0;
+  uint32_t id;
+  bool ext;
+
+  /* Verify parameter. */
+  assert( (snapshots != NULL) || (max == 0) );
+
+  /* Only continue with valid parameter. */
+  if ( (snapshots != NULL) || (max == 0) )
+  {
+    /* Read the used slots. Those of the 11-bit CAN identifiers come first. */
+    for (size_t idx = 0; (idx < (IDTABLE_STD_IDS + STATS_EXT_SLOTS)) && (result < max);
+         idx++)
+    {
+      if ( (IdTableGetId(&statsTable, idx, &id, &ext)) &&
+           (StatsRead(&statsSlots[idx], id, ext, &snapshots[result])) )
+      {
+        result++;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of StatsList ***/
+
+
+/************************************************************************************//**
+** \brief     Resets the statistics of all CAN identifiers. Can be called from any
+**            thread.
+**
+****************************************************************************************/
+void StatsReset(void)
+{
+  /* Outdate all slots. */
+  atomic_fetch_add(&statsGeneration, 1U);
+} /*** end of StatsReset ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a slot and calculates the statistics from it.
+** \param     slot Pointer to the slot.
+** \param     id CAN identifier of the slot.
+** \param     ext True for a 29-bit CAN identifier, false for 11-bit.
+** \param     snapshot Pointer to where the statistics are stored.
+** \return    True if successful, false if the slot holds no CAN messages of the current
+**            generation.
+**
+****************************************************************************************/
+static bool StatsRead(tStatsSlot * slot, uint32_t id, bool ext,
+                      tStatsSnapshot * snapshot)
+{
+  bool result;
+  tStatsSlot copy;
+  unsigned int sequence;
+
+  /* Copy the slot until the copy is consistent. */
+  do
+  {
+    sequence = IdTableReadBegin(&slot->sequence);
+    copy.generation = slot->generation;
+    copy.count = slot->count;
+    copy.first = slot->first;
+    copy.last = slot->last;
+    copy.intervalMin = slot->intervalMin;
+    copy.intervalMax = slot->intervalMax;
+    copy.intervalSum = slot->intervalSum;
+    copy.jitter = slot->jitter;
+    copy.len = slot->len;
+  }
+  while (!IdTableReadEnd(&slot->sequence, sequence));
+
+  /* Only statistics of the current generation count. */
+  result = (copy.count > 0) &&
+           (copy.generation == atomic_load_explicit(&statsGeneration,
+                                                    memory_order_relaxed));
+  if (result)
+  {
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->id = id;
+    snapshot->ext = ext;
+    snapshot->len = copy.len;
+    snapshot->count = copy.count;
+    snapshot->timestamp = copy.last;
+    /* The time based statistics need at least two CAN messages. */
+    if (copy.count > 1)
+    {
+      if (copy.last > copy.first)
+      {
+        snapshot->rate = (double)(copy.count - 1U) * 1e6 /
+                         (double)(copy.last - copy.first);
+      }
+      snapshot->intervalMin = copy.intervalMin;
+      snapshot->intervalMax = copy.intervalMax;
+      snapshot->intervalAvg = (double)copy.intervalSum / (double)(copy.count - 1U);
+      snapshot->jitter = (double)copy.jitter / 16.0;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of StatsRead ***/
+
+
+/*********************************** end of stats.c ************************************/
@@ -0,0 +1,70 @@
+/************************************************************************************//**
+* \file         stats.h
+* \brief        Per-identifier statistics header file.
+*
+****************************************************************************************/
+#ifndef STATS_H
+#define STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of 29-bit CAN identifiers that statistics can be kept for. Each 11-bit
+ *  CAN identifier has its own slot.
+ */
+#ifndef STATS_EXT_SLOTS
+#define STATS_EXT_SLOTS                (512U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Statistics of one CAN identifier, since it was first received after the last
+ *  reset. The times are in microseconds.
+ */
+typedef struct
+{
+  /** \brief CAN identifier. */
+  uint32_t id;
+  /** \brief True for a 29-bit CAN identifier, false for 11-bit. */
+  bool     ext;
+  /** \brief Data length of the latest CAN message. */
+  uint8_t  len;
+  /** \brief Number of received CAN messages. */
+  uint64_t count;
+  /** \brief Timestamp of the latest CAN message. */
+  uint64_t timestamp;
+  /** \brief Average number of CAN messages per second. */
+  double   rate;
+  /** \brief Shortest time between two CAN messages. */
+  uint32_t intervalMin;
+  /** \brief Longest time between two CAN messages. */
+  uint32_t intervalMax;
+  /** \brief Average time between two CAN messages. */
+  double   intervalAvg;
+  /** \brief Smoothed difference between successive times between two CAN messages. */
+  double   jitter;
+} tStatsSnapshot;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void   StatsInit(void);
+void   StatsMessage(tCanMsg const * msg);
+bool   StatsGet(uint32_t id, bool ext, tStatsSnapshot * snapshot);
+size_t StatsList(tStatsSnapshot * snapshots, size_t max);
+void   StatsReset(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_H */
+/*********************************** end of stats.h ************************************/
@@ -12,29 +12,108 @@
 #include <stddef.h>                         /* for NULL declaration                    */
 #include <stdbool.h>                        /* for boolean type                        */
 #include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <stdalign.h>                       /* Alignment specifiers                    */
 #include <threads.h>                        /* Multithreading                          */
 #include <stdatomic.h>                      /* Atomic operations                       */
+#include <time.h>                           /* Date and time utilities                 */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <sys/epoll.h>                      /* I/O event notification                  */
+#include <sys/eventfd.h>                    /* Event notification file descriptor      */
+#include <sys/timerfd.h>                    /* Timer file descriptor                   */
 #include "util.h"                           /* Utility functions                       */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "loop.h"                           /* Event loop driver                       */
 #include "timer.h"                          /* timer driver                            */
 
 
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Size of a cache line in bytes. Timer nodes are aligned to it, to prevent false
+ *  sharing between neighboring nodes.
+ */
+#define TIMER_CACHE_LINE_SIZE          (64U)
+
+/** \brief Value of the free list link that marks the end of the list. */
+#define TIMER_POOL_END                 (UINT16_MAX)
+
+/** \brief Number of bits in a timer handle that hold the pool index. The free list head
+ *  uses the same layout, with an ABA tag instead of the generation.
+ */
+#define TIMER_HANDLE_INDEX_BITS        (16U)
+
+/** \brief Bit mask to extract the pool index from a handle or the free list head. */
+#define TIMER_HANDLE_INDEX_MASK        ((1U << TIMER_HANDLE_INDEX_BITS) - 1U)
+
+/** \brief Constructs a timer handle from a generation and a pool index. Note that the
+ *  index is stored plus one, to make sure a valid handle never equals NULL.
+ */
+#define TIMER_HANDLE(generation, idx)  \
+  ((tTimer)(((uintptr_t)(generation) << TIMER_HANDLE_INDEX_BITS) | ((uintptr_t)(idx) + 1U)))
+
+/** \brief Value of an invalid file descriptor. */
+#define TIMER_INVALID_FD               (-1)
+
+/** \brief Maximum number of pending timer commands from other threads than the
+ *  scheduler thread.
+ */
+#define TIMER_COMMAND_QUEUE_SIZE       (1024U)
+
+
 /****************************************************************************************
 * Type definitions
 ****************************************************************************************/
 typedef struct t_timer_node
 {
-  /** \brief Callback function pointer to call upon timeout. */
-  tTimerEventCallback callbackFcn;  
+  /** \brief Callback function pointer to call upon timeout. Aligned to a cache line,
+   *  which aligns and pads the entire node to a cache line as well.
+   */
+  alignas(TIMER_CACHE_LINE_SIZE) tTimerEventCallback callbackFcn;  
+  /** \brief Callback function pointer with context to call upon timeout. */
+  tTimerContextCallback contextCallbackFcn;
+  /** \brief User context pointer, passed to the context and batch callbacks. */
+  void * context;
   /** \brief Boolean flag to indicate if the timer is active or not. */
   bool running;
+  /** \brief Boolean flag to indicate that the timer event is reported through the batch
+   *  callback.
+   */
+  bool batched;
+  /** \brief Generation counter. Incremented each time the node is released, such that
+   *  handles to a previous use of this node no longer match.
+   */
+  uint16_t generation;
+  /** \brief Pool index of the next node in the free list or the retired list. */
+  _Atomic uint16_t nextFree;
   /** \brief Timestamp of when the timer was started. */
   uint64_t startTime;
   /** \brief Period of the timer in microseconds. */
   uint32_t period_us;
-  /** \brief Pointer to the next node in the list or NULL if it is the list end. */
-  struct t_timer_node volatile * nextNode;
 } tTimerNode;
 
+/** \brief Enumerated type with the commands that other threads post to the scheduler. */
+typedef enum
+{
+  TIMER_CMD_START,
+  TIMER_CMD_RESTART,
+  TIMER_CMD_STOP,
+  TIMER_CMD_DELETE
+} tTimerCommandType;
+
+/** \brief Timer command, as posted to the scheduler thread. */
+typedef struct
+{
+  /** \brief Handle of the timer that the command applies to. */
+  tTimer timer;
+  /** \brief System time at which the command was issued. */
+  uint64_t time;
+  /** \brief Timer period in microseconds. Only used by the start command. */
+  uint32_t period_us;
+  /** \brief The command type. */
+  tTimerCommandType type;
+} tTimerCommand;
+
 
 /****************************************************************************************
 * Local data declarations
@@ -48,17 +127,79 @@ static bool timerPollingThreadRunning;
 /** \brief Atomic boolean that is used to inform the polling thread to stop running. */
 static atomic_bool timerStopPollingThread;
 
-/** \brief Mutex for mutual exlusive access to the timer linked list. */
-static mtx_t timerListMutex;
-
-/** \brief Timer linked list. */
-static tTimerNode volatile * timerList;
+/** \brief Thread local boolean flag that is only set on the scheduler thread. The
+ *  scheduler thread owns the state of all timers. API calls on this thread, such as the
+ *  ones from inside a timer callback, operate on the timers directly. Other threads
+ *  post a command to the scheduler thread instead.
+ */
+static thread_local bool timerOnSchedulerThread;
+
+/** \brief Function pointer for the batch event callback handler. Volatile because it
+ *  is shared with the scheduler thread.
+ */
+static volatile tTimerBatchCallback timerBatchCallback;
+
+/** \brief Batched timers that expired during the current scheduler pass. */
+static tTimerExpiry timerBatch[TIMER_POOL_SIZE];
+
+/** \brief Timer file descriptor that expires at the next timer event. Only used when
+ *  the timers are serviced by the event loop.
+ */
+static int timerEventFd = TIMER_INVALID_FD;
+
+/** \brief Event file descriptor that other threads signal after posting a command.
+ *  Only used when the timers are serviced by the event loop.
+ */
+static int timerWakeupFd = TIMER_INVALID_FD;
+
+/** \brief System time at which the next timer event is due, or UINT64_MAX if no timer
+ *  is running. Only accessed by the scheduler thread.
+ */
+static uint64_t timerNextExpiry;
+
+/** \brief Boolean flag that is set while the scheduler performs its pass. Only accessed
+ *  by the scheduler thread.
+ */
+static bool timerProcessing;
+
+/** \brief Lock-free queue with commands for the scheduler thread. */
+static tRing timerCommandQueue;
+
+/** \brief Pool with timer nodes. */
+static tTimerNode timerPool[TIMER_POOL_SIZE];
+
+/** \brief Head of the lock-free free list. Holds the pool index of the first node in
+ *  the lower bits and a tag in the upper bits. The tag changes upon each update, which
+ *  prevents the ABA problem.
+ */
+static atomic_uint_fast32_t timerPoolFree;
+
+/** \brief Number of pool nodes that were ever handed out. The polling thread only needs
+ *  to scan this part of the pool.
+ */
+static atomic_uint timerPoolUsed;
+
+/** \brief Pool index of the first node in the list of deleted nodes. Only accessed by
+ *  the scheduler thread. These nodes are returned to the free list once the scheduler
+ *  completed its scan, such that a node is never reused while the scan is still
+ *  looking at it.
+ */
+static uint16_t timerPoolRetired;
 
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
 static int TimerPollingThread(void * param);
+static void TimerLoopEvent(int fd, uint32_t events, void * context);
+static void TimerArm(void);
+static void TimerProcess(uint64_t now);
+static void TimerPost(tTimerCommand const * command);
+static void TimerApply(tTimerCommand const * command);
+static tTimerNode * TimerLookup(tTimer timer);
+static tTimer TimerPoolAllocate(tTimerNode ** node);
+static void TimerTrackExpiry(tTimerNode const * aTimer);
+static void TimerPoolRelease(uint16_t idx);
 
 
 /************************************************************************************//**
@@ -68,21 +209,74 @@ static int TimerPollingThread(void * param);
 ****************************************************************************************/
 void TimerInit(void)
 {
+  uint_fast32_t freeHead = TIMER_POOL_END;
+  uint16_t generation;
+
   /* Initialize locals. */
   timerPollingThreadId = 0;
   timerPollingThreadRunning = false;
   atomic_init(&timerStopPollingThread, false);
-  timerList = NULL;
+  atomic_init(&timerPoolUsed, 0);
+  timerPoolRetired = TIMER_POOL_END;
+  timerBatchCallback = NULL;
+  timerNextExpiry = UINT64_MAX;
+  timerProcessing = false;
+
+  /* Build the free list, such that nodes are handed out in ascending order. This keeps
+   * the part of the pool that the polling thread scans as small as possible.
+   */
+  for (uint16_t idx = TIMER_POOL_SIZE; idx > 0; idx--)
+  {
+    /* Preallocation enabled? Initializing the entire node touches its memory. Keep the
+     * generation, otherwise a handle from before a previous TimerTerminate() would
+     * match the node again.
+     */
+    if (TIMER_POOL_PREALLOC > 0)
+    {
+      generation = timerPool[idx - 1].generation;
+      memset(&timerPool[idx - 1], 0, sizeof(tTimerNode));
+      timerPool[idx - 1].generation = generation;
+    }
+    timerPool[idx - 1].running = false;
+    atomic_init(&timerPool[idx - 1].nextFree, (uint16_t)freeHead);
+    freeHead = idx - 1;
+  }
+  atomic_init(&timerPoolFree, freeHead);
 
-  /* Initialize the mutex. */
-  if (mtx_init(&timerListMutex, mtx_plain) != thrd_success)
+  /* Create the command queue. */
+  if (!RingInit(&timerCommandQueue, sizeof(tTimerCommand), TIMER_COMMAND_QUEUE_SIZE))
   {
     assert(false);
   }
 
+  /* Do the timers run on the virtual clock? Then the thread that advances the virtual
+   * clock with TimerAdvance() services them. No polling thread or timer file descriptor
+   * is needed.
+   */
+  if (UtilVirtualTime())
+  {
+    timerOnSchedulerThread = LoopSingleThreaded();
+  }
+  /* Are the timers serviced by the event loop? */
+  else if (LoopSingleThreaded())
+  {
+    /* The event loop runs on this thread, so this thread is the scheduler thread. */
+    timerOnSchedulerThread = true;
+    /* Create the timer file descriptor that expires at the next timer event and the
+     * event file descriptor that other threads signal after posting a command.
+     */
+    timerEventFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    timerWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( (timerEventFd == TIMER_INVALID_FD) || (timerWakeupFd == TIMER_INVALID_FD) ||
+         (!LoopAdd(timerEventFd, EPOLLIN, TimerLoopEvent, NULL)) ||
+         (!LoopAdd(timerWakeupFd, EPOLLIN, TimerLoopEvent, NULL)) )
+    {
+      assert(false);
+    }
+  }
   /* Start the polling thread for processing timer related events. */
-  if (thrd_create(&timerPollingThreadId, (thrd_start_t)TimerPollingThread, NULL) 
-      == thrd_success)
+  else if (thrd_create(&timerPollingThreadId, (thrd_start_t)TimerPollingThread, NULL) 
+           == thrd_success)
   {
     /* Set flag. */
     timerPollingThreadRunning = true;
@@ -97,9 +291,6 @@ void TimerInit(void)
 ****************************************************************************************/
 void TimerTerminate(void)
 {
-  tTimerNode volatile * aTimer;  
-  tTimerNode volatile * delTimer;  
-
   /* Stop the timer's polling thread. */
   if (timerPollingThreadRunning)
   {
@@ -109,27 +300,39 @@ void TimerTerminate(void)
     thrd_join(timerPollingThreadId, NULL);
   }
 
-  /* Obtain mutual exclusion to the timer linked list. */
-  mtx_lock(&timerListMutex);   
-  /* Begin at the start of the list. */
-  aTimer = timerList;
-  /* Iterate over the entire list. */
-  while (aTimer != NULL)
+  /* Unregister from the event loop and close the file descriptors. */
+  if (timerEventFd != TIMER_INVALID_FD)
+  {
+    LoopRemove(timerEventFd);
+    close(timerEventFd);
+    timerEventFd = TIMER_INVALID_FD;
+  }
+  if (timerWakeupFd != TIMER_INVALID_FD)
   {
-    /* Store the one to delete. */
-    delTimer = aTimer;
-    /* Move to the next one, before actually deleting it. */
-    aTimer = aTimer->nextNode;
-    /* Release memory of the one that is to be deleted. */
-    free((void *)delTimer);
+    LoopRemove(timerWakeupFd);
+    close(timerWakeupFd);
+    timerWakeupFd = TIMER_INVALID_FD;
   }
-  /* Set list to empty now that all nodes have been released. */
-  timerList = NULL;
-  /* Release mutual exclusion to the timer linked list. */
-  mtx_unlock(&timerListMutex);   
+  timerOnSchedulerThread = false;
 
-  /* Destroy the mutex. */
-  mtx_destroy(&timerListMutex);
+  /* Invalidate all handles that are still out there. No need to rebuild the free list,
+   * because TimerInit does that.
+   */
+  for (uint16_t idx = 0; idx < atomic_load(&timerPoolUsed); idx++)
+  {
+    timerPool[idx].running = false;
+    timerPool[idx].callbackFcn = NULL;
+    timerPool[idx].contextCallbackFcn = NULL;
+    timerPool[idx].batched = false;
+    timerPool[idx].generation++;
+  }
+  atomic_store(&timerPoolFree, TIMER_POOL_END);
+  atomic_store(&timerPoolUsed, 0);
+  timerPoolRetired = TIMER_POOL_END;
+  timerBatchCallback = NULL;
+
+  /* Release the command queue. Commands that are still pending are discarded. */
+  RingTerminate(&timerCommandQueue);
 
   /* Reset locals. */
   atomic_init(&timerStopPollingThread, false);
@@ -140,7 +343,8 @@ void TimerTerminate(void)
 
 /************************************************************************************//**
 ** \brief     Create a new timer. It returns the handle of the newly created timer, which
-**            is needed for other timer related API functions.
+**            is needed for other timer related API functions. Lock-free, so it can be
+**            called from any thread.
 ** \param     callbackFcn Callback function pointer of the function that should be called
 **            upon each expiration event.
 ** \return    Timer handle if successful, NULL otherwise.
@@ -149,7 +353,7 @@ void TimerTerminate(void)
 tTimer TimerCreate(tTimerEventCallback callbackFcn)
 {
   tTimer result = NULL;
-  tTimerNode volatile * newTimer;  
+  tTimerNode * newTimer;
 
   /* Verify parameter. */
   assert(callbackFcn != NULL);
@@ -157,32 +361,12 @@ tTimer TimerCreate(tTimerEventCallback callbackFcn)
   /* Only continue with valid parameter. */
   if (callbackFcn != NULL)  
   {
-    /* Allocate memory for the new timer. */
-    newTimer = (tTimerNode volatile *)malloc(sizeof(tTimerNode));
-
-    /* Verify that memory could be allocated. */
-    assert(newTimer != NULL);
-
-    /* Only continue when memory was allocated. */
-    if (newTimer != NULL)
+    /* Obtain a node from the pool. */
+    result = TimerPoolAllocate(&newTimer);
+    if (result != NULL)
     {
-      /* Initialize the timer. */
-      newTimer->running = false;
-      newTimer->startTime = 0;
-      newTimer->period_us = 0;
+      /* Set the callback. */
       newTimer->callbackFcn = callbackFcn;
-      newTimer->nextNode = NULL;
-
-      /* Obtain mutual exclusion to the timer linked list. */
-      mtx_lock(&timerListMutex);  
-      /* Add the new node at the start of the linked list. */
-      newTimer->nextNode = timerList;
-      timerList = newTimer;
-      /* Release mutual exclusion to the timer linked list. */
-      mtx_unlock(&timerListMutex);   
-
-      /* Update the result. */
-      result = (tTimer)newTimer;
     }
   }
 
@@ -192,15 +376,92 @@ tTimer TimerCreate(tTimerEventCallback callbackFcn)
 
 
 /************************************************************************************//**
-** \brief     Deletes a previously created timer. 
+** \brief     Create a new timer with a callback that receives a user context pointer.
+**            This makes it possible to share one callback function between many timers,
+**            for example to drive a table of cyclic CAN messages. Lock-free, so it can
+**            be called from any thread.
+** \param     callbackFcn Callback function pointer of the function that should be called
+**            upon each expiration event.
+** \param     context User context pointer that is passed to the callback function.
+** \return    Timer handle if successful, NULL otherwise.
+**
+****************************************************************************************/
+tTimer TimerCreateContext(tTimerContextCallback callbackFcn, void * context)
+{
+  tTimer result = NULL;
+  tTimerNode * newTimer;
+
+  /* Verify parameter. */
+  assert(callbackFcn != NULL);
+
+  /* Only continue with valid parameter. */
+  if (callbackFcn != NULL)  
+  {
+    /* Obtain a node from the pool. */
+    result = TimerPoolAllocate(&newTimer);
+    if (result != NULL)
+    {
+      /* Set the callback and its context. */
+      newTimer->contextCallbackFcn = callbackFcn;
+      newTimer->context = context;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TimerCreateContext ***/
+
+
+/************************************************************************************//**
+** \brief     Create a new batched timer. It does not have its own callback. Instead, all
+**            batched timers that expire during the same scheduler pass are reported
+**            together, with a single call of the callback that was set with
+**            TimerSetBatchCallback(). Lock-free, so it can be called from any thread.
+** \param     context User context pointer that is reported for this timer in the batch.
+** \return    Timer handle if successful, NULL otherwise.
+**
+****************************************************************************************/
+tTimer TimerCreateBatched(void * context)
+{
+  tTimer result;
+  tTimerNode * newTimer;
+
+  /* Obtain a node from the pool. */
+  result = TimerPoolAllocate(&newTimer);
+  if (result != NULL)
+  {
+    /* Mark the timer as batched and store its context. */
+    newTimer->batched = true;
+    newTimer->context = context;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TimerCreateBatched ***/
+
+
+/************************************************************************************//**
+** \brief     Sets the callback function that reports all batched timers that expired
+**            during the same scheduler pass.
+** \param     callbackFcn Batch callback function pointer. NULL to disable it.
+**
+****************************************************************************************/
+void TimerSetBatchCallback(tTimerBatchCallback callbackFcn)
+{
+  /* Set the batch callback handler. */
+  timerBatchCallback = callbackFcn;
+} /*** end of TimerSetBatchCallback ***/
+
+
+/************************************************************************************//**
+** \brief     Deletes a previously created timer. Lock-free, so it can be called from any
+**            thread, including from inside a timer callback.
 ** \param     timer Handle of the timer to delete.
 **
 ****************************************************************************************/
 void TimerDelete(tTimer timer)
 {
-  tTimerNode volatile * delTimer = (tTimerNode volatile *)timer;  
-  tTimerNode volatile * prevTimer;  
-  tTimerNode volatile * aTimer;  
+  tTimerCommand command = { .timer = timer, .type = TIMER_CMD_DELETE };
 
   /* Verify parameter. */
   assert(timer != NULL);
@@ -208,56 +469,22 @@ void TimerDelete(tTimer timer)
   /* Only continue with valid parameter. */
   if (timer != NULL)  
   {
-    /* Obtain mutual exclusion to the timer linked list. */
-    mtx_lock(&timerListMutex);
-    /* Can only delete a node from the list if the list is not empty. */
-    if (timerList != NULL)
-    {
-      /* Is the node to be deleted right at the start of the list? */
-      if (timerList == delTimer)
-      {
-        /* Remove it from the list and free its allocated memory. */
-        timerList = delTimer->nextNode;
-        free((void *)delTimer);
-      }
-      /* Not at the start of the list, so we need to search for it. */
-      else
-      {
-        /* Begin at the start of the list. */
-        aTimer = timerList;
-        /* Loop through the list to find the to be deleted node. */
-        while (aTimer->nextNode != NULL)
-        {
-          /* Is the next node the one to delete? */
-          if (aTimer->nextNode == delTimer)
-          {
-            /* Remove it from the list and free its allocated memory. */
-            aTimer->nextNode = delTimer->nextNode;
-            free((void *)delTimer);
-            /* All done, so no point in continuing the loop. */
-            break;
-          }
-          /* Continue with the next node. */
-          aTimer = aTimer->nextNode;
-        }
-      }
-    }
-    /* Release mutual exclusion to the timer linked list. */
-    mtx_unlock(&timerListMutex);   
+    /* Hand the command to the scheduler. */
+    TimerPost(&command);
   }
 } /*** end of TimerDelete ***/
 
 
 /************************************************************************************//**
 ** \brief     Starts the timer by scheduling a timer event to occur in time specified by
-**            the period parameter.
+**            the period parameter. Lock-free, so it can be called from any thread.
 ** \param     timer Handle of the timer to start.
 ** \param     period Number of milliseconds after which the timer event should occur.
 **
 ****************************************************************************************/
 void TimerStart(tTimer timer, uint32_t period)
 {
-  tTimerNode volatile * aTimer = (tTimerNode volatile *)timer;  
+  tTimerCommand command = { .timer = timer, .type = TIMER_CMD_START };
 
   /* Verify parameter. */
   assert(timer != NULL);
@@ -265,15 +492,11 @@ void TimerStart(tTimer timer, uint32_t period)
   /* Only continue with valid parameter. */
   if (timer != NULL)  
   {
-    /* Obtain mutual exclusion to the timer linked list. */
-    mtx_lock(&timerListMutex);  
-    /* Set the start time, store the period and start the timer. 
-     */
-    aTimer->startTime = UtilSystemTime();
-    aTimer->period_us = period * 1000;
-    aTimer->running = true;
-    /* Release mutual exclusion to the timer linked list. */
-    mtx_unlock(&timerListMutex);   
+    /* Set the start time and the period. */
+    command.time = UtilSystemTime();
+    command.period_us = period * 1000;
+    /* Hand the command to the scheduler. */
+    TimerPost(&command);
   }
 } /*** end of TimerStart ***/
 
@@ -281,13 +504,13 @@ void TimerStart(tTimer timer, uint32_t period)
 /************************************************************************************//**
 ** \brief     Restarts the timer using the same period as the last event. Typically 
 **            called from the timer's event callback to create a pure cyclical timer.
+**            Lock-free, so it can be called from any thread.
 ** \param     timer Handle of the timer to restart.
 **
 ****************************************************************************************/
 void TimerRestart(tTimer timer)
 {
-  tTimerNode volatile * aTimer = (tTimerNode volatile *)timer;  
-  uint64_t now = UtilSystemTime();
+  tTimerCommand command = { .timer = timer, .type = TIMER_CMD_RESTART };
 
   /* Verify parameter. */
   assert(timer != NULL);
@@ -295,31 +518,23 @@ void TimerRestart(tTimer timer)
   /* Only continue with valid parameter. */
   if (timer != NULL)  
   {
-    /* Obtain mutual exclusion to the timer linked list. */
-    mtx_lock(&timerListMutex);  
-    /* Add period to the start time to restart it. */
-    aTimer->startTime += aTimer->period_us;
-    /* Did the timer already overrun? */
-    if ((now - aTimer->startTime) > aTimer->period_us)
-    {
-      /* Schedule the timer to trigger the timeout event right away. */
-      aTimer->startTime = now - aTimer->period_us;
-    }
-    aTimer->running = true;
-    /* Release mutual exclusion to the timer linked list. */
-    mtx_unlock(&timerListMutex);   
+    /* Set the time at which the restart was requested. */
+    command.time = UtilSystemTime();
+    /* Hand the command to the scheduler. */
+    TimerPost(&command);
   }
 } /*** end of TimerRestart ***/
 
 
 /************************************************************************************//**
-** \brief     Stops the timer that was previously started.
+** \brief     Stops the timer that was previously started. Lock-free, so it can be called
+**            from any thread.
 ** \param     timer Handle of the timer to delete.
 **
 ****************************************************************************************/
 void TimerStop(tTimer timer)
 {
-  tTimerNode volatile * aTimer = (tTimerNode volatile *)timer;  
+  tTimerCommand command = { .timer = timer, .type = TIMER_CMD_STOP };
 
   /* Verify parameter. */
   assert(timer != NULL);
@@ -327,16 +542,44 @@ void TimerStop(tTimer timer)
   /* Only continue with valid parameter. */
   if (timer != NULL)  
   {
-    /* Obtain mutual exclusion to the timer linked list. */
-    mtx_lock(&timerListMutex);   
-    /* Stop the timer. */
-    aTimer->running = false;
-    /* Release mutual exclusion to the timer linked list. */
-    mtx_unlock(&timerListMutex);   
+    /* Hand the command to the scheduler. */
+    TimerPost(&command);
   }
 } /*** end of TimerStop ***/
 
 
+/************************************************************************************//**
+** \brief     Advances the virtual clock to the specified time and invokes the callbacks
+**            of the timers that expire on the way, each at its own instant of the
+**            virtual clock. Only does something when the virtual clock is used, see
+**            UtilSetVirtualTime(). The calling thread becomes the scheduler thread.
+** \param     now New time of the virtual clock in microseconds. The virtual clock never
+**            goes back in time.
+**
+****************************************************************************************/
+void TimerAdvance(uint64_t now)
+{
+  /* Only continue when the virtual clock is used. */
+  if (UtilVirtualTime())
+  {
+    /* This thread services the timers from now on. */
+    timerOnSchedulerThread = true;
+    /* Apply the pending commands and determine the next timer event. */
+    TimerProcess(UtilSystemTime());
+    /* Step the virtual clock from one timer event to the next, until the new time. */
+    while (timerNextExpiry <= now)
+    {
+      UtilSetVirtualTime(timerNextExpiry);
+      TimerProcess(timerNextExpiry);
+    }
+    if (now > UtilSystemTime())
+    {
+      UtilSetVirtualTime(now);
+    }
+  }
+} /*** end of TimerAdvance ***/
+
+
 /************************************************************************************//**
 ** \brief     Polling thread that handles detection and processing of timer related
 **            events.
@@ -346,50 +589,14 @@ void TimerStop(tTimer timer)
 ****************************************************************************************/
 static int TimerPollingThread(void * param)
 {
-  tTimerNode volatile * aTimer;
-  uint64_t now;
-  tTimerEventCallback callbackFcnCopy;
+  /* This thread is the scheduler thread. */
+  timerOnSchedulerThread = true;
 
   /* Enter the thread's loop and run it, until a stop is requested. */
   while (!atomic_load(&timerStopPollingThread))
   {
-    /* Get current system time. */
-    now = UtilSystemTime();
-    /* Obtain mutual exclusion to the timer linked list. */
-    mtx_lock(&timerListMutex);   
-    /* Begin at the start of the list. */
-    aTimer = timerList;
-    /* Iterate over the entire list. */
-    while (aTimer != NULL)
-    {
-      /* Is this timer running? */
-      if (aTimer->running)
-      {
-        /* Did this timer timeout? */
-        if ((now - aTimer->startTime) > aTimer->period_us)
-        {
-          /* Make a copy of its callback function pointer. */
-          callbackFcnCopy = aTimer->callbackFcn;
-          /* Invoke the callback function, but make sure to do it outside of the mutex
-           * lock, because the user might call other timer API functions inside the
-           * callback, which would result in a deadlock.
-           */
-          if (callbackFcnCopy != NULL)
-          {
-            /* Release mutual exclusion to the timer linked list. */
-            mtx_unlock(&timerListMutex);   
-            /* Invoke the callback. */
-            callbackFcnCopy();
-            /* Obtain mutual exclusion to the timer linked list. */
-            mtx_lock(&timerListMutex);   
-          }
-        }
-      }
-      /* Continue with the next timer. */
-      aTimer = aTimer->nextNode;
-    }
-    /* Release mutual exclusion to the timer linked list. */
-    mtx_unlock(&timerListMutex);   
+    /* Process the timers. */
+    TimerProcess(UtilSystemTime());
 
     /* Wait a little to not starve the CPU. Note that one millisecond is the smallest 
      * timer interval. Yet the thread executation takes a litle time to, so we should
@@ -403,4 +610,408 @@ static int TimerPollingThread(void * param)
 } /*** end of TimerPollingThread ***/
 
 
+/************************************************************************************//**
+** \brief     Event loop callback that gets called when the timer file descriptor
+**            expired or when another thread posted a command.
+** \param     fd File descriptor that reported the event.
+** \param     events The epoll event flags.
+** \param     context User context pointer (not used).
+**
+****************************************************************************************/
+static void TimerLoopEvent(int fd, uint32_t events, void * context)
+{
+  uint64_t counter;
+
+  /* Reset the expiration or event counter of the file descriptor. */
+  (void)read(fd, &counter, sizeof(counter));
+  /* Process the timers and rearm the timer file descriptor for the next event. */
+  TimerProcess(UtilSystemTime());
+  TimerArm();
+} /*** end of TimerLoopEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Arms the timer file descriptor such that it expires when the next timer
+**            event is due. Disarms it if no timer is running. Should only be called from
+**            the scheduler thread.
+**
+****************************************************************************************/
+static void TimerArm(void)
+{
+  struct itimerspec spec = { 0 };
+  uint64_t now;
+  uint64_t delay_us = 1;
+
+  /* Only continue if the timers are serviced by the event loop. */
+  if (timerEventFd != TIMER_INVALID_FD)
+  {
+    /* Is a timer running? A zero expiration value disarms the timer file descriptor. */
+    if (timerNextExpiry != UINT64_MAX)
+    {
+      /* Determine how long to wait. Overdue events must still arm the timer file
+       * descriptor, so wait at least one microsecond.
+       */
+      now = UtilSystemTime();
+      if (timerNextExpiry > now)
+      {
+        delay_us = timerNextExpiry - now;
+      }
+      spec.it_value.tv_sec = (time_t)(delay_us / (1000 * 1000));
+      spec.it_value.tv_nsec = (long)((delay_us % (1000 * 1000)) * 1000);
+    }
+    (void)timerfd_settime(timerEventFd, 0, &spec, NULL);
+  }
+} /*** end of TimerArm ***/
+
+
+/************************************************************************************//**
+** \brief     Updates the time of the next timer event after a timer was (re)started.
+**            Outside of a scheduler pass, the timer file descriptor is rearmed right
+**            away. Should only be called from the scheduler thread.
+** \param     aTimer Pointer to the timer node.
+**
+****************************************************************************************/
+static void TimerTrackExpiry(tTimerNode const * aTimer)
+{
+  uint64_t expiry = aTimer->startTime + aTimer->period_us + 1U;
+
+  /* Does this timer expire before the currently known next event? */
+  if (expiry < timerNextExpiry)
+  {
+    timerNextExpiry = expiry;
+    /* Rearm the timer file descriptor, unless the scheduler pass does this. */
+    if (!timerProcessing)
+    {
+      TimerArm();
+    }
+  }
+} /*** end of TimerTrackExpiry ***/
+
+
+/************************************************************************************//**
+** \brief     Performs one scheduler pass. Applies the pending commands from other
+**            threads, invokes the callbacks of the timers that expired and finally
+**            returns the nodes of deleted timers to the free list. Should only be called
+**            from the scheduler thread.
+** \param     now Current system time.
+**
+****************************************************************************************/
+static void TimerProcess(uint64_t now)
+{
+  tTimerCommand command;
+  tTimerNode * aTimer;
+  tTimerBatchCallback batchCallbackCopy;
+  size_t batchCount = 0;
+  unsigned int used;
+  uint16_t idx;
+
+  /* Start the pass. The scan and the applied commands determine the next expiry. */
+  timerProcessing = true;
+  timerNextExpiry = UINT64_MAX;
+
+  /* Apply all commands that other threads posted. */
+  while (RingPop(&timerCommandQueue, &command))
+  {
+    TimerApply(&command);
+  }
+
+  /* Iterate over the part of the pool that was handed out. No lock is held, so the
+   * callbacks are free to call timer API functions. A timer deleted from within a
+   * callback stops running right away, while its node stays out of the free list until
+   * the scan completed.
+   */
+  used = atomic_load(&timerPoolUsed);
+  for (idx = 0; idx < used; idx++)
+  {
+    aTimer = &timerPool[idx];
+    /* Is this timer running and did it timeout? */
+    if ( (aTimer->running) && ((now - aTimer->startTime) > aTimer->period_us) )
+    {
+      /* The timer event is a one-shot. The callback restarts the timer if it should
+       * be cyclical.
+       */
+      aTimer->running = false;
+      /* Batched timer? */
+      if (aTimer->batched)
+      {
+        /* Add it to the batch, which is reported once the scan completed. */
+        timerBatch[batchCount].timer = TIMER_HANDLE(aTimer->generation, idx);
+        timerBatch[batchCount].context = aTimer->context;
+        batchCount++;
+      }
+      /* Timer with a context callback? */
+      else if (aTimer->contextCallbackFcn != NULL)
+      {
+        /* Invoke the callback. */
+        aTimer->contextCallbackFcn(TIMER_HANDLE(aTimer->generation, idx), 
+                                   aTimer->context);
+      }
+      /* Timer with a plain callback. */
+      else if (aTimer->callbackFcn != NULL)
+      {
+        /* Invoke the callback. */
+        aTimer->callbackFcn();
+      }
+    }
+    /* Still running, so keep track of when it expires. */
+    else if ( (aTimer->running) && 
+              ((aTimer->startTime + aTimer->period_us + 1U) < timerNextExpiry) )
+    {
+      timerNextExpiry = aTimer->startTime + aTimer->period_us + 1U;
+    }
+  }
+
+  /* Report the batched timers that expired. */
+  batchCallbackCopy = timerBatchCallback;
+  if ( (batchCount > 0) && (batchCallbackCopy != NULL) )
+  {
+    batchCallbackCopy(timerBatch, batchCount);
+  }
+
+  /* Now that the scan completed, the nodes of deleted timers can be reused. */
+  while (timerPoolRetired != TIMER_POOL_END)
+  {
+    idx = timerPoolRetired;
+    timerPoolRetired = atomic_load_explicit(&timerPool[idx].nextFree, 
+                                            memory_order_relaxed);
+    TimerPoolRelease(idx);
+  }
+
+  /* Pass completed. */
+  timerProcessing = false;
+} /*** end of TimerProcess ***/
+
+
+/************************************************************************************//**
+** \brief     Hands a command over to the scheduler. When called on the scheduler thread
+**            itself, the command is applied right away. Otherwise it is queued.
+** \param     command Pointer to the command.
+**
+****************************************************************************************/
+static void TimerPost(tTimerCommand const * command)
+{
+  /* Running on the scheduler thread, for example inside a timer callback? */
+  if (timerOnSchedulerThread)
+  {
+    /* Apply the command directly. */
+    TimerApply(command);
+  }
+  else
+  {
+    /* Queue the command. In the unlikely event that the queue is full, wait for the
+     * scheduler to catch up.
+     */
+    while (!RingPush(&timerCommandQueue, command))
+    {
+      thrd_yield();
+    }
+    /* Wake up the event loop, if it services the timers. */
+    if (timerWakeupFd != TIMER_INVALID_FD)
+    {
+      uint64_t counter = 1;
+      (void)write(timerWakeupFd, &counter, sizeof(counter));
+    }
+  }
+} /*** end of TimerPost ***/
+
+
+/************************************************************************************//**
+** \brief     Applies a command to a timer. Should only be called from the scheduler
+**            thread. Commands for timers that no longer exist are ignored.
+** \param     command Pointer to the command.
+**
+****************************************************************************************/
+static void TimerApply(tTimerCommand const * command)
+{
+  tTimerNode * aTimer;
+
+  /* Only apply the command if the timer handle is still valid. */
+  aTimer = TimerLookup(command->timer);
+  if (aTimer != NULL)
+  {
+    switch (command->type)
+    {
+      case TIMER_CMD_START:
+        /* Set the start time, store the period and start the timer. */
+        aTimer->startTime = command->time;
+        aTimer->period_us = command->period_us;
+        aTimer->running = true;
+        TimerTrackExpiry(aTimer);
+        break;
+
+      case TIMER_CMD_RESTART:
+        /* Add period to the start time to restart it. */
+        aTimer->startTime += aTimer->period_us;
+        /* Did the timer already overrun? */
+        if ((command->time - aTimer->startTime) > aTimer->period_us)
+        {
+          /* Schedule the timer to trigger the timeout event right away. */
+          aTimer->startTime = command->time - aTimer->period_us;
+        }
+        aTimer->running = true;
+        TimerTrackExpiry(aTimer);
+        break;
+
+      case TIMER_CMD_STOP:
+        /* Stop the timer. */
+        aTimer->running = false;
+        break;
+
+      case TIMER_CMD_DELETE:
+        /* Stop the timer and invalidate all handles to it. */
+        aTimer->running = false;
+        aTimer->generation++;
+        /* Defer returning the node to the free list until the current scan completed. */
+        atomic_store_explicit(&aTimer->nextFree, timerPoolRetired, memory_order_relaxed);
+        timerPoolRetired = (uint16_t)(aTimer - timerPool);
+        break;
+
+      default:
+        break;
+    }
+  }
+} /*** end of TimerApply ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a timer handle to its node in the timer pool. Should only be
+**            called from the scheduler thread.
+** \param     timer Timer handle.
+** \return    Pointer to the timer node if the handle is valid, NULL if the handle does
+**            not belong to a currently existing timer.
+**
+****************************************************************************************/
+static tTimerNode * TimerLookup(tTimer timer)
+{
+  tTimerNode * result = NULL;
+  uintptr_t handle = (uintptr_t)timer;
+  uintptr_t idx;
+  uint16_t generation;
+
+  /* Extract the pool index and the generation from the handle. */
+  idx = (handle & TIMER_HANDLE_INDEX_MASK);
+  generation = (uint16_t)(handle >> TIMER_HANDLE_INDEX_BITS);
+
+  /* Only continue with an index that lies within the pool. Keep in mind that the index
+   * is stored plus one in the handle.
+   */
+  if ( (idx > 0) && (idx <= TIMER_POOL_SIZE) )
+  {
+    /* Only give the node back if its generation still matches. The generation changes
+     * as soon as the timer is deleted.
+     */
+    if (timerPool[idx - 1].generation == generation)
+    {
+      result = &timerPool[idx - 1];
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TimerLookup ***/
+
+
+/************************************************************************************//**
+** \brief     Pushes a node back onto the lock-free free list. Should only be called from
+**            the scheduler thread.
+** \param     idx Pool index of the node.
+**
+****************************************************************************************/
+static void TimerPoolRelease(uint16_t idx)
+{
+  uint_fast32_t oldHead;
+  uint_fast32_t newHead;
+
+  /* Clear the callbacks, such that a stale node never invokes them. */
+  timerPool[idx].callbackFcn = NULL;
+  timerPool[idx].contextCallbackFcn = NULL;
+  timerPool[idx].context = NULL;
+  timerPool[idx].batched = false;
+
+  /* Push the node onto the free list. The release ordering publishes the updated
+   * generation to the thread that pops the node again.
+   */
+  oldHead = atomic_load_explicit(&timerPoolFree, memory_order_relaxed);
+  do
+  {
+    atomic_store_explicit(&timerPool[idx].nextFree, 
+                          (uint16_t)(oldHead & TIMER_HANDLE_INDEX_MASK),
+                          memory_order_relaxed);
+    newHead = (((oldHead >> TIMER_HANDLE_INDEX_BITS) + 1U) << TIMER_HANDLE_INDEX_BITS) |
+              idx;
+  }
+  while (!atomic_compare_exchange_weak_explicit(&timerPoolFree, &oldHead, newHead,
+                                                memory_order_release,
+                                                memory_order_relaxed));
+} /*** end of TimerPoolRelease ***/
+
+
+/************************************************************************************//**
+** \brief     Pops a node from the lock-free free list and constructs its handle. The
+**            callbacks of the node are cleared. Can be called from any thread.
+** \param     node Pointer to where the pointer to the obtained node is stored.
+** \return    Timer handle if successful, NULL if the pool is exhausted.
+**
+****************************************************************************************/
+static tTimer TimerPoolAllocate(tTimerNode ** node)
+{
+  tTimer result = NULL;
+  tTimerNode * newTimer = NULL;
+  uint_fast32_t oldHead;
+  uint_fast32_t newHead;
+  unsigned int used;
+  uint16_t idx;
+
+  /* Pop a node from the free list, if one is still available. */
+  oldHead = atomic_load_explicit(&timerPoolFree, memory_order_acquire);
+  do
+  {
+    idx = (uint16_t)(oldHead & TIMER_HANDLE_INDEX_MASK);
+    if (idx == TIMER_POOL_END)
+    {
+      break;
+    }
+    newHead = (((oldHead >> TIMER_HANDLE_INDEX_BITS) + 1U) << TIMER_HANDLE_INDEX_BITS) |
+              atomic_load_explicit(&timerPool[idx].nextFree, memory_order_relaxed);
+  }
+  while (!atomic_compare_exchange_weak_explicit(&timerPoolFree, &oldHead, newHead,
+                                                memory_order_acquire,
+                                                memory_order_acquire));
+
+  /* Was a node obtained from the free list? */
+  if (idx != TIMER_POOL_END)
+  {
+    newTimer = &timerPool[idx];
+    /* Extend the part of the pool that the polling thread scans, if needed. */
+    used = atomic_load(&timerPoolUsed);
+    while (idx >= used)
+    {
+      if (atomic_compare_exchange_weak(&timerPoolUsed, &used, (unsigned int)idx + 1U))
+      {
+        break;
+      }
+    }
+
+    /* Initialize the timer. The scheduler thread does not look at the node before it
+     * receives a command for it, so it is safe to access it here.
+     */
+    newTimer->startTime = 0;
+    newTimer->period_us = 0;
+    newTimer->callbackFcn = NULL;
+    newTimer->contextCallbackFcn = NULL;
+    newTimer->context = NULL;
+    newTimer->batched = false;
+
+    /* Construct the handle from the generation and the pool index. */
+    result = TIMER_HANDLE(newTimer->generation, idx);
+  }
+
+  /* Give the node back to the caller. */
+  *node = newTimer;
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TimerPoolAllocate ***/
+
+
 /*********************************** end of timer.c ************************************/
@@ -10,15 +10,57 @@
 extern "C" {
 #endif
 
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of timers that can exist at the same time. The timer nodes are
+ *  taken from a fixed-capacity pool, so creating and deleting timers at runtime never
+ *  calls the heap allocator. Can be overridden at build time. Must not exceed 65535.
+ */
+#ifndef TIMER_POOL_SIZE
+#define TIMER_POOL_SIZE      (256U)
+#endif
+
+/** \brief Set to 1 to touch all timer pool nodes in TimerInit, such that the pool's
+ *  memory is paged in before the first timer is created. Can be overridden at build
+ *  time.
+ */
+#ifndef TIMER_POOL_PREALLOC
+#define TIMER_POOL_PREALLOC  (1U)
+#endif
+
+
 /****************************************************************************************
 * Type definitions
 ****************************************************************************************/
-/** \brief Timer handle type. */
+/** \brief Timer handle type. Encodes the pool index and the generation of the timer
+ *  node, such that a handle of an already deleted timer is detected and ignored.
+ */
 typedef void * tTimer;
 
 /** \brief Function type for the timer event callback handler. */
 typedef void (* tTimerEventCallback)(void);
 
+/** \brief Function type for the timer event callback handler with user context. The
+ *  same handler can be shared by many timers, because it receives the handle and the
+ *  context pointer of the timer that expired.
+ */
+typedef void (* tTimerContextCallback)(tTimer timer, void * context);
+
+/** \brief Information about one expired timer, as passed to the batch callback. */
+typedef struct
+{
+  /** \brief Handle of the timer that expired. */
+  tTimer timer;
+  /** \brief Context pointer that was specified when creating the timer. */
+  void * context;
+} tTimerExpiry;
+
+/** \brief Function type for the batch event callback handler. Called once with all
+ *  batched timers that expired during the same scheduler pass.
+ */
+typedef void (* tTimerBatchCallback)(tTimerExpiry const * expired, size_t count);
+
 
 /****************************************************************************************
 * Function prototypes
@@ -26,10 +68,14 @@ typedef void (* tTimerEventCallback)(void);
 void   TimerInit(void);
 void   TimerTerminate(void);
 tTimer TimerCreate(tTimerEventCallback callbackFcn);
+tTimer TimerCreateContext(tTimerContextCallback callbackFcn, void * context);
+tTimer TimerCreateBatched(void * context);
+void   TimerSetBatchCallback(tTimerBatchCallback callbackFcn);
 void   TimerDelete(tTimer timer);
 void   TimerStart(tTimer timer, uint32_t period);
 void   TimerRestart(tTimer timer);
 void   TimerStop(tTimer timer);
+void   TimerAdvance(uint64_t now);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,676 @@
+/************************************************************************************//**
+* \file         trigger.c
+* \brief        Pre/post-trigger capture source file.
+* \details      Continuously keeps the most recent CAN messages in a fixed-size ring in
+*               memory, so that the CAN messages around a fault can be written to disk,
+*               without logging everything. The ring is allocated once, when the capture
+*               starts, and holds the pre-trigger and post-trigger windows. Storing a CAN
+*               message takes a few atomic increments and a copy into the ring, without
+*               locks or allocations.
+*
+*               When the application calls TriggerFire(), the CAN messages before the
+*               trigger are kept and the ring fills up with the CAN messages after it,
+*               until the post-trigger window is complete. From then on, CAN messages are
+*               no longer stored, until a writer thread wrote both windows to a binary log
+*               file. Afterwards, the capture is armed again for the next trigger. Like an
+*               oscilloscope in single shot mode, triggers in the meantime are ignored.
+*
+*               Each slot of the ring holds a sequence number next to the record. It is
+*               zero while the record is being stored, and the index plus one afterwards.
+*               The writer thread only writes records with the expected sequence number,
+*               before and after copying them. A slot that was never filled or that was
+*               overwritten in the meantime is skipped, instead of writing a torn record.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <limits.h>                         /* for PATH_MAX                            */
+#include <time.h>                           /* Date and time utilities                 */
+#include <fcntl.h>                          /* File control options                    */
+#include <unistd.h>                         /* UNIX standard functions                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "util.h"                           /* Utility functions                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+#include "trigger.h"                        /* Pre/post-trigger capture                */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Value of an invalid file descriptor. */
+#define TRIGGER_INVALID_FD             (-1)
+
+/** \brief Value of the end index, while the capture is armed and waits for a trigger. */
+#define TRIGGER_ARMED                  (UINT64_MAX)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Slot of the ring. */
+typedef struct
+{
+  /** \brief Index of the stored record plus one, or zero while it is being stored. */
+  atomic_uint_fast64_t sequence;
+  /** \brief The stored record. */
+  tLoggerRecord        record;
+} tTriggerSlot;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Ring with the most recent CAN messages. Kept until TriggerTerminate(), since
+ *  TriggerMessage() can still be storing into it when TriggerStop() returns.
+ */
+static tTriggerSlot * triggerRing;
+
+/** \brief Number of slots in the ring. Always a power of two. */
+static size_t triggerCapacity;
+
+/** \brief Set while the capture runs and accepts CAN messages. */
+static atomic_bool triggerRunning;
+
+/** \brief Atomic boolean that is used to inform the writer thread to stop running. */
+static atomic_bool triggerStopWriter;
+
+/** \brief Set while the capture waits for a trigger. */
+static atomic_bool triggerArmed;
+
+/** \brief Index of the next CAN message. Keeps counting, also when CAN messages are not
+ *  stored, so the slot of each index stays the same.
+ */
+static atomic_uint_fast64_t triggerHead;
+
+/** \brief Number of CAN messages that are being stored at this moment. The writer thread
+ *  waits for it to drop to zero, before it reads the ring.
+ */
+static atomic_size_t triggerStoring;
+
+/** \brief Index of the first CAN message that is not part of the post-trigger window,
+ *  or TRIGGER_ARMED while waiting for a trigger.
+ */
+static atomic_uint_fast64_t triggerEnd;
+
+/** \brief Index of the first CAN message after the trigger. */
+static atomic_uint_fast64_t triggerIndex;
+
+/** \brief Time of the trigger in microseconds, relative to the start of the CAN
+ *  communication, just like the timestamps of the CAN messages.
+ */
+static atomic_uint_fast64_t triggerTime;
+
+/** \brief Mutex and condition variable for waiting on a trigger. They exist from
+ *  TriggerInit() to TriggerTerminate(), because TriggerFire() locks the mutex without
+ *  holding off a concurrent TriggerStop().
+ */
+static mtx_t triggerMutex;
+static cnd_t triggerCondition;
+
+/** \brief Identifier of the writer thread. */
+static thrd_t triggerThreadId;
+
+/** \brief Configuration of the capture. The prefix points to triggerPrefix. */
+static tTriggerConfig triggerConfig;
+
+/** \brief Copy of the path and file name prefix of the capture files. */
+static char triggerPrefix[PATH_MAX];
+
+/** \brief Block with the records that the writer thread collected. */
+static tLoggerRecord triggerBlock[TRIGGER_BLOCK_RECORDS];
+
+/** \brief Number of records in the block. */
+static size_t triggerBlockCount;
+
+/** \brief File descriptor of the current capture file. Only used by the writer thread. */
+static int triggerFd;
+
+/** \brief Sequence number of the next capture file. */
+static uint32_t triggerFileIndex;
+
+/** \brief Counters that the application updates. */
+static atomic_uint_fast64_t triggerTriggers;
+static atomic_uint_fast64_t triggerIgnored;
+
+/** \brief Counters that the writer thread updates. */
+static atomic_uint_fast64_t triggerFiles;
+static atomic_uint_fast64_t triggerWritten;
+static atomic_uint_fast64_t triggerWriteErrors;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static int    TriggerWriterThread(void * param);
+static void   TriggerLimitEnd(uint64_t end);
+static void   TriggerFlush(void);
+static void   TriggerWriteBlock(void);
+static bool   TriggerOpenFile(char * path, size_t size);
+
+
+/************************************************************************************//**
+** \brief     Initializes the pre/post-trigger capture. Capturing does not start until
+**            TriggerStart() is called.
+**
+****************************************************************************************/
+void TriggerInit(void)
+{
+  /* Initialize locals. */
+  triggerRing = NULL;
+  triggerCapacity = 0;
+  atomic_init(&triggerRunning, false);
+  atomic_init(&triggerStopWriter, false);
+  atomic_init(&triggerArmed, false);
+  atomic_init(&triggerHead, 0);
+  atomic_init(&triggerStoring, 0);
+  atomic_init(&triggerEnd, TRIGGER_ARMED);
+  atomic_init(&triggerIndex, 0);
+  atomic_init(&triggerTime, 0);
+  atomic_init(&triggerTriggers, 0);
+  atomic_init(&triggerIgnored, 0);
+  atomic_init(&triggerFiles, 0);
+  atomic_init(&triggerWritten, 0);
+  atomic_init(&triggerWriteErrors, 0);
+  triggerBlockCount = 0;
+  triggerFd = TRIGGER_INVALID_FD;
+  triggerFileIndex = 0;
+  if ( (mtx_init(&triggerMutex, mtx_plain) != thrd_success) ||
+       (cnd_init(&triggerCondition) != thrd_success) )
+  {
+    assert(false);
+  }
+} /*** end of TriggerInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates the pre/post-trigger capture. Stops capturing, in case it still
+**            runs.
+**
+****************************************************************************************/
+void TriggerTerminate(void)
+{
+  /* Stop capturing. */
+  TriggerStop();
+
+  /* Release the ring, the mutex and the condition variable. */
+  free(triggerRing);
+  triggerRing = NULL;
+  triggerCapacity = 0;
+  cnd_destroy(&triggerCondition);
+  mtx_destroy(&triggerMutex);
+} /*** end of TriggerTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts keeping the most recent CAN messages in memory and arms the trigger.
+**            Call it from OnPreStart to capture all CAN messages from the start. The
+**            ring is allocated upon the first start. Later starts must not need more
+**            slots. A time limit after the trigger also needs a frame limit, because
+**            that determines how much room the ring has for the post-trigger window.
+** \param     config Pointer to the capture configuration.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool TriggerStart(tTriggerConfig const * config)
+{
+  bool result = false;
+  size_t frames;
+  size_t capacity = 1U;
+
+  /* Verify parameter. */
+  assert(config != NULL);
+
+  /* Only continue with valid parameter and when not yet running. */
+  if ( (config != NULL) && (config->prefix != NULL) && (!atomic_load(&triggerRunning)) &&
+       (strlen(config->prefix) < sizeof(triggerPrefix)) &&
+       (config->preFrames <= (SIZE_MAX / 4U)) &&
+       (config->postFrames <= (SIZE_MAX / 4U)) &&
+       ( (config->postFrames > 0) || (config->postTime == 0) ) )
+  {
+    /* The ring must hold both windows. Round it up to a power of two. */
+    frames = config->preFrames + config->postFrames;
+    while (capacity < frames)
+    {
+      capacity <<= 1;
+    }
+    /* Allocate the ring upon first use. */
+    if (triggerRing == NULL)
+    {
+      triggerRing = malloc(capacity * sizeof(tTriggerSlot));
+      if (triggerRing != NULL)
+      {
+        triggerCapacity = capacity;
+      }
+    }
+    if ( (triggerRing != NULL) && (capacity <= triggerCapacity) )
+    {
+      /* Store the configuration. */
+      strcpy(triggerPrefix, config->prefix);
+      triggerConfig = *config;
+      triggerConfig.prefix = triggerPrefix;
+      /* Empty the ring. */
+      for (size_t idx = 0; idx < triggerCapacity; idx++)
+      {
+        atomic_init(&triggerRing[idx].sequence, 0);
+      }
+      atomic_store(&triggerHead, 0);
+      atomic_store(&triggerEnd, TRIGGER_ARMED);
+
+      /* Start the writer thread. */
+      atomic_store(&triggerStopWriter, false);
+      if (thrd_create(&triggerThreadId, TriggerWriterThread, NULL) == thrd_success)
+      {
+        atomic_store(&triggerArmed, true);
+        atomic_store(&triggerRunning, true);
+        result = true;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TriggerStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops capturing. When a trigger fired, the writer thread first writes what
+**            it has of both windows.
+**
+****************************************************************************************/
+void TriggerStop(void)
+{
+  /* Only continue if running. */
+  if (atomic_load(&triggerRunning))
+  {
+    /* No longer accept CAN messages and triggers. */
+    atomic_store(&triggerRunning, false);
+    atomic_store(&triggerArmed, false);
+
+    /* Request the writer thread to stop and wait until it terminated. */
+    mtx_lock(&triggerMutex);
+    atomic_store(&triggerStopWriter, true);
+    cnd_signal(&triggerCondition);
+    mtx_unlock(&triggerMutex);
+    thrd_join(triggerThreadId, NULL);
+  }
+} /*** end of TriggerStop ***/
+
+
+/************************************************************************************//**
+** \brief     Stores a CAN message in the ring. Never blocks. Can be called from any
+**            thread.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+** \return    True if the CAN message was stored, false if the capture does not run, is
+**            not configured to capture transmitted CAN messages or the post-trigger
+**            window is already complete.
+**
+****************************************************************************************/
+bool TriggerMessage(tCanMsg const * msg, bool transmitted)
+{
+  bool result = false;
+  uint64_t index;
+  uint64_t end;
+  tTriggerSlot * slot;
+
+  /* Verify parameter. */
+  assert(msg != NULL);
+
+  /* Only continue with valid parameter and when running. */
+  if ( (msg != NULL) && (atomic_load_explicit(&triggerRunning, memory_order_acquire)) &&
+       ( (!transmitted) || (triggerConfig.logTransmitted) ) )
+  {
+    /* Claim the next index and determine if it still belongs in the ring. Announce the
+     * store first, so the writer thread knows to wait for it, once it sees the index.
+     */
+    atomic_fetch_add(&triggerStoring, 1);
+    index = atomic_fetch_add(&triggerHead, 1);
+    end = atomic_load(&triggerEnd);
+    result = (index < end);
+    /* End the post-trigger window, once its time passed. */
+    if ( (result) && (end != TRIGGER_ARMED) && (triggerConfig.postTime > 0) &&
+         (msg->timestamp > (atomic_load(&triggerTime) +
+                            ((uint64_t)triggerConfig.postTime * 1000U))) )
+    {
+      TriggerLimitEnd(index);
+      result = false;
+    }
+
+    if (result)
+    {
+      /* Invalidate the slot, before its record changes. */
+      slot = &triggerRing[index & (triggerCapacity - 1U)];
+      atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+      atomic_thread_fence(memory_order_release);
+      /* Convert the CAN message to a record and publish it. */
+      WriterMakeRecord(&slot->record, msg, transmitted);
+      atomic_store_explicit(&slot->sequence, index + 1U, memory_order_release);
+    }
+    atomic_fetch_sub_explicit(&triggerStoring, 1, memory_order_release);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TriggerMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Fires the trigger. The CAN messages of the pre-trigger window are kept and
+**            the post-trigger window starts. Never blocks on disk access. Can be called
+**            from any thread, for example from OnMessage upon an error frame.
+** \return    True if the trigger was accepted, false if the capture does not run or
+**            the previous trigger is still being handled.
+**
+****************************************************************************************/
+bool TriggerFire(void)
+{
+  bool result = false;
+  bool expected = true;
+  uint64_t index;
+
+  /* Only continue when running. */
+  if (atomic_load(&triggerRunning))
+  {
+    /* Accept the trigger, when armed. */
+    if (atomic_compare_exchange_strong(&triggerArmed, &expected, false))
+    {
+      /* Mark the start of the post-trigger window, before it can end. */
+      atomic_store(&triggerTime, UtilSystemTime() - CanStartTime());
+      index = atomic_load(&triggerHead);
+      atomic_store(&triggerIndex, index);
+      atomic_store(&triggerEnd, index + triggerConfig.postFrames);
+      atomic_fetch_add(&triggerTriggers, 1);
+      /* Wake up the writer thread, so it watches the post-trigger window. */
+      mtx_lock(&triggerMutex);
+      cnd_signal(&triggerCondition);
+      mtx_unlock(&triggerMutex);
+      result = true;
+    }
+    else
+    {
+      atomic_fetch_add(&triggerIgnored, 1);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TriggerFire ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the pre/post-trigger capture statistics. Can be called from any
+**            thread.
+** \param     stats Pointer to where the statistics are stored.
+**
+****************************************************************************************/
+void TriggerGetStats(tTriggerStats * stats)
+{
+  /* Verify parameter. */
+  assert(stats != NULL);
+
+  /* Only continue with valid parameter. */
+  if (stats != NULL)
+  {
+    stats->triggers = atomic_load(&triggerTriggers);
+    stats->ignored = atomic_load(&triggerIgnored);
+    stats->files = atomic_load(&triggerFiles);
+    stats->written = atomic_load(&triggerWritten);
+    stats->writeErrors = atomic_load(&triggerWriteErrors);
+  }
+} /*** end of TriggerGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Writer thread that waits for a trigger and writes both windows to a capture
+**            file, once the post-trigger window is complete.
+** \param     param Thread parameter (not used).
+** \return    Thread return value.
+**
+****************************************************************************************/
+static int TriggerWriterThread(void * param)
+{
+  struct timespec deadline;
+  uint64_t now;
+  uint64_t postTime = (uint64_t)triggerConfig.postTime * 1000U;
+
+  /* Enter the thread's loop and run it, until a stop is requested and a pending trigger
+   * is handled.
+   */
+  while (true)
+  {
+    if (atomic_load(&triggerEnd) != TRIGGER_ARMED)
+    {
+      /* End the post-trigger window, once its time passed without CAN messages to end
+       * it, or when a stop is requested.
+       */
+      now = UtilSystemTime() - CanStartTime();
+      if ( (atomic_load(&triggerStopWriter)) ||
+           ( (postTime > 0) && (now > (atomic_load(&triggerTime) + postTime)) ) )
+      {
+        TriggerLimitEnd(atomic_load(&triggerHead));
+      }
+      /* Write both windows, once all CAN messages of the post-trigger window arrived. */
+      if (atomic_load(&triggerHead) >= atomic_load(&triggerEnd))
+      {
+        TriggerFlush();
+        continue;
+      }
+    }
+    else if (atomic_load(&triggerStopWriter))
+    {
+      break;
+    }
+    /* Wait for a trigger or check the post-trigger window again after the poll
+     * interval.
+     */
+    mtx_lock(&triggerMutex);
+    if (atomic_load(&triggerEnd) == TRIGGER_ARMED)
+    {
+      while ( (atomic_load(&triggerEnd) == TRIGGER_ARMED) &&
+              (!atomic_load(&triggerStopWriter)) )
+      {
+        cnd_wait(&triggerCondition, &triggerMutex);
+      }
+    }
+    else if (!atomic_load(&triggerStopWriter))
+    {
+      (void)timespec_get(&deadline, TIME_UTC);
+      deadline.tv_nsec += (long)(TRIGGER_POLL_INTERVAL % 1000U) * 1000000L;
+      deadline.tv_sec += (time_t)(TRIGGER_POLL_INTERVAL / 1000U) +
+                         (time_t)(deadline.tv_nsec / 1000000000L);
+      deadline.tv_nsec %= 1000000000L;
+      (void)cnd_timedwait(&triggerCondition, &triggerMutex, &deadline);
+    }
+    mtx_unlock(&triggerMutex);
+  }
+
+  /* Shut down the thread. */
+  thrd_exit(EXIT_SUCCESS);
+} /*** end of TriggerWriterThread ***/
+
+
+/************************************************************************************//**
+** \brief     Ends the post-trigger window at the specified index, unless it already
+**            ends before it.
+** \param     end Index of the first CAN message that is no longer part of the window.
+**
+****************************************************************************************/
+static void TriggerLimitEnd(uint64_t end)
+{
+  uint64_t current = atomic_load(&triggerEnd);
+
+  /* Lower the end index, unless another thread lowered it further in the meantime. */
+  while ( (end < current) &&
+          (!atomic_compare_exchange_weak(&triggerEnd, &current, end)) )
+  {
+    ;
+  }
+} /*** end of TriggerLimitEnd ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the CAN messages of both windows to a new capture file, informs the
+**            application and arms the trigger again.
+**
+****************************************************************************************/
+static void TriggerFlush(void)
+{
+  char path[PATH_MAX] = "";
+  uint64_t index = atomic_load(&triggerIndex);
+  uint64_t end = atomic_load(&triggerEnd);
+  uint64_t time = atomic_load(&triggerTime);
+  uint64_t preTime = (uint64_t)triggerConfig.preTime * 1000U;
+  uint64_t start;
+  uint64_t written;
+  uint64_t sequence;
+  tTriggerSlot * slot;
+
+  /* CAN messages of the windows might still be in the process of being stored. Wait
+   * until they are. Storing one takes no longer than a copy.
+   */
+  while (atomic_load_explicit(&triggerStoring, memory_order_acquire) != 0)
+  {
+    thrd_yield();
+  }
+
+  /* Create the capture file and collect the valid records of both windows. */
+  written = atomic_load(&triggerWritten);
+  if (TriggerOpenFile(path, sizeof(path)))
+  {
+    start = (index > triggerConfig.preFrames) ? (index - triggerConfig.preFrames) : 0U;
+    for (uint64_t idx = start; idx < end; idx++)
+    {
+      slot = &triggerRing[idx & (triggerCapacity - 1U)];
+      sequence = idx + 1U;
+      if (atomic_load_explicit(&slot->sequence, memory_order_acquire) == sequence)
+      {
+        triggerBlock[triggerBlockCount] = slot->record;
+        /* Only keep the record, if it did not change while copying it. */
+        atomic_thread_fence(memory_order_acquire);
+        if ( (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == sequence) &&
+             ( (preTime == 0) || (idx >= index) ||
+               ((triggerBlock[triggerBlockCount].timestamp + preTime) >= time) ) )
+        {
+          if (++triggerBlockCount == TRIGGER_BLOCK_RECORDS)
+          {
+            TriggerWriteBlock();
+          }
+        }
+      }
+    }
+    TriggerWriteBlock();
+    close(triggerFd);
+    triggerFd = TRIGGER_INVALID_FD;
+  }
+  else
+  {
+    path[0] = '\0';
+  }
+
+  /* Inform the application. */
+  if (triggerConfig.doneFcn != NULL)
+  {
+    triggerConfig.doneFcn(path, (size_t)(atomic_load(&triggerWritten) - written),
+                          triggerConfig.context);
+  }
+
+  /* Arm the trigger again, unless the capture stops. */
+  atomic_store(&triggerEnd, TRIGGER_ARMED);
+  if (atomic_load(&triggerRunning))
+  {
+    atomic_store(&triggerArmed, true);
+  }
+} /*** end of TriggerFlush ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the collected records to the capture file.
+**
+****************************************************************************************/
+static void TriggerWriteBlock(void)
+{
+  /* Write the records. */
+  if (triggerBlockCount > 0)
+  {
+    if (UtilWriteAll(triggerFd, triggerBlock, triggerBlockCount * sizeof(tLoggerRecord)))
+    {
+      atomic_fetch_add(&triggerWritten, triggerBlockCount);
+    }
+    else
+    {
+      atomic_fetch_add(&triggerWriteErrors, triggerBlockCount);
+    }
+  }
+
+  /* The block is empty again. */
+  triggerBlockCount = 0;
+} /*** end of TriggerWriteBlock ***/
+
+
+/************************************************************************************//**
+** \brief     Creates a new capture file and writes its header. The file name is based on
+**            the time of the trigger.
+** \param     path Buffer where the path of the capture file is stored.
+** \param     size Size of the buffer.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool TriggerOpenFile(char * path, size_t size)
+{
+  bool result = false;
+  char timeText[32];
+  tLoggerFileHeader header = { 0 };
+  time_t seconds = (time_t)((CanStartTime() + atomic_load(&triggerTime)) / 1000000U);
+  struct tm localTime;
+
+  /* Construct the file name from the prefix, the local time and the sequence number. */
+  if (localtime_r(&seconds, &localTime) == NULL)
+  {
+    memset(&localTime, 0, sizeof(localTime));
+  }
+  (void)strftime(timeText, sizeof(timeText), "%Y%m%d_%H%M%S", &localTime);
+  if (snprintf(path, size, "%s_%s_%04u.clog", triggerPrefix, timeText,
+               triggerFileIndex) < (int)size)
+  {
+    triggerFileIndex++;
+    /* Create the capture file. */
+    triggerFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (triggerFd != TRIGGER_INVALID_FD)
+    {
+      atomic_fetch_add(&triggerFiles, 1);
+      /* Write the file header. */
+      memcpy(header.magic, LOGGER_MAGIC, sizeof(header.magic));
+      header.version = LOGGER_VERSION;
+      header.recordSize = sizeof(tLoggerRecord);
+      header.startTime = CanStartTime();
+      if (UtilWriteAll(triggerFd, &header, sizeof(header)))
+      {
+        result = true;
+      }
+      else
+      {
+        close(triggerFd);
+        triggerFd = TRIGGER_INVALID_FD;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of TriggerOpenFile ***/
+
+
+/*********************************** end of trigger.c **********************************/
@@ -0,0 +1,102 @@
+/************************************************************************************//**
+* \file         trigger.h
+* \brief        Pre/post-trigger capture header file.
+*
+****************************************************************************************/
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of records that the writer thread collects, before writing them to the
+ *  capture file with one system call.
+ */
+#ifndef TRIGGER_BLOCK_RECORDS
+#define TRIGGER_BLOCK_RECORDS          (8192U)
+#endif
+
+/** \brief Interval in milliseconds at which the writer thread checks if the time of the
+ *  post-trigger window passed, when no CAN messages arrive to end it.
+ */
+#ifndef TRIGGER_POLL_INTERVAL
+#define TRIGGER_POLL_INTERVAL          (10U)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of the callback that is called, once the CAN messages around a
+ *  trigger were written. The path is empty, if no capture file could be written.
+ */
+typedef void (* tTriggerDoneCallback)(char const * path, size_t count, void * context);
+
+/** \brief Configuration of the pre/post-trigger capture. */
+typedef struct
+{
+  /** \brief Path and file name prefix of the capture files. The date, time and a
+   *  sequence number are appended to it, for example "/var/log/fault_20240131_235959_
+   *  0001.clog". They are binary log files, just like the ones of the logger.
+   */
+  char const *         prefix;
+  /** \brief Maximum number of CAN messages before the trigger. */
+  size_t               preFrames;
+  /** \brief Maximum number of CAN messages after the trigger. Must not be 0 when
+   *  postTime is set.
+   */
+  size_t               postFrames;
+  /** \brief Maximum time in milliseconds before the trigger, or 0 for no time limit. */
+  uint32_t             preTime;
+  /** \brief Maximum time in milliseconds after the trigger, or 0 for no time limit. */
+  uint32_t             postTime;
+  /** \brief True to also capture the transmitted CAN messages. */
+  bool                 logTransmitted;
+  /** \brief Optional callback that is called from the writer thread, once a capture
+   *  file was written, or NULL.
+   */
+  tTriggerDoneCallback doneFcn;
+  /** \brief Context pointer that is passed to the callback. */
+  void               * context;
+} tTriggerConfig;
+
+/** \brief Pre/post-trigger capture statistics. */
+typedef struct
+{
+  /** \brief Number of triggers that were accepted. */
+  uint64_t triggers;
+  /** \brief Number of triggers that were ignored, because the previous one was still
+   *  being handled.
+   */
+  uint64_t ignored;
+  /** \brief Number of capture files that were written. */
+  uint64_t files;
+  /** \brief Number of records that were written to the capture files. */
+  uint64_t written;
+  /** \brief Number of records that were lost, because writing them failed. */
+  uint64_t writeErrors;
+} tTriggerStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void TriggerInit(void);
+void TriggerTerminate(void);
+bool TriggerStart(tTriggerConfig const * config);
+void TriggerStop(void);
+bool TriggerMessage(tCanMsg const * msg, bool transmitted);
+bool TriggerFire(void);
+void TriggerGetStats(tTriggerStats * stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRIGGER_H */
+/*********************************** end of trigger.h **********************************/
@@ -11,11 +11,24 @@
 #include <stdint.h>                         /* for standard integer types              */
 #include <stddef.h>                         /* for NULL declaration                    */
 #include <stdbool.h>                        /* for boolean type                        */
+#include <errno.h>                          /* Error numbers                           */
+#include <unistd.h>                         /* UNIX standard functions                 */
 #include <time.h>                           /* Date and time utilities                 */
 #include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
 #include "util.h"                           /* Utility functions                       */
 
 
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Set once the virtual clock is used instead of the system time. */
+static atomic_bool utilVirtualClock;
+
+/** \brief Current time of the virtual clock in microseconds. */
+static atomic_uint_fast64_t utilVirtualNow;
+
+
 /************************************************************************************//**
 ** \brief     Sleeps the current thread for the specified amount of microseconds.
 ** \param     micros Amount of microseconds to sleep.
@@ -38,7 +51,8 @@ void UtilSleep(uint32_t micros)
 
 
 /************************************************************************************//**
-** \brief     Gets the current system time in microseconds.
+** \brief     Gets the current system time in microseconds, or the time of the virtual
+**            clock once it is used. See UtilSetVirtualTime().
 ** \return    System time in microseconds.
 **
 ****************************************************************************************/
@@ -47,8 +61,13 @@ uint64_t UtilSystemTime(void)
   uint64_t result = 0;
   struct timespec now;
 
+  /* Report the time of the virtual clock, if it is used. */
+  if (atomic_load_explicit(&utilVirtualClock, memory_order_acquire))
+  {
+    result = atomic_load_explicit(&utilVirtualNow, memory_order_acquire);
+  }
   /* Obtain the current time. */
-  if (timespec_get(&now, TIME_UTC) != 0)
+  else if (timespec_get(&now, TIME_UTC) != 0)
   {
     /* Convert to microseconds. */
     result = ((int64_t)now.tv_sec * 1000 * 1000) + ((int64_t)now.tv_nsec / 1000);
@@ -59,4 +78,74 @@ uint64_t UtilSystemTime(void)
 } /*** end of UtilSystemTime ***/
 
 
+/************************************************************************************//**
+** \brief     Sets the time of the virtual clock. The first call switches UtilSystemTime()
+**            over from the system time to the virtual clock, for the rest of the
+**            program run. This makes it possible to run the application in simulated
+**            time, for example from the timestamps of a log file.
+** \param     now New time of the virtual clock in microseconds.
+**
+****************************************************************************************/
+void UtilSetVirtualTime(uint64_t now)
+{
+  /* Set the time and use the virtual clock from now on. */
+  atomic_store_explicit(&utilVirtualNow, now, memory_order_release);
+  atomic_store_explicit(&utilVirtualClock, true, memory_order_release);
+} /*** end of UtilSetVirtualTime ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if UtilSystemTime() reports the time of the virtual clock.
+** \return    True if the virtual clock is used, false for the system time.
+**
+****************************************************************************************/
+bool UtilVirtualTime(void)
+{
+  /* Give the result back to the caller. */
+  return atomic_load(&utilVirtualClock);
+} /*** end of UtilVirtualTime ***/
+
+
+/************************************************************************************//**
+** \brief     Writes data to a file. Continues after partial writes and interruptions by
+**            a signal.
+** \param     fd File descriptor of the file.
+** \param     data Pointer to the data.
+** \param     size Number of bytes to write.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool UtilWriteAll(int fd, void const * data, size_t size)
+{
+  bool result = true;
+  uint8_t const * bytes = data;
+  ssize_t written;
+
+  /* Verify parameter. */
+  assert( (data != NULL) || (size == 0) );
+
+  /* Write until all data is written or an error occurred. */
+  while ( (size > 0) && (result) )
+  {
+    written = write(fd, bytes, size);
+    if (written > 0)
+    {
+      bytes += written;
+      size -= (size_t)written;
+    }
+    else if ( (written < 0) && (errno == EINTR) )
+    {
+      continue;
+    }
+    else
+    {
+      result = false;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of UtilWriteAll ***/
+
+
 /*********************************** end of util.c *************************************/
@@ -15,6 +15,9 @@ extern "C" {
 ****************************************************************************************/
 void     UtilSleep(uint32_t micros);
 uint64_t UtilSystemTime(void);
+void     UtilSetVirtualTime(uint64_t now);
+bool     UtilVirtualTime(void);
+bool     UtilWriteAll(int fd, void const * data, size_t size);
 
 
 #ifdef __cplusplus
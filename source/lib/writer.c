@@ -0,0 +1,367 @@
+/************************************************************************************//**
+* \file         writer.c
+* \brief        Asynchronous record writer source file.
+* \details      Shared by the logger and the capture writers, which must never block the
+*               thread that reports a CAN message. That thread only converts the CAN
+*               message to a record and appends it to a lock-free queue. A writer thread
+*               takes the records from the queue and passes them on to the record
+*               callback, which collects them into large blocks. Once the queue is empty,
+*               the flush callback writes what was collected. The writer thread sleeps
+*               until enough records are queued or the flush interval passed. When the
+*               disk cannot keep up, records are dropped and counted, instead of stalling
+*               the CAN reception.
+*
+*               The queue, the mutex and the condition variable live from WriterInit() up
+*               to WriterTerminate(), and not just while the writer runs. A thread that
+*               saw the writer running right before it stopped might still use them.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                         /* for assertions                          */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <time.h>                           /* Date and time utilities                 */
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "can.h"                            /* CAN driver                              */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+#include "logger.h"                         /* Asynchronous binary logger              */
+#include "writer.h"                         /* Asynchronous record writer              */
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static int WriterThread(void * param);
+
+
+/************************************************************************************//**
+** \brief     Initializes a writer. It does not start until WriterStart() is called.
+** \param     writer Pointer to the writer.
+** \param     config Pointer to the configuration. Must stay valid until the writer is
+**            terminated.
+**
+****************************************************************************************/
+void WriterInit(tWriter * writer, tWriterConfig const * config)
+{
+  /* Verify parameters. */
+  assert(writer != NULL);
+  assert(config != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (writer != NULL) && (config != NULL) )
+  {
+    /* Initialize the writer. The queue is only allocated upon first use. */
+    writer->config = config;
+    writer->queueAllocated = false;
+    atomic_init(&writer->running, false);
+    atomic_init(&writer->stopThread, false);
+    atomic_init(&writer->waiting, false);
+    atomic_init(&writer->queued, 0);
+    atomic_init(&writer->dropped, 0);
+    atomic_init(&writer->highWater, 0);
+    if ( (mtx_init(&writer->mutex, mtx_plain) != thrd_success) ||
+         (cnd_init(&writer->condition) != thrd_success) )
+    {
+      assert(false);
+    }
+  }
+} /*** end of WriterInit ***/
+
+
+/************************************************************************************//**
+** \brief     Terminates a writer. Stops it, in case it still runs, and releases its
+**            resources.
+** \param     writer Pointer to the writer.
+**
+****************************************************************************************/
+void WriterTerminate(tWriter * writer)
+{
+  /* Verify parameter. */
+  assert(writer != NULL);
+
+  /* Only continue with valid parameter. */
+  if (writer != NULL)
+  {
+    /* Stop the writer. */
+    WriterStop(writer);
+    /* Release the queue, the mutex and the condition variable. */
+    if (writer->queueAllocated)
+    {
+      RingTerminate(&writer->queue);
+      writer->queueAllocated = false;
+    }
+    cnd_destroy(&writer->condition);
+    mtx_destroy(&writer->mutex);
+  }
+} /*** end of WriterTerminate ***/
+
+
+/************************************************************************************//**
+** \brief     Starts the writer thread and accepts records from now on.
+** \param     writer Pointer to the writer.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+bool WriterStart(tWriter * writer)
+{
+  bool result = false;
+  tLoggerRecord record;
+
+  /* Verify parameter. */
+  assert(writer != NULL);
+
+  /* Only continue with valid parameter and when not yet running. */
+  if ( (writer != NULL) && (!atomic_load(&writer->running)) )
+  {
+    /* Allocate the queue upon first use. Otherwise discard records that were still
+     * reported while the writer stopped.
+     */
+    if (!writer->queueAllocated)
+    {
+      writer->queueAllocated = RingInit(&writer->queue, sizeof(tLoggerRecord),
+                                        writer->config->queueSize);
+    }
+    else
+    {
+      while (RingPop(&writer->queue, &record))
+      {
+        ;
+      }
+    }
+    /* Start the writer thread. */
+    if (writer->queueAllocated)
+    {
+      atomic_store(&writer->stopThread, false);
+      atomic_store(&writer->waiting, false);
+      if (thrd_create(&writer->threadId, WriterThread, writer) == thrd_success)
+      {
+        atomic_store(&writer->running, true);
+        result = true;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of WriterStart ***/
+
+
+/************************************************************************************//**
+** \brief     Stops accepting records. The writer thread handles all queued records and
+**            calls the close callback, before it stops.
+** \param     writer Pointer to the writer.
+**
+****************************************************************************************/
+void WriterStop(tWriter * writer)
+{
+  /* Verify parameter. */
+  assert(writer != NULL);
+
+  /* Only continue with valid parameter and if running. */
+  if ( (writer != NULL) && (atomic_load(&writer->running)) )
+  {
+    /* No longer accept records. */
+    atomic_store(&writer->running, false);
+    /* Request the writer thread to stop and wait until it terminated. */
+    mtx_lock(&writer->mutex);
+    atomic_store(&writer->stopThread, true);
+    cnd_signal(&writer->condition);
+    mtx_unlock(&writer->mutex);
+    thrd_join(writer->threadId, NULL);
+  }
+} /*** end of WriterStop ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if the writer runs and accepts records. Can be called from any
+**            thread.
+** \param     writer Pointer to the writer.
+** \return    True if running, false otherwise.
+**
+****************************************************************************************/
+bool WriterRunning(tWriter * writer)
+{
+  /* Give the result back to the caller. */
+  return atomic_load_explicit(&writer->running, memory_order_acquire);
+} /*** end of WriterRunning ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a record for the writer thread. Never blocks. Can be called from any
+**            thread, once the writer was started at least once.
+** \param     writer Pointer to the writer.
+** \param     record Pointer to the record.
+** \return    True if the record was queued, false if the queue is full.
+**
+****************************************************************************************/
+bool WriterPush(tWriter * writer, tLoggerRecord const * record)
+{
+  bool result = false;
+  size_t depth;
+
+  /* Verify parameters. */
+  assert(writer != NULL);
+  assert(record != NULL);
+
+  /* Only continue with valid parameters and an allocated queue. */
+  if ( (writer != NULL) && (record != NULL) && (writer->queueAllocated) )
+  {
+    if (RingPush(&writer->queue, record))
+    {
+      atomic_fetch_add_explicit(&writer->queued, 1, memory_order_relaxed);
+      /* Keep track of the highest queue depth. */
+      depth = RingCount(&writer->queue);
+      if (depth > atomic_load_explicit(&writer->highWater, memory_order_relaxed))
+      {
+        atomic_store_explicit(&writer->highWater, depth, memory_order_relaxed);
+      }
+      /* Wake up the writer thread once enough records are queued. It wakes up by itself
+       * after the flush interval. The fence pairs with the one in the writer thread, so
+       * that either this thread sees it waiting, or it sees the queued record.
+       */
+      atomic_thread_fence(memory_order_seq_cst);
+      if ( (depth >= writer->config->wakeCount) &&
+           (atomic_load_explicit(&writer->waiting, memory_order_relaxed)) )
+      {
+        mtx_lock(&writer->mutex);
+        cnd_signal(&writer->condition);
+        mtx_unlock(&writer->mutex);
+      }
+      result = true;
+    }
+    else
+    {
+      atomic_fetch_add_explicit(&writer->dropped, 1, memory_order_relaxed);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of WriterPush ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the queue statistics of a writer. Can be called from any thread.
+** \param     writer Pointer to the writer.
+** \param     stats Pointer to where the statistics are stored.
+**
+****************************************************************************************/
+void WriterGetStats(tWriter * writer, tWriterStats * stats)
+{
+  /* Verify parameters. */
+  assert(writer != NULL);
+  assert(stats != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (writer != NULL) && (stats != NULL) )
+  {
+    stats->queued = atomic_load(&writer->queued);
+    stats->dropped = atomic_load(&writer->dropped);
+    stats->highWater = atomic_load(&writer->highWater);
+  }
+} /*** end of WriterGetStats ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a CAN message to a record. The timestamp is taken over as is and
+**            the bus number is zero. Unused data bytes are cleared.
+** \param     record Pointer to where the record is stored.
+** \param     msg Pointer to the CAN message.
+** \param     transmitted True for a transmitted CAN message, false for a received one.
+**
+****************************************************************************************/
+void WriterMakeRecord(tLoggerRecord * record, tCanMsg const * msg, bool transmitted)
+{
+  /* Verify parameters. */
+  assert(record != NULL);
+  assert(msg != NULL);
+
+  /* Only continue with valid parameters. */
+  if ( (record != NULL) && (msg != NULL) )
+  {
+    record->timestamp = msg->timestamp;
+    record->id = msg->id;
+    record->len = (msg->len <= CAN_DATA_LEN_MAX) ? msg->len : CAN_DATA_LEN_MAX;
+    record->flags = (msg->ext ? LOGGER_FLAG_EXT : 0U) |
+                    (transmitted ? LOGGER_FLAG_TX : 0U);
+    record->bus = 0;
+    record->reserved = 0;
+    memset(record->data, 0, sizeof(record->data));
+    memcpy(record->data, msg->data, record->len);
+  }
+} /*** end of WriterMakeRecord ***/
+
+
+/************************************************************************************//**
+** \brief     Writer thread that passes the queued records on to the callbacks.
+** \param     param Pointer to the writer.
+** \return    Thread return value.
+**
+****************************************************************************************/
+static int WriterThread(void * param)
+{
+  tWriter * writer = param;
+  tWriterConfig const * config = writer->config;
+  struct timespec deadline;
+  tLoggerRecord record;
+
+  /* Enter the thread's loop and run it, until a stop is requested and all records are
+   * handled.
+   */
+  while (true)
+  {
+    /* Hand over the queued records. */
+    while (RingPop(&writer->queue, &record))
+    {
+      config->recordFcn(&record);
+    }
+    /* Queue is empty. Write what was collected, so no record waits longer than the
+     * flush interval.
+     */
+    config->flushFcn();
+    /* Done if a stop is requested. */
+    if (atomic_load(&writer->stopThread))
+    {
+      break;
+    }
+    /* Wait until enough records are queued or the flush interval passed. Set the
+     * waiting flag before looking at the queue, otherwise a record that is queued in
+     * between would not wake this thread up.
+     */
+    atomic_store_explicit(&writer->waiting, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    (void)timespec_get(&deadline, TIME_UTC);
+    deadline.tv_nsec += (long)(config->flushInterval % 1000U) * 1000000L;
+    deadline.tv_sec += (time_t)(config->flushInterval / 1000U) +
+                       (time_t)(deadline.tv_nsec / 1000000000L);
+    deadline.tv_nsec %= 1000000000L;
+    mtx_lock(&writer->mutex);
+    while ( (RingCount(&writer->queue) < config->wakeCount) &&
+            (!atomic_load(&writer->stopThread)) )
+    {
+      if (cnd_timedwait(&writer->condition, &writer->mutex, &deadline) != thrd_success)
+      {
+        break;
+      }
+    }
+    mtx_unlock(&writer->mutex);
+    atomic_store_explicit(&writer->waiting, false, memory_order_relaxed);
+  }
+
+  /* Let the user of the writer close its file and shut down the thread. */
+  if (config->closeFcn != NULL)
+  {
+    config->closeFcn();
+  }
+  thrd_exit(EXIT_SUCCESS);
+} /*** end of WriterThread ***/
+
+
+/*********************************** end of writer.c ***********************************/
@@ -0,0 +1,112 @@
+/************************************************************************************//**
+* \file         writer.h
+* \brief        Asynchronous record writer header file.
+*
+****************************************************************************************/
+#ifndef WRITER_H
+#define WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <threads.h>                        /* Multithreading                          */
+#include <stdatomic.h>                      /* Atomic operations                       */
+#include "ring.h"                           /* Lock-free ring buffer                   */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type that the writer thread calls for each queued record. */
+typedef void (* tWriterRecordCallback)(tLoggerRecord const * record);
+
+/** \brief Function type that the writer thread calls once the queue is empty, to write
+ *  what it collected so far.
+ */
+typedef void (* tWriterFlushCallback)(void);
+
+/** \brief Function type that the writer thread calls right before it stops, after the
+ *  last flush.
+ */
+typedef void (* tWriterCloseCallback)(void);
+
+/** \brief Configuration of a writer. */
+typedef struct
+{
+  /** \brief Number of records that the queue can hold. Must be a power of two. */
+  size_t queueSize;
+  /** \brief Number of queued records at which the writer thread is woken up. */
+  size_t wakeCount;
+  /** \brief Maximum time in milliseconds that a record waits in the queue. */
+  uint32_t flushInterval;
+  /** \brief Called for each queued record. */
+  tWriterRecordCallback recordFcn;
+  /** \brief Called once the queue is empty. */
+  tWriterFlushCallback flushFcn;
+  /** \brief Called right before the writer thread stops. Can be NULL. */
+  tWriterCloseCallback closeFcn;
+} tWriterConfig;
+
+/** \brief Writer statistics. */
+typedef struct
+{
+  /** \brief Number of records that were queued. */
+  uint64_t queued;
+  /** \brief Number of records that were dropped, because the queue was full. */
+  uint64_t dropped;
+  /** \brief Highest number of records that were queued at the same time. */
+  size_t   highWater;
+} tWriterStats;
+
+/** \brief Asynchronous record writer. A lock-free queue between the threads that report
+ *  the records and a writer thread that handles them.
+ */
+typedef struct
+{
+  /** \brief Configuration of the writer. */
+  tWriterConfig const * config;
+  /** \brief Queue with the records for the writer thread. */
+  tRing queue;
+  /** \brief Boolean flag to determine if the queue was allocated. */
+  bool queueAllocated;
+  /** \brief Set while the writer runs and accepts records. */
+  atomic_bool running;
+  /** \brief Atomic boolean that is used to inform the writer thread to stop running. */
+  atomic_bool stopThread;
+  /** \brief Set while the writer thread waits for records. */
+  atomic_bool waiting;
+  /** \brief Mutex and condition variable for waiting on records. */
+  mtx_t mutex;
+  cnd_t condition;
+  /** \brief Identifier of the writer thread. */
+  thrd_t threadId;
+  /** \brief Counters that the reporting threads update. */
+  atomic_uint_fast64_t queued;
+  atomic_uint_fast64_t dropped;
+  atomic_size_t highWater;
+} tWriter;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void WriterInit(tWriter * writer, tWriterConfig const * config);
+void WriterTerminate(tWriter * writer);
+bool WriterStart(tWriter * writer);
+void WriterStop(tWriter * writer);
+bool WriterRunning(tWriter * writer);
+bool WriterPush(tWriter * writer, tLoggerRecord const * record);
+void WriterGetStats(tWriter * writer, tWriterStats * stats);
+void WriterMakeRecord(tLoggerRecord * record, tCanMsg const * msg, bool transmitted);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WRITER_H */
+/*********************************** end of writer.h ***********************************/
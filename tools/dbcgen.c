@@ -0,0 +1,1388 @@
+/************************************************************************************//**
+* \file         dbcgen.c
+* \brief        Generator of CAN message decoders and encoders from a DBC file.
+* \details      Reads the CAN messages and signals of a DBC file and generates a C source
+*               and header file with a decoder and an encoder for each CAN message. The
+*               position, size, byte order, scaling and range of each signal are constants
+*               in the generated code. Decoding loads the data bytes into a 64-bit value
+*               once and extracts each signal with a constant shift and mask. The
+*               generated files also hold a table with all CAN messages and functions to
+*               register a handler for a CAN message with the message dispatcher.
+*
+*               Usage: dbcgen FILE.dbc DIRECTORY
+*
+*               For "vehicle.dbc" it writes "vehicle_dbc.c" and "vehicle_dbc.h" to the
+*               directory. The caplin_add_dbc() CMake function runs it at build time.
+*               Extended multiplexing and CAN FD messages are not supported.
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#define _GNU_SOURCE                         /* for getline()                           */
+#include <stdint.h>                         /* for standard integer types              */
+#include <stddef.h>                         /* for NULL declaration                    */
+#include <stdbool.h>                        /* for boolean type                        */
+#include <stdio.h>                          /* for standard input/output functions     */
+#include <stdlib.h>                         /* for standard library                    */
+#include <string.h>                         /* for string library                      */
+#include <ctype.h>                          /* for character classification            */
+#include <limits.h>                         /* for PATH_MAX                            */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum length of a name, including the string termination. */
+#define DBCGEN_NAME_MAX                (128U)
+
+/** \brief Maximum data length of a CAN message. */
+#define DBCGEN_LEN_MAX                 (8U)
+
+/** \brief Bit in the identifier of a DBC file that marks a 29-bit CAN identifier. */
+#define DBCGEN_EXT_FLAG                (0x80000000UL)
+
+/** \brief Value of a signal that is not multiplexed. */
+#define DBCGEN_NOT_MULTIPLEXED         (-1L)
+
+/** \brief Maximum length of a generated expression, including the string termination. */
+#define DBCGEN_EXPR_MAX                (1024U)
+
+/** \brief Column at which the comments behind the fields of a structure start. */
+#define DBCGEN_COMMENT_COLUMN          (44U)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Signal of a CAN message. */
+typedef struct
+{
+  /** \brief Name of the signal, used as the name of its field. */
+  char     name[DBCGEN_NAME_MAX];
+  /** \brief Unit of the signal. */
+  char     unit[DBCGEN_NAME_MAX];
+  /** \brief Start bit as specified in the DBC file. */
+  uint32_t start;
+  /** \brief Size in bits. */
+  uint32_t size;
+  /** \brief Shift of the signal in the 64-bit value with the data bytes. */
+  uint32_t shift;
+  /** \brief True for big endian (Motorola) byte order, false for little endian. */
+  bool     motorola;
+  /** \brief True for a signed raw value. */
+  bool     sign;
+  /** \brief Raw value type: 0 for an integer, 1 for a float and 2 for a double. */
+  int      valueType;
+  /** \brief True for the multiplexor signal of the CAN message. */
+  bool     multiplexor;
+  /** \brief Value of the multiplexor for which this signal is present, or
+   *  DBCGEN_NOT_MULTIPLEXED.
+   */
+  long     muxValue;
+  /** \brief Scaling of the raw value to the physical value. */
+  double   factor;
+  double   offset;
+  /** \brief Range of the physical value. */
+  double   min;
+  double   max;
+} tDbcgenSignal;
+
+/** \brief CAN message. */
+typedef struct
+{
+  /** \brief Name of the CAN message as specified in the DBC file. */
+  char            name[DBCGEN_NAME_MAX];
+  /** \brief Name in camel case, for types and functions. */
+  char            camel[DBCGEN_NAME_MAX];
+  /** \brief Name in upper case with underscores, for macros. */
+  char            macro[DBCGEN_NAME_MAX];
+  /** \brief CAN identifier. */
+  uint32_t        id;
+  /** \brief True for a 29-bit CAN identifier, false for 11-bit. */
+  bool            ext;
+  /** \brief Data length as specified in the DBC file. */
+  uint32_t        len;
+  /** \brief Number of data bytes that the signals need. */
+  uint32_t        needed;
+  /** \brief Signals of the CAN message. */
+  tDbcgenSignal * signals;
+  /** \brief Number of signals. */
+  size_t          signalCount;
+} tDbcgenMessage;
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief CAN messages of the DBC file. */
+static tDbcgenMessage * dbcgenMessages;
+
+/** \brief Number of CAN messages. */
+static size_t dbcgenMessageCount;
+
+/** \brief Prefix of the generated names in camel case, upper case and for variables. */
+static char dbcgenCamel[DBCGEN_NAME_MAX];
+static char dbcgenMacro[DBCGEN_NAME_MAX];
+static char dbcgenVariable[DBCGEN_NAME_MAX];
+
+/** \brief Base name of the DBC file and of the generated files. */
+static char dbcgenFileName[DBCGEN_NAME_MAX];
+static char dbcgenBaseName[DBCGEN_NAME_MAX];
+
+/** \brief True while the signals in the DBC file belong to a skipped CAN message. */
+static bool dbcgenSkipSignals;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static bool         DbcgenParse(char const * path);
+static bool         DbcgenParseMessage(char const * line);
+static bool         DbcgenParseSignal(char const * line);
+static bool         DbcgenParseValueType(char const * line);
+static bool         DbcgenPrepare(void);
+static int          DbcgenCompare(void const * first, void const * second);
+static void         DbcgenNames(char const * path);
+static void         DbcgenCamelCase(char const * name, char * out);
+static void         DbcgenMacroCase(char const * name, char * out);
+static void         DbcgenNumber(double value, bool constant, char * out);
+static void         DbcgenLimit(uint32_t bits, char * out);
+static char const * DbcgenFieldType(tDbcgenSignal const * signal);
+static bool         DbcgenScaled(tDbcgenSignal const * signal);
+static void         DbcgenRawValue(tDbcgenSignal const * signal, char * out);
+static void         DbcgenMask(uint32_t size, char * out);
+static bool         DbcgenWriteHeader(char const * directory);
+static bool         DbcgenWriteSource(char const * directory);
+static void         DbcgenWriteDecoder(FILE * file, tDbcgenMessage const * message);
+static void         DbcgenWriteEncoder(FILE * file, tDbcgenMessage const * message);
+
+
+/************************************************************************************//**
+** \brief     This is the program entry point.
+** \param     argc Number of program arguments.
+** \param     argv Array with program arguments.
+** \return    Program return code. 0 for success, error code otherwise.
+**
+****************************************************************************************/
+int main(int argc, char *argv[])
+{
+  int result = EXIT_FAILURE;
+
+  /* Check the program arguments. */
+  if (argc != 3)
+  {
+    fprintf(stderr, "Usage: dbcgen FILE.dbc DIRECTORY\n");
+  }
+  /* Read the DBC file and generate the source and header file. */
+  else
+  {
+    DbcgenNames(argv[1]);
+    if ( (DbcgenParse(argv[1])) && (DbcgenPrepare()) &&
+         (DbcgenWriteHeader(argv[2])) && (DbcgenWriteSource(argv[2])) )
+    {
+      result = EXIT_SUCCESS;
+    }
+  }
+
+  /* Release the memory. */
+  for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+  {
+    free(dbcgenMessages[idx].signals);
+  }
+  free(dbcgenMessages);
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of main ***/
+
+
+/************************************************************************************//**
+** \brief     Reads the CAN messages and signals from the DBC file. Everything else in
+**            the DBC file is skipped.
+** \param     path Path of the DBC file.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenParse(char const * path)
+{
+  bool result = false;
+  FILE * file;
+  char * line = NULL;
+  size_t size = 0;
+  char const * text;
+  size_t lineNumber = 0;
+  bool inString = false;
+  bool startsInString;
+
+  /* Open the DBC file. */
+  file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "dbcgen: cannot open %s\n", path);
+  }
+  else
+  {
+    result = true;
+    /* Handle the DBC file line by line. */
+    while ( (result) && (getline(&line, &size, file) != -1) )
+    {
+      lineNumber++;
+      /* Strings, for example of comments, can span multiple lines. Skip the lines that
+       * start inside a string.
+       */
+      startsInString = inString;
+      for (char const * ch = line; *ch != '\0'; ch++)
+      {
+        if ( (*ch == '\\') && (ch[1] != '\0') )
+        {
+          ch++;
+        }
+        else if (*ch == '"')
+        {
+          inString = !inString;
+        }
+      }
+      if (startsInString)
+      {
+        continue;
+      }
+      /* Handle the CAN messages, their signals and the value types of the signals. */
+      text = line;
+      while (isspace((unsigned char)*text))
+      {
+        text++;
+      }
+      if (strncmp(text, "BO_ ", 4) == 0)
+      {
+        result = DbcgenParseMessage(text);
+      }
+      else if (strncmp(text, "SG_ ", 4) == 0)
+      {
+        result = DbcgenParseSignal(text);
+      }
+      else if (strncmp(text, "SIG_VALTYPE_ ", 13) == 0)
+      {
+        result = DbcgenParseValueType(text);
+      }
+      if (!result)
+      {
+        fprintf(stderr, "dbcgen: %s:%zu: cannot handle this line\n", path, lineNumber);
+      }
+    }
+    free(line);
+    fclose(file);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenParse ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a CAN message from a line such as "BO_ 256 EngineData: 8 ECU".
+** \param     line The line.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenParseMessage(char const * line)
+{
+  bool result = false;
+  tDbcgenMessage * grown;
+  tDbcgenMessage * message;
+  unsigned long id;
+  unsigned int len;
+  char name[DBCGEN_NAME_MAX];
+
+  /* Read the identifier, name and data length. */
+  if (sscanf(line, "BO_ %lu %127[^: ] : %u", &id, name, &len) == 3)
+  {
+    /* Skip the pseudo CAN message that holds the signals without a CAN message. */
+    if (strcmp(name, "VECTOR__INDEPENDENT_SIG_MSG") == 0)
+    {
+      dbcgenSkipSignals = true;
+      result = true;
+    }
+    /* Add the CAN message. */
+    else if (len <= DBCGEN_LEN_MAX)
+    {
+      grown = realloc(dbcgenMessages, (dbcgenMessageCount + 1U) * sizeof(tDbcgenMessage));
+      if (grown != NULL)
+      {
+        dbcgenMessages = grown;
+        message = &dbcgenMessages[dbcgenMessageCount++];
+        memset(message, 0, sizeof(*message));
+        strcpy(message->name, name);
+        DbcgenCamelCase(name, message->camel);
+        DbcgenMacroCase(name, message->macro);
+        message->ext = ((id & DBCGEN_EXT_FLAG) != 0);
+        message->id = (uint32_t)(id & 0x1FFFFFFFUL);
+        message->len = len;
+        message->needed = len;
+        dbcgenSkipSignals = false;
+        result = true;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "dbcgen: %s has more than %u data bytes\n", name, DBCGEN_LEN_MAX);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenParseMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a signal of the last CAN message from a line such as
+**            SG_ Speed m1 : 24|16@1+ (0.125,0) [0|8031.875] "rpm" ECU.
+** \param     line The line.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenParseSignal(char const * line)
+{
+  bool result = false;
+  tDbcgenMessage * message;
+  tDbcgenSignal * grown;
+  tDbcgenSignal signal = { 0 };
+  char mux[DBCGEN_NAME_MAX] = "";
+  char order;
+  char sign;
+  char * end;
+  char const * unit;
+  char const * colon;
+  size_t length;
+  int used = 0;
+
+  /* Only continue when the signal belongs to a CAN message. */
+  if (dbcgenSkipSignals)
+  {
+    result = true;
+  }
+  else if (dbcgenMessageCount > 0)
+  {
+    message = &dbcgenMessages[dbcgenMessageCount - 1U];
+    signal.valueType = 0;
+    signal.muxValue = DBCGEN_NOT_MULTIPLEXED;
+    /* Read the name and the optional multiplexer indicator in front of the colon. */
+    colon = strchr(line, ':');
+    if ( (colon != NULL) &&
+         (sscanf(line, "SG_ %127[^ :] %n", signal.name, &used) == 1) &&
+         (&line[used] < colon) )
+    {
+      (void)sscanf(&line[used], "%127[^ :]", mux);
+    }
+    used = (colon != NULL) ? (int)(colon - line) : 0;
+    /* The multiplexer indicator is "M" for the multiplexor or "m" plus a value. */
+    if (strcmp(mux, "M") == 0)
+    {
+      signal.multiplexor = true;
+      result = true;
+    }
+    else if (mux[0] == 'm')
+    {
+      signal.muxValue = strtol(&mux[1], &end, 10);
+      result = ( (end != &mux[1]) && (*end == '\0') && (signal.muxValue >= 0) );
+    }
+    else
+    {
+      result = (mux[0] == '\0');
+    }
+    /* Read the layout, scaling and range. */
+    if ( (result) && (line[used] == ':') &&
+         (sscanf(&line[used + 1], " %u|%u@%c%c (%lf,%lf) [%lf|%lf]", &signal.start,
+                 &signal.size, &order, &sign, &signal.factor, &signal.offset,
+                 &signal.min, &signal.max) == 8) &&
+         ( (order == '0') || (order == '1') ) && ( (sign == '+') || (sign == '-') ) &&
+         (signal.size >= 1U) && (signal.size <= 64U) && (signal.factor != 0.0) )
+    {
+      signal.motorola = (order == '0');
+      signal.sign = (sign == '-');
+      /* Read the unit. */
+      unit = strchr(&line[used], '"');
+      if (unit != NULL)
+      {
+        length = strcspn(unit + 1, "\"");
+        if (length >= sizeof(signal.unit))
+        {
+          length = sizeof(signal.unit) - 1U;
+        }
+        memcpy(signal.unit, unit + 1, length);
+        signal.unit[length] = '\0';
+      }
+      /* Add the signal. */
+      grown = realloc(message->signals, (message->signalCount + 1U) * sizeof(signal));
+      if (grown != NULL)
+      {
+        message->signals = grown;
+        message->signals[message->signalCount++] = signal;
+      }
+      else
+      {
+        result = false;
+      }
+    }
+    else
+    {
+      result = false;
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenParseSignal ***/
+
+
+/************************************************************************************//**
+** \brief     Reads the value type of a signal from a line such as
+**            SIG_VALTYPE_ 256 Temperature : 1;
+** \param     line The line.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenParseValueType(char const * line)
+{
+  bool result = false;
+  unsigned long id;
+  char name[DBCGEN_NAME_MAX];
+  int valueType;
+  tDbcgenMessage * message;
+
+  /* Read the identifier, the name of the signal and its value type. */
+  if ( (sscanf(line, "SIG_VALTYPE_ %lu %127[^: ] : %d", &id, name, &valueType) == 3) &&
+       (valueType >= 0) && (valueType <= 2) )
+  {
+    /* Find the signal and store its value type. */
+    for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+    {
+      message = &dbcgenMessages[idx];
+      if ( (message->id == (uint32_t)(id & 0x1FFFFFFFUL)) &&
+           (message->ext == ((id & DBCGEN_EXT_FLAG) != 0)) )
+      {
+        for (size_t sig = 0; sig < message->signalCount; sig++)
+        {
+          if (strcmp(message->signals[sig].name, name) == 0)
+          {
+            message->signals[sig].valueType = valueType;
+            result = true;
+          }
+        }
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenParseValueType ***/
+
+
+/************************************************************************************//**
+** \brief     Checks the CAN messages and signals and determines the shift of each
+**            signal. Sorts the CAN messages by their identifier.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenPrepare(void)
+{
+  bool result = true;
+  tDbcgenMessage * message;
+  tDbcgenSignal * signal;
+  uint32_t position;
+  uint32_t needed;
+  size_t multiplexors;
+
+  for (size_t idx = 0; (idx < dbcgenMessageCount) && (result); idx++)
+  {
+    message = &dbcgenMessages[idx];
+    multiplexors = 0;
+    for (size_t sig = 0; (sig < message->signalCount) && (result); sig++)
+    {
+      signal = &message->signals[sig];
+      /* A little endian signal starts at its least significant bit. Its shift in the
+       * little endian 64-bit value is the start bit.
+       */
+      if (!signal->motorola)
+      {
+        position = signal->start;
+        result = ((signal->start + signal->size) <= 64U);
+        signal->shift = signal->start;
+      }
+      /* A big endian signal starts at its most significant bit, which is numbered
+       * within its byte. Convert it to a bit position counted from the most
+       * significant bit of the first data byte, which is the big endian 64-bit value.
+       */
+      else
+      {
+        position = ((signal->start / 8U) * 8U) + (7U - (signal->start % 8U));
+        result = ((position + signal->size) <= 64U);
+        signal->shift = 64U - position - signal->size;
+      }
+      /* Floats and doubles must have their size. */
+      if ( ( (signal->valueType == 1) && (signal->size != 32U) ) ||
+           ( (signal->valueType == 2) && (signal->size != 64U) ) )
+      {
+        result = false;
+      }
+      if (!result)
+      {
+        fprintf(stderr, "dbcgen: signal %s of %s does not fit\n", signal->name,
+                message->name);
+        break;
+      }
+      /* Keep track of the number of data bytes that the signals need. */
+      needed = ((signal->motorola ? position : signal->start) + signal->size + 7U) / 8U;
+      if (needed > message->needed)
+      {
+        fprintf(stderr, "dbcgen: warning: signal %s of %s exceeds its data length\n",
+                signal->name, message->name);
+        message->needed = needed;
+      }
+      /* Only simple multiplexing with one multiplexor is supported. */
+      if (signal->multiplexor)
+      {
+        multiplexors++;
+        /* Move the multiplexor to the front, so it is handled first. */
+        if (sig > 0)
+        {
+          tDbcgenSignal first = message->signals[0];
+          message->signals[0] = *signal;
+          *signal = first;
+        }
+      }
+    }
+    for (size_t sig = 0; (sig < message->signalCount) && (result); sig++)
+    {
+      if ( (message->signals[sig].muxValue != DBCGEN_NOT_MULTIPLEXED) &&
+           (multiplexors != 1U) )
+      {
+        fprintf(stderr, "dbcgen: %s has no single multiplexor\n", message->name);
+        result = false;
+      }
+    }
+    if ( (result) && (multiplexors > 1U) )
+    {
+      fprintf(stderr, "dbcgen: %s has more than one multiplexor\n", message->name);
+      result = false;
+    }
+  }
+
+  /* Sort the CAN messages and check that each identifier is used once. */
+  if (result)
+  {
+    qsort(dbcgenMessages, dbcgenMessageCount, sizeof(tDbcgenMessage), DbcgenCompare);
+    for (size_t idx = 1; idx < dbcgenMessageCount; idx++)
+    {
+      if (DbcgenCompare(&dbcgenMessages[idx - 1U], &dbcgenMessages[idx]) == 0)
+      {
+        fprintf(stderr, "dbcgen: %s and %s have the same identifier\n",
+                dbcgenMessages[idx - 1U].name, dbcgenMessages[idx].name);
+        result = false;
+      }
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenPrepare ***/
+
+
+/************************************************************************************//**
+** \brief     Compares two CAN messages by their identifier. 11-bit identifiers come
+**            first.
+** \param     first Pointer to the first CAN message.
+** \param     second Pointer to the second CAN message.
+** \return    Negative, zero or positive, like strcmp().
+**
+****************************************************************************************/
+static int DbcgenCompare(void const * first, void const * second)
+{
+  tDbcgenMessage const * a = first;
+  tDbcgenMessage const * b = second;
+  uint64_t keyA = (uint64_t)a->id | (a->ext ? DBCGEN_EXT_FLAG : 0U);
+  uint64_t keyB = (uint64_t)b->id | (b->ext ? DBCGEN_EXT_FLAG : 0U);
+
+  /* Give the result back to the caller. */
+  return (keyA > keyB) - (keyA < keyB);
+} /*** end of DbcgenCompare ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the names of the generated files and the prefix of the
+**            generated names from the file name of the DBC file.
+** \param     path Path of the DBC file.
+**
+****************************************************************************************/
+static void DbcgenNames(char const * path)
+{
+  char const * name = strrchr(path, '/');
+  size_t length;
+
+  /* Strip the directory and the extension. */
+  name = (name != NULL) ? (name + 1) : path;
+  snprintf(dbcgenFileName, sizeof(dbcgenFileName), "%s", name);
+  length = strcspn(name, ".");
+  if (length >= sizeof(dbcgenBaseName))
+  {
+    length = sizeof(dbcgenBaseName) - 1U;
+  }
+  /* The base name must be a valid identifier. */
+  for (size_t idx = 0; idx < length; idx++)
+  {
+    dbcgenBaseName[idx] = isalnum((unsigned char)name[idx]) ? name[idx] : '_';
+  }
+  dbcgenBaseName[length] = '\0';
+  if ( (length == 0) || (isdigit((unsigned char)dbcgenBaseName[0])) )
+  {
+    memmove(&dbcgenBaseName[4], dbcgenBaseName, sizeof(dbcgenBaseName) - 5U);
+    memcpy(dbcgenBaseName, "dbc_", 4);
+    dbcgenBaseName[sizeof(dbcgenBaseName) - 1U] = '\0';
+  }
+
+  /* Derive the prefixes. */
+  DbcgenCamelCase(dbcgenBaseName, dbcgenCamel);
+  DbcgenMacroCase(dbcgenBaseName, dbcgenMacro);
+  strcpy(dbcgenVariable, dbcgenCamel);
+  dbcgenVariable[0] = (char)tolower((unsigned char)dbcgenVariable[0]);
+} /*** end of DbcgenNames ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a name to camel case. "ENGINE_DATA" and "engine_data" become
+**            "EngineData". Parts with lower case letters keep their case.
+** \param     name The name.
+** \param     out Buffer of DBCGEN_NAME_MAX characters for the converted name.
+**
+****************************************************************************************/
+static void DbcgenCamelCase(char const * name, char * out)
+{
+  size_t count = 0;
+  size_t partLength;
+  bool lower;
+
+  while ( (*name != '\0') && (count < (DBCGEN_NAME_MAX - 1U)) )
+  {
+    /* Skip the underscores between the parts. */
+    if (*name == '_')
+    {
+      name++;
+      continue;
+    }
+    /* Determine if the part has lower case letters. */
+    partLength = strcspn(name, "_");
+    lower = false;
+    for (size_t idx = 0; idx < partLength; idx++)
+    {
+      lower = lower || islower((unsigned char)name[idx]);
+    }
+    /* Copy the part with an upper case first letter. */
+    for (size_t idx = 0; (idx < partLength) && (count < (DBCGEN_NAME_MAX - 1U)); idx++)
+    {
+      if (idx == 0)
+      {
+        out[count++] = (char)toupper((unsigned char)name[idx]);
+      }
+      else
+      {
+        out[count++] = lower ? name[idx] : (char)tolower((unsigned char)name[idx]);
+      }
+    }
+    name += partLength;
+  }
+  out[count] = '\0';
+} /*** end of DbcgenCamelCase ***/
+
+
+/************************************************************************************//**
+** \brief     Converts a name to upper case with underscores between the words.
+**            "EngineData" becomes "ENGINE_DATA" and "ABSStatus" becomes "ABS_STATUS".
+** \param     name The name.
+** \param     out Buffer of DBCGEN_NAME_MAX characters for the converted name.
+**
+****************************************************************************************/
+static void DbcgenMacroCase(char const * name, char * out)
+{
+  size_t count = 0;
+
+  for (size_t idx = 0; (name[idx] != '\0') && (count < (DBCGEN_NAME_MAX - 2U)); idx++)
+  {
+    /* A word starts at an upper case letter after a lower case letter or a digit, and
+     * at the last upper case letter of an abbreviation in front of a word.
+     */
+    if ( (idx > 0) && (isupper((unsigned char)name[idx])) && (out[count - 1U] != '_') &&
+         ( (islower((unsigned char)name[idx - 1U])) ||
+           (isdigit((unsigned char)name[idx - 1U])) ||
+           ( (isupper((unsigned char)name[idx - 1U])) &&
+             (islower((unsigned char)name[idx + 1U])) ) ) )
+    {
+      out[count++] = '_';
+    }
+    out[count++] = (char)toupper((unsigned char)name[idx]);
+  }
+  out[count] = '\0';
+} /*** end of DbcgenMacroCase ***/
+
+
+/************************************************************************************//**
+** \brief     Formats a number with as few digits as possible, without losing precision.
+**            The exponent notation is only used for very large and very small numbers.
+** \param     value The value.
+** \param     constant True to format it as a floating point constant, false for a
+**            comment.
+** \param     out Buffer of at least 32 characters for the number.
+**
+****************************************************************************************/
+static void DbcgenNumber(double value, bool constant, char * out)
+{
+  bool plain = ( (value == 0.0) || ( (value < 1e15) && (value > -1e15) &&
+                                     ( (value >= 1e-4) || (value <= -1e-4) ) ) );
+
+  /* Find the shortest representation that reads back as the same value. */
+  for (int digits = 1; digits <= 17; digits++)
+  {
+    snprintf(out, 32, "%.*g", digits, value);
+    if ( (strtod(out, NULL) == value) && ( (!plain) || (strchr(out, 'e') == NULL) ) )
+    {
+      break;
+    }
+  }
+  /* Make sure a constant is a floating point constant. */
+  if ( (constant) && (strpbrk(out, ".eEn") == NULL) )
+  {
+    strcat(out, ".0");
+  }
+} /*** end of DbcgenNumber ***/
+
+
+/************************************************************************************//**
+** \brief     Formats the largest floating point constant that does not exceed the
+**            largest unsigned value with the specified number of bits.
+** \param     bits Number of bits.
+** \param     out Buffer of at least 32 characters for the constant.
+**
+****************************************************************************************/
+static void DbcgenLimit(uint32_t bits, char * out)
+{
+  uint64_t limit = (bits >= 64U) ? UINT64_MAX : ((1ULL << bits) - 1U);
+
+  /* A double only has 53 bits of precision. Round down, so the limit converts back to
+   * an integer without overflowing.
+   */
+  if (bits > 53U)
+  {
+    limit &= ~((1ULL << (bits - 53U)) - 1U);
+  }
+  snprintf(out, 32, "%llu.0", (unsigned long long)limit);
+} /*** end of DbcgenLimit ***/
+
+
+/************************************************************************************//**
+** \brief     Determines if the physical value of a signal differs from its raw value.
+** \param     signal Pointer to the signal.
+** \return    True if the signal has a factor or an offset, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenScaled(tDbcgenSignal const * signal)
+{
+  /* Give the result back to the caller. */
+  return ( (signal->factor != 1.0) || (signal->offset != 0.0) );
+} /*** end of DbcgenScaled ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the type of the field that holds the physical value of a signal.
+**            Scaled signals are doubles. Other signals keep their raw type, with the
+**            smallest integer type that fits.
+** \param     signal Pointer to the signal.
+** \return    Name of the type.
+**
+****************************************************************************************/
+static char const * DbcgenFieldType(tDbcgenSignal const * signal)
+{
+  static char const * const types[2][4] =
+  {
+    { "uint8_t", "uint16_t", "uint32_t", "uint64_t" },
+    { "int8_t", "int16_t", "int32_t", "int64_t" }
+  };
+  char const * result;
+
+  if ( (DbcgenScaled(signal)) || (signal->valueType == 2) )
+  {
+    result = "double";
+  }
+  else if (signal->valueType == 1)
+  {
+    result = "float";
+  }
+  else
+  {
+    result = types[signal->sign ? 1 : 0][(signal->size <= 8U) ? 0 :
+                                         (signal->size <= 16U) ? 1 :
+                                         (signal->size <= 32U) ? 2 : 3];
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenFieldType ***/
+
+
+/************************************************************************************//**
+** \brief     Formats the mask of a value with the specified number of bits.
+** \param     size Number of bits.
+** \param     out Buffer of at least 32 characters for the mask.
+**
+****************************************************************************************/
+static void DbcgenMask(uint32_t size, char * out)
+{
+  uint64_t mask = (size >= 64U) ? UINT64_MAX : ((1ULL << size) - 1U);
+
+  snprintf(out, 32, "0x%llXULL", (unsigned long long)mask);
+} /*** end of DbcgenMask ***/
+
+
+/************************************************************************************//**
+** \brief     Formats the expression that extracts the unsigned raw value of a signal
+**            from the 64-bit values "le" and "be" with the data bytes.
+** \param     signal Pointer to the signal.
+** \param     out Buffer of DBCGEN_EXPR_MAX characters for the expression.
+**
+****************************************************************************************/
+static void DbcgenRawValue(tDbcgenSignal const * signal, char * out)
+{
+  char const * value = signal->motorola ? "be" : "le";
+  char mask[32];
+
+  DbcgenMask(signal->size, mask);
+  if (signal->size == 64U)
+  {
+    snprintf(out, DBCGEN_EXPR_MAX, "%s", value);
+  }
+  else if (signal->shift == 0)
+  {
+    snprintf(out, DBCGEN_EXPR_MAX, "(%s & %s)", value, mask);
+  }
+  else
+  {
+    snprintf(out, DBCGEN_EXPR_MAX, "((%s >> %u) & %s)", value, signal->shift, mask);
+  }
+} /*** end of DbcgenRawValue ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the generated header file.
+** \param     directory Directory of the generated files.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenWriteHeader(char const * directory)
+{
+  bool result = false;
+  char path[PATH_MAX];
+  FILE * file = NULL;
+  tDbcgenMessage const * message;
+  tDbcgenSignal const * signal;
+  char text[DBCGEN_NAME_MAX * 2U];
+  char min[32];
+  char max[32];
+  int length;
+
+  /* Create the header file. */
+  if (snprintf(path, sizeof(path), "%s/%s_dbc.h", directory, dbcgenBaseName) <
+      (int)sizeof(path))
+  {
+    file = fopen(path, "w");
+  }
+  if (file == NULL)
+  {
+    fprintf(stderr, "dbcgen: cannot create %s\n", path);
+  }
+  else
+  {
+    fprintf(file, "/* CAN message decoders and encoders for %s. */\n", dbcgenFileName);
+    fprintf(file, "/* Generated by dbcgen. Do not edit. */\n");
+    fprintf(file, "#ifndef %s_DBC_H\n#define %s_DBC_H\n\n", dbcgenMacro, dbcgenMacro);
+    fprintf(file, "#include \"caplin.h\"\n\n");
+    fprintf(file, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+    fprintf(file, "/* Number of CAN messages in the table. */\n");
+    fprintf(file, "#define %s_MESSAGE_COUNT (%zuU)\n\n", dbcgenMacro, dbcgenMessageCount);
+
+    for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+    {
+      message = &dbcgenMessages[idx];
+      /* Properties of the CAN message. */
+      fprintf(file, "/* %s, CAN identifier 0x%X (%s-bit), %u bytes. */\n", message->name,
+              message->id, message->ext ? "29" : "11", message->len);
+      fprintf(file, "#define %s_%s_ID (0x%XUL)\n", dbcgenMacro, message->macro,
+              message->id);
+      fprintf(file, "#define %s_%s_EXT (%s)\n", dbcgenMacro, message->macro,
+              message->ext ? "true" : "false");
+      fprintf(file, "#define %s_%s_LEN (%uU)\n\n", dbcgenMacro, message->macro,
+              message->len);
+      /* Structure with the physical values of the signals. */
+      fprintf(file, "typedef struct\n{\n");
+      for (size_t sig = 0; sig < message->signalCount; sig++)
+      {
+        signal = &message->signals[sig];
+        length = snprintf(text, sizeof(text), "  %-8s %s;", DbcgenFieldType(signal),
+                          signal->name);
+        fprintf(file, "%s%*s", text,
+                (length < (int)DBCGEN_COMMENT_COLUMN) ?
+                ((int)DBCGEN_COMMENT_COLUMN - length) : 1, "");
+        DbcgenNumber(signal->min, false, min);
+        DbcgenNumber(signal->max, false, max);
+        fprintf(file, "/* [%s..%s]%s%s", min, max, (signal->unit[0] != '\0') ? " " : "",
+                signal->unit);
+        if (signal->multiplexor)
+        {
+          fprintf(file, ", multiplexor");
+        }
+        else if (signal->muxValue != DBCGEN_NOT_MULTIPLEXED)
+        {
+          fprintf(file, ", when multiplexor is %ld", signal->muxValue);
+        }
+        fprintf(file, " */\n");
+      }
+      if (message->signalCount == 0)
+      {
+        fprintf(file, "  uint8_t  unused;\n");
+      }
+      fprintf(file, "} t%s%s;\n\n", dbcgenCamel, message->camel);
+      /* Handler type and functions. */
+      length = fprintf(file, "typedef void (* t%s%sHandler)(", dbcgenCamel,
+                       message->camel);
+      fprintf(file, "t%s%s const * signals,\n", dbcgenCamel, message->camel);
+      fprintf(file, "%*stCanMsg const * msg, void * context);\n\n", length, "");
+      fprintf(file, "bool %s%sDecode(tCanMsg const * msg, t%s%s * signals);\n",
+              dbcgenCamel, message->camel, dbcgenCamel, message->camel);
+      fprintf(file, "void %s%sEncode(t%s%s const * signals, tCanMsg * msg);\n",
+              dbcgenCamel, message->camel, dbcgenCamel, message->camel);
+      fprintf(file, "bool %s%sRegister(t%s%sHandler handlerFcn, void * context);\n\n",
+              dbcgenCamel, message->camel, dbcgenCamel, message->camel);
+    }
+
+    /* Message table. */
+    fprintf(file, "/* Table with all CAN messages, sorted by identifier. */\n");
+    fprintf(file, "extern tDbcMessage const %sMessages[%s_MESSAGE_COUNT];\n\n",
+            dbcgenVariable, dbcgenMacro);
+    fprintf(file, "tDbcMessage const * %sFind(uint32_t id, bool ext);\n\n", dbcgenCamel);
+    fprintf(file, "#ifdef __cplusplus\n}\n#endif\n\n");
+    fprintf(file, "#endif /* %s_DBC_H */\n", dbcgenMacro);
+    result = (ferror(file) == 0);
+    result = (fclose(file) == 0) && (result);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenWriteHeader ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the generated source file.
+** \param     directory Directory of the generated files.
+** \return    True if successful, false otherwise.
+**
+****************************************************************************************/
+static bool DbcgenWriteSource(char const * directory)
+{
+  bool result = false;
+  char path[PATH_MAX];
+  FILE * file = NULL;
+  tDbcgenMessage const * message;
+  char const * name;
+
+  /* Create the source file. */
+  if (snprintf(path, sizeof(path), "%s/%s_dbc.c", directory, dbcgenBaseName) <
+      (int)sizeof(path))
+  {
+    file = fopen(path, "w");
+  }
+  if (file == NULL)
+  {
+    fprintf(stderr, "dbcgen: cannot create %s\n", path);
+  }
+  else
+  {
+    name = dbcgenCamel;
+    fprintf(file, "/* CAN message decoders and encoders for %s. */\n", dbcgenFileName);
+    fprintf(file, "/* Generated by dbcgen. Do not edit. */\n");
+    fprintf(file, "#include <string.h>\n");
+    fprintf(file, "#include \"%s_dbc.h\"\n\n", dbcgenBaseName);
+
+    /* Helper functions. */
+    fprintf(file,
+      "/* Loads the data bytes as a little endian 64-bit value. */\n"
+      "static inline uint64_t %sLoadLe(uint8_t const * data)\n{\n"
+      "  return (uint64_t)data[0] | ((uint64_t)data[1] << 8) |"
+      " ((uint64_t)data[2] << 16) |\n"
+      "         ((uint64_t)data[3] << 24) | ((uint64_t)data[4] << 32) |"
+      " ((uint64_t)data[5] << 40) |\n"
+      "         ((uint64_t)data[6] << 48) | ((uint64_t)data[7] << 56);\n}\n\n", name);
+    fprintf(file,
+      "/* Loads the data bytes as a big endian 64-bit value. */\n"
+      "static inline uint64_t %sLoadBe(uint8_t const * data)\n{\n"
+      "  return ((uint64_t)data[0] << 56) | ((uint64_t)data[1] << 48) |"
+      " ((uint64_t)data[2] << 40) |\n"
+      "         ((uint64_t)data[3] << 32) | ((uint64_t)data[4] << 24) |"
+      " ((uint64_t)data[5] << 16) |\n"
+      "         ((uint64_t)data[6] << 8) | (uint64_t)data[7];\n}\n\n", name);
+    fprintf(file,
+      "/* Stores a little endian and a big endian 64-bit value in the data bytes. */\n"
+      "static inline void %sStore(uint8_t * data, uint64_t le, uint64_t be)\n{\n"
+      "  for (unsigned int idx = 0; idx < 8U; idx++)\n  {\n"
+      "    data[idx] = (uint8_t)((le >> (8U * idx)) | (be >> (56U - (8U * idx))));\n"
+      "  }\n}\n\n", name);
+    fprintf(file,
+      "/* Converts a physical value to an unsigned raw value, rounded and limited. */\n"
+      "static inline uint64_t %sRawUnsigned(double value, double factor, double offset,\n"
+      "                                     double max)\n{\n"
+      "  double raw = ((value - offset) / factor) + 0.5;\n\n"
+      "  if (!(raw >= 0.0))\n  {\n    raw = 0.0;\n  }\n"
+      "  if (raw > max)\n  {\n    raw = max;\n  }\n"
+      "  return (uint64_t)raw;\n}\n\n", name);
+    fprintf(file,
+      "/* Converts a physical value to a signed raw value, rounded and limited. */\n"
+      "static inline uint64_t %sRawSigned(double value, double factor, double offset,\n"
+      "                                   double min, double max)\n{\n"
+      "  double raw = (value - offset) / factor;\n\n"
+      "  raw += (raw >= 0.0) ? 0.5 : -0.5;\n"
+      "  if (!(raw >= min))\n  {\n    raw = min;\n  }\n"
+      "  if (raw > max)\n  {\n    raw = max;\n  }\n"
+      "  return (uint64_t)(int64_t)raw;\n}\n\n", name);
+    fprintf(file,
+      "/* Sign extends a raw value. */\n"
+      "static inline int64_t %sSigned(uint64_t raw, uint64_t sign)\n{\n"
+      "  return (int64_t)((raw ^ sign) - sign);\n}\n\n"
+      "/* Reinterprets raw values as floating point values and the other way around. */\n"
+      "static inline float %sFloat(uint64_t raw)\n{\n"
+      "  uint32_t bits = (uint32_t)raw;\n  float value;\n\n"
+      "  memcpy(&value, &bits, sizeof(value));\n  return value;\n}\n\n"
+      "static inline double %sDouble(uint64_t raw)\n{\n"
+      "  double value;\n\n"
+      "  memcpy(&value, &raw, sizeof(value));\n  return value;\n}\n\n"
+      "static inline uint64_t %sFloatRaw(float value)\n{\n"
+      "  uint32_t bits;\n\n"
+      "  memcpy(&bits, &value, sizeof(bits));\n  return bits;\n}\n\n"
+      "static inline uint64_t %sDoubleRaw(double value)\n{\n"
+      "  uint64_t raw;\n\n"
+      "  memcpy(&raw, &value, sizeof(raw));\n  return raw;\n}\n\n",
+      name, name, name, name, name);
+
+    /* Decoder, encoder and handler of each CAN message. */
+    for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+    {
+      message = &dbcgenMessages[idx];
+      DbcgenWriteDecoder(file, message);
+      DbcgenWriteEncoder(file, message);
+      fprintf(file, "static t%s%sHandler %s%sHandler;\n\n", name, message->camel,
+              dbcgenVariable, message->camel);
+      fprintf(file,
+        "static void %s%sDispatch(tCanMsg const * msg, void * context)\n{\n"
+        "  t%s%s signals;\n\n"
+        "  if ( (%s%sHandler != NULL) && (%s%sDecode(msg, &signals)) )\n  {\n"
+        "    %s%sHandler(&signals, msg, context);\n  }\n}\n\n",
+        name, message->camel, name, message->camel, dbcgenVariable, message->camel,
+        name, message->camel, dbcgenVariable, message->camel);
+      fprintf(file,
+        "bool %s%sRegister(t%s%sHandler handlerFcn, void * context)\n{\n"
+        "  %s%sHandler = handlerFcn;\n"
+        "  return DispatchRegister(%s_%s_ID, %s_%s_EXT,\n"
+        "                          (handlerFcn != NULL) ? %s%sDispatch : NULL,\n"
+        "                          context);\n"
+        "}\n\n",
+        name, message->camel, name, message->camel, dbcgenVariable, message->camel,
+        dbcgenMacro, message->macro, dbcgenMacro, message->macro, name, message->camel);
+      fprintf(file,
+        "static bool %s%sDecodeAny(tCanMsg const * msg, void * signals)\n{\n"
+        "  return %s%sDecode(msg, signals);\n}\n\n"
+        "static void %s%sEncodeAny(void const * signals, tCanMsg * msg)\n{\n"
+        "  %s%sEncode(signals, msg);\n}\n\n",
+        name, message->camel, name, message->camel, name, message->camel, name,
+        message->camel);
+    }
+
+    /* Message table. */
+    fprintf(file, "tDbcMessage const %sMessages[%s_MESSAGE_COUNT] =\n{\n", dbcgenVariable,
+            dbcgenMacro);
+    for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+    {
+      message = &dbcgenMessages[idx];
+      fprintf(file, "  { \"%s\", %s_%s_ID, %s_%s_EXT, %s_%s_LEN, %zuU,\n"
+              "    sizeof(t%s%s), %s%sDecodeAny, %s%sEncodeAny },\n", message->name,
+              dbcgenMacro, message->macro, dbcgenMacro, message->macro, dbcgenMacro,
+              message->macro, message->signalCount, name, message->camel, name,
+              message->camel, name, message->camel);
+    }
+    fprintf(file, "};\n\n");
+
+    /* Lookup by identifier. The compiler turns the switch into a jump table or a
+     * binary search.
+     */
+    fprintf(file, "tDbcMessage const * %sFind(uint32_t id, bool ext)\n{\n", name);
+    fprintf(file, "  tDbcMessage const * result = NULL;\n\n");
+    fprintf(file, "  switch (id | (ext ? 0x80000000UL : 0U))\n  {\n");
+    for (size_t idx = 0; idx < dbcgenMessageCount; idx++)
+    {
+      message = &dbcgenMessages[idx];
+      fprintf(file, "    case 0x%lXUL:\n      result = &%sMessages[%zu];\n      break;\n",
+              (unsigned long)message->id | (message->ext ? DBCGEN_EXT_FLAG : 0U),
+              dbcgenVariable, idx);
+    }
+    fprintf(file, "    default:\n      break;\n  }\n  return result;\n}\n");
+    result = (ferror(file) == 0);
+    result = (fclose(file) == 0) && (result);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of DbcgenWriteSource ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the decoder of a CAN message.
+** \param     file The generated source file.
+** \param     message Pointer to the CAN message.
+**
+****************************************************************************************/
+static void DbcgenWriteDecoder(FILE * file, tDbcgenMessage const * message)
+{
+  tDbcgenSignal const * signal;
+  bool little = false;
+  bool big = false;
+  bool multiplexed = false;
+  char raw[DBCGEN_EXPR_MAX];
+  char value[2U * DBCGEN_EXPR_MAX];
+  char sign[32];
+  char factor[32];
+  char offset[32];
+
+  /* Determine which 64-bit values are needed. */
+  for (size_t sig = 0; sig < message->signalCount; sig++)
+  {
+    little = little || (!message->signals[sig].motorola);
+    big = big || (message->signals[sig].motorola);
+    multiplexed = multiplexed || (message->signals[sig].multiplexor);
+  }
+
+  fprintf(file, "bool %s%sDecode(tCanMsg const * msg, t%s%s * signals)\n{\n",
+          dbcgenCamel, message->camel, dbcgenCamel, message->camel);
+  fprintf(file, "  bool result = false;\n");
+  if (little)
+  {
+    fprintf(file, "  uint64_t le;\n");
+  }
+  if (big)
+  {
+    fprintf(file, "  uint64_t be;\n");
+  }
+  if (multiplexed)
+  {
+    fprintf(file, "  uint64_t mux;\n");
+  }
+  fprintf(file, "\n  if ( (msg != NULL) && (signals != NULL) && "
+          "(msg->len >= %uU) )\n  {\n", message->needed);
+  if (little)
+  {
+    fprintf(file, "    le = %sLoadLe(msg->data);\n", dbcgenCamel);
+  }
+  if (big)
+  {
+    fprintf(file, "    be = %sLoadBe(msg->data);\n", dbcgenCamel);
+  }
+  /* Multiplexed signals that are not present are not decoded. Clear them, instead of
+   * leaving whatever the caller had in the structure.
+   */
+  if (multiplexed)
+  {
+    fprintf(file, "    memset(signals, 0, sizeof(*signals));\n");
+  }
+
+  for (size_t sig = 0; sig < message->signalCount; sig++)
+  {
+    signal = &message->signals[sig];
+    DbcgenRawValue(signal, raw);
+    /* The multiplexor is handled first. Keep its raw value. */
+    if (signal->multiplexor)
+    {
+      fprintf(file, "    mux = %s;\n", raw);
+      snprintf(raw, sizeof(raw), "mux");
+    }
+    /* Sign extend the raw value. */
+    if ( (signal->sign) && (signal->valueType == 0) )
+    {
+      snprintf(sign, sizeof(sign), "0x%llXULL", 1ULL << (signal->size - 1U));
+      if (signal->size == 64U)
+      {
+        snprintf(value, sizeof(value), "(int64_t)%s", raw);
+      }
+      else
+      {
+        snprintf(value, sizeof(value), "%sSigned(%s, %s)", dbcgenCamel, raw, sign);
+      }
+    }
+    else if (signal->valueType == 1)
+    {
+      snprintf(value, sizeof(value), "%sFloat(%s)", dbcgenCamel, raw);
+    }
+    else if (signal->valueType == 2)
+    {
+      snprintf(value, sizeof(value), "%sDouble(%s)", dbcgenCamel, raw);
+    }
+    else
+    {
+      snprintf(value, sizeof(value), "%s", raw);
+    }
+    /* Only decode a multiplexed signal when it is present. */
+    if (signal->muxValue != DBCGEN_NOT_MULTIPLEXED)
+    {
+      fprintf(file, "    if (mux == %ldU)\n    {\n  ", signal->muxValue);
+    }
+    /* Scale the raw value to the physical value. */
+    if (DbcgenScaled(signal))
+    {
+      DbcgenNumber(signal->factor, true, factor);
+      DbcgenNumber(signal->offset, true, offset);
+      fprintf(file, "    signals->%s = ", signal->name);
+      if (signal->factor != 1.0)
+      {
+        fprintf(file, "(");
+      }
+      fprintf(file, "(double)%s", value);
+      if (signal->factor != 1.0)
+      {
+        fprintf(file, " * %s)", factor);
+      }
+      if (signal->offset > 0.0)
+      {
+        fprintf(file, " + %s", offset);
+      }
+      else if (signal->offset < 0.0)
+      {
+        DbcgenNumber(-signal->offset, true, offset);
+        fprintf(file, " - %s", offset);
+      }
+      fprintf(file, ";\n");
+    }
+    else
+    {
+      fprintf(file, "    signals->%s = (%s)%s;\n", signal->name, DbcgenFieldType(signal),
+              value);
+    }
+    if (signal->muxValue != DBCGEN_NOT_MULTIPLEXED)
+    {
+      fprintf(file, "    }\n");
+    }
+  }
+  fprintf(file, "    result = true;\n  }\n  return result;\n}\n\n");
+} /*** end of DbcgenWriteDecoder ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the encoder of a CAN message.
+** \param     file The generated source file.
+** \param     message Pointer to the CAN message.
+**
+****************************************************************************************/
+static void DbcgenWriteEncoder(FILE * file, tDbcgenMessage const * message)
+{
+  tDbcgenSignal const * signal;
+  bool multiplexed = false;
+  char raw[DBCGEN_EXPR_MAX];
+  char mask[32];
+  char factor[32];
+  char offset[32];
+  char min[32];
+  char max[32];
+
+  /* Determine if the CAN message is multiplexed. */
+  for (size_t sig = 0; sig < message->signalCount; sig++)
+  {
+    multiplexed = multiplexed || (message->signals[sig].multiplexor);
+  }
+
+  fprintf(file, "void %s%sEncode(t%s%s const * signals, tCanMsg * msg)\n{\n",
+          dbcgenCamel, message->camel, dbcgenCamel, message->camel);
+  fprintf(file, "  uint64_t le = 0;\n  uint64_t be = 0;\n");
+  if (multiplexed)
+  {
+    fprintf(file, "  uint64_t mux;\n");
+  }
+  fprintf(file, "\n  if ( (signals != NULL) && (msg != NULL) )\n  {\n");
+
+  for (size_t sig = 0; sig < message->signalCount; sig++)
+  {
+    signal = &message->signals[sig];
+    DbcgenMask(signal->size, mask);
+    DbcgenNumber(signal->factor, true, factor);
+    DbcgenNumber(signal->offset, true, offset);
+    /* Convert the physical value to the raw value. */
+    if ( (signal->valueType != 0) && (DbcgenScaled(signal)) )
+    {
+      snprintf(raw, sizeof(raw), "%s%sRaw((%s)((signals->%s - %s) / %s))", dbcgenCamel,
+               (signal->valueType == 1) ? "Float" : "Double",
+               (signal->valueType == 1) ? "float" : "double", signal->name, offset,
+               factor);
+    }
+    else if (signal->valueType != 0)
+    {
+      snprintf(raw, sizeof(raw), "%s%sRaw(signals->%s)", dbcgenCamel,
+               (signal->valueType == 1) ? "Float" : "Double", signal->name);
+    }
+    else if ( (DbcgenScaled(signal)) && (signal->sign) )
+    {
+      DbcgenLimit(signal->size - 1U, max);
+      snprintf(min, sizeof(min), "-%llu.0",
+               (unsigned long long)(1ULL << (signal->size - 1U)));
+      snprintf(raw, sizeof(raw), "(%sRawSigned(signals->%s, %s, %s, %s, %s) & %s)",
+               dbcgenCamel, signal->name, factor, offset, min, max, mask);
+    }
+    else if (DbcgenScaled(signal))
+    {
+      DbcgenLimit(signal->size, max);
+      snprintf(raw, sizeof(raw), "%sRawUnsigned(signals->%s, %s, %s, %s)",
+               dbcgenCamel, signal->name, factor, offset, max);
+    }
+    else if (signal->sign)
+    {
+      snprintf(raw, sizeof(raw), "((uint64_t)(int64_t)signals->%s & %s)", signal->name,
+               mask);
+    }
+    else
+    {
+      snprintf(raw, sizeof(raw), "((uint64_t)signals->%s & %s)", signal->name, mask);
+    }
+    /* Keep the raw value of the multiplexor. */
+    if (signal->multiplexor)
+    {
+      fprintf(file, "    mux = %s;\n", raw);
+      snprintf(raw, sizeof(raw), "mux");
+    }
+    /* Only encode a multiplexed signal when it is present. */
+    if (signal->muxValue != DBCGEN_NOT_MULTIPLEXED)
+    {
+      fprintf(file, "    if (mux == %ldU)\n    {\n  ", signal->muxValue);
+    }
+    /* Put the raw value in place. */
+    if (signal->shift == 0)
+    {
+      fprintf(file, "    %s |= %s;\n", signal->motorola ? "be" : "le", raw);
+    }
+    else
+    {
+      fprintf(file, "    %s |= %s << %u;\n", signal->motorola ? "be" : "le", raw,
+              signal->shift);
+    }
+    if (signal->muxValue != DBCGEN_NOT_MULTIPLEXED)
+    {
+      fprintf(file, "    }\n");
+    }
+  }
+  fprintf(file, "    msg->id = %s_%s_ID;\n", dbcgenMacro, message->macro);
+  fprintf(file, "    msg->ext = %s_%s_EXT;\n", dbcgenMacro, message->macro);
+  fprintf(file, "    msg->len = %s_%s_LEN;\n", dbcgenMacro, message->macro);
+  fprintf(file, "    %sStore(msg->data, le, be);\n  }\n}\n\n", dbcgenCamel);
+} /*** end of DbcgenWriteEncoder ***/
+
+
+/*********************************** end of dbcgen.c ***********************************/
@@ -0,0 +1,284 @@
+/************************************************************************************//**
+* \file         extractbench.c
+* \brief        Benchmark of the batch signal extraction.
+* \details      Extracts a set of typical signals from generated CAN messages with the
+*               same identifier, once with a byte-wise loop per signal and per CAN
+*               message and once with the batch signal extraction. It checks that both
+*               give the same physical values and reports their throughput in
+*               nanoseconds per signal value.
+*
+*               Usage: extractbench
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "caplin.h"                         /* Caplin functionality                    */
+#include <time.h>                           /* Date and time utilities                 */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of CAN messages that are generated. */
+#define EXTRACTBENCH_MESSAGES          (1000000UL)
+
+/** \brief Number of times that the extraction is repeated. The fastest run is
+ *  reported.
+ */
+#define EXTRACTBENCH_RUNS              (5U)
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Signals of the CAN message, with both byte orders, signed and unsigned
+ *  values and sizes from a single bit up to the full 64 bits.
+ */
+static tExtractSignal const extractbenchSignals[] =
+{
+  /* start, size, motorola, sign, factor, offset */
+  {  0U,  4U, false, false, 1.0,     0.0    },
+  {  4U,  4U, false, false, 1.0,     0.0    },
+  {  8U, 16U, false, false, 0.25,    0.0    },
+  { 24U, 12U, false, true,  0.1,    -40.0   },
+  { 36U,  1U, false, false, 1.0,     0.0    },
+  { 37U, 27U, false, true,  0.001,   0.0    },
+  {  7U, 16U, true,  false, 0.125,   0.0    },
+  { 23U, 10U, true,  true,  0.5,     100.0  },
+  { 29U, 30U, true,  false, 1e-6,    0.0    },
+  { 63U,  3U, true,  false, 1.0,     0.0    },
+  {  0U, 64U, false, false, 1.0,     0.0    },
+  {  7U, 64U, true,  true,  1.0,     0.0    }
+};
+
+/** \brief Number of signals of the CAN message. */
+#define EXTRACTBENCH_SIGNALS \
+  (sizeof(extractbenchSignals) / sizeof(extractbenchSignals[0]))
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static double   ExtractbenchBytewise(tLoggerRecord const * record,
+                                     tExtractSignal const * signal);
+static double   ExtractbenchNow(void);
+static uint32_t ExtractbenchRandom(void);
+
+
+/************************************************************************************//**
+** \brief     This is the program entry point.
+** \param     argc Number of program arguments.
+** \param     argv Array with program arguments.
+** \return    Program return code. 0 for success, error code otherwise.
+**
+****************************************************************************************/
+int main(int argc, char *argv[])
+{
+  int result = EXIT_FAILURE;
+  tLoggerRecord * records;
+  double * columns[EXTRACTBENCH_SIGNALS] = { NULL };
+  double * expected = NULL;
+  bool allocated = true;
+  size_t errors = 0;
+  double start;
+  double bytewiseTime = 0.0;
+  double batchTime = 0.0;
+  double valueCount;
+
+  (void)argc;
+  (void)argv;
+
+  /* Allocate memory for the CAN messages and the physical values. */
+  records = malloc(EXTRACTBENCH_MESSAGES * sizeof(tLoggerRecord));
+  expected = malloc(EXTRACTBENCH_MESSAGES * EXTRACTBENCH_SIGNALS * sizeof(double));
+  for (size_t sig = 0; sig < EXTRACTBENCH_SIGNALS; sig++)
+  {
+    columns[sig] = malloc(EXTRACTBENCH_MESSAGES * sizeof(double));
+    allocated = allocated && (columns[sig] != NULL);
+  }
+
+  /* Only continue with memory. */
+  if ( (records != NULL) && (expected != NULL) && (allocated) )
+  {
+    /* Generate CAN messages with random data. Some are shorter, with leftover data in
+     * the bytes beyond their data length.
+     */
+    for (size_t idx = 0; idx < EXTRACTBENCH_MESSAGES; idx++)
+    {
+      memset(&records[idx], 0, sizeof(tLoggerRecord));
+      records[idx].id = 0x123U;
+      records[idx].len = ((idx % 16U) == 0) ? 6U : CAN_DATA_LEN_MAX;
+      for (uint32_t byte = 0; byte < CAN_DATA_LEN_MAX; byte++)
+      {
+        records[idx].data[byte] = (uint8_t)ExtractbenchRandom();
+      }
+    }
+
+    for (uint32_t run = 0; run < EXTRACTBENCH_RUNS; run++)
+    {
+      /* Extract the signals with a byte-wise loop per CAN message. */
+      start = ExtractbenchNow();
+      for (size_t idx = 0; idx < EXTRACTBENCH_MESSAGES; idx++)
+      {
+        for (size_t sig = 0; sig < EXTRACTBENCH_SIGNALS; sig++)
+        {
+          expected[(sig * EXTRACTBENCH_MESSAGES) + idx] =
+            ExtractbenchBytewise(&records[idx], &extractbenchSignals[sig]);
+        }
+      }
+      if ( (run == 0) || ((ExtractbenchNow() - start) < bytewiseTime) )
+      {
+        bytewiseTime = ExtractbenchNow() - start;
+      }
+
+      /* Extract the signals with the batch signal extraction. */
+      start = ExtractbenchNow();
+      if (!ExtractRecords(records, EXTRACTBENCH_MESSAGES, extractbenchSignals,
+                          EXTRACTBENCH_SIGNALS, columns))
+      {
+        errors++;
+      }
+      if ( (run == 0) || ((ExtractbenchNow() - start) < batchTime) )
+      {
+        batchTime = ExtractbenchNow() - start;
+      }
+    }
+
+    /* Compare the physical values. */
+    for (size_t sig = 0; sig < EXTRACTBENCH_SIGNALS; sig++)
+    {
+      for (size_t idx = 0; idx < EXTRACTBENCH_MESSAGES; idx++)
+      {
+        if (columns[sig][idx] != expected[(sig * EXTRACTBENCH_MESSAGES) + idx])
+        {
+          errors++;
+        }
+      }
+    }
+
+    /* Report the results. */
+    valueCount = (double)EXTRACTBENCH_MESSAGES * EXTRACTBENCH_SIGNALS;
+    printf("Messages:     %lu\n", EXTRACTBENCH_MESSAGES);
+    printf("Signals:      %zu\n", EXTRACTBENCH_SIGNALS);
+    printf("Kernel:       %s\n", ExtractKernelName());
+    printf("Byte-wise:    %.2f ns per value\n", bytewiseTime * 1e9 / valueCount);
+    printf("Batch:        %.2f ns per value\n", batchTime * 1e9 / valueCount);
+    printf("Speedup:      %.1fx\n", bytewiseTime / batchTime);
+    printf("Values:       %s\n", (errors == 0) ? "OK" : "MISMATCH");
+    if (errors == 0)
+    {
+      result = EXIT_SUCCESS;
+    }
+  }
+  else
+  {
+    printf("ERROR: Could not allocate memory.\n");
+  }
+
+  /* Release the memory. */
+  free(records);
+  free(expected);
+  for (size_t sig = 0; sig < EXTRACTBENCH_SIGNALS; sig++)
+  {
+    free(columns[sig]);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of main ***/
+
+
+/************************************************************************************//**
+** \brief     Extracts a signal from a record bit by bit. Bytes beyond the data length
+**            count as zero.
+** \param     record Pointer to the record.
+** \param     signal Pointer to the layout of the signal.
+** \return    The physical value.
+**
+****************************************************************************************/
+static double ExtractbenchBytewise(tLoggerRecord const * record,
+                                   tExtractSignal const * signal)
+{
+  uint64_t raw = 0;
+  uint32_t bit = signal->start;
+  uint32_t byte;
+  double result;
+
+  for (uint32_t idx = 0; idx < signal->size; idx++)
+  {
+    byte = bit / 8U;
+    /* A big endian signal runs from its most significant bit downwards, jumping to
+     * the next byte after bit 0 of a byte.
+     */
+    if (signal->motorola)
+    {
+      raw = (raw << 1) | ((byte < record->len) ?
+                          ((record->data[byte] >> (bit % 8U)) & 1U) : 0U);
+      bit = ((bit % 8U) == 0) ? (bit + 15U) : (bit - 1U);
+    }
+    /* A little endian signal runs from its least significant bit upwards. */
+    else
+    {
+      raw |= (uint64_t)((byte < record->len) ?
+                        ((record->data[byte] >> (bit % 8U)) & 1U) : 0U) << idx;
+      bit++;
+    }
+  }
+
+  /* Sign extend and scale the raw value. */
+  if ( (signal->sign) && (signal->size < 64U) && ((raw >> (signal->size - 1U)) != 0) )
+  {
+    raw |= UINT64_MAX << signal->size;
+  }
+  if (signal->sign)
+  {
+    result = ((double)(int64_t)raw * signal->factor) + signal->offset;
+  }
+  else
+  {
+    result = ((double)raw * signal->factor) + signal->offset;
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of ExtractbenchBytewise ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time of the monotonic clock.
+** \return    Time in seconds.
+**
+****************************************************************************************/
+static double ExtractbenchNow(void)
+{
+  struct timespec now;
+
+  /* Obtain the time and give it back to the caller. */
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+} /*** end of ExtractbenchNow ***/
+
+
+/************************************************************************************//**
+** \brief     Generates a pseudo random number with a xorshift generator, so that the
+**            generated CAN messages are the same on each run.
+** \return    The pseudo random number.
+**
+****************************************************************************************/
+static uint32_t ExtractbenchRandom(void)
+{
+  static uint32_t state = 2463534242UL;
+
+  /* Advance the generator. */
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+
+  /* Give the result back to the caller. */
+  return state;
+} /*** end of ExtractbenchRandom ***/
+
+
+/*********************************** end of extractbench.c *****************************/
@@ -0,0 +1,323 @@
+/************************************************************************************//**
+* \file         packbench.c
+* \brief        Benchmark of the compressed capture file encoder and decoder.
+* \details      Encodes and decodes CAN traffic in memory and reports the compression
+*               ratio and the throughput. The throughput is measured in megabytes of
+*               logger records per second. Without arguments, it generates typical
+*               traffic of a vehicle bus: mostly cyclic CAN messages with counters and
+*               slowly changing signals, plus some event driven CAN messages. Otherwise
+*               it reads the CAN messages from the specified log file.
+*
+*               Usage: packbench [FILE]
+*
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "caplin.h"                         /* Caplin functionality                    */
+#include <time.h>                           /* Date and time utilities                 */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of CAN messages that are generated. */
+#define PACKBENCH_MESSAGES             (10000000UL)
+
+/** \brief Number of cyclic CAN identifiers that are generated. */
+#define PACKBENCH_CYCLIC_IDS           (80U)
+
+/** \brief Number of times that the encoding and the decoding are repeated. The fastest
+ *  run is reported.
+ */
+#define PACKBENCH_RUNS                 (5U)
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Encoder and decoder state. They are large, so not on the stack. */
+static tPackCodec packbenchCodec;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static size_t   PackbenchGenerate(tLoggerRecord * records, size_t count);
+static size_t   PackbenchLoad(char const * path, tLoggerRecord ** records);
+static double   PackbenchNow(void);
+static uint32_t PackbenchRandom(void);
+
+
+/************************************************************************************//**
+** \brief     This is the program entry point.
+** \param     argc Number of program arguments.
+** \param     argv Array with program arguments.
+** \return    Program return code. 0 for success, error code otherwise.
+**
+****************************************************************************************/
+int main(int argc, char *argv[])
+{
+  int result = EXIT_FAILURE;
+  tLoggerRecord * records = NULL;
+  tLoggerRecord decoded;
+  uint8_t * packed = NULL;
+  size_t count = 0;
+  size_t size = 0;
+  size_t pos;
+  size_t used;
+  size_t errors = 0;
+  double start;
+  double encodeTime = 0.0;
+  double decodeTime = 0.0;
+  double rawSize;
+
+  /* Obtain the CAN messages. */
+  if (argc > 1)
+  {
+    count = PackbenchLoad(argv[1], &records);
+  }
+  else
+  {
+    records = malloc(PACKBENCH_MESSAGES * sizeof(tLoggerRecord));
+    if (records != NULL)
+    {
+      count = PackbenchGenerate(records, PACKBENCH_MESSAGES);
+    }
+  }
+  if (count > 0)
+  {
+    packed = malloc(count * PACK_RECORD_MAX);
+  }
+
+  /* Only continue with CAN messages and memory for the encoded ones. */
+  if (packed != NULL)
+  {
+    for (uint32_t run = 0; run < PACKBENCH_RUNS; run++)
+    {
+      /* Encode all CAN messages. */
+      start = PackbenchNow();
+      PackCodecReset(&packbenchCodec);
+      size = 0;
+      for (size_t idx = 0; idx < count; idx++)
+      {
+        size += PackEncode(&packbenchCodec, &records[idx], &packed[size]);
+      }
+      if ( (run == 0) || ((PackbenchNow() - start) < encodeTime) )
+      {
+        encodeTime = PackbenchNow() - start;
+      }
+
+      /* Decode all CAN messages and compare them with the originals. */
+      start = PackbenchNow();
+      PackCodecReset(&packbenchCodec);
+      pos = 0;
+      for (size_t idx = 0; idx < count; idx++)
+      {
+        used = PackDecode(&packbenchCodec, &packed[pos], size - pos, &decoded);
+        pos += used;
+        if ( (used == 0) || (decoded.timestamp != records[idx].timestamp) ||
+             (decoded.id != records[idx].id) || (decoded.len != records[idx].len) ||
+             (decoded.flags != records[idx].flags) ||
+             (memcmp(decoded.data, records[idx].data, CAN_DATA_LEN_MAX) != 0) )
+        {
+          errors++;
+        }
+      }
+      if ( (run == 0) || ((PackbenchNow() - start) < decodeTime) )
+      {
+        decodeTime = PackbenchNow() - start;
+      }
+    }
+
+    /* Report the results. */
+    rawSize = (double)count * sizeof(tLoggerRecord);
+    printf("Messages:     %zu\n", count);
+    printf("Raw size:     %.1f MB (%zu bytes per message)\n", rawSize / 1e6,
+           sizeof(tLoggerRecord));
+    printf("Packed size:  %.1f MB (%.2f bytes per message)\n", (double)size / 1e6,
+           (double)size / (double)count);
+    printf("Ratio:        %.1f : 1\n", rawSize / (double)size);
+    printf("Encode:       %.0f MB/s, %.1f ns per message\n", rawSize / encodeTime / 1e6,
+           encodeTime * 1e9 / (double)count);
+    printf("Decode:       %.0f MB/s, %.1f ns per message\n", rawSize / decodeTime / 1e6,
+           decodeTime * 1e9 / (double)count);
+    printf("Round trip:   %s\n", (errors == 0) ? "OK" : "MISMATCH");
+    if (errors == 0)
+    {
+      result = EXIT_SUCCESS;
+    }
+  }
+  else
+  {
+    printf("ERROR: Could not obtain the CAN messages.\n");
+  }
+
+  /* Release the memory. */
+  free(records);
+  free(packed);
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of main ***/
+
+
+/************************************************************************************//**
+** \brief     Generates typical traffic of a vehicle bus. Cyclic CAN messages with
+**            periods of 10 ms to 1 s and some timing jitter. Their data holds constant
+**            bytes, an alive counter and slowly changing signals. Some CAN messages
+**            are event driven, with 29-bit identifiers and random data.
+** \param     records Array where the records are stored.
+** \param     count Number of records to generate.
+** \return    Number of generated records.
+**
+****************************************************************************************/
+static size_t PackbenchGenerate(tLoggerRecord * records, size_t count)
+{
+  static uint32_t const periods[] = { 10000U, 20000U, 50000U, 100000U, 1000000U };
+  uint64_t next[PACKBENCH_CYCLIC_IDS];
+  uint8_t data[PACKBENCH_CYCLIC_IDS][CAN_DATA_LEN_MAX];
+  uint64_t now = 1700000000000000ULL;
+  uint32_t earliest;
+  tLoggerRecord * record;
+
+  /* Stagger the cyclic CAN messages and give them constant data. */
+  for (uint32_t id = 0; id < PACKBENCH_CYCLIC_IDS; id++)
+  {
+    next[id] = now + (PackbenchRandom() % 10000U);
+    for (uint32_t idx = 0; idx < CAN_DATA_LEN_MAX; idx++)
+    {
+      data[id][idx] = (uint8_t)PackbenchRandom();
+    }
+  }
+
+  for (size_t idx = 0; idx < count; idx++)
+  {
+    record = &records[idx];
+    memset(record, 0, sizeof(*record));
+    /* Once in a while an event driven CAN message. */
+    if ((PackbenchRandom() % 100U) == 0)
+    {
+      record->timestamp = now + (PackbenchRandom() % 50U);
+      record->id = 0x18DA0000UL | (PackbenchRandom() % 0x10000U);
+      record->flags = LOGGER_FLAG_EXT;
+      record->len = CAN_DATA_LEN_MAX;
+      for (uint32_t byte = 0; byte < CAN_DATA_LEN_MAX; byte++)
+      {
+        record->data[byte] = (uint8_t)PackbenchRandom();
+      }
+    }
+    /* Otherwise the cyclic CAN message that is due first. */
+    else
+    {
+      earliest = 0;
+      for (uint32_t id = 1; id < PACKBENCH_CYCLIC_IDS; id++)
+      {
+        if (next[id] < next[earliest])
+        {
+          earliest = id;
+        }
+      }
+      now = next[earliest];
+      next[earliest] += periods[earliest % 5U] + (PackbenchRandom() % 100U) - 50U;
+      /* Byte 0 is an alive counter and byte 1 changes once in a while. */
+      data[earliest][0]++;
+      if ((PackbenchRandom() % 8U) == 0)
+      {
+        data[earliest][1] += (uint8_t)((PackbenchRandom() % 3U) - 1U);
+      }
+      record->timestamp = now;
+      record->id = 0x100U + (earliest * 8U);
+      record->len = CAN_DATA_LEN_MAX;
+      memcpy(record->data, data[earliest], CAN_DATA_LEN_MAX);
+    }
+  }
+
+  /* Give the result back to the caller. */
+  return count;
+} /*** end of PackbenchGenerate ***/
+
+
+/************************************************************************************//**
+** \brief     Loads the CAN messages from a log file into memory.
+** \param     path Path of the log file.
+** \param     records Pointer to where the pointer to the allocated records is stored.
+** \return    Number of loaded records.
+**
+****************************************************************************************/
+static size_t PackbenchLoad(char const * path, tLoggerRecord ** records)
+{
+  size_t result = 0;
+  size_t size = 0;
+  tLoggerRecord * grown;
+  tReplayFile file;
+  tCanMsg msg;
+
+  /* Read all CAN messages and grow the array as needed. */
+  if (ReplayFileOpen(&file, path))
+  {
+    while (ReplayFileRead(&file, &msg))
+    {
+      if (result == size)
+      {
+        size = (size == 0) ? 65536U : (2U * size);
+        grown = realloc(*records, size * sizeof(tLoggerRecord));
+        if (grown == NULL)
+        {
+          break;
+        }
+        *records = grown;
+      }
+      memset(&(*records)[result], 0, sizeof(tLoggerRecord));
+      (*records)[result].timestamp = msg.timestamp;
+      (*records)[result].id = msg.id;
+      (*records)[result].len = msg.len;
+      (*records)[result].flags = msg.ext ? LOGGER_FLAG_EXT : 0U;
+      memcpy((*records)[result].data, msg.data, msg.len);
+      result++;
+    }
+    ReplayFileClose(&file);
+  }
+
+  /* Give the result back to the caller. */
+  return result;
+} /*** end of PackbenchLoad ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time of the monotonic clock.
+** \return    Time in seconds.
+**
+****************************************************************************************/
+static double PackbenchNow(void)
+{
+  struct timespec now;
+
+  /* Obtain the time and give it back to the caller. */
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+} /*** end of PackbenchNow ***/
+
+
+/************************************************************************************//**
+** \brief     Generates a pseudo random number with a xorshift generator, so that the
+**            generated traffic is the same on each run.
+** \return    The pseudo random number.
+**
+****************************************************************************************/
+static uint32_t PackbenchRandom(void)
+{
+  static uint32_t state = 2463534242UL;
+
+  /* Advance the generator. */
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+
+  /* Give the result back to the caller. */
+  return state;
+} /*** end of PackbenchRandom ***/
+
+
+/*********************************** end of packbench.c ********************************/